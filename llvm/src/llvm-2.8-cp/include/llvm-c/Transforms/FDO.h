@@ -21,6 +21,17 @@ extern "C" {
 #endif
 
 void LLVMAddFDOInlinerPass(LLVMPassManagerRef PM);
+void LLVMAddFDOInlineSimPass(LLVMPassManagerRef PM);
+void LLVMAddFDOValueSpecPass(LLVMPassManagerRef PM);
+void LLVMAddFDOICallPromotionPass(LLVMPassManagerRef PM);
+void LLVMAddFDOBlockLayoutPass(LLVMPassManagerRef PM);
+void LLVMAddFDOColdSplitPass(LLVMPassManagerRef PM);
+void LLVMAddFDOFunctionOrderPass(LLVMPassManagerRef PM);
+void LLVMAddFDOTripCountsPass(LLVMPassManagerRef PM);
+void LLVMAddFDOSuperblocksPass(LLVMPassManagerRef PM);
+void LLVMAddFDOBranchWeightsPass(LLVMPassManagerRef PM);
+void LLVMAddFDOBlockFreqsPass(LLVMPassManagerRef PM);
+void LLVMAddFDOMultiversionPass(LLVMPassManagerRef PM);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,88 @@
+//===- CFGChecksum.h - Matching the counters of changed code ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The counter layout of a profiled module (CFGChecksumInfo): for every
+// defined function, a hash of its name, a checksum of the shape of its
+// CFG, the range of its counters, and a signature of what each counter
+// counts.  A run (or combined profile) of another version of the module
+// is mapped onto this one function by function: a function with the
+// same checksum keeps its counters; a changed one keeps the counters
+// whose signatures match, if enough of them do (-cp-stale-match).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_CFGCHECKSUM_H
+#define LLVM_ANALYSIS_CFGCHECKSUM_H
+
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include <vector>
+
+namespace llvm {
+
+  class BasicBlock;
+  class Function;
+  class Module;
+
+  // the counters of one function: its entry, the signature of each
+  // counter of its range, and, for combined edge profiles, the counter
+  // each is normalized by (empty if not known)
+  struct CFGFunctionLayout {
+    CFGChecksumEntry entry;
+    std::vector<unsigned> signatures;
+    std::vector<unsigned> dominators;
+  };
+
+  // one per defined function, in module order
+  typedef std::vector<CFGFunctionLayout> CFGLayout;
+
+  class CFGChecksum {
+  public:
+    // the counter a counter is mapped from: none
+    static const unsigned NoCounter = ~0U;
+
+    static unsigned nameHash(const Function& F);
+    // the shape of F's CFG: the successors of each block, in order
+    static unsigned checksum(const Function& F);
+    // what BB does: its opcodes, callees and number of successors
+    static unsigned blockSignature(const BasicBlock* BB);
+    // successor edge s of BB, by its source and target
+    static unsigned edgeSignature(const BasicBlock* BB, unsigned s);
+
+    // The edge counters (EdgeInfo) of M, numbered as the edge profiler
+    // does: per function, the entry edge, then the successor edges of
+    // every block
+    static void edgeLayout(const Module& M, CFGLayout& layout);
+    // One counter per block of blocks (in module order), numbered from
+    // first on
+    static void blockLayout(const Module& M,
+                            const std::vector<BasicBlock*>& blocks,
+                            unsigned first, CFGLayout& layout);
+
+    // The words of a CFGChecksumInfo block: PT, the type of the
+    // counters, then each function's entry and signatures (and
+    // dominators, if PT is CombinedEdgeInfo)
+    static void encode(ProfilingType PT, const CFGLayout& layout,
+                       std::vector<unsigned>& words);
+    static bool decode(const std::vector<unsigned>& words, ProfilingType& PT,
+                       CFGLayout& layout);
+
+    // Maps the functions and counters of current (this module) to those
+    // of old (the profiled version): function[f] is the function of old
+    // that current function f is matched to (-1: none), source[c] the
+    // counter of old that current counter c is mapped from (NoCounter:
+    // none), for the counters of the ranges of current.  Returns false
+    // (and maps nothing) if old is current.
+    static bool match(const CFGLayout& old, const CFGLayout& current,
+                      std::vector<int>& function,
+                      std::vector<unsigned>& source);
+  };
+
+} // namespace llvm
+
+#endif
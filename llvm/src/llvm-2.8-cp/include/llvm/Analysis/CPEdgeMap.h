@@ -0,0 +1,95 @@
+//===- CPEdgeMap.h - CFG edges of a combined edge profile ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Maps the CFG edges of a module to the histograms of a combined edge
+// profile.  Edges are numbered as by the edge profiler (and
+// EdgeDominatorTree): per defined function, the entry edge, then the
+// successor edges of every block, in order.  The numbering depends on
+// the block order, so build the map before changing the CFG or the
+// layout.
+//
+// The histograms are hierarchically normalized (executions of the edge
+// per execution of its edge dominator).  chainWeights turns them into
+// expected executions per call of the function, by multiplying one
+// statistic of each histogram down the edge dominator tree (ie, the
+// normalized frequencies are treated as independent).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_CPEDGEMAP_H
+#define LLVM_ANALYSIS_CPEDGEMAP_H
+
+#include <map>
+#include <vector>
+
+namespace llvm {
+
+  class BasicBlock;
+  class CombinedEdgeProfile;
+  class CPHistogram;
+  class Function;
+  class Module;
+
+  class CPEdgeMap {
+  public:
+    // a statistic of a normalized edge histogram
+    typedef double (*EdgeStat)(const CPHistogram& hist, double q);
+
+    CPEdgeMap(Module& M, CombinedEdgeProfile& cep);
+
+    // false if the profile does not have the module's edge count
+    bool valid() const { return(_valid); };
+    // number of edges of the module
+    unsigned size() const { return(_size); };
+
+    bool hasFunction(Function* F) const;
+    unsigned entryEdge(Function* F) const;
+    unsigned edge(BasicBlock* BB, unsigned succ) const;
+    // number of edges of F (entry edge included)
+    unsigned edgeCount(Function* F) const;
+
+    CPHistogram& histogram(unsigned e);
+    unsigned dominator(unsigned e) const;
+
+    // Weight of every edge of F, indexed by e - entryEdge(F): the
+    // entry edge weighs scale; roots of unreachable regions weigh 0
+    void chainWeights(Function* F, EdgeStat stat, double q, double scale,
+                      std::vector<double>& weights);
+
+    // true if no edge into BB ran in any profiled run
+    bool neverExecuted(BasicBlock* BB);
+    // fraction of the runs in which BB ran (at least the largest
+    // coverage of its incoming edges)
+    double coverage(BasicBlock* BB);
+
+    // Statistics over all runs, zeros (runs where the edge did not
+    // execute) included.  q is ignored by meanStat.
+    static double meanStat(const CPHistogram& hist, double q);
+    static double quantileStat(const CPHistogram& hist, double q);
+    // mean of the lowest q of the runs (lower-tail expectation)
+    static double tailMeanStat(const CPHistogram& hist, double q);
+    // estimate of P(X < Y) over runs, zeros included; ties count half
+    static double probLess(const CPHistogram& X, const CPHistogram& Y);
+
+  private:
+    double chain(unsigned e, unsigned first, EdgeStat stat, double q,
+                 double scale, std::vector<double>& weights);
+
+    CombinedEdgeProfile& _cep;
+    std::map<Function*, unsigned> _entry;
+    std::map<Function*, unsigned> _count;
+    std::map<BasicBlock*, unsigned> _first;   // first successor edge
+    std::map<BasicBlock*, std::vector<unsigned> > _preds;  // edges into
+    unsigned _size;
+    bool _valid;
+  };
+
+} // namespace llvm
+
+#endif
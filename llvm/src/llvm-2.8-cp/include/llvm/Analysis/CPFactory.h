@@ -8,7 +8,7 @@
 //===----------------------------------------------------------------------===//
 //
 // Takes raw and/or combined profiles from one or more profile file
-// and combines the like-typed profiles (edge/path/call) into a single
+// and combines the like-typed profiles (edge/path/call/value) into a single
 // combined profile of that type.
 //
 //===----------------------------------------------------------------------===//
@@ -22,6 +22,8 @@
 #include "llvm/Analysis/ProfileInfoTypes.h"
 #include "llvm/Analysis/CombinedProfile.h"
 
+#include <map>
+#include <set>
 #include <vector>
 
 namespace llvm {
@@ -39,9 +41,19 @@ namespace llvm {
     bool buildProfiles(cl::list<std::string>& filenames);
     bool buildProfiles(const std::string& filename);
 
+    // Only combine the raw profiles of these runs (empty: all runs).
+    // Runs are numbered from 0 over the files in order; a run starts
+    // at the beginning of a file and at every argument block after
+    // its first.  Combined profiles in the files are not filtered.
+    void selectRuns(const std::set<unsigned>& runs) {_runs = runs;};
+
     bool hasCallCP() {return(_callCP != NULL);};
     bool hasEdgeCP() {return(_edgeCP != NULL);};
     bool hasPathCP() {return(_pathCP != NULL);};
+    bool hasValueCP() {return(_valueCP != NULL);};
+    bool hasICallCP() {return(_icallCP != NULL);};
+    bool hasContextPathCP() {return(_contextPathCP != NULL);};
+    bool hasLoopPathCP() {return(_loopPathCP != NULL);};
 
     // the caller of a 'take' method also takes responsibility for
     // deallocating the CP.  A CP can only be taken once.
@@ -54,8 +66,25 @@ namespace llvm {
     CombinedPathProfile* takePathCP()
     { CombinedPathProfile* tmp = _pathCP; _pathCP = NULL; return(tmp); };
 
+    CombinedValueProfile* takeValueCP()
+    { CombinedValueProfile* tmp = _valueCP; _valueCP = NULL; return(tmp); };
+
+    CombinedICallProfile* takeICallCP()
+    { CombinedICallProfile* tmp = _icallCP; _icallCP = NULL; return(tmp); };
+
+    CombinedContextPathProfile* takeContextPathCP()
+    { CombinedContextPathProfile* tmp = _contextPathCP;
+      _contextPathCP = NULL; return(tmp); };
+    CombinedLoopPathProfile* takeLoopPathCP()
+    { CombinedLoopPathProfile* tmp = _loopPathCP;
+      _loopPathCP = NULL; return(tmp); };
+
     static const std::string& profilingTypeToString(ProfilingType p);
 
+    // skip the data of a raw profile block (after its type), false if
+    // the type is not a raw profile or the block is truncated
+    static bool skipRawProfile(ProfilingType p, FILE* file);
+
     void clear();
 
     // free the static data of CP classes (CPFactory itself doesn't have any)
@@ -65,9 +94,22 @@ namespace llvm {
     CombinedCallProfile* _callCP;
     CombinedEdgeProfile* _edgeCP;
     CombinedPathProfile* _pathCP;
+    CombinedValueProfile* _valueCP;
+    CombinedICallProfile* _icallCP;
+    CombinedContextPathProfile* _contextPathCP;
+    CombinedLoopPathProfile* _loopPathCP;
 
     bool skipArgumentInfo(FILE* file);
+    bool readSampleInfo(FILE* file, unsigned run);
+    bool readCounterMap(FILE* file, 
+                        std::map<ProfilingType,CounterMapVec>& maps);
+    bool readCFGChecksums(FILE* file,
+                          std::map<ProfilingType,CFGLayout>& layouts,
+                          CombinedProfile* lastCP);
+    bool readPrunedCounters(FILE* file,
+                    std::map<ProfilingType,std::vector<unsigned> >& pruned);
     Module& _M;
+    std::set<unsigned> _runs;  // selected runs (empty: all)
 
   private:
     CPFactory(); // do not implement
@@ -0,0 +1,82 @@
+//===- CPFunctionOrder.h - Function order from a call profile --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Computes a code layout order of the functions of a module from a
+// combined call profile, by call-chain clustering (C3): functions are
+// visited from the most called down, and each one is appended to the
+// cluster of its heaviest caller unless the merged cluster would exceed
+// a size limit (about a page); the clusters are then sorted by density
+// (calls per instruction).  Never-called functions come last, in module
+// order.
+//
+// The call profile holds, per block with calls, the distribution over
+// runs of its executions per call of its function.  Call counts are
+// estimated by propagating one per run from main (or from every
+// function without callers) down the call graph, in reverse post order
+// (back edges, ie recursion, are not propagated), using a quantile of
+// each call block's distribution (zeros included): a low quantile only
+// clusters callers and callees that are together in most runs.
+//
+// The profile must match the module; compute the order before
+// transforming it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_CPFUNCTIONORDER_H
+#define LLVM_ANALYSIS_CPFUNCTIONORDER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class CombinedCallProfile;
+  class Function;
+  class Module;
+  class raw_ostream;
+
+  class CPFunctionOrder {
+  public:
+    typedef std::vector<Function*> Order;
+
+    // q: quantile of the call block distributions; maxCluster: largest
+    // cluster (instructions)
+    CPFunctionOrder(Module& M, CombinedCallProfile& ccp, double q,
+                    unsigned maxCluster);
+
+    const Order& getOrder() const { return(_order); };
+
+    // estimated calls per run
+    double getCalls(Function* F) const;
+
+    // one line per function: its section name (for gold's
+    // --section-ordering-file) or its symbol name
+    void writeOrderFile(raw_ostream& stream, bool sections) const;
+
+    static std::string getSectionName(Function* F);
+
+  private:
+    typedef std::map<Function*, double> CallWeights;  // callee --> weight
+    typedef std::map<Function*, CallWeights> CallGraphWeights;
+
+    void buildCallWeights(Module& M, CombinedCallProfile& ccp, double q);
+    void estimateCalls(Module& M);
+    void cluster(Module& M, unsigned maxCluster);
+    static unsigned functionSize(Function* F);
+
+    CallGraphWeights _callees;   // caller --> callee --> calls per call
+    CallGraphWeights _callers;   // callee --> caller --> calls per call
+    std::map<Function*, double> _calls;
+    Order _order;
+  };
+
+} // namespace llvm
+
+#endif
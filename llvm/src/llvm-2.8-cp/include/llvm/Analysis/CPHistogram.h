@@ -81,6 +81,8 @@ namespace llvm {
     double zeroWeight() const;
     double totalWeight() const;
     double maxWeight() const;
+    // the zeros are implicit: changing the total changes their weight
+    void setTotalWeight(double totalweight);
 
     double occupancy() const;
     double coverage() const;
@@ -126,6 +128,9 @@ namespace llvm {
     bool serialize(unsigned ID, FILE* f) const;
     // returns ID on success, -1 on errro
     int deserialize(unsigned bincount, double totalweight, FILE* f);
+    // returns true on success; for IDs that do not fit in an int
+    bool deserialize(unsigned bincount, double totalweight, FILE* f,
+                     unsigned& ID);
     void print(llvm::raw_ostream& stream) const;
     void printStats(llvm::raw_ostream& stream) const;
 
@@ -17,6 +17,7 @@
 #include <stdio.h>
 
 #include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/Analysis/CFGChecksum.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/CallSite.h"  // CallSites are value classes
 #include <vector>
@@ -35,6 +36,10 @@ namespace llvm {
 	class CombinedEdgeProfile;
 	class CombinedPathProfile;
   class CombinedCallProfile;
+  class CombinedValueProfile;
+  class CombinedICallProfile;
+  class CombinedContextPathProfile;
+  class CombinedLoopPathProfile;
 
 	// --------------------------------------------------------------------------
 	// CombinedProfile - Implements a set of common functions and variables used
@@ -47,6 +52,8 @@ namespace llvm {
 
 	typedef std::list<CombinedProfile*> CPList;
 
+  typedef std::vector<CounterMapEntry> CounterMapVec;
+
   class CombinedProfile {
   public:
 		CombinedProfile();
@@ -83,6 +90,38 @@ namespace llvm {
 		double getTotalWeight() const;
 		void addWeight(double w = 1.0);
 
+    // Selective instrumentation: the counter map (CounterMapInfo) of the
+    // run the next addProfile reads, one entry per defined function in
+    // module order (empty: every function was instrumented).  What a run
+    // left uninstrumented is unknown in that run, not 0: the run does
+    // not count toward the weight of its histograms.
+    void setCounterMap(const CounterMapVec& map)
+    {_counterMap = map;};
+    // the weight of the runs in which key (a histogram index, or a
+    // function number for path profiles) was known
+    double getKnownWeight(unsigned key) const;
+    // the unknown weights, written after the profile (CombinedUnknownInfo,
+    // only if there are any)
+    bool serializeUnknown(FILE* f) const;
+    bool deserializeUnknown(FILE* f);
+
+    // Stale profiles: the CFG checksums and counters (CFGChecksumInfo)
+    // of the version of the module that the run the next addProfile
+    // reads profiled (empty: unknown, taken to be this one).
+    void setCounterLayout(const CFGLayout& layout)
+    {_layout = layout;};
+    // Instrumentation pruning: the counters of the run the next
+    // addProfile reads that were left out because they had converged to
+    // 1.0 (PrunedCounterInfo): counter indices, or function number and
+    // path words for path profiles.
+    void setPrunedCounters(const std::vector<unsigned>& pruned)
+    {_pruned = pruned;};
+
+    // Map a combined profile of another version of the module, laid out
+    // as layout (the CFGChecksumInfo written after it), onto this one.
+    // False if the profile can't be mapped.
+    virtual bool remapLayout(const CFGLayout& layout) {return(false);};
+
     unsigned size() const {return(_histograms.size());};
     CPHistVec::iterator begin() {return(_histograms.begin());};
     CPHistVec::iterator end() {return(_histograms.begin());};
@@ -91,8 +130,41 @@ namespace llvm {
     //static void freeStaticData() = 0;
 
 	protected:
+    // the known weight of histogram h
+    virtual double histogramWeight(unsigned h) const
+    {return(getKnownWeight(h));};
+    // was function f (in module order) instrumented in the current run
+    bool isInstrumented(unsigned f) const
+    {return( (f >= _counterMap.size()) || _counterMap[f].instrumented );};
+    void addUnknown(unsigned key, double w = 1.0) {_unknown[key] += w;};
+    // add the unknown weights of the like-typed CPs of list
+    void mergeUnknown(CPList& list);
+
+    // Map the counters of a run of another version of the module (its
+    // layout set by setCounterLayout) onto current, the layout of this
+    // module: counts is rewritten with size counters, unknown marks the
+    // counters of current's ranges that did not match (the others are
+    // the caller's, from the matched functions), and the counter map and
+    // pruned counters are carried over.  False if the run profiled this
+    // module.
+    bool remapCounters(const CFGLayout& current, unsigned size,
+                       std::vector<unsigned>& counts,
+                       std::vector<bool>& unknown,
+                       std::vector<int>& function);
+    // Rebuild _histograms, one per counter of current, from those of a
+    // profile laid out as old.  The histograms that did not match, or
+    // whose dominator (if the layouts have them) did not map to the new
+    // one, are unknown in every run.
+    void remapHistograms(const CFGLayout& old, const CFGLayout& current);
+    // write current as a CFGChecksumInfo after the profile
+    bool serializeLayout(FILE* f, const CFGLayout& current) const;
+
 		double _weight;
 		unsigned _bincount;
+    CounterMapVec _counterMap;
+    CFGLayout _layout;
+    std::vector<unsigned> _pruned;
+    std::map<unsigned,double> _unknown;  // key --> weight of unknown runs
     // the actual histograms.  build an index map on top of
     // _histograms if you need a sparse/non-int mapping from ID-->histogram
     CPHistVec _histograms;  
@@ -117,6 +189,19 @@ namespace llvm {
     bool addProfile(FILE* f);
 		unsigned serialize(FILE* f);
 		bool deserialize(FILE* f);
+
+    // Add an optimal edge profile (-insert-optimal-edge-profiling counts
+    // only the edges off a maximum spanning tree), reconstructing the
+    // other edge counts by flow conservation
+    bool addOptimalProfile(FILE* f);
+
+    // The edge counts (EdgeInfo layout) of an optimal edge profile's
+    // counters (OptEdgeInfo layout: with an exit edge for each block
+    // without successors, ~0U for the uncounted edges).  False if the
+    // counters do not fit the module.
+    static bool expandOptimalCounts(Module& M,
+                                    const std::vector<unsigned>& optimal,
+                                    std::vector<unsigned>& counts);
     
     //static unsigned calcBinCount(CEPList& list, 
     //                             unsigned fallback = DEFAULT_BINS);
@@ -125,9 +210,26 @@ namespace llvm {
     
     CPHistogram* operator[](const int index);
 
+    // the edge that edge index e is normalized to (e for roots)
+    unsigned getDominatorIndex(unsigned e) const;
+
+    bool remapLayout(const CFGLayout& layout);
+
     static void freeStaticData();
 
 	private:
+    // add the hierarchically-normalized frequencies of one run's counts;
+    // the stale edges (of a changed function) are unknown
+    void addCounts(const unsigned* counts, unsigned edgeCount,
+                   const std::vector<bool>& stale);
+    // the edge counters of _module (CFGChecksumInfo)
+    const CFGLayout& moduleLayout();
+    // the count of pruned edge e, from its edge dominators
+    unsigned resolvePruned(std::vector<unsigned>& counts,
+                           std::vector<bool>& pruned, unsigned e);
+
+    Module& _module;
+    CFGLayout _moduleLayout;
     static EdgeDominatorTree* _edt;
   };  // class CombinedEdgeProfile
 
@@ -136,8 +238,9 @@ namespace llvm {
   // Combined Path Profile
   // --------------------------------------------------------------------------
 
-  // these give semantics to the template parameters
-  typedef unsigned PathIndex;
+  // these give semantics to the template parameters.  Ball-Larus path
+  // numbers are 64-bit (see PathNumbering.h)
+  typedef uint64_t PathIndex;
   typedef unsigned FunctionIndex;
   typedef std::pair<FunctionIndex,PathIndex> PathID;
 
@@ -168,6 +271,10 @@ namespace llvm {
     //                             unsigned fallback = DEFAULT_BINS);
 		bool buildFromList(CPList& list, unsigned binCount);
 
+  protected:
+    double histogramWeight(unsigned h) const;
+
+  public:
     // override printDrift because histogram indexes are not
     // consistent across path profiles
     void printDrift(CombinedPathProfile& other, 
@@ -188,9 +295,126 @@ namespace llvm {
     //_functions can't be static because mapping is not consistent
 		CPPFunctionMap _functions; // sparse map <funcID,pathID> --> histogram index
     std::vector<Function*> _functionRef;
+    std::vector<FunctionIndex> _histFunction;  // histogram index --> funcID
+    void setHistogramFunction(unsigned h, FunctionIndex funcIndex);
   }; // class CombinedPathProfile
 
 
+  // --------------------------------------------------------------------------
+  // Combined Context Path Profile
+  // --------------------------------------------------------------------------
+
+  // A context path is a path of a function together with the path
+  // prefixes of its innermost callers (-path-profile-context): each
+  // caller frame is the path of the caller that ends at the call, with
+  // -process-early-termination numbering.  There is one histogram per
+  // context path: the path's share of the function's paths in that
+  // context, in each run.
+
+  // callers' path prefixes, outermost first
+  typedef std::vector<PathID> PathContext;
+  typedef std::pair<PathContext,PathID> ContextPathID;
+  typedef std::set<ContextPathID> ContextPathSet;
+
+  // ContextPathID --> index in _histograms
+  typedef std::map<ContextPathID,unsigned> CCPPHistogramMap;
+
+  class CombinedContextPathProfile : public CombinedProfile {
+	public:
+    explicit CombinedContextPathProfile(Module& module);
+
+    const std::string& getNameStr() const 
+    {
+      static const std::string type="context path";
+      return(type);
+    };
+
+    ProfilingType getProfilingType() const {return(CombinedContextPathInfo);};
+
+    bool addProfile(FILE* f);
+    unsigned serialize(FILE* f);
+    bool deserialize(FILE* f);
+
+    bool buildFromList(CPList& list, unsigned binCount);
+
+    unsigned getFunctionCount() const {return(_functionCount);};
+    bool valid(const ContextPathID& path) const;
+    CPHistogram& getHistogram(const ContextPathID& path);
+    void getContextPathSet(ContextPathSet& paths) const;
+
+    // The paths of function funcIndex called in context, with their
+    // mean share, the hottest first
+    void getCalleePaths(const PathContext& context, FunctionIndex funcIndex,
+                        std::vector<std::pair<double,PathIndex> >& paths);
+
+    static void freeStaticData() {};
+
+	private:
+    unsigned _functionCount;
+    CCPPHistogramMap _paths;
+
+    bool readContextPath(FILE* f, unsigned depth, ContextPathID& path) const;
+  }; // class CombinedContextPathProfile
+
+
+  // --------------------------------------------------------------------------
+  // Combined Loop Path Profile
+  // --------------------------------------------------------------------------
+
+  // A loop path is a sequence of consecutive iterations of a loop
+  // (-path-profile-iterations), each the path of the function that ends
+  // at a backedge of the loop, oldest first.  A loop is identified by
+  // its function and the block number of its header.  There is one
+  // histogram per loop path: its share of the loop paths of the same
+  // loop and length, in each run.
+
+  // (function, header block number)
+  typedef std::pair<FunctionIndex,unsigned> LoopID;
+  typedef std::pair<LoopID,std::vector<PathIndex> > LoopPathID;
+  typedef std::set<LoopPathID> LoopPathSet;
+
+  // LoopPathID --> index in _histograms
+  typedef std::map<LoopPathID,unsigned> CLPPHistogramMap;
+
+  class CombinedLoopPathProfile : public CombinedProfile {
+	public:
+    explicit CombinedLoopPathProfile(Module& module);
+
+    const std::string& getNameStr() const 
+    {
+      static const std::string type="loop path";
+      return(type);
+    };
+
+    ProfilingType getProfilingType() const {return(CombinedLoopPathInfo);};
+
+    bool addProfile(FILE* f);
+    unsigned serialize(FILE* f);
+    bool deserialize(FILE* f);
+
+    bool buildFromList(CPList& list, unsigned binCount);
+
+    unsigned getFunctionCount() const {return(_functionCount);};
+    bool valid(const LoopPathID& path) const;
+    CPHistogram& getHistogram(const LoopPathID& path);
+    void getLoopPathSet(LoopPathSet& paths) const;
+
+    // The loop paths of loop (of every length), with their mean share,
+    // the hottest first
+    void getLoopPaths(const LoopID& loop,
+      std::vector<std::pair<double,std::vector<PathIndex> > >& paths);
+
+    static void freeStaticData() {};
+
+	private:
+    unsigned _functionCount;
+    CLPPHistogramMap _paths;
+
+    bool readLoopPath(FILE* f, const LoopPathHeader& header,
+                      LoopPathID& path) const;
+  }; // class CombinedLoopPathProfile
+
+
   // --------------------------------------------------------------------------
   // Combined Call Profile
   // --------------------------------------------------------------------------
@@ -232,12 +456,15 @@ namespace llvm {
 
     CPHistogram& operator[](const CallIndex index);
     CPHistogram& operator[](BasicBlock* bb);
+    CallIndex getCallIndex(BasicBlock* bb) {return(_profmap[bb]);};
 
     // !! void getCallSet(CallSet& calls) const;
 
     bool isFDOInliningCandidate(Instruction* I);
     bool hasFDOInliningCandidate(BasicBlock* BB);
 
+    bool remapLayout(const CFGLayout& layout);
+
     static void freeStaticData() { _profmap.clear(); _funcIndex.clear(); 
       _funcRef.clear(); _entryCalls.clear(); _histCnt = 0; }
 
@@ -250,11 +477,127 @@ namespace llvm {
     static unsigned _histCnt;        // number of histograms
     UnsignedVec _funcFreq;    // function index --> entry frequency
 
+    // the counters of this module: the raw call block counters (after
+    // the entry counters, CallInfo), or the histograms
+    void moduleLayout(bool combined, CFGLayout& layout);
+
     // Use CS.getParent() to get BB; look up profile in _profmap.
 
   };  // class CombinedCallProfile
 
 
+  // --------------------------------------------------------------------------
+  // Combined Value Profile
+  // --------------------------------------------------------------------------
+
+  // A value site is one (non-constant, integer) argument of an FDO
+  // inlining candidate.  There is one histogram per (site, value): the
+  // fraction of the site's calls that passed the value, in each run.
+  // Runs where the value was not among the top values count as 0, so
+  // mean(true) is the expected stability of the value.
+
+  typedef unsigned ValueSiteIndex;
+  typedef std::pair<ValueSiteIndex,uint64_t> ValueID;
+  typedef std::set<ValueID> ValueSet;
+
+  // ValueID --> index in _histograms
+  typedef std::map<ValueID,unsigned> CVPHistogramMap;
+
+  class CombinedValueProfile : public CombinedProfile {
+	public:
+    explicit CombinedValueProfile(Module& M);
+
+    const std::string& getNameStr() const 
+    {
+      static const std::string type="value";
+      return(type);
+    };
+
+    ProfilingType getProfilingType() const {return(CombinedValueInfo);};
+
+    bool addProfile(FILE* f);
+    unsigned serialize(FILE* f);
+    bool deserialize(FILE* f);
+
+    bool buildFromList(CPList& list, unsigned binCount);
+
+    unsigned getSiteCount() const {return(_siteCalls.size());};
+    Instruction* getSiteCall(ValueSiteIndex site) const 
+    {return(_siteCalls[site]);};
+    unsigned getSiteArg(ValueSiteIndex site) const {return(_siteArgs[site]);};
+    bool findSite(Instruction* call, unsigned argNo, 
+                  ValueSiteIndex& site) const;
+
+    bool valid(const ValueID& value) const;
+    CPHistogram& getHistogram(const ValueID& value);
+    void getValueSet(ValueSet& values) const;
+
+    // The value with the highest expected stability at the site.
+    // Returns the stability (0 if the site has no values).
+    double getStableValue(ValueSiteIndex site, uint64_t& value);
+
+    static bool isFDOInliningCandidate(Instruction* I);
+    static bool isValueSite(CallSite cs, unsigned argNo);
+
+    static void freeStaticData() {};
+
+  protected:
+    // for subclasses that number their own sites
+    CombinedValueProfile() {};
+    void addSite(Instruction* call, unsigned argNo);
+
+    CVPHistogramMap _values;
+
+	private:
+    // sites are not static: the specializer changes the call sites
+    std::vector<Instruction*> _siteCalls;  // site --> call
+    std::vector<unsigned> _siteArgs;       // site --> argument number
+    std::map<std::pair<Instruction*,unsigned>,ValueSiteIndex> _siteIndex;
+  };  // class CombinedValueProfile
+
+
+  // --------------------------------------------------------------------------
+  // Combined Indirect Call Profile
+  // --------------------------------------------------------------------------
+
+  // A value profile whose sites are the indirect calls (argument 0) and
+  // whose values are function numbers: 1-based over the defined
+  // functions in module order, 0 for targets defined elsewhere.  The
+  // histogram of (site, target) is the fraction of the site's calls
+  // that went to the target, in each run.
+
+  typedef std::pair<double,Function*> ICallTarget;
+
+  class CombinedICallProfile : public CombinedValueProfile {
+	public:
+    explicit CombinedICallProfile(Module& M);
+
+    const std::string& getNameStr() const 
+    {
+      static const std::string type="icall";
+      return(type);
+    };
+
+    ProfilingType getProfilingType() const {return(CombinedICallInfo);};
+
+    bool findCallSite(Instruction* call, ValueSiteIndex& site) const
+    {return(findSite(call, 0, site));};
+
+    // the function of a target number (NULL for 0 or a bad number)
+    Function* getTarget(uint64_t number) const;
+
+    // The known targets of a site with their expected stability, most
+    // stable first
+    void getStableTargets(ValueSiteIndex site,
+                          std::vector<ICallTarget>& targets);
+
+    static bool isICallSite(Instruction* I);
+
+	private:
+    std::vector<Function*> _functionRef;  // number - 1 --> function
+  };  // class CombinedICallProfile
+
+
 }  // namespace llvm
 
 #endif
@@ -94,6 +94,13 @@ namespace llvm {
   ModulePass *createProfileLoaderPass();
   extern char &ProfileLoaderPassID;
 
+  //===--------------------------------------------------------------------===//
+  //
+  // createCPProfileLoaderPass - This pass provides profile information from
+  // a combined edge profile.
+  //
+  ModulePass *createCPProfileLoaderPass();
+
   //===--------------------------------------------------------------------===//
   //
   // createNoProfileInfoPass - This pass implements the default "no profile".
@@ -31,6 +31,7 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/System/DataTypes.h"
 #include <map>
 #include <stack>
 #include <vector>
@@ -61,8 +62,9 @@ namespace llvm {
       BasicBlock* getBlock();
 
       // Get/set the number of paths to the exit starting at the node.
-      unsigned getNumberPaths();
-      void setNumberPaths(unsigned numberPaths);
+      // Path counts are 64-bit; UINT64_MAX means the count overflowed.
+      uint64_t getNumberPaths();
+      void setNumberPaths(uint64_t numberPaths);
 
       // Get/set the NodeColor used in graph algorithms.
       NodeColor getColor();
@@ -108,7 +110,7 @@ namespace llvm {
       BLEdgeVector _succEdges;
 
       // The number of paths from the node to the exit.
-      unsigned _numberPaths;
+      uint64_t _numberPaths;
 
       // 'Color' used by graph algorithms to mark the node.
       NodeColor _color;
@@ -141,10 +143,10 @@ namespace llvm {
 
       // Returns the weight of this edge.  Used to decode path numbers to
       // sequences of basic blocks.
-      unsigned getWeight();
+      uint64_t getWeight();
 
       // Sets the weight of the edge.  Used during path numbering.
-      void setWeight(unsigned weight);
+      void setWeight(uint64_t weight);
 
       // Gets/sets the phony edge originating at the root.
       BallLarusEdge* getPhonyRoot();
@@ -172,7 +174,7 @@ namespace llvm {
       // Edge weight cooresponding to path number increments before removing
       // increments along a spanning tree. The sum over the edge weights gives
       // the path number.
-      unsigned _weight;
+      uint64_t _weight;
 
 			// Type to represent for what this edge is intended
 			EdgeType _edgeType;
@@ -217,11 +219,24 @@ namespace llvm {
       void calculatePathNumbers();
 
       // Returns the number of paths for the DAG.
-      unsigned getNumberOfPaths();
+      uint64_t getNumberOfPaths();
+
+      // True if the number of paths from the root overflowed 64 bits
+      // even after splitting; the path numbers are then meaningless.
+      bool hasPathOverflow();
 
       // Get the first edge on the path
       // PB: taken from llvm-cprof
-      BallLarusEdge* getFirstBLEdge(unsigned int pathNumber);
+      BallLarusEdge* getFirstBLEdge(uint64_t pathNumber);
+
+      // The blocks on a path, in order; a path that ends on a backedge
+      // ends with its header.  calculatePathNumbers() must have run.
+      void getPathBlocks(uint64_t pathNumber,
+                         std::vector<BasicBlock*>& blocks);
+
+      // True if paths also end at the blocks with calls
+      // (-process-early-termination).  The numbering depends on it.
+      static bool hasCallEdges();
 
       // Returns the root (i.e. entry) node for the DAG.
       BallLarusNode* getRoot();
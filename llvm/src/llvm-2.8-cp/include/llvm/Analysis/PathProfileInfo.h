@@ -29,8 +29,8 @@ namespace llvm {
   typedef std::vector<BasicBlock*> PathBlockVector;
   typedef std::vector<BasicBlock*>::iterator PathBlockIterator;
 
-  typedef std::map<unsigned int,Path*> PathMap;
-  typedef std::map<unsigned int,Path*>::iterator PathIterator;
+  typedef std::map<uint64_t,Path*> PathMap;
+  typedef std::map<uint64_t,Path*>::iterator PathIterator;
 
   typedef std::map<Function*,unsigned int> FunctionPathCountMap;
   typedef std::map<Function*,PathMap> FunctionPathMap;
@@ -52,12 +52,12 @@ namespace llvm {
 
   class Path {
   public:
-    Path(unsigned int number, unsigned int count,
+    Path(uint64_t number, unsigned int count,
 			double countStdDev, PathProfileInfo* ppi);
 
     double getFrequency() const;
 
-    unsigned int getNumber() const;
+    uint64_t getNumber() const;
     unsigned int getCount() const;
     double getCountStdDev() const;
 
@@ -67,7 +67,7 @@ namespace llvm {
     BasicBlock* getFirstBlockInPath() const;
 
   private:
-    unsigned int _number;
+    uint64_t _number;
     unsigned int _count;
     double _countStdDev;
 
@@ -86,8 +86,8 @@ namespace llvm {
     Function* getCurrentFunction() const;
     BasicBlock* getCurrentFunctionEntry();
 
-    Path* getPath(unsigned int number);
-    unsigned int getPotentialPathCount();
+    Path* getPath(uint64_t number);
+    uint64_t getPotentialPathCount();
 
     PathIterator pathBegin();
     PathIterator pathEnd();
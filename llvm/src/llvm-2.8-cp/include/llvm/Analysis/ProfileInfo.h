@@ -243,6 +243,11 @@ namespace llvm {
   /// it available to the optimizers.
   Pass *createProfileLoaderPass(const std::string &Filename);
 
+  /// createCPProfileLoaderPass - This function returns a Pass that provides
+  /// profiling information from the combined edge profile in the specified
+  /// file.
+  Pass *createCPProfileLoaderPass(const std::string &Filename);
+
 } // End llvm namespace
 
 #endif
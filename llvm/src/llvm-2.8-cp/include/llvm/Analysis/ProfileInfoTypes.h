@@ -31,9 +31,70 @@ enum ProfilingType {
   CombinedEdgeInfo = 8, /* Combined edge profiling information */
   CombinedPathInfo = 9, /* Combined path profiling information */
   CallInfo         = 10, /* Callgraph profiling information */
-  CombinedCallInfo = 11 /* Combeind callgraph profiling information */
+  CombinedCallInfo = 11, /* Combeind callgraph profiling information */
+  ValueInfo        = 12, /* Argument value profiling information */
+  CombinedValueInfo = 13, /* Combined argument value profiling information */
+  SampleInfo       = 14, /* Sampling rate of the rest of the run: the checks
+                           per sample and the checks instrumented per
+                           sample */
+  CounterMapInfo   = 15, /* Which functions the counters of a profile type
+                            cover in the rest of the run */
+  CombinedUnknownInfo = 16, /* Weight of the runs in which parts of the
+                              preceding combined profile were unknown */
+  ICallInfo        = 17, /* Indirect call target profiling information */
+  CombinedICallInfo = 18, /* Combined indirect call target profiling
+                            information */
+  ContextPathInfo  = 19, /* Path profiling information in the context of
+                            the callers' path prefixes */
+  CombinedContextPathInfo = 20, /* Combined context path profiling
+                                  information */
+  LoopPathInfo     = 21, /* Path profiling information over consecutive
+                            loop iterations */
+  CombinedLoopPathInfo = 22, /* Combined loop path profiling information */
+  CFGChecksumInfo  = 23, /* The CFG checksum and counters of each function
+                            of the profiled module, to match the counters
+                            of changed code */
+  PrunedCounterInfo = 24 /* The counters of a profile type in the rest of
+                            the run that were not instrumented because
+                            they converged to 1.0 */
 };
 
+/*
+ * An entry of a counter map (CounterMapInfo), one per defined function in
+ * module order, after a word holding the ProfilingType of the counters.
+ * The counters keep the layout of a fully instrumented module; the
+ * counters of a function that was not instrumented are unknown, not 0.
+ */
+typedef struct {
+  unsigned first;        /* index of the function's first counter */
+  unsigned instrumented; /* 0 if the function was not instrumented */
+} CounterMapEntry;
+
+/*
+ * A pruned counter block (PrunedCounterInfo) holds the ProfilingType of
+ * the counters, then the index of each counter that -profile-prune-cp
+ * left out because it always ran as often as the counter it is
+ * normalized by.  Its slot in the counter array stays 0.  For path
+ * profiles (PathInfo) each pruned function is instead three words: the
+ * function number and the path it always took (low word first).
+ */
+
+/*
+ * An entry of a CFG checksum block (CFGChecksumInfo), one per defined
+ * function in module order, after a word holding the ProfilingType of the
+ * counters.  count signature words, one per counter, follow each entry.
+ * The checksum covers the shape of the CFG (the successors of each
+ * block); a signature, what its counter counts.  The block of a combined
+ * edge profile (CombinedEdgeInfo) has count more words per function: the
+ * counter each counter is normalized by, its edge dominator.
+ */
+typedef struct {
+  unsigned nameHash;     /* hash of the function's name */
+  unsigned checksum;     /* CFG checksum */
+  unsigned first;        /* index of the function's first counter */
+  unsigned count;        /* number of counters of the function */
+} CFGChecksumEntry;
+
 /*
  * The header for tables that map path numbers to path counters.
  */
@@ -43,13 +104,97 @@ typedef struct {
 } PathHeader;
 
 /*
- * Describes an entry in a tagged table for path counters.
+ * Describes an entry in a tagged table for path counters.  Path numbers
+ * are 64-bit (split in two words, as in ValueProfileSlot).
  */
 typedef struct {
-  unsigned pathNumber;
+  unsigned pathNumberLo;
+  unsigned pathNumberHi;
   unsigned pathCounter;
 } PathTableEntry;
 
+/*
+ * Most callers a context path profile (ContextPathInfo) records.
+ */
+#define PP_MAX_CONTEXT 4
+
+/*
+ * The header of a context path: depth frames follow, the callers
+ * outermost first and the path of the function last.  A caller frame
+ * holds the path prefix that ends at the call.
+ */
+typedef struct {
+  unsigned depth;        /* number of frames, callers and callee */
+  unsigned pathCounter;
+} PathContextHeader;
+
+typedef struct {
+  unsigned fnNumber;
+  unsigned pathNumberLo;
+  unsigned pathNumberHi;
+} PathContextFrame;
+
+/*
+ * Most consecutive iterations a loop path profile (LoopPathInfo)
+ * records.
+ */
+#define PP_MAX_ITERATIONS 4
+
+/*
+ * The header of a sequence of iteration paths of a loop (the paths that
+ * end at its backedges): length path numbers follow, oldest first, as
+ * pairs of words (low first).  A loop is numbered by the position of
+ * its header block in the function; sequences shorter than the maximum
+ * start at an entry of the loop.
+ */
+typedef struct {
+  unsigned fnNumber;
+  unsigned loopNumber;   /* the header's block number */
+  unsigned length;       /* number of iterations */
+  unsigned pathCounter;
+} LoopPathHeader;
+
+/*
+ * Number of (value, count) slots kept per value profiling site.
+ */
+#define VP_TOPK 4
+
+/*
+ * One slot of a value profiling site: a 64-bit value (split in two
+ * words so the table is an array of unsigned) and its count.
+ */
+typedef struct {
+  unsigned valueLo;
+  unsigned valueHi;
+  unsigned count;
+} ValueProfileSlot;
+
+/*
+ * A value profiling site (one argument of one call site).  total is
+ * the number of profiled calls; the slot counts are lower bounds on
+ * the number of calls with that value (Misra-Gries).
+ */
+typedef struct {
+  unsigned total;
+  ValueProfileSlot slots[VP_TOPK];
+} ValueProfileSite;
+
+/*
+ * Indirect call target profiles (ICallInfo) are tables of value
+ * profiling sites, one per indirect call.  Their values are function
+ * numbers, 1-based over the defined functions in module order; 0 is a
+ * target defined outside the module.
+ */
+
+/*
+ * Header of a value entry in a combined value profile.
+ */
+typedef struct {
+  unsigned site;
+  unsigned valueLo;
+  unsigned valueHi;
+} ValueHeader;
+
 /*
  * Defines a bin in a combined profiling histogram
  */
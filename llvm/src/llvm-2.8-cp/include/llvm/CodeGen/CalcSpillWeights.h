@@ -27,10 +27,16 @@ namespace llvm {
     LiveIntervals &lis_;
     const MachineLoopInfo &loops_;
     DenseMap<unsigned, float> hint_;
+    bool profiled_;
+
+    /// hasProfiledFrequencies - whether every block of mf's function has a
+    /// profiled frequency (!cp.freq) to weigh its uses by.
+    static bool hasProfiledFrequencies(const MachineFunction &mf);
   public:
     VirtRegAuxInfo(MachineFunction &mf, LiveIntervals &lis,
                    const MachineLoopInfo &loops) :
-      mf_(mf), lis_(lis), loops_(loops) {}
+      mf_(mf), lis_(lis), loops_(loops),
+      profiled_(hasProfiledFrequencies(mf)) {}
 
     /// CalculateRegClass - recompute the register class for reg from its uses.
     /// Since the register class can affect the allocation hint, this function
@@ -38,7 +44,9 @@ namespace llvm {
     void CalculateRegClass(unsigned reg);
 
     /// CalculateWeightAndHint - (re)compute li's spill weight and allocation
-    /// hint.
+    /// hint.  Uses are weighted by the profiled frequency of their block when
+    /// -FDOBlockFreqs annotated every block of the function, and by the loop
+    /// depth otherwise.
     void CalculateWeightAndHint(LiveInterval &li);
   };
 
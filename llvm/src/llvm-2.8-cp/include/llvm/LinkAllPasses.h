@@ -73,6 +73,8 @@ namespace {
       (void) llvm::createOptimalEdgeProfilerPass();
       (void) llvm::createPathProfilerPass();
       (void) llvm::createCallProfilerPass();
+      (void) llvm::createValueProfilerPass();
+      (void) llvm::createICallProfilerPass();
       (void) llvm::createFunctionInliningPass();
       (void) llvm::createAlwaysInlinerPass();
       (void) llvm::createGlobalDCEPass();
@@ -103,6 +105,7 @@ namespace {
       (void) llvm::createProfileEstimatorPass();
       (void) llvm::createProfileVerifierPass();
       (void) llvm::createProfileLoaderPass();
+      (void) llvm::createCPProfileLoaderPass();
       (void) llvm::createPathProfileLoaderPass();
       (void) llvm::createPathProfileVerifierPass();
       (void) llvm::createGenerateEdgeDominancePass();
@@ -156,6 +159,17 @@ namespace {
       (void) llvm::createCorrelatedValuePropagationPass();
 
       (void) llvm::createFDOInlinerPass();
+      (void) llvm::createFDOInlineSimPass();
+      (void) llvm::createFDOValueSpecPass();
+      (void) llvm::createFDOICallPromotionPass();
+      (void) llvm::createFDOBlockLayoutPass();
+      (void) llvm::createFDOColdSplitPass();
+      (void) llvm::createFDOFunctionOrderPass();
+      (void) llvm::createFDOTripCountsPass();
+      (void) llvm::createFDOSuperblocksPass();
+      (void) llvm::createFDOBranchWeightsPass();
+      (void) llvm::createFDOBlockFreqsPass();
+      (void) llvm::createFDOMultiversionPass();
 
       (void)new llvm::IntervalPartition();
       (void)new llvm::FindUsedTypes();
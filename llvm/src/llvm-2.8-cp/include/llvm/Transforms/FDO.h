@@ -28,6 +28,39 @@ namespace llvm {
   // FDO Inlining
   ModulePass* createFDOInlinerPass();
 
+  // Dry-run FDO inlining simulation (parameter sweeps)
+  ModulePass* createFDOInlineSimPass();
+
+  // Call specialization for stable argument values (value profile)
+  ModulePass* createFDOValueSpecPass();
+
+  // Indirect call promotion to stable targets (icall profile)
+  ModulePass* createFDOICallPromotionPass();
+
+  // Basic block layout from the distributions of a combined edge profile
+  ModulePass* createFDOBlockLayoutPass();
+
+  // Splitting of the code that is cold over all profiled runs
+  ModulePass* createFDOColdSplitPass();
+
+  // Function layout (and link order file) from a combined call profile
+  ModulePass* createFDOFunctionOrderPass();
+
+  // Loop trip-count annotation (for -loop-unroll) from a combined edge profile
+  ModulePass* createFDOTripCountsPass();
+
+  // Superblock formation along the hot paths of a combined path profile
+  ModulePass* createFDOSuperblocksPass();
+
+  // Switch weights for codegen from a combined edge profile
+  ModulePass* createFDOBranchWeightsPass();
+
+  // Block frequencies for spill weights from a combined edge profile
+  ModulePass* createFDOBlockFreqsPass();
+
+  // Function versions per input class from clustered edge profiles
+  ModulePass* createFDOMultiversionPass();
+
 } // End llvm namespace
 
 #endif
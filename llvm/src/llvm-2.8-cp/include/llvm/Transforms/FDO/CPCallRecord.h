@@ -22,7 +22,9 @@
 #ifndef LLVM_TRANSFORMS_FDO_FDOINLINER_CPCALLRECORD_H
 #define LLVM_TRANSFORMS_FDO_FDOINLINER_CPCALLRECORD_H
 
+#include "llvm/ADT/ValueMap.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/System/DataTypes.h"
 #include <map>
 #include <set>
 #include <list>
@@ -43,7 +45,10 @@ namespace llvm {
 
 
   class Function;
+  class Module;
   class CPCallRecord;
+  class CombinedPathProfile;
+  class CombinedValueProfile;
   class TStream;
 
   struct ArgImpact {
@@ -79,6 +84,15 @@ namespace llvm {
 
   typedef std::map<Function*,FunctionAttr> FuncAttrMap;
 
+  // expected fraction of a function's (acyclic) paths through a block.
+  // Erased blocks drop out, so a block allocated in their place by
+  // inlining is not mistaken for a profiled one.
+  typedef ValueMap<BasicBlock*,double> BlockHeatMap;
+
+  // call --> argument number --> stability of its most frequent value.
+  // Erased calls drop out (an inlined copy of a call has no entry).
+  typedef ValueMap<Instruction*, std::map<unsigned,double> > ArgStabilityMap;
+
   // A metric function takes a record and benefit; returns a double
   typedef double (*FDOInlineMetric)(CPCallRecord&, double);
   typedef std::map<std::string, FDOInlineMetric> MetricNameMap;
@@ -91,6 +105,8 @@ namespace llvm {
     CallSite      cs;
     CPHistogram*  cphist;  // why is this * and not & ??
     double        mval;
+    double        mraw;    // metric value before normalizing by cost
+    double        mbenefit;// per-call benefit used for the last mval
     ArgImpact     totalImpact;  // impact of argument characteristics
     bool          ignored;
     FuncSet       history;
@@ -129,6 +145,14 @@ namespace llvm {
 
     static bool selectMetric(const std::string& name = "null");
     double evalMetric();
+    // the selected metric applied with a unit benefit, ie, the
+    // profile-derived call frequency the metric believes in.
+    double evalFrequency();
+
+    // replace/read the -FDI-Q quantile list (used by the simulator
+    // to sweep several quantile settings in one run)
+    static void setQList(const std::vector<double>& qs);
+    static void getQList(std::vector<double>& qs);
 
     // true if there are factors that should flat-out inhibit inlining
     bool neverInline();
@@ -163,8 +187,31 @@ namespace llvm {
 
     static FuncAttrMap* getFuncAttrMap() { return(&_funcAttr); };
     static int recalcFunctionAttr(Function* f);
+    // recalcFunctionAttr in two steps: prepare (serial) creates the
+    // record; analyze only touches f's record, so functions can be
+    // analyzed in parallel.  analyze can also compute all ArgImpacts.
+    static void prepareFunctionAttr(Function* f);
+    static int analyzeFunctionAttr(Function* f, bool argImpacts = true);
     static ArgImpact* getArgImpact(Function*, unsigned argNum);
 
+    // Path-profile-aware benefits.  Once a combined path profile is
+    // set, calls to profiled functions get their argument savings
+    // weighted by the heat of the affected callee blocks, and blocks
+    // that are (nearly) never executed don't count towards the cost.
+    // Returns the number of functions with path information.
+    static unsigned setPathProfile(Module& M, CombinedPathProfile& cpp);
+    static bool hasPathProfile(Function* F);
+    static uint64_t getPathProfileDigest() { return(_pathDigest); };
+
+    // Value-profile-aware benefits.  A non-constant argument whose
+    // most frequent value is stable (-FDI-value-stable) gets the
+    // constant argument savings, weighted by its stability: the
+    // specialized code only runs when the guard holds, so the savings
+    // don't reduce the inlined size.  Must be set on the IR that was
+    // value profiled.  Returns the number of stable arguments.
+    static unsigned setValueProfile(CombinedValueProfile& cvp);
+    static uint64_t getValueProfileDigest() { return(_valueDigest); };
+
     static void freeStaticData();
 
   private:
@@ -172,6 +219,13 @@ namespace llvm {
 
     double inlineBenefit();
     double inlineCost();
+    double inlineHotBenefit();
+    double stableArgBenefit();
+
+    static double blockHeat(BasicBlock* BB);
+    static double calcHotConstantImpact(Value* V);
+    static double calcHotAllocaImpact(Value* V);
+    static unsigned calcColdSize(Function* F);
 
     // get the FunctionAttr; default: create & recalc if not found
     static FunctionAttr* getFunctionAttr(Function* F, bool create = true);
@@ -185,6 +239,10 @@ namespace llvm {
     static FDOInlineMetric _metric;     // function pointer to eval call sites
     static MetricNameMap   _metricmap;  // name string --> function pointer
     static FuncAttrMap     _funcAttr;   // code attribute cache
+    static BlockHeatMap    _blockHeat;  // from the path profile
+    static uint64_t        _pathDigest; // summarizes _blockHeat
+    static ArgStabilityMap _argStability; // from the value profile
+    static uint64_t        _valueDigest;  // summarizes _argStability
 
     static unsigned CurrID;  // debug
     
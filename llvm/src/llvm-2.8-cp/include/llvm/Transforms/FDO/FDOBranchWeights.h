@@ -0,0 +1,36 @@
+//===- FDOBranchWeights.h - Branch weight metadata for FDO -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The !cp.weights annotation of the branch weights pass
+// (FDOBranchWeights.cpp), shared with the passes that annotate copies
+// of a function with the weights of part of the profiled runs.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef LLVM_TRANSFORMS_FDO_FDOBRANCHWEIGHTS_H
+#define LLVM_TRANSFORMS_FDO_FDOBRANCHWEIGHTS_H
+
+#include <vector>
+
+namespace llvm {
+
+  class BasicBlock;
+  class CPEdgeMap;
+
+  // Attaches !cp.weights to BB's switch, from the weights of its
+  // function's edges (indexed by edge - first, as filled by
+  // CPEdgeMap::chainWeights).  Returns false if BB does not end in a
+  // switch or it never ran.
+  bool setBranchWeights(BasicBlock* BB, CPEdgeMap& map,
+                        const std::vector<double>& weights, unsigned first);
+
+} // namespace llvm
+
+#endif
@@ -0,0 +1,47 @@
+//===- FDOColdSplit.h - Cold region outlining for FDO passes ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The region finding and extraction of the hot/cold splitting pass
+// (FDOColdSplit.cpp), shared with the partial inlining of the FDO
+// inliner.  Which blocks are cold is up to the client (from a combined
+// edge profile); these only group and outline them.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef LLVM_TRANSFORMS_FDO_FDOCOLDSPLIT_H
+#define LLVM_TRANSFORMS_FDO_FDOCOLDSPLIT_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class BasicBlock;
+  class Function;
+
+  // the header first, then the other blocks in function order
+  typedef std::vector<BasicBlock*> ColdRegion;
+
+  // Appends the single-entry regions of F's cold blocks of at least
+  // minSize instructions: a cold block whose immediate dominator is not
+  // cold, and the cold blocks it dominates that are entered only from
+  // within the region.
+  void findColdRegions(Function* F, const std::set<BasicBlock*>& cold,
+                       unsigned minSize, std::vector<ColdRegion>& regions);
+
+  // Outlines the region into a noinline, optsize function named
+  // <F>.cold, in section (unless empty).  Returns the new function, or
+  // NULL if the region can't be extracted (allocas, va_start, ...).
+  Function* extractColdRegion(ColdRegion& region, const std::string& section);
+
+} // namespace llvm
+
+#endif
@@ -0,0 +1,109 @@
+//===- FDOInlineCache.h - Persistent FDO inlining decisions -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Cache of FDO inliner call-site evaluations and decisions, kept
+// between (incremental) builds.  An entry is keyed by
+//
+//   (caller hash, callee hash, call-site ordinal, histogram digest,
+//    metric key)
+//
+// where the function hashes are structural hashes of the IR (no
+// pointers), the ordinal numbers the inlining candidates within the
+// caller, and the metric key covers the metric name and -FDI-Q list.
+// If none of these changed, the metric evaluation of the call site is
+// replayed from the cache instead of being recomputed.  The decision
+// (inlined or not) of the previous build is also kept, so that
+// decisions that changed can be reported.
+//
+// File format (text, one entry per line after the header):
+//   FDI-cache <version>
+//   <caller> <callee> <ordinal> <digest> <metric> <mval> <mraw> <mbenefit>
+//     <instr> <branch> <icall> <alloca> <decision>
+// hashes in hex, decision is 'I' (inlined) or 'N' (not inlined).
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef LLVM_TRANSFORMS_FDO_FDOINLINECACHE_H
+#define LLVM_TRANSFORMS_FDO_FDOINLINECACHE_H
+
+#include "llvm/System/DataTypes.h"
+#include "llvm/Transforms/FDO/CPCallRecord.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class CPHistogram;
+  class Function;
+
+  struct InlineCacheKey {
+    uint64_t caller;
+    uint64_t callee;
+    unsigned ordinal;
+    uint64_t digest;
+    uint64_t metric;
+
+    bool operator<(const InlineCacheKey& rhs) const;
+  };
+
+  struct InlineCacheEntry {
+    double mval;
+    double mraw;
+    double mbenefit;
+    ArgImpact totalImpact;
+    bool inlined;
+  };
+
+  class FDOInlineCache {
+  public:
+    FDOInlineCache();
+
+    // read a cache file; a missing file is an empty cache.  Returns
+    // false on a malformed file (the cache is then left empty).
+    bool load(const std::string& filename);
+    // write the entries of the current build (stale entries are dropped)
+    bool save(const std::string& filename) const;
+
+    // Key construction.  The function hash is memoized until clear().
+    uint64_t functionHash(Function* F);
+    static uint64_t histogramDigest(const CPHistogram& hist);
+    static uint64_t metricKey(const std::string& metric,
+                              const std::vector<double>& qs);
+
+    // Look up an original call site; on a hit, restore the cached
+    // evaluation into rec.  The record is registered (by rec.ID) for
+    // the current build in either case.
+    bool replay(const InlineCacheKey& key, CPCallRecord& rec);
+    // store the evaluation of a record that missed
+    void update(const CPCallRecord& rec);
+    // the original call site with this record ID was inlined
+    void markInlined(unsigned recID);
+
+    // compare the decisions against the previous build
+    unsigned changedDecisions() const;
+
+    unsigned hits() const { return(_hits); };
+    unsigned misses() const { return(_misses); };
+
+  private:
+    typedef std::map<InlineCacheKey, InlineCacheEntry> EntryMap;
+
+    EntryMap _previous;   // loaded from file
+    EntryMap _current;    // this build
+    std::map<unsigned, InlineCacheKey> _byID;  // record ID --> key
+    std::map<Function*, uint64_t> _funcHash;
+    unsigned _hits;
+    unsigned _misses;
+  };
+
+} // namespace llvm
+
+#endif
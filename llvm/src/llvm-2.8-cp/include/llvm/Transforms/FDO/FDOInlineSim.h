@@ -0,0 +1,122 @@
+//===- FDOInlineSim.h - Dry-run model of the FDO inliner --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Models FDO inlining on the call graph without touching the IR, so
+// that many (metric, Q, budget, depth) settings can be compared in one
+// run.  The IR is only read once to snapshot function sizes
+// (FunctionAttr) and call site metric values (CPCallRecord); each
+// configuration is then simulated independently on a worker thread.
+//
+// The model follows FDOInliner::runOnModule: best-first by mval,
+// "too big" / "never" / "too deep" candidates are ignored for good,
+// callers are re-evaluated when their callee grows, and the call
+// sites of an inlined callee are copied into the caller with their
+// frequency scaled by the frequency of the inlined call.  Frequencies
+// of copied call sites are combined as products of the per-site
+// metric frequencies (ie, the histograms are assumed independent),
+// and code growth is the callee size less the constant/alloca
+// argument savings of the call site.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef LLVM_TRANSFORMS_FDO_FDOINLINESIM_H
+#define LLVM_TRANSFORMS_FDO_FDOINLINESIM_H
+
+#include "llvm/Pass.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class Module;
+  class raw_ostream;
+
+  // One original (pre-inlining) call site
+  struct SimSite {
+    unsigned caller;   // function index
+    unsigned callee;   // function index
+    int less;          // callee size - inlineSize for this site
+    bool never;        // CPCallRecord::neverInline
+  };
+
+  struct SimFunc {
+    std::string name;
+    int size;
+    bool addressTaken;
+    bool isMain;
+    std::vector<unsigned> sites;  // original sites in this function
+  };
+
+  // Per-site values that depend on the metric (and its quantiles)
+  struct SimMetric {
+    std::string name;
+    std::string qstr;          // quantiles as given on the command line
+    std::vector<double> qs;
+    bool valid;
+    std::vector<double> mraw;  // metric value before cost normalization
+    std::vector<double> benefit;
+    std::vector<double> freq;  // metric frequency (metric at benefit 1)
+    std::vector<double> mean;  // expected calls per caller invocation
+  };
+
+  struct SimConfig {
+    unsigned metric;   // index into the SimMetric vector
+    unsigned budgetOpt;
+    int budget;
+    unsigned depth;
+  };
+
+  struct SimResult {
+    unsigned inlined;
+    unsigned tooBig;
+    unsigned tooDeep;
+    unsigned never;
+    unsigned deadFuncs;
+    int budgetUsed;
+    int finalSize;
+    double callsSaved;     // dynamic calls removed per caller invocation
+    double instrSaved;     // ... weighted by the per-call inline benefit
+  };
+
+  class FDOInlineSim : public ModulePass {
+  public:
+    static char ID;
+
+    FDOInlineSim();
+    bool runOnModule(Module& M);
+    void getAnalysisUsage(AnalysisUsage &Info) const;
+
+    // simulate one configuration on the (read-only) snapshot
+    static void simulate(const std::vector<SimFunc>& funcs,
+                         const std::vector<SimSite>& sites,
+                         const SimMetric& metric, const SimConfig& config,
+                         SimResult& result);
+
+  protected:
+    bool buildModel(Module& M);
+    void buildConfigs();
+    void printTable(raw_ostream& stream);
+
+    // FDOWorkFunc: context is the FDOInlineSim, item a config index
+    static void runConfig(void* context, unsigned item);
+
+    std::vector<SimFunc>   _funcs;
+    std::vector<SimSite>   _sites;
+    std::vector<SimMetric> _metrics;
+    std::vector<SimConfig> _configs;
+    std::vector<SimResult> _results;
+    int _totalSize;
+
+  }; // FDOInlineSim
+
+} // namespace
+
+
+#endif
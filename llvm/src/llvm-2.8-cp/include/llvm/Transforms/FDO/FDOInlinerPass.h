@@ -17,6 +17,7 @@
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/FDO/CPCallRecord.h"
 #include "llvm/Transforms/FDO/TStream.h"
@@ -28,7 +29,15 @@ namespace llvm {
   class Module;
   class CallGraph;
   class TargetData;
+  class FDOInlineCache;
+  class CPEdgeMap;
 
+  // options of the FDO inliner (FDOInliner.cpp) that the inlining
+  // simulator and the other code-growing FDO passes also read
+  extern cl::opt<unsigned>    FDIBudget;
+  extern cl::opt<std::string> CPCallFile;
+  extern cl::opt<std::string> FDIMetric;
+  extern cl::opt<unsigned>    FDIDepth;
 
   typedef DenseMap<const ArrayType*, std::vector<AllocaInst*> > 
   InlinedArrayAllocasTy;
@@ -54,6 +63,9 @@ namespace llvm {
     bool isFDOInliningCandidate(Instruction* I);
     bool hasFDOInliningCandidate(BasicBlock* BB);
 
+    // code-growth budget for a -FDI-budget setting and program size
+    static int calcBudget(unsigned requested, int size);
+
 
   protected:
     llvm::raw_fd_ostream* initLog(TStream& ts, const std::string& suffix, 
@@ -71,6 +83,9 @@ namespace llvm {
     llvm::raw_fd_ostream* hashFD;
 
     unsigned initialize(Module& M, CallGraph& CG, const TargetData* TD);
+    void buildSCCs(CallGraph& CG);
+    unsigned analyzeFunctions(Module& M);
+    void findColdBlocks(Module& M, CPEdgeMap& map);
 
     void finalReport(Module& M);
 
@@ -109,11 +124,19 @@ namespace llvm {
 
     std::set<CallSite> _removed;
 
+    // call-graph SCCs, bottom-up (-FDI-scc, -FDI-threads)
+    std::vector<FuncSet> _sccs;
+    // function --> its SCC in _sccs
+    std::map<const Function*, unsigned> _sccOf;
+    // best remaining candidate in the current (or a later) SCC
+    CallList::iterator nextSCCCandidate(unsigned& scc);
+
     // =====================
     // Evaluation metrics
     // =====================
 
     FuncAttrMap* _funcAttr;   // code attribute cache
+    FDOInlineCache* _cache;   // decisions of the previous build (-FDI-cache)
 
 
     // =====================
@@ -129,6 +152,11 @@ namespace llvm {
     bool updateCallers(Function* caller);
     int computeBudget(int size);
 
+    // partial inlining (-FDI-eprof)
+    bool outlineColdRegions(Function* F, CallGraph& CG, int& growth);
+    std::set<BasicBlock*> _coldBlocks;  // never ran in any profiled run
+    std::set<Function*>   _outlined;    // callees already tried
+
     unsigned functionZID(Function* f);
 
     AllocaMap _allocas;   // per-caller inlined array allocas
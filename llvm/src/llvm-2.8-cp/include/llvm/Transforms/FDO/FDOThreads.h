@@ -0,0 +1,38 @@
+//===- FDOThreads.h - Worker threads for FDO analyses -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A minimal work-sharing helper for the FDO passes.  Work items are
+// numbered 0..N-1 and handed out dynamically to a fixed number of
+// worker threads.  The work function must not touch the IR or any
+// other shared mutable state; everything it needs should be
+// snapshotted (read-only) before the workers are started.
+//
+// If LLVM was configured without thread support, the items are simply
+// run serially on the calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef LLVM_TRANSFORMS_FDO_FDOTHREADS_H
+#define LLVM_TRANSFORMS_FDO_FDOTHREADS_H
+
+namespace llvm {
+
+  // called once for every item in [0, numItems)
+  typedef void (*FDOWorkFunc)(void* context, unsigned item);
+
+  // Run work(context, i) for every item i, using up to numThreads
+  // threads (0 or 1 means serial).  Returns once all items are done.
+  // Returns the number of threads actually used.
+  unsigned runFDOWorkers(FDOWorkFunc work, void* context,
+                         unsigned numItems, unsigned numThreads);
+
+} // namespace llvm
+
+#endif
@@ -31,6 +31,12 @@ ModulePass *createPathProfilerPass();
 // Insert callgraph profiling instrumentation
 ModulePass *createCallProfilerPass();
 
+// Insert argument value profiling instrumentation
+ModulePass *createValueProfilerPass();
+
+// Insert indirect call target profiling instrumentation
+ModulePass *createICallProfilerPass();
+
 } // End llvm namespace
 
 #endif
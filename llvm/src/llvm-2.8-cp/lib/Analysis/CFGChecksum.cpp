@@ -0,0 +1,298 @@
+//===- CFGChecksum.cpp - Matching the counters of changed code ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// See CFGChecksum.h
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Module.h"
+#include "llvm/Instructions.h"
+#include "llvm/Analysis/CFGChecksum.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <map>
+
+using namespace llvm;
+
+// Fraction of the counters of a changed function that must match for
+// its profile to be kept
+static cl::opt<double>
+CPStaleMatch("cp-stale-match", cl::init(0.8), cl::value_desc("fraction"),
+             cl::desc("Fraction of the counters of a changed function that "
+                      "must match to keep its profile"));
+
+
+namespace {
+  // FNV-1a, a word at a time
+  unsigned mix(unsigned h, unsigned v)
+  {
+    for(unsigned i = 0; i < 4; ++i, v >>= 8)
+      h = (h ^ (v & 0xff)) * 16777619U;
+    return(h);
+  }
+
+  const unsigned HashSeed = 2166136261U;
+
+  // the signature of the entry edge: one per function, mapped with it
+  const unsigned EntrySignature = 0x656e7472U;
+}
+
+
+unsigned CFGChecksum::nameHash(const Function& F)
+{
+  return(HashString(F.getName()));
+}
+
+
+unsigned CFGChecksum::checksum(const Function& F)
+{
+  std::map<const BasicBlock*,unsigned> number;
+  unsigned n = 0;
+  for(Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    number[BB] = n++;
+
+  unsigned h = mix(HashSeed, n);
+  for(Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+  {
+    const TerminatorInst* TI = BB->getTerminator();
+    h = mix(h, TI->getNumSuccessors());
+    for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+      h = mix(h, number[TI->getSuccessor(s)]);
+  }
+  return(h);
+}
+
+
+unsigned CFGChecksum::blockSignature(const BasicBlock* BB)
+{
+  unsigned h = HashSeed;
+  for(BasicBlock::const_iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+  {
+    h = mix(h, I->getOpcode());
+    if( !isa<CallInst>(I) && !isa<InvokeInst>(I) )
+      continue;
+    const Function* callee = ImmutableCallSite(I).getCalledFunction();
+    if(callee != NULL)
+      h = mix(h, HashString(callee->getName()));
+  }
+  return(mix(h, BB->getTerminator()->getNumSuccessors()));
+}
+
+
+unsigned CFGChecksum::edgeSignature(const BasicBlock* BB, unsigned s)
+{
+  const TerminatorInst* TI = BB->getTerminator();
+  unsigned h = mix(blockSignature(BB), s);
+  return(mix(h, blockSignature(TI->getSuccessor(s))));
+}
+
+
+void CFGChecksum::edgeLayout(const Module& M, CFGLayout& layout)
+{
+  layout.clear();
+  unsigned e = 0;
+  for(Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+
+    CFGFunctionLayout fl;
+    fl.entry.nameHash = nameHash(*F);
+    fl.entry.checksum = checksum(*F);
+    fl.entry.first = e;
+    fl.signatures.push_back(EntrySignature);
+    for(Function::const_iterator BB = F->begin(), BE = F->end();
+        BB != BE; ++BB)
+    {
+      const TerminatorInst* TI = BB->getTerminator();
+      for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+        fl.signatures.push_back(edgeSignature(BB, s));
+    }
+    fl.entry.count = fl.signatures.size();
+    e += fl.entry.count;
+    layout.push_back(fl);
+  }
+}
+
+
+void CFGChecksum::blockLayout(const Module& M,
+                              const std::vector<BasicBlock*>& blocks,
+                              unsigned first, CFGLayout& layout)
+{
+  layout.clear();
+  unsigned b = 0;
+  for(Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+
+    CFGFunctionLayout fl;
+    fl.entry.nameHash = nameHash(*F);
+    fl.entry.checksum = checksum(*F);
+    fl.entry.first = first + b;
+    for(; (b < blocks.size()) && (blocks[b]->getParent() == &*F); ++b)
+      fl.signatures.push_back(blockSignature(blocks[b]));
+    fl.entry.count = fl.signatures.size();
+    layout.push_back(fl);
+  }
+}
+
+
+void CFGChecksum::encode(ProfilingType PT, const CFGLayout& layout,
+                         std::vector<unsigned>& words)
+{
+  words.clear();
+  words.push_back(PT);
+  for(unsigned f = 0, E = layout.size(); f != E; ++f)
+  {
+    const CFGChecksumEntry& entry = layout[f].entry;
+    words.push_back(entry.nameHash);
+    words.push_back(entry.checksum);
+    words.push_back(entry.first);
+    words.push_back(entry.count);
+    words.insert(words.end(), layout[f].signatures.begin(),
+                 layout[f].signatures.end());
+    if(PT == CombinedEdgeInfo)
+    {
+      std::vector<unsigned> dominators(layout[f].dominators);
+      dominators.resize(entry.count, NoCounter);
+      words.insert(words.end(), dominators.begin(), dominators.end());
+    }
+  }
+}
+
+
+bool CFGChecksum::decode(const std::vector<unsigned>& words,
+                         ProfilingType& PT, CFGLayout& layout)
+{
+  layout.clear();
+  if(words.empty())
+    return(false);
+
+  PT = (ProfilingType)words[0];
+  unsigned w = 1;
+  const unsigned header = sizeof(CFGChecksumEntry) / sizeof(unsigned);
+  while(w != words.size())
+  {
+    if(w + header > words.size())
+      return(false);
+
+    CFGFunctionLayout fl;
+    fl.entry.nameHash = words[w];
+    fl.entry.checksum = words[w+1];
+    fl.entry.first = words[w+2];
+    fl.entry.count = words[w+3];
+    w += header;
+    if(fl.entry.count > words.size() - w)
+      return(false);
+    fl.signatures.assign(words.begin() + w,
+                         words.begin() + w + fl.entry.count);
+    w += fl.entry.count;
+    if(PT == CombinedEdgeInfo)
+    {
+      if(fl.entry.count > words.size() - w)
+        return(false);
+      fl.dominators.assign(words.begin() + w,
+                           words.begin() + w + fl.entry.count);
+      w += fl.entry.count;
+    }
+    layout.push_back(fl);
+  }
+  return(true);
+}
+
+
+// A signature that occurs as often in both versions of a function maps
+// its counters in order; the others are left unmapped.  mapped holds the
+// source of each counter of current's range.
+static unsigned matchSignatures(const CFGFunctionLayout& old,
+                                const CFGFunctionLayout& current,
+                                std::vector<unsigned>& mapped)
+{
+  typedef std::map<unsigned, std::vector<unsigned> > Occurrences;
+  Occurrences oldSigs, curSigs;
+  for(unsigned c = 0, E = old.signatures.size(); c != E; ++c)
+    oldSigs[old.signatures[c]].push_back(old.entry.first + c);
+  for(unsigned c = 0, E = current.signatures.size(); c != E; ++c)
+    curSigs[current.signatures[c]].push_back(c);
+
+  unsigned matched = 0;
+  for(Occurrences::iterator S = curSigs.begin(), E = curSigs.end();
+      S != E; ++S)
+  {
+    Occurrences::iterator O = oldSigs.find(S->first);
+    if( (O == oldSigs.end()) || (O->second.size() != S->second.size()) )
+      continue;
+    for(unsigned i = 0, IE = S->second.size(); i != IE; ++i)
+      mapped[S->second[i]] = O->second[i];
+    matched += S->second.size();
+  }
+  return(matched);
+}
+
+
+bool CFGChecksum::match(const CFGLayout& old, const CFGLayout& current,
+                        std::vector<int>& function,
+                        std::vector<unsigned>& source)
+{
+  bool same = (old.size() == current.size());
+  for(unsigned f = 0, E = current.size(); same && (f != E); ++f)
+  {
+    const CFGChecksumEntry& o = old[f].entry;
+    const CFGChecksumEntry& c = current[f].entry;
+    same = (o.nameHash == c.nameHash) && (o.checksum == c.checksum)
+      && (o.first == c.first) && (o.count == c.count);
+  }
+  if(same)
+    return(false);
+
+  // functions are matched by name; a name seen twice matches nothing
+  std::map<unsigned,int> byName;
+  for(unsigned f = 0, E = old.size(); f != E; ++f)
+  {
+    unsigned name = old[f].entry.nameHash;
+    byName[name] = byName.count(name) ? -1 : (int)f;
+  }
+
+  unsigned size = 0;
+  for(unsigned f = 0, E = current.size(); f != E; ++f)
+    size = std::max(size, current[f].entry.first + current[f].entry.count);
+  function.assign(current.size(), -1);
+  source.assign(size, NoCounter);
+
+  for(unsigned f = 0, E = current.size(); f != E; ++f)
+  {
+    const CFGFunctionLayout& cur = current[f];
+    std::map<unsigned,int>::iterator O = byName.find(cur.entry.nameHash);
+    if( (O == byName.end()) || (O->second < 0) )
+      continue;
+    const CFGFunctionLayout& prev = old[O->second];
+
+    if( (prev.entry.checksum == cur.entry.checksum)
+        && (prev.entry.count == cur.entry.count) )
+    {
+      // unchanged: its counters move as a range
+      function[f] = O->second;
+      for(unsigned c = 0; c != cur.entry.count; ++c)
+        source[cur.entry.first + c] = prev.entry.first + c;
+      continue;
+    }
+
+    // changed: keep what matches, if enough does
+    std::vector<unsigned> mapped(cur.signatures.size(), NoCounter);
+    unsigned matched = matchSignatures(prev, cur, mapped);
+    if( (cur.entry.count > 0)
+        && (matched < CPStaleMatch * cur.entry.count) )
+      continue;
+    function[f] = O->second;
+    for(unsigned c = 0, CE = mapped.size(); c != CE; ++c)
+      source[cur.entry.first + c] = mapped[c];
+  }
+  return(true);
+}
@@ -0,0 +1,225 @@
+//===- CPEdgeMap.cpp - CFG edges of a combined edge profile ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// See CPEdgeMap.h
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Module.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+
+using namespace llvm;
+
+
+CPEdgeMap::CPEdgeMap(Module& M, CombinedEdgeProfile& cep) :
+  _cep(cep), _size(0), _valid(true)
+{
+  unsigned e = 0;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+
+    _entry[F] = e;
+    _preds[&F->getEntryBlock()].push_back(e);
+    e++;
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      _first[BB] = e;
+      TerminatorInst* TI = BB->getTerminator();
+      for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s, ++e)
+        _preds[TI->getSuccessor(s)].push_back(e);
+    }
+    _count[F] = e - _entry[F];
+  }
+
+  // the clients report the mismatch
+  _size = e;
+  if(e != _cep.size())
+    _valid = false;
+}
+
+
+bool CPEdgeMap::hasFunction(Function* F) const
+{
+  return(_valid && (_entry.count(F) > 0));
+}
+
+
+unsigned CPEdgeMap::entryEdge(Function* F) const
+{
+  return(_entry.find(F)->second);
+}
+
+
+unsigned CPEdgeMap::edge(BasicBlock* BB, unsigned succ) const
+{
+  return(_first.find(BB)->second + succ);
+}
+
+
+unsigned CPEdgeMap::edgeCount(Function* F) const
+{
+  return(_count.find(F)->second);
+}
+
+
+CPHistogram& CPEdgeMap::histogram(unsigned e)
+{
+  return(*_cep[e]);
+}
+
+
+unsigned CPEdgeMap::dominator(unsigned e) const
+{
+  return(_cep.getDominatorIndex(e));
+}
+
+
+void CPEdgeMap::chainWeights(Function* F, EdgeStat stat, double q,
+                             double scale, std::vector<double>& weights)
+{
+  unsigned first = entryEdge(F);
+  unsigned count = edgeCount(F);
+  weights.assign(count, -1);
+  for(unsigned e = 0; e != count; ++e)
+    chain(first + e, first, stat, q, scale, weights);
+}
+
+
+double CPEdgeMap::chain(unsigned e, unsigned first, EdgeStat stat, double q,
+                        double scale, std::vector<double>& weights)
+{
+  double& w = weights[e - first];
+  if(w >= 0)
+    return(w);
+
+  unsigned dom = dominator(e);
+  if(dom == e)
+  {
+    // a root: the entry edge, or the first edge of an unreachable region
+    w = (e == first) ? scale : 0;
+    return(w);
+  }
+
+  w = 0;  // guards against cycles in a malformed tree
+  w = (*stat)(histogram(e), q) * chain(dom, first, stat, q, scale, weights);
+  return(w);
+}
+
+
+bool CPEdgeMap::neverExecuted(BasicBlock* BB)
+{
+  return(coverage(BB) <= 0);
+}
+
+
+double CPEdgeMap::coverage(BasicBlock* BB)
+{
+  std::map<BasicBlock*, std::vector<unsigned> >::iterator P = _preds.find(BB);
+  if( !_valid || (P == _preds.end()) )
+    return(0);
+
+  double best = 0;
+  for(unsigned i = 0, E = P->second.size(); i != E; ++i)
+  {
+    CPHistogram& hist = histogram(P->second[i]);
+    double c = hist.nonZero() ? hist.coverage() : 0;
+    if(c > best)
+      best = c;
+  }
+  return(best);
+}
+
+
+double CPEdgeMap::meanStat(const CPHistogram& hist, double q)
+{
+  return(hist.mean(true));
+}
+
+
+// CPHistogram::quantile ignores the zeros; they are the lowest values
+double CPEdgeMap::quantileStat(const CPHistogram& hist, double q)
+{
+  double total = hist.totalWeight();
+  if( (total <= 0) || !hist.nonZero() )
+    return(0);
+
+  double zeros = hist.zeroWeight() / total;
+  if(q <= zeros)
+    return(0);
+  if(hist.isPoint())
+    return(hist.min());
+  return(hist.quantile((q - zeros) / (1 - zeros)));
+}
+
+
+double CPEdgeMap::tailMeanStat(const CPHistogram& hist, double q)
+{
+  double total = hist.totalWeight();
+  if( (total <= 0) || !hist.nonZero() || (q <= 0) )
+    return(0);
+  if(q >= 1)
+    return(hist.mean(true));
+
+  double want = q * total;
+  double have = hist.zeroWeight();   // value 0
+  if(have >= want)
+    return(0);
+
+  double sum = 0;
+  if(hist.isPoint())
+    sum = (want - have) * hist.min();
+  else
+  {
+    for(unsigned b = 0, E = hist.bins(); (b != E) && (have < want); ++b)
+    {
+      double w = hist.getBinWeight(b);
+      if(have + w > want)
+        w = want - have;
+      sum += w * hist.getBinCenter(b);
+      have += w;
+    }
+  }
+  return(sum / want);
+}
+
+
+// P(X < Y | both > 0).  estProbLessThan sums over the bins of Y, and a
+// point distribution has none.
+static double estLess(const CPHistogram& X, const CPHistogram& Y)
+{
+  if(!Y.isPoint())
+    return(X.estProbLessThan(Y));
+  if(X.isPoint())
+    return( (X.min() < Y.min()) ? 1 : 0 );
+  return(X.probLessThan(Y.min()));
+}
+
+
+// P(X < Y) = P(X = 0, Y > 0) + P(X > 0, Y > 0) P(X < Y | both > 0)
+//            + (P(X = 0, Y = 0) + P(X = Y > 0)) / 2
+// with X and Y independent.
+double CPEdgeMap::probLess(const CPHistogram& X, const CPHistogram& Y)
+{
+  double cx = X.nonZero() ? X.coverage() : 0;
+  double cy = Y.nonZero() ? Y.coverage() : 0;
+
+  double p = (1 - cx) * cy + 0.5 * (1 - cx) * (1 - cy);
+  if( (cx > 0) && (cy > 0) )
+  {
+    double less = estLess(X, Y);
+    double more = estLess(Y, X);
+    double tie = 1 - less - more;
+    if(tie < 0) tie = 0;
+    p += cx * cy * (less + 0.5 * tie);
+  }
+  return(p);
+}
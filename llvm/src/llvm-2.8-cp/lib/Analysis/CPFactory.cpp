@@ -8,7 +8,7 @@
 //===----------------------------------------------------------------------===//
 //
 // Takes raw and/or combined profiles from one or more profile file
-// and combines the like-typed profiles (edge/path/call) into a single
+// and combines the like-typed profiles (edge/path/call/value) into a single
 // combined profile of that type.
 //
 //===----------------------------------------------------------------------===//
@@ -32,7 +32,8 @@ CPBinCount("bc", cl::init(0), cl::value_desc("number"),
 #define DEFAULT_BINCOUNT 20
 
 CPFactory::CPFactory(Module& M) : 
-  _callCP(NULL), _edgeCP(NULL), _pathCP(NULL), _M(M) 
+  _callCP(NULL), _edgeCP(NULL), _pathCP(NULL), _valueCP(NULL), _icallCP(NULL),
+  _contextPathCP(NULL), _loopPathCP(NULL), _M(M) 
 {
 }
 
@@ -47,6 +48,10 @@ void CPFactory::clear()
   if(_callCP != NULL) delete _callCP;
   if(_edgeCP != NULL) delete _edgeCP;
   if(_pathCP != NULL) delete _pathCP;
+  if(_valueCP != NULL) delete _valueCP;
+  if(_icallCP != NULL) delete _icallCP;
+  if(_contextPathCP != NULL) delete _contextPathCP;
+  if(_loopPathCP != NULL) delete _loopPathCP;
 }
 
 // repackage the single file name into a vector
@@ -75,11 +80,26 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
   bool rawEdges = false;
   bool rawPaths = false;
   bool rawCalls = false;
+  bool rawValues = false;
+  bool rawICalls = false;
+  bool rawContextPaths = false;
+  bool rawLoopPaths = false;
   // only create if needed to avoid needlessly building edgedomtrees, etc.
   CombinedEdgeProfile* cepFromRaw = NULL; // = new CombinedEdgeProfile(_M);
   CombinedPathProfile* cppFromRaw = NULL; // = new CombinedPathProfile(_M);
   CombinedCallProfile* ccpFromRaw = NULL; // = new CombinedCallProfile(_M);
-  CPList cepList, cppList, ccpList;
+  CombinedValueProfile* cvpFromRaw = NULL;
+  CombinedICallProfile* cipFromRaw = NULL;
+  CombinedContextPathProfile* cxpFromRaw = NULL;
+  CombinedLoopPathProfile* clpFromRaw = NULL;
+  CPList cepList, cppList, ccpList, cvpList, cipList, cxpList, clpList;
+  // the counter maps of the current run, by the type of their counters
+  std::map<ProfilingType,CounterMapVec> counterMaps;
+  // the CFG checksums of the version of the module the run profiled
+  std::map<ProfilingType,CFGLayout> layouts;
+  // the counters the run's instrumentation pruned, by their type
+  std::map<ProfilingType,std::vector<unsigned> > prunedCounters;
+  CombinedProfile* lastCP = NULL;  // the last combined profile read
 
   errs() << "--> CPFactory::buildProfiles (" << filenames.size() << ")\n";
 
@@ -87,9 +107,16 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
   if(_edgeCP != NULL) delete _edgeCP;
   if(_pathCP != NULL) delete _pathCP;
   if(_callCP != NULL) delete _callCP;
+  if(_valueCP != NULL) delete _valueCP;
+  if(_icallCP != NULL) delete _icallCP;
+  if(_contextPathCP != NULL) delete _contextPathCP;
+  if(_loopPathCP != NULL) delete _loopPathCP;
+  _edgeCP = NULL; _pathCP = NULL; _callCP = NULL; _valueCP = NULL;
+  _icallCP = NULL; _contextPathCP = NULL; _loopPathCP = NULL;
 
 
   unsigned fnum = 0;
+  unsigned run = 0;
   for(unsigned E = filenames.size(); fnum < E; ++fnum)
   {
     errs() << "CPFactory::buildProfiles reading " 
@@ -108,15 +135,66 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
     // profiles are collected into single new combined profile
     // (-FromRaw).  Combined profiles are collected in lists (-List)
     // to be combined at the end.
+    bool fresh = true;  // no block read from this file yet
+    if(fnum > 0) run++;
+    counterMaps.clear();
+    layouts.clear();
+    prunedCounters.clear();
+    lastCP = NULL;
     while(fread(&profType, sizeof(ProfilingType), 1, file) > 0)
     {
       errs() << "CPFactory::buildProfile Profile type: " 
              << profilingTypeToString(profType) << "\n";
+
+      // the raw profiles of runs that are not selected are skipped
+      if( (profType == ArgumentInfo) && !fresh ) run++;
+      fresh = false;
+      if( !_runs.empty() && !_runs.count(run) && (profType != ArgumentInfo)
+          && (profType != CombinedEdgeInfo) && (profType != CombinedPathInfo)
+          && (profType != CombinedCallInfo) 
+          && (profType != CombinedValueInfo)
+          && (profType != CombinedICallInfo)
+          && (profType != CombinedContextPathInfo)
+          && (profType != CombinedLoopPathInfo)
+          && (profType != CFGChecksumInfo)
+          && (profType != CombinedUnknownInfo) )
+      {
+        error = !skipRawProfile(profType, file);
+        if(error) break;
+        continue;
+      }
+
 			// What to do with this specific profiling type
 			switch (profType) 
       {
 			case ArgumentInfo:
 				skipArgumentInfo(file);
+        counterMaps.clear();
+        layouts.clear();
+        prunedCounters.clear();
+				break;
+
+			case CounterMapInfo:
+        // which functions a partially instrumented run covers
+        error = !readCounterMap(file, counterMaps);
+				break;
+
+			case CFGChecksumInfo:
+        // the version of the module of the run's next raw profile, or of
+        // the combined profile before it
+        error = !readCFGChecksums(file, layouts, lastCP);
+				break;
+
+			case PrunedCounterInfo:
+        // the converged counters a pruned run did not instrument
+        error = !readPrunedCounters(file, prunedCounters);
+				break;
+
+			case SampleInfo:
+        // the rate of a sampled run.  Every check runs the instrumented
+        // code at this rate, so the combined frequencies, ratios of counts
+        // of the same run, need no rescaling.
+        error = !readSampleInfo(file, run);
 				break;
 
         //
@@ -124,12 +202,27 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
         //
 			case EdgeInfo:
         if(cepFromRaw == NULL) cepFromRaw = new CombinedEdgeProfile(_M);
+        cepFromRaw->setCounterMap(counterMaps[EdgeInfo]);
+        cepFromRaw->setCounterLayout(layouts[EdgeInfo]);
+        cepFromRaw->setPrunedCounters(prunedCounters[EdgeInfo]);
         error = !cepFromRaw->addProfile(file);
+        rawEdges = true;
+				break;
+
+			case OptEdgeInfo:
+        // reconstructed into a full edge profile
+        if(cepFromRaw == NULL) cepFromRaw = new CombinedEdgeProfile(_M);
+        cepFromRaw->setCounterMap(CounterMapVec());
+        cepFromRaw->setCounterLayout(CFGLayout());
+        cepFromRaw->setPrunedCounters(std::vector<unsigned>());
+        error = !cepFromRaw->addOptimalProfile(file);
         rawEdges = true;
 				break;
 
 			case PathInfo:
         if(cppFromRaw == NULL) cppFromRaw = new CombinedPathProfile(_M);
+        cppFromRaw->setCounterMap(counterMaps[PathInfo]);
+        cppFromRaw->setPrunedCounters(prunedCounters[PathInfo]);
         error = !cppFromRaw->addProfile(file);
         rawPaths = true;
 				break;
@@ -138,18 +231,53 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
         if(ccpFromRaw == NULL) ccpFromRaw = new CombinedCallProfile(_M);
         errs() << "ccpFromRaw=" << ccpFromRaw;
         errs() << ", size=" << ccpFromRaw->size() << "\n";
+        ccpFromRaw->setCounterMap(counterMaps[CallInfo]);
+        ccpFromRaw->setCounterLayout(layouts[CallInfo]);
+        ccpFromRaw->setPrunedCounters(prunedCounters[CallInfo]);
         error = !ccpFromRaw->addProfile(file);
         rawCalls = true;
 				break;
 
+			case ValueInfo:
+        if(cvpFromRaw == NULL) cvpFromRaw = new CombinedValueProfile(_M);
+        error = !cvpFromRaw->addProfile(file);
+        rawValues = true;
+				break;
+
+			case ICallInfo:
+        if(cipFromRaw == NULL) cipFromRaw = new CombinedICallProfile(_M);
+        error = !cipFromRaw->addProfile(file);
+        rawICalls = true;
+				break;
+
+			case ContextPathInfo:
+        if(cxpFromRaw == NULL)
+          cxpFromRaw = new CombinedContextPathProfile(_M);
+        error = !cxpFromRaw->addProfile(file);
+        rawContextPaths = true;
+				break;
+
+			case LoopPathInfo:
+        if(clpFromRaw == NULL)
+          clpFromRaw = new CombinedLoopPathProfile(_M);
+        error = !clpFromRaw->addProfile(file);
+        rawLoopPaths = true;
+				break;
+
         //
         // Combined Profiles: add them to the -List to be combined later
         //
+			case CombinedUnknownInfo:
+        // the unknown weights of the combined profile just read
+        error = (lastCP == NULL) || !lastCP->deserializeUnknown(file);
+				break;
+
 			case CombinedEdgeInfo:
         {
           CombinedEdgeProfile* cep = new CombinedEdgeProfile(_M);
           error = !cep->deserialize(file);
           cepList.push_back(cep);
+          lastCP = cep;
           break;
         }
 
@@ -158,6 +286,7 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
           CombinedPathProfile* cpp = new CombinedPathProfile(_M);
           error = !cpp->deserialize(file);
           cppList.push_back(cpp);
+          lastCP = cpp;
           break;
         }
 
@@ -166,6 +295,43 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
           CombinedCallProfile* ccp = new CombinedCallProfile(_M);
           error = !ccp->deserialize(file);
           ccpList.push_back(ccp);
+          lastCP = ccp;
+          break;
+        }
+
+			case CombinedValueInfo:
+        {
+          CombinedValueProfile* cvp = new CombinedValueProfile(_M);
+          error = !cvp->deserialize(file);
+          cvpList.push_back(cvp);
+          lastCP = cvp;
+          break;
+        }
+
+			case CombinedICallInfo:
+        {
+          CombinedICallProfile* cip = new CombinedICallProfile(_M);
+          error = !cip->deserialize(file);
+          cipList.push_back(cip);
+          lastCP = cip;
+          break;
+        }
+
+			case CombinedContextPathInfo:
+        {
+          CombinedContextPathProfile* cxp = new CombinedContextPathProfile(_M);
+          error = !cxp->deserialize(file);
+          cxpList.push_back(cxp);
+          lastCP = cxp;
+          break;
+        }
+
+			case CombinedLoopPathInfo:
+        {
+          CombinedLoopPathProfile* clp = new CombinedLoopPathProfile(_M);
+          error = !clp->deserialize(file);
+          clpList.push_back(clp);
+          lastCP = clp;
           break;
         }
 
@@ -193,6 +359,10 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
     if(cepFromRaw != NULL) delete cepFromRaw;
     if(cppFromRaw != NULL) delete cppFromRaw;
     if(ccpFromRaw != NULL) delete ccpFromRaw;
+    if(cvpFromRaw != NULL) delete cvpFromRaw;
+    if(cipFromRaw != NULL) delete cipFromRaw;
+    if(cxpFromRaw != NULL) delete cxpFromRaw;
+    if(clpFromRaw != NULL) delete clpFromRaw;
   }
   else
   {
@@ -240,6 +410,50 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
     }
     //else delete ccpFromRaw;
 
+    if(rawValues)
+    {
+      unsigned bins = cvpFromRaw->calcBinCount(cvpList, CPBinCount);
+      errs() << "CPFactory::buildProfiles: building value histograms with " 
+             << bins << " bins";
+      cvpFromRaw->buildHistograms(bins);
+      cvpList.push_back(cvpFromRaw);
+      errs() << " CP weight = " << format("%.2f", cvpFromRaw->getTotalWeight())
+             << "\n";
+    }
+
+    if(rawICalls)
+    {
+      unsigned bins = cipFromRaw->calcBinCount(cipList, CPBinCount);
+      errs() << "CPFactory::buildProfiles: building icall histograms with " 
+             << bins << " bins";
+      cipFromRaw->buildHistograms(bins);
+      cipList.push_back(cipFromRaw);
+      errs() << " CP weight = " << format("%.2f", cipFromRaw->getTotalWeight())
+             << "\n";
+    }
+
+    if(rawContextPaths)
+    {
+      unsigned bins = cxpFromRaw->calcBinCount(cxpList, CPBinCount);
+      errs() << "CPFactory::buildProfiles: building context path histograms "
+             << "with " << bins << " bins";
+      cxpFromRaw->buildHistograms(bins);
+      cxpList.push_back(cxpFromRaw);
+      errs() << " CP weight = " << format("%.2f", cxpFromRaw->getTotalWeight())
+             << "\n";
+    }
+
+    if(rawLoopPaths)
+    {
+      unsigned bins = clpFromRaw->calcBinCount(clpList, CPBinCount);
+      errs() << "CPFactory::buildProfiles: building loop path histograms "
+             << "with " << bins << " bins";
+      clpFromRaw->buildHistograms(bins);
+      clpList.push_back(clpFromRaw);
+      errs() << " CP weight = " << format("%.2f", clpFromRaw->getTotalWeight())
+             << "\n";
+    }
+
 
     // Combine all the profiles we've read to build the final combined profile
     if(cepList.size() > 0)
@@ -290,6 +504,73 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
       errs() << " weight: " << format("%.2f", _callCP->getTotalWeight()) << "\n";
     }
 
+    if(cvpList.size() > 0)
+    {
+      errs() << "CPFactory::buildProfiles CVPs: " << cvpList.size();
+      if(cvpList.size() == 1)
+      {
+        _valueCP = (CombinedValueProfile*)cvpList.front();
+        cvpList.pop_front();
+      }
+      else
+      {
+        _valueCP = new CombinedValueProfile(_M);
+        _valueCP->buildFromList(cvpList, CPBinCount);
+      }
+      errs() << " weight: " << format("%.2f", _valueCP->getTotalWeight()) << "\n";
+    }
+
+    if(cipList.size() > 0)
+    {
+      errs() << "CPFactory::buildProfiles CIPs: " << cipList.size();
+      if(cipList.size() == 1)
+      {
+        _icallCP = (CombinedICallProfile*)cipList.front();
+        cipList.pop_front();
+      }
+      else
+      {
+        _icallCP = new CombinedICallProfile(_M);
+        _icallCP->buildFromList(cipList, CPBinCount);
+      }
+      errs() << " weight: " << format("%.2f", _icallCP->getTotalWeight())
+             << "\n";
+    }
+
+    if(cxpList.size() > 0)
+    {
+      errs() << "CPFactory::buildProfiles CXPs: " << cxpList.size();
+      if(cxpList.size() == 1)
+      {
+        _contextPathCP = (CombinedContextPathProfile*)cxpList.front();
+        cxpList.pop_front();
+      }
+      else
+      {
+        _contextPathCP = new CombinedContextPathProfile(_M);
+        _contextPathCP->buildFromList(cxpList, CPBinCount);
+      }
+      errs() << " weight: " 
+             << format("%.2f", _contextPathCP->getTotalWeight()) << "\n";
+    }
+
+    if(clpList.size() > 0)
+    {
+      errs() << "CPFactory::buildProfiles CLPs: " << clpList.size();
+      if(clpList.size() == 1)
+      {
+        _loopPathCP = (CombinedLoopPathProfile*)clpList.front();
+        clpList.pop_front();
+      }
+      else
+      {
+        _loopPathCP = new CombinedLoopPathProfile(_M);
+        _loopPathCP->buildFromList(clpList, CPBinCount);
+      }
+      errs() << " weight: " 
+             << format("%.2f", _loopPathCP->getTotalWeight()) << "\n";
+    }
+
   }
 
   // Cleanup
@@ -302,11 +583,20 @@ bool CPFactory::buildProfiles(const FilenameVec& filenames)
     delete *i;
   for(CPList::iterator i = ccpList.begin(), E = ccpList.end(); i != E; ++i)
     delete *i;
+  for(CPList::iterator i = cvpList.begin(), E = cvpList.end(); i != E; ++i)
+    delete *i;
+  for(CPList::iterator i = cipList.begin(), E = cipList.end(); i != E; ++i)
+    delete *i;
+  for(CPList::iterator i = cxpList.begin(), E = cxpList.end(); i != E; ++i)
+    delete *i;
+  for(CPList::iterator i = clpList.begin(), E = clpList.end(); i != E; ++i)
+    delete *i;
 
   errs() << "<-- CPFactory::buildProfiles\n";
 
   // return success if we built at least one CP
-  if( hasEdgeCP() || hasPathCP() || hasCallCP() )
+  if( hasEdgeCP() || hasPathCP() || hasCallCP() || hasValueCP()
+      || hasICallCP() || hasContextPathCP() || hasLoopPathCP() )
     return(true);
   else
   {
@@ -336,6 +626,174 @@ bool CPFactory::skipArgumentInfo(FILE* file)
 }
 
 
+// read the sampling rate of a run (-profile-sample-interval)
+bool CPFactory::readSampleInfo(FILE* file, unsigned run)
+{
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, file) != 1 )
+    return(false);
+
+  std::vector<unsigned> rate(count);
+  if( (count > 0)
+      && (fread(&rate[0], sizeof(unsigned), count, file) != count) )
+    return(false);
+
+  if( (count >= 2) && (rate[1] > 0) )
+    errs() << "CPFactory::buildProfiles run " << run << " sampled: "
+           << rate[1] << " of every " << rate[0] << " checks\n";
+  return(true);
+}
+
+
+// read a counter map (CounterMapInfo): the type of the counters it
+// covers, then a CounterMapEntry per defined function
+bool CPFactory::readCounterMap(FILE* file,
+                               std::map<ProfilingType,CounterMapVec>& maps)
+{
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, file) != 1 )
+    return(false);
+
+  std::vector<unsigned> words(count);
+  if( (count > 0)
+      && (fread(&words[0], sizeof(unsigned), count, file) != count) )
+    return(false);
+  if(count == 0)
+    return(true);
+
+  CounterMapVec& map = maps[(ProfilingType)words[0]];
+  map.clear();
+  unsigned skipped = 0;
+  for(unsigned i = 1; i + 1 < count; i += 2)
+  {
+    CounterMapEntry entry = { words[i], words[i+1] };
+    map.push_back(entry);
+    if( !entry.instrumented ) skipped++;
+  }
+  errs() << "CPFactory::buildProfiles " << skipped << " of " << map.size()
+         << " functions not instrumented for the "
+         << profilingTypeToString((ProfilingType)words[0]) << "\n";
+  return(true);
+}
+
+
+// read the CFG checksums of a profiled module (CFGChecksumInfo).  Those
+// of raw counters describe the run's next profile of that type; those of
+// a combined profile follow it, and map it onto this module right away.
+bool CPFactory::readCFGChecksums(FILE* file,
+                                 std::map<ProfilingType,CFGLayout>& layouts,
+                                 CombinedProfile* lastCP)
+{
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, file) != 1 )
+    return(false);
+
+  std::vector<unsigned> words(count);
+  if( (count > 0)
+      && (fread(&words[0], sizeof(unsigned), count, file) != count) )
+    return(false);
+
+  ProfilingType PT;
+  CFGLayout layout;
+  if( !CFGChecksum::decode(words, PT, layout) )
+  {
+    errs() << "CPFactory::buildProfiles: corrupt CFG checksums\n";
+    return(false);
+  }
+
+  if( (lastCP != NULL) && (lastCP->getProfilingType() == PT) )
+    return(lastCP->remapLayout(layout));
+  layouts[PT] = layout;
+  return(true);
+}
+
+
+// read the counters a run left out because they had converged
+// (PrunedCounterInfo): the type of the counters, then their indices (for
+// path profiles: function, path low and high words)
+bool CPFactory::readPrunedCounters(FILE* file,
+    std::map<ProfilingType,std::vector<unsigned> >& pruned)
+{
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, file) != 1 )
+    return(false);
+
+  std::vector<unsigned> words(count);
+  if( (count > 0)
+      && (fread(&words[0], sizeof(unsigned), count, file) != count) )
+    return(false);
+  if(count == 0)
+    return(true);
+
+  pruned[(ProfilingType)words[0]].assign(words.begin() + 1, words.end());
+  return(true);
+}
+
+
+bool CPFactory::skipRawProfile(ProfilingType p, FILE* file)
+{
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, file) != 1 ) 
+    return(false);
+
+  switch(p)
+  {
+  case FunctionInfo:
+  case BlockInfo:
+  case EdgeInfo:
+  case OptEdgeInfo:
+  case CallInfo:
+  case ValueInfo:
+  case ICallInfo:
+  case SampleInfo:
+  case CounterMapInfo:
+  case CFGChecksumInfo:
+  case PrunedCounterInfo:
+    // a counter array
+    return(fseek(file, count * sizeof(unsigned), SEEK_CUR) == 0);
+
+  case PathInfo:
+    // count functions, each a header and its path table
+    for(unsigned i = 0; i < count; ++i)
+    {
+      PathHeader header;
+      if( (fread(&header, sizeof(PathHeader), 1, file) != 1)
+          || (fseek(file, header.numEntries * sizeof(PathTableEntry), 
+                    SEEK_CUR) != 0) )
+        return(false);
+    }
+    return(true);
+
+  case ContextPathInfo:
+    // count context paths, each a header and its frames
+    for(unsigned i = 0; i < count; ++i)
+    {
+      PathContextHeader header;
+      if( (fread(&header, sizeof(PathContextHeader), 1, file) != 1)
+          || (fseek(file, header.depth * sizeof(PathContextFrame),
+                    SEEK_CUR) != 0) )
+        return(false);
+    }
+    return(true);
+
+  case LoopPathInfo:
+    // count loop paths, each a header and its path numbers
+    for(unsigned i = 0; i < count; ++i)
+    {
+      LoopPathHeader header;
+      if( (fread(&header, sizeof(LoopPathHeader), 1, file) != 1)
+          || (fseek(file, header.length * 2 * sizeof(unsigned),
+                    SEEK_CUR) != 0) )
+        return(false);
+    }
+    return(true);
+
+  default:
+    return(false);
+  }
+}
+
+
 void CPFactory::freeStaticData()
 {
   errs() << "CPFactory::freeStaticData : freeing static data disabled.\n";
@@ -358,6 +816,19 @@ const std::string& CPFactory::profilingTypeToString(ProfilingType p)
   static std::string cpInfoStr      = "Combined Path Profile";
   static std::string callInfoStr    = "Raw Call Profile";
   static std::string ccInfoStr      = "Combined Call Profile";
+  static std::string valueInfoStr   = "Raw Value Profile";
+  static std::string cvInfoStr      = "Combined Value Profile";
+  static std::string icallInfoStr   = "Raw Indirect Call Profile";
+  static std::string ciInfoStr      = "Combined Indirect Call Profile";
+  static std::string cxtInfoStr     = "Raw Context Path Profile";
+  static std::string cxInfoStr      = "Combined Context Path Profile";
+  static std::string loopInfoStr    = "Raw Loop Path Profile";
+  static std::string clInfoStr      = "Combined Loop Path Profile";
+  static std::string sampleInfoStr  = "Sampling Rate";
+  static std::string mapInfoStr     = "Counter Map";
+  static std::string checksumInfoStr = "CFG Checksums";
+  static std::string prunedInfoStr  = "Pruned Counters";
+  static std::string unknownWtStr   = "Combined Unknown Weights";
   static std::string unknownInfoStr = "(unknowned profile type)";
 
 
@@ -385,6 +856,32 @@ const std::string& CPFactory::profilingTypeToString(ProfilingType p)
     return(callInfoStr);
   case CombinedCallInfo:
     return(ccInfoStr);
+  case ValueInfo:
+    return(valueInfoStr);
+  case CombinedValueInfo:
+    return(cvInfoStr);
+  case ICallInfo:
+    return(icallInfoStr);
+  case CombinedICallInfo:
+    return(ciInfoStr);
+  case ContextPathInfo:
+    return(cxtInfoStr);
+  case CombinedContextPathInfo:
+    return(cxInfoStr);
+  case LoopPathInfo:
+    return(loopInfoStr);
+  case CombinedLoopPathInfo:
+    return(clInfoStr);
+  case SampleInfo:
+    return(sampleInfoStr);
+  case CounterMapInfo:
+    return(mapInfoStr);
+  case CFGChecksumInfo:
+    return(checksumInfoStr);
+  case PrunedCounterInfo:
+    return(prunedInfoStr);
+  case CombinedUnknownInfo:
+    return(unknownWtStr);
   default:
     return(unknownInfoStr);
   }
@@ -0,0 +1,268 @@
+//===- CPFunctionOrder.cpp - Function order from a call profile -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// See CPFunctionOrder.h
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cp-function-order"
+
+#include "llvm/Module.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFunctionOrder.h"
+#include "llvm/Analysis/CPHistogram.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace llvm;
+
+
+namespace {
+  // sorts by decreasing value, keeping the order of equal values
+  template<typename T>
+  struct ByValue {
+    const std::map<T, double>& values;
+    ByValue(const std::map<T, double>& v) : values(v) {}
+    bool operator()(T a, T b) const
+    { return(values.find(a)->second > values.find(b)->second); }
+  };
+}
+
+
+CPFunctionOrder::CPFunctionOrder(Module& M, CombinedCallProfile& ccp,
+                                 double q, unsigned maxCluster)
+{
+  buildCallWeights(M, ccp, q);
+  estimateCalls(M);
+  cluster(M, maxCluster);
+}
+
+
+double CPFunctionOrder::getCalls(Function* F) const
+{
+  std::map<Function*, double>::const_iterator i = _calls.find(F);
+  return( (i == _calls.end()) ? 0 : i->second );
+}
+
+
+void CPFunctionOrder::writeOrderFile(raw_ostream& stream, bool sections) const
+{
+  for(unsigned f = 0, E = _order.size(); f != E; ++f)
+  {
+    if(sections)
+      stream << getSectionName(_order[f]) << "\n";
+    else
+      stream << _order[f]->getName() << "\n";
+  }
+}
+
+
+// the section the function is placed in (its own, unless it has one)
+std::string CPFunctionOrder::getSectionName(Function* F)
+{
+  if(F->hasSection())
+    return(F->getSection());
+  return(".text." + F->getNameStr());
+}
+
+
+// Calls per call of the caller, for each (caller, callee) pair
+void CPFunctionOrder::buildCallWeights(Module& M, CombinedCallProfile& ccp,
+                                       double q)
+{
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      if(!ccp.hasFDOInliningCandidate(BB)) continue;
+
+      double freq = CPEdgeMap::quantileStat(ccp[BB], q);
+      if(freq <= 0) continue;
+
+      for(BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      {
+        if(!ccp.isFDOInliningCandidate(I)) continue;
+        Function* callee = CallSite(cast<Value>(I)).getCalledFunction();
+        _callees[F][callee] += freq;
+        _callers[callee][F] += freq;
+      }
+    }
+  }
+}
+
+
+// Calls per run, propagated in reverse post order from the roots
+void CPFunctionOrder::estimateCalls(Module& M)
+{
+  std::vector<Function*> roots;
+  Function* main = M.getFunction("main");
+  if( (main != NULL) && !main->isDeclaration() )
+    roots.push_back(main);
+  else
+    for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if( !F->isDeclaration() && !_callers.count(F) )
+        roots.push_back(F);
+
+  // post order of the call graph
+  std::vector<Function*> post;
+  std::set<Function*> visited;
+  for(unsigned r = 0, RE = roots.size(); r != RE; ++r)
+  {
+    if(!visited.insert(roots[r]).second) continue;
+
+    typedef std::pair<Function*, CallWeights::iterator> Frame;
+    std::vector<Frame> stack;
+    CallWeights& rc = _callees[roots[r]];
+    stack.push_back(Frame(roots[r], rc.begin()));
+    while(!stack.empty())
+    {
+      Frame& top = stack.back();
+      if(top.second == _callees[top.first].end())
+      {
+        post.push_back(top.first);
+        stack.pop_back();
+        continue;
+      }
+      Function* callee = (top.second++)->first;
+      if(visited.insert(callee).second)
+        stack.push_back(Frame(callee, _callees[callee].begin()));
+    }
+  }
+
+  std::map<Function*, unsigned> rpo;
+  for(unsigned i = 0, E = post.size(); i != E; ++i)
+    rpo[post[E - 1 - i]] = i;
+
+  for(unsigned r = 0, RE = roots.size(); r != RE; ++r)
+    _calls[roots[r]] = 1;
+
+  for(unsigned i = post.size(); i != 0; --i)
+  {
+    Function* F = post[i - 1];
+    unsigned index = rpo[F];
+    double& calls = _calls[F];
+
+    CallWeights& callers = _callers[F];
+    for(CallWeights::iterator C = callers.begin(), E = callers.end();
+        C != E; ++C)
+    {
+      std::map<Function*, unsigned>::iterator ci = rpo.find(C->first);
+      if( (ci != rpo.end()) && (ci->second < index) )   // not a back edge
+        calls += _calls[C->first] * C->second;
+    }
+
+    DEBUG(dbgs() << "  " << F->getName() << ": "
+                 << format("%.2f", calls) << " calls\n");
+  }
+}
+
+
+// Call-chain clustering
+void CPFunctionOrder::cluster(Module& M, unsigned maxCluster)
+{
+  std::vector<Function*> hot, cold;
+  std::map<Function*, double> calls;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+    double c = getCalls(F);
+    calls[F] = c;
+    if(c > 0)
+      hot.push_back(F);
+    else
+      cold.push_back(F);
+  }
+  std::stable_sort(hot.begin(), hot.end(), ByValue<Function*>(calls));
+
+  // one cluster per function to start with
+  std::vector<Order> clusters(hot.size());
+  std::vector<unsigned> sizes(hot.size());
+  std::vector<double> time(hot.size());
+  std::map<Function*, unsigned> clusterOf;
+  for(unsigned f = 0, E = hot.size(); f != E; ++f)
+  {
+    clusters[f].push_back(hot[f]);
+    sizes[f] = functionSize(hot[f]);
+    time[f] = calls[hot[f]] * sizes[f];
+    clusterOf[hot[f]] = f;
+  }
+
+  // append each function's cluster to its heaviest caller's
+  for(unsigned f = 0, E = hot.size(); f != E; ++f)
+  {
+    Function* F = hot[f];
+    Function* caller = NULL;
+    double best = 0;
+    CallWeights& callers = _callers[F];
+    for(CallWeights::iterator C = callers.begin(), CE = callers.end();
+        C != CE; ++C)
+    {
+      double w = getCalls(C->first) * C->second;
+      if( (C->first != F) && (w > best) )
+      {
+        best = w;
+        caller = C->first;
+      }
+    }
+    if(caller == NULL) continue;
+
+    unsigned from = clusterOf[F], to = clusterOf[caller];
+    if( (from == to) || (sizes[from] + sizes[to] > maxCluster) )
+      continue;
+
+    for(unsigned m = 0, ME = clusters[from].size(); m != ME; ++m)
+    {
+      clusters[to].push_back(clusters[from][m]);
+      clusterOf[clusters[from][m]] = to;
+    }
+    clusters[from].clear();
+    sizes[to] += sizes[from];
+    time[to] += time[from];
+    sizes[from] = 0;
+    time[from] = 0;
+  }
+
+  // densest clusters first
+  std::vector<unsigned> live;
+  std::map<unsigned, double> density;
+  for(unsigned c = 0, E = clusters.size(); c != E; ++c)
+  {
+    if(clusters[c].empty()) continue;
+    live.push_back(c);
+    density[c] = time[c] / (sizes[c] ? sizes[c] : 1);
+  }
+  std::stable_sort(live.begin(), live.end(), ByValue<unsigned>(density));
+
+  _order.clear();
+  for(unsigned c = 0, E = live.size(); c != E; ++c)
+    _order.insert(_order.end(), clusters[live[c]].begin(),
+                  clusters[live[c]].end());
+  _order.insert(_order.end(), cold.begin(), cold.end());
+
+  DEBUG(dbgs() << "CPFunctionOrder: " << hot.size() << " called functions in "
+               << live.size() << " clusters, " << cold.size()
+               << " never called\n");
+}
+
+
+unsigned CPFunctionOrder::functionSize(Function* F)
+{
+  unsigned size = 0;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    size += BB->size();
+  return(size);
+}
@@ -607,6 +607,16 @@ double CPHistogram::totalWeight() const
 }
 
 
+// The runs a histogram covers can drop (parts of a profile that were
+// unknown in some runs), but never below the weight of its values
+void CPHistogram::setTotalWeight(double totalweight)
+{
+  if(totalweight < _stats.sumOfWeights)
+    totalweight = _stats.sumOfWeights;
+  _stats.totalWeight = totalweight;
+}
+
+
 double CPHistogram::maxWeight() const
 {
   if(!nonZero())
@@ -1406,14 +1416,24 @@ bool CPHistogram::serialize(unsigned ID, FILE* f) const
 // read binary representation from f.  Return the ID, since we don't
 // store that internally.
 int CPHistogram::deserialize(unsigned bincount, double totalweight, FILE* f)
+{
+  unsigned ID;
+  if( !deserialize(bincount, totalweight, f, ID) )
+    return(-1);
+  return(ID);
+}
+
+bool CPHistogram::deserialize(unsigned bincount, double totalweight, FILE* f,
+                              unsigned& ID)
 {
   CPHistogramHeader entry;
 
   // Read in the header
   if ( fread(&entry, sizeof(CPHistogramHeader), 1, f) != 1)
   {
-    return(-1);
+    return(false);
   }
+  ID = entry.ID;
 
   clear();
 
@@ -1434,7 +1454,7 @@ int CPHistogram::deserialize(unsigned bincount, double totalweight, FILE* f)
            << entry.ID << "\n";
 
   if(isPoint())  // points have no bins, we're done
-    return(entry.ID);
+    return(true);
 
   // allocate the bins
   setBinCount(bincount);
@@ -1444,7 +1464,7 @@ int CPHistogram::deserialize(unsigned bincount, double totalweight, FILE* f)
   {
     errs() << "Error: histogram bin data corrupt: " << (unsigned)entry.binsUsed 
            << " of " << bincount << " bins used!\n";
-    return(-1);
+    return(false);
   }
 
   // Get the data for each bin
@@ -1456,11 +1476,11 @@ int CPHistogram::deserialize(unsigned bincount, double totalweight, FILE* f)
     if( fread(&newBin, sizeof(CPHistogramBin), 1, f) != 1 )
     {
       errs() << "warning: could not read histogram bin entry " << b << "\n";
-      return(-1);
+      return(false);
     }
     setBinWeight(newBin.index, newBin.weight);
   }
-  return(entry.ID);
+  return(true);
 }
 
 
@@ -0,0 +1,203 @@
+//===- CPProfileLoaderPass.cpp - ProfileInfo from a combined profile ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// An implementation of ProfileInfo that is fed by a combined edge
+// profile (read through CPFactory) instead of a raw llvmprof.out, so
+// that every ProfileInfo client (block placement, CodeGenPrepare,
+// critical edge splitting, ...) can use combined profiles unchanged.
+//
+// A combined edge profile stores, for every edge, the distribution
+// over runs of its hierarchically-normalized frequency: executions of
+// the edge per execution of its edge dominator.  One statistic of each
+// distribution (-cp-profile-stat) is chained down the edge dominator
+// tree, so that an edge's weight is its expected executions per call
+// of the function, times -cp-profile-scale:
+//
+//   weight(entry edge) = scale
+//   weight(e)          = stat(hist(e)) * weight(dom(e))
+//
+// (ie, the normalized frequencies are treated as independent).  The
+// statistics, over all runs (including those where the edge was not
+// executed) are:
+//
+//   mean      the mean
+//   quantile  the -cp-profile-q quantile
+//   risk      the mean of the runs at or below the -cp-profile-q
+//             quantile (lower-tail expectation), ie, a pessimistic
+//             quantile that also accounts for how bad the tail is
+//
+// Block weights are the sums of the incoming edge weights.  Edges of
+// blocks that are not reachable from the entry (other roots of the edge
+// dominator tree) get weight 0.
+//
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "cp-profile-loader"
+#include "llvm/BasicBlock.h"
+#include "llvm/InstrTypes.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Analysis/ProfileInfo.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/Statistic.h"
+#include <vector>
+using namespace llvm;
+
+STATISTIC(NumCPEdgesRead, "The # of combined profile edges read.");
+
+static cl::opt<std::string>
+CPProfileFilename("cp-profile-file", cl::init("edge.cp"),
+                  cl::value_desc("filename"),
+                  cl::desc("Combined edge profile loaded by "
+                           "-cp-profile-loader"));
+
+namespace {
+  enum CPProfileStat { CPStatMean, CPStatQuantile, CPStatRisk };
+}
+
+static cl::opt<CPProfileStat>
+CPProfileStatistic("cp-profile-stat", cl::init(CPStatMean),
+                   cl::desc("Statistic of the combined edge profile "
+                            "used as the edge weight"),
+                   cl::values(
+                     clEnumValN(CPStatMean, "mean", "mean over runs"),
+                     clEnumValN(CPStatQuantile, "quantile",
+                                "-cp-profile-q quantile over runs"),
+                     clEnumValN(CPStatRisk, "risk",
+                                "mean of the runs at or below the "
+                                "-cp-profile-q quantile"),
+                     clEnumValEnd));
+
+static cl::opt<double>
+CPProfileQ("cp-profile-q", cl::init(0.5),
+           cl::desc("Quantile for -cp-profile-stat=quantile|risk"));
+
+static cl::opt<double>
+CPProfileScale("cp-profile-scale", cl::init(1.0),
+               cl::desc("Weight of a function's entry edge "
+                        "(-cp-profile-loader)"));
+
+namespace {
+  class CPLoaderPass : public ModulePass, public ProfileInfo {
+    std::string Filename;
+  public:
+    static char ID; // Class identification, replacement for typeinfo
+    explicit CPLoaderPass(const std::string &filename = "")
+      : ModulePass(ID), Filename(filename) {
+      if (filename.empty()) Filename = CPProfileFilename;
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+
+    virtual const char *getPassName() const {
+      return "Combined profile information loader";
+    }
+
+    /// getAdjustedAnalysisPointer - This method is used when a pass implements
+    /// an analysis interface through multiple inheritance.  If needed, it
+    /// should override this to adjust the this pointer as needed for the
+    /// specified pass info.
+    virtual void *getAdjustedAnalysisPointer(AnalysisID PI) {
+      if (PI == &ProfileInfo::ID)
+        return (ProfileInfo*)this;
+      return this;
+    }
+
+    /// run - Load the combined profile from the specified file.
+    virtual bool runOnModule(Module &M);
+
+    static double statistic(const CPHistogram &H, double q);
+  };
+}  // End of anonymous namespace
+
+char CPLoaderPass::ID = 0;
+INITIALIZE_AG_PASS(CPLoaderPass, ProfileInfo, "cp-profile-loader",
+              "Load profile information from a combined edge profile",
+              false, true, false);
+
+ModulePass *llvm::createCPProfileLoaderPass() { return new CPLoaderPass(); }
+
+Pass *llvm::createCPProfileLoaderPass(const std::string &Filename) {
+  return new CPLoaderPass(Filename);
+}
+
+
+double CPLoaderPass::statistic(const CPHistogram &H, double q) {
+  switch (CPProfileStatistic) {
+  case CPStatQuantile:
+    return CPEdgeMap::quantileStat(H, q);
+  case CPStatRisk:
+    return CPEdgeMap::tailMeanStat(H, q);
+  case CPStatMean:
+  default:
+    return CPEdgeMap::meanStat(H, q);
+  }
+}
+
+
+bool CPLoaderPass::runOnModule(Module &M) {
+  EdgeInformation.clear();
+  BlockInformation.clear();
+  FunctionInformation.clear();
+
+  CPFactory Fact(M);
+  if (!Fact.buildProfiles(Filename) || !Fact.hasEdgeCP()) {
+    errs() << "WARNING: no combined edge profile in '" << Filename
+           << "'; no profile information available!\n";
+    return false;
+  }
+  CombinedEdgeProfile *CEP = Fact.takeEdgeCP();
+
+  CPEdgeMap Map(M, *CEP);
+  if (!Map.valid())
+    errs() << "WARNING: profile information is inconsistent with "
+           << "the current program!\n";
+
+  for (Module::iterator F = M.begin(), E = M.end(); Map.valid() && F != E;
+       ++F) {
+    if (F->isDeclaration()) continue;
+    DEBUG(dbgs() << "Working on " << F->getNameStr() << "\n");
+
+    std::vector<double> Weights;
+    Map.chainWeights(F, statistic, CPProfileQ, CPProfileScale, Weights);
+    unsigned First = Map.entryEdge(F);
+
+    // blocks without incoming edges (unreachable) are never executed
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      BlockInformation[F][BB] = 0;
+
+    Edge Entry = getEdge(0, &F->getEntryBlock());
+    EdgeInformation[F][Entry] = Weights[0];
+    BlockInformation[F][&F->getEntryBlock()] = Weights[0];
+    FunctionInformation[F] = Weights[0];
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+      TerminatorInst *TI = BB->getTerminator();
+      for (unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s) {
+        // duplicate edges (eg, switch cases) add up
+        double W = Weights[Map.edge(BB, s) - First];
+        EdgeInformation[F][getEdge(BB, TI->getSuccessor(s))] += W;
+        BlockInformation[F][TI->getSuccessor(s)] += W;
+      }
+    }
+
+    NumCPEdgesRead += Map.edgeCount(F);
+  }
+
+  delete CEP;
+  return false;
+}
@@ -62,7 +62,7 @@ CombinedCallProfile::CombinedCallProfile(Module& M)
         numFuncs++;
     }
     _funcRef.resize(numFuncs, 0);
-    _funcIndex.resize(numFuncs, numFuncs); // init to invalid index
+    _funcIndex.clear();  // filled per histogram below
     _entryCalls.clear();
     
     
@@ -127,10 +127,48 @@ CombinedCallProfile::CombinedCallProfile(Module& M)
 }
 
 
+// (not getPrevNode: the block list's sentinel is only half a node)
 bool CombinedCallProfile::isEntry(BasicBlock* BB)
 {
-  return(BB->getPrevNode() == 0);
+  return(BB == &BB->getParent()->getEntryBlock());
 } 
+
+
+void CombinedCallProfile::moduleLayout(bool combined, CFGLayout& layout)
+{
+  layout.clear();
+  if(_funcRef.empty())
+    return;
+
+  // the blocks with calls, in counter order; the raw counters of the
+  // entry blocks are the entry counters
+  std::vector<BasicBlock*> blocks;
+  for(unsigned f = 0, E = _funcRef.size(); f != E; ++f)
+    for(Function::iterator BB = _funcRef[f]->begin(), 
+          BE = _funcRef[f]->end(); BB != BE; ++BB)
+      if( (combined || !isEntry(BB)) && hasFDOInliningCandidate(BB) )
+        blocks.push_back(BB);
+
+  CFGChecksum::blockLayout(*_funcRef[0]->getParent(), blocks,
+                           combined ? 0 : _funcRef.size(), layout);
+}
+
+
+// A combined profile of another version of the module: keep the
+// histograms of the blocks that match
+bool CombinedCallProfile::remapLayout(const CFGLayout& layout)
+{
+  CFGLayout current;
+  moduleLayout(true, current);
+  remapHistograms(layout, current);
+  if(_histograms.size() != _histCnt)
+  {
+    errs() << "CCP::remapLayout: error: " << _histograms.size()
+           << " blocks mapped, " << _histCnt << " in the module\n";
+    return(false);
+  }
+  return(true);
+}
  
    
 unsigned CombinedCallProfile::serialize(FILE* f)
@@ -171,6 +209,20 @@ unsigned CombinedCallProfile::serialize(FILE* f)
     written++;
 	}
 
+  if( !serializeUnknown(f) ) 
+  {
+    errs() << "error: unable to write unknown call weights to file.\n";
+    return(0);
+  }
+
+  CFGLayout layout;
+  moduleLayout(true, layout);
+  if( !serializeLayout(f, layout) )
+  {
+    errs() << "error: unable to write call CFG checksums to file.\n";
+    return(0);
+  }
+
   //errs() << "<-- CCP::serialize\n";
   return(written);
 }
@@ -201,6 +253,10 @@ bool CombinedCallProfile::deserialize(FILE* f)
       return false;
     }
 
+    // a profile of another version of the module may have more blocks
+    // (remapLayout maps them onto this one)
+    if((unsigned)index >= _histograms.size())
+      _histograms.resize(index + 1, NULL);
     _histograms[index] = newHist;
 	}
 
@@ -232,7 +288,33 @@ bool CombinedCallProfile::addProfile(FILE* file)
     return(false);
   }
 
+  // read the counters
+  std::vector<unsigned> counts(callCount);
+  if( (callCount > 0)
+      && (fread(&counts[0], sizeof(unsigned), callCount, file) 
+          != callCount) ) {
+    errs() << "  warning: call profiling info header/data mismatch\n";
+    return(false);
+  }
+
   int expectedCnt = _funcFreq.size()+_histograms.size()-(_entryCalls.size()-1);
+
+  // a run of another version of the module: map its call blocks onto
+  // this one, and its entry counters with their functions
+  std::vector<unsigned> raw(counts);
+  std::vector<bool> stale;
+  std::vector<int> function;
+  CFGLayout layout;
+  if( !_layout.empty() )
+    moduleLayout(false, layout);
+  if( remapCounters(layout, expectedCnt, counts, stale, function) )
+  {
+    for(unsigned f = 0, E = _funcFreq.size(); f != E; ++f)
+      if( (function[f] >= 0) && ((unsigned)function[f] < raw.size()) )
+        counts[f] = raw[function[f]];
+    callCount = counts.size();
+  }
+
   if((int)callCount != expectedCnt)
   {
     errs() << "addProfile: Error: " << callCount << " profile entries, but " 
@@ -241,15 +323,8 @@ bool CombinedCallProfile::addProfile(FILE* file)
            << " blocks with calls (" << _entryCalls.size()-1 << " entries))\n";
     return(false);
   }
-
-  // read the counters
-  unsigned* callBuffer = new unsigned[callCount];
-  if( fread(callBuffer, sizeof(unsigned), callCount, file)
-      != callCount) {
-    delete [] callBuffer;
-    errs() << "  warning: call profiling info header/data mismatch\n";
-    return(false);
-  }
+  const unsigned* callBuffer = callCount ? &counts[0] : NULL;
+  std::set<unsigned> pruned(_pruned.begin(), _pruned.end());
 
   addWeight(1.0);
 
@@ -278,20 +353,37 @@ bool CombinedCallProfile::addProfile(FILE* file)
   // ... followed by frequencies for block with calls
   //errs() << "  Reading " << _histograms.size() << " block counters\n";
   unsigned ec = 0;  // index in _entryCalls
-  for(unsigned h = 0, E = _histograms.size(); h < E; ++h, ++i)
+  for(unsigned h = 0, E = _histograms.size(); h < E; ++h)
   {
-    if(h == _entryCalls[ec])  // entry blocks always have HN-freq=1
+    if( (ec + 1 < _entryCalls.size()) && (h == _entryCalls[ec]) )
     {
+      // entry blocks always have HN-freq=1 and no counter of their own
       //errs() << "    h["<<h<<"] = 1 (entry " << ec << ")\n";
-      // this counter doesn't actually exist, so increment h!
-      _histograms[h++]->addToList(1.0);  
+      if(isInstrumented(_funcIndex[h]))
+        _histograms[h]->addToList(1.0);  
+      else
+        addUnknown(h);
       ec++;
+      continue;
+    }
+    unsigned c = i++;  // this block's counter
+
+    // the blocks of a function the run did not instrument are unknown,
+    // as are the stale blocks of a changed function
+    if( !isInstrumented(_funcIndex[h]) || ((c < stale.size()) && stale[c]) )
+    {
+      addUnknown(h);
+      continue;
     }
 
     //errs() << "    h["<<h<<"] = ";
     unsigned funcFreq = _funcFreq[_funcIndex[h]];
-    unsigned count = callBuffer[i];
-    if(count == 0xffffffff)
+    unsigned count = callBuffer[c];
+    // A block pruned from the instrumentation (-profile-prune-cp) because
+    // it always ran once per call has HN-freq=1
+    if(pruned.count(c))
+      count = funcFreq;
+    else if(count == 0xffffffff)
       errs() << "CombinedCallProfile::addProfile Warning: saturated call count (" << h << ")\n";
     if( (funcFreq > 0) && (count > 0) )
     {
@@ -302,7 +394,6 @@ bool CombinedCallProfile::addProfile(FILE* file)
     }
   }
 
-  delete [] callBuffer;
   //errs() << "<-- CCP::addProfile (" << getTotalWeight() << ")\n";
   return(true);
 }
@@ -321,6 +412,7 @@ bool CombinedCallProfile::buildFromList(CPList& list, unsigned binCount)
     _bincount = binCount;
 
   _weight = 0;
+  _unknown.clear();
 
 	if(list.size() == 0)
 		return true;
@@ -364,6 +456,7 @@ bool CombinedCallProfile::buildFromList(CPList& list, unsigned binCount)
       errs() << "BuildFromList: call count mismatch! " 
              << calls << " vs " << callCount << "\n";
   }
+  mergeUnknown(list);
 
 	// Merge each set of histograms
 	for( unsigned i = 0; i < callCount; i++ )
@@ -381,7 +474,7 @@ bool CombinedCallProfile::buildFromList(CPList& list, unsigned binCount)
 				cphl.push_back(&hist);
     }
 
-		_histograms[i] = new CPHistogram(_bincount, _weight, cphl);
+		_histograms[i] = new CPHistogram(_bincount, getKnownWeight(i), cphl);
 	}
 
   //errs() << "<-- CCP::buildFromList (" << getTotalWeight() << ")\n";
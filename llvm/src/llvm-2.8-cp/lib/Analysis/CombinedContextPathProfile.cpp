@@ -0,0 +1,312 @@
+//===- CombinedContextPathProfile.cpp -------------------------*- C++ -*---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Combined profile of paths in the context of their callers' path
+// prefixes (see PathProfiling.cpp, -path-profile-context, for the
+// instrumentation).
+//
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "cp-contextpath"
+
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+
+using namespace llvm;
+
+// ----------------------------------------------------------------------------
+// Combined context path profile implementation
+// ----------------------------------------------------------------------------
+
+CombinedContextPathProfile::CombinedContextPathProfile(Module& module) :
+  _functionCount(0)
+{
+  for( Module::iterator F = module.begin(), E = module.end(); F != E; ++F )
+    if( !F->isDeclaration() )
+      _functionCount++;
+}
+
+
+// Reads the depth frames of a context path; the last is the callee.
+bool CombinedContextPathProfile::readContextPath(FILE* f, unsigned depth,
+                                                 ContextPathID& path) const
+{
+  if( (depth < 2) || (depth > PP_MAX_CONTEXT + 1) )
+  {
+    errs() << "CCPP: bad context depth " << depth << "\n";
+    return(false);
+  }
+
+  path.first.clear();
+  for(unsigned d = 0; d < depth; ++d)
+  {
+    PathContextFrame frame;
+    if( fread(&frame, sizeof(PathContextFrame), 1, f) != 1 )
+    {
+      errs() << "CCPP: failed to read context frame\n";
+      return(false);
+    }
+    if( (frame.fnNumber == 0) || (frame.fnNumber > _functionCount) )
+    {
+      errs() << "CCPP: bad function " << frame.fnNumber << " ("
+             << _functionCount << " functions)\n";
+      return(false);
+    }
+
+    PathID id(frame.fnNumber,
+              ((PathIndex)frame.pathNumberHi << 32) | frame.pathNumberLo);
+    if(d + 1 < depth)
+      path.first.push_back(id);
+    else
+      path.second = id;
+  }
+  return(true);
+}
+
+
+unsigned CombinedContextPathProfile::serialize(FILE* f)
+{
+  unsigned pathCount = 0;
+  for(CCPPHistogramMap::iterator P = _paths.begin(), E = _paths.end();
+      P != E; ++P)
+    if(_histograms[P->second]->nonZero())
+      pathCount++;
+
+	// Output information about the profile
+  ProfilingType ptype = getProfilingType();
+	if( (fwrite(&ptype, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&_weight, sizeof(double), 1, f) != 1) ||
+      (fwrite(&pathCount, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&_bincount, sizeof(unsigned), 1, f) != 1) )
+  {
+		errs() << "error: unable to write CCPP header to file.\n";
+		return(0);
+	}
+
+  // each histogram follows its depth and frames
+  unsigned written = 0;
+  for(CCPPHistogramMap::iterator P = _paths.begin(), E = _paths.end();
+      P != E; ++P)
+  {
+    CPHistogram* hist = _histograms[P->second];
+    if( !hist->nonZero() )
+      continue;
+
+    const PathContext& context = P->first.first;
+    unsigned depth = context.size() + 1;
+    bool ok = (fwrite(&depth, sizeof(unsigned), 1, f) == 1);
+    for(unsigned d = 0; ok && (d < depth); ++d)
+    {
+      const PathID& id = (d < context.size()) ? context[d] : P->first.second;
+      PathContextFrame frame = { id.first, (unsigned)id.second,
+                                 (unsigned)(id.second >> 32) };
+      ok = (fwrite(&frame, sizeof(PathContextFrame), 1, f) == 1);
+    }
+
+    if( !ok || !hist->serialize(written, f) )
+    {
+      errs() << "error: CCPP::serialize failed to serialize histogram: f:"
+             << P->first.second.first << ", p:" << P->first.second.second
+             << "\n";
+      return(0);
+    }
+    written++;
+  }
+
+  return(written);
+}
+
+
+bool CombinedContextPathProfile::deserialize(FILE* f)
+{
+	unsigned pathCount;
+
+	if( !fread(&_weight, sizeof(double), 1, f) ||
+		  !fread(&pathCount, sizeof(unsigned), 1, f) ||
+		  !fread(&_bincount, sizeof(unsigned), 1, f) ) {
+		errs() << "warning: combined context path profiling data corrupt.\n";
+		return false;
+	}
+
+  for(unsigned p = 0; p < pathCount; p++)
+  {
+    unsigned depth;
+    ContextPathID path;
+    if( (fread(&depth, sizeof(unsigned), 1, f) != 1)
+        || !readContextPath(f, depth, path) )
+    {
+      errs() << "CCPP::deserialize Error: failed to read context path "
+             << p << " of " << pathCount << "\n";
+      return(false);
+    }
+
+    CPHistogram* hist = new CPHistogram();
+    unsigned ID;
+    if( !hist->deserialize(_bincount, _weight, f, ID) )
+    {
+      errs() << "CCPP::deserialize Error: failed to read histogram "
+             << p << " of " << pathCount << "\n";
+      delete hist;
+      return(false);
+    }
+
+    _paths[path] = _histograms.size();
+    _histograms.push_back(hist);
+  }
+
+	return true;
+}
+
+
+// Reads in a raw context path profile and adds, for every context path,
+// its share of the paths of the same function in the same context to
+// its add list.
+bool CombinedContextPathProfile::addProfile(FILE* f)
+{
+  unsigned pathCount;
+  if( fread(&pathCount, sizeof(unsigned), 1, f) != 1 )
+  {
+    errs() << "  error: context path profiling info has no header\n";
+    return(false);
+  }
+
+  // (context, function) --> executions of its paths
+  typedef std::pair<PathContext,FunctionIndex> CalleeKey;
+  std::map<CalleeKey,double> totals;
+  std::vector<std::pair<ContextPathID,unsigned> > counts;
+  for(unsigned p = 0; p < pathCount; ++p)
+  {
+    PathContextHeader header;
+    ContextPathID path;
+    if( (fread(&header, sizeof(PathContextHeader), 1, f) != 1)
+        || !readContextPath(f, header.depth, path) )
+    {
+      errs() << "  error: bad context path profiling file syntax\n";
+      return(false);
+    }
+    if(header.pathCounter == 0)
+      continue;
+
+    counts.push_back(std::make_pair(path, header.pathCounter));
+    totals[CalleeKey(path.first, path.second.first)] += header.pathCounter;
+  }
+
+  addWeight(1.0);
+
+  for(unsigned p = 0, E = counts.size(); p != E; ++p)
+  {
+    const ContextPathID& path = counts[p].first;
+    double total = totals[CalleeKey(path.first, path.second.first)];
+    getHistogram(path).addToList(counts[p].second / total);
+  }
+
+  return(true);
+}
+
+
+// Even though list is a generic CPList, it should only contain CCPPs
+bool CombinedContextPathProfile::buildFromList(CPList& list, unsigned binCount)
+{
+	if(list.size() == 0)
+		return true;
+
+  ProfilingType myType = getProfilingType();
+
+  if(binCount == 0)
+    _bincount = calcBinCount(list);
+  else
+    _bincount = binCount;
+
+  // collect the histograms of each context path from all CPs in the list
+  std::map<ContextPathID,CPHistogramList> ccpphm;
+	for(CPList::iterator CP = list.begin(), E = list.end(); CP != E; ++CP)
+  {
+    if((*CP)->getProfilingType() != myType)
+    {
+      errs() << "CCPP::buildFromList Warning: CP in list is not a CCPP\n";
+      continue;
+    }
+
+    CombinedContextPathProfile* cp = (CombinedContextPathProfile*)(*CP);
+		_weight += cp->_weight;
+
+    for(CCPPHistogramMap::iterator P = cp->_paths.begin(),
+          PE = cp->_paths.end(); P != PE; ++P)
+    {
+      CPHistogram* hist = cp->_histograms[P->second];
+      if( hist->nonZeroWeight() != 0 )
+        ccpphm[P->first].push_back(hist);
+    }
+  }
+
+  for(std::map<ContextPathID,CPHistogramList>::iterator P = ccpphm.begin(),
+        E = ccpphm.end(); P != E; ++P)
+  {
+    _paths[P->first] = _histograms.size();
+    _histograms.push_back(new CPHistogram(_bincount, _weight, P->second));
+  }
+
+	return true;
+}
+
+
+bool CombinedContextPathProfile::valid(const ContextPathID& path) const
+{
+  return(_paths.count(path) > 0);
+}
+
+
+CPHistogram& CombinedContextPathProfile::getHistogram(const ContextPathID& path)
+{
+  CCPPHistogramMap::iterator P = _paths.find(path);
+  if(P != _paths.end())
+    return(*_histograms[P->second]);
+
+  CPHistogram* hist = new CPHistogram();
+  _paths[path] = _histograms.size();
+  _histograms.push_back(hist);
+  return(*hist);
+}
+
+
+void CombinedContextPathProfile::getContextPathSet(ContextPathSet& paths) const
+{
+  for(CCPPHistogramMap::const_iterator P = _paths.begin(), E = _paths.end();
+      P != E; ++P)
+    paths.insert(P->first);
+}
+
+
+namespace {
+  bool hotterFirst(const std::pair<double,PathIndex>& a,
+                   const std::pair<double,PathIndex>& b)
+  {
+    return(a.first > b.first);
+  }
+}
+
+void CombinedContextPathProfile::getCalleePaths(const PathContext& context,
+    FunctionIndex funcIndex, std::vector<std::pair<double,PathIndex> >& paths)
+{
+  ContextPathID first(context, PathID(funcIndex, 0));
+  for(CCPPHistogramMap::iterator P = _paths.lower_bound(first),
+        E = _paths.end(); P != E; ++P)
+  {
+    if( (P->first.first != context) || (P->first.second.first != funcIndex) )
+      break;
+    paths.push_back(std::make_pair(_histograms[P->second]->mean(true),
+                                   P->first.second.second));
+  }
+  std::stable_sort(paths.begin(), paths.end(), hotterFirst);
+}
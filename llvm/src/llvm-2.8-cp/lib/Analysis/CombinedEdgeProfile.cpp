@@ -11,6 +11,8 @@
 //===----------------------------------------------------------------------===//
 #define DEBUG_TYPE "cp-histogram"
 
+#include "llvm/Module.h"
+#include "llvm/Analysis/ProfileInfoLoader.h"
 #include "llvm/Analysis/ProfileInfoTypes.h"
 #include "llvm/Analysis/CombinedProfile.h"
 #include "llvm/Analysis/CPHistogram.h"
@@ -19,7 +21,9 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <climits>
 #include <cmath>
+#include <map>
 #include <stdlib.h>
 
 
@@ -33,7 +37,7 @@ using namespace llvm;
 EdgeDominatorTree* CombinedEdgeProfile::_edt = NULL;
 
 
-CombinedEdgeProfile::CombinedEdgeProfile(Module& module) 
+CombinedEdgeProfile::CombinedEdgeProfile(Module& module) : _module(module)
 {
   if(_edt == NULL)
     _edt = new EdgeDominatorTree(module);
@@ -44,6 +48,7 @@ void CombinedEdgeProfile::freeStaticData()
 {
   if(_edt != NULL)
     delete _edt;
+  _edt = NULL;
 }
 
 
@@ -68,6 +73,22 @@ bool CombinedEdgeProfile::addProfile(FILE* file)
     errs() << "  error: edge profiling info has no header\n";
     return(false);
   }
+
+  std::vector<unsigned> counts(edgeCount);
+  if( (edgeCount > 0)
+      && (fread(&counts[0], sizeof(unsigned), edgeCount, file)
+          != edgeCount) ) {
+    errs() << "  warning: edge profiling info header/data mismatch\n";
+    return(false);
+  }
+
+  // a run of another version of the module: map its edges onto this one
+  std::vector<bool> stale;
+  std::vector<int> function;
+  if( remapCounters(moduleLayout(), _edt->getEdgeCount(), counts, stale,
+                    function) )
+    edgeCount = counts.size();
+
   if(_histograms.size() != edgeCount) 
   {
     if(_histograms.size() != 0)
@@ -76,21 +97,106 @@ bool CombinedEdgeProfile::addProfile(FILE* file)
   }
   //errs() << "CEP::addProfile: " << edgeCount << " edges\n";
 
-  // TODO: is edge count reasonable for this program?
-  // Also ... do all of the edge profiles have the proper edge count?
-  // Compare it to the dominator tree, since that information will be there
-  
-  unsigned* edgeBuffer = new unsigned[edgeCount];
-  if( fread(edgeBuffer, sizeof(unsigned), edgeCount, file)
-      != edgeCount) {
-    delete [] edgeBuffer;
-    errs() << "  warning: edge profiling info header/data mismatch\n";
+  if(edgeCount > 0)
+    addCounts(&counts[0], edgeCount, stale);
+  else
+    addWeight(1.0);
+  //errs() << "<-- addEdgeProfile\n";
+  return(true);
+}
+
+
+// Read in an optimal edge profile, and add it as the standard edge
+// profile it stands for.
+bool CombinedEdgeProfile::addOptimalProfile(FILE* file)
+{
+  if(_edt == NULL)
+  {
+    errs() << "addOptimalProfile: error: EDT not set!\n";
+    return(false);
+  }
+
+  unsigned optCount;
+  if( fread(&optCount, sizeof(optCount), 1, file) != 1 ) {
+    errs() << "  error: optimal edge profiling info has no header\n";
+    return(false);
+  }
+
+  std::vector<unsigned> optimal(optCount);
+  if( (optCount > 0) 
+      && (fread(&optimal[0], sizeof(unsigned), optCount, file) != optCount) ) {
+    errs() << "  warning: optimal edge profiling info header/data mismatch\n";
+    return(false);
+  }
+
+  std::vector<unsigned> counts;
+  if( !expandOptimalCounts(_module, optimal, counts) ) {
+    errs() << "  error: optimal edge profile does not match the program\n";
     return(false);
   }
+  if(_histograms.size() != counts.size())
+    _histograms.resize(counts.size());
+
+  if(counts.size() > 0)
+    addCounts(&counts[0], counts.size(), std::vector<bool>());
+  return(true);
+}
 
+
+void CombinedEdgeProfile::addCounts(const unsigned* counts, 
+                                    unsigned edgeCount,
+                                    const std::vector<bool>& stale)
+{
   addWeight(1.0);
 
+  // An edge pruned from the instrumentation (-profile-prune-cp) because
+  // it always ran as often as its edge dominator is listed in _pruned:
+  // give it its dominator's count, so it is normalized to 1
+  std::vector<unsigned> resolved(counts, counts + edgeCount);
+  std::vector<bool> pruned(edgeCount, false);
+  for( unsigned p = 0, E = _pruned.size(); p != E; p++ )
+    if(_pruned[p] < edgeCount)
+      pruned[_pruned[p]] = true;
+  for( unsigned i = 0; i < edgeCount; i++ )
+    resolvePruned(resolved, pruned, i);
+  const unsigned* edgeBuffer = edgeCount ? &resolved[0] : counts;
+
+  // The edges of the functions the run did not instrument (its counter
+  // map) are unknown in this run
+  std::vector<bool> unknown(edgeCount, false);
+  for(unsigned f = 0, F = _counterMap.size(); f != F; ++f)
+  {
+    if(isInstrumented(f)) continue;
+    unsigned end = (f+1 < F) ? _counterMap[f+1].first : edgeCount;
+    for(unsigned e = _counterMap[f].first; (e < end) && (e < edgeCount); ++e)
+      unknown[e] = true;
+  }
+
+  // The stale edges, and the edges normalized by them, are unknown too
+  if( !stale.empty() )
+  {
+    for( unsigned i = 0; (i < edgeCount) && (i < stale.size()); i++ )
+      if(stale[i]) unknown[i] = true;
+    for( unsigned i = 0; i < edgeCount; i++ )
+      for( unsigned e = i; !unknown[i]; )
+      {
+        unsigned domID = _edt->getDominatorIndex(e);
+        if( (domID == e) || (domID >= edgeCount) )
+          break;
+        unknown[i] = unknown[domID];
+        e = domID;
+      }
+  }
+
   for( unsigned i = 0; i < edgeCount; i++ ) {
+    if(unknown[i])
+    {
+      // allocated all the same: a single run is never buildFromList'ed
+      operator[](i);
+      addUnknown(i);
+      continue;
+    }
+
     // Add a new histogram entry
     double normFreq = 0;
     unsigned execCnt = edgeBuffer[i];
@@ -119,10 +225,146 @@ bool CombinedEdgeProfile::addProfile(FILE* file)
     // use operator[] so that we check if the histogram is allocated
     operator[](i)->addToList(normFreq);
   }
+}
 
-  delete [] edgeBuffer;
-  //errs() << "<-- addEdgeProfile\n";
-  return(true);
+
+// The count of a pruned edge is the count of the nearest counted edge
+// up the edge dominator tree (0 if even the root is pruned)
+unsigned CombinedEdgeProfile::resolvePruned(std::vector<unsigned>& counts,
+                                            std::vector<bool>& pruned,
+                                            unsigned e)
+{
+  if( !pruned[e] )
+    return(counts[e]);
+
+  pruned[e] = false;
+  unsigned domID = _edt->getDominatorIndex(e);
+  if( (domID == e) || (domID >= counts.size()) )
+    counts[e] = 0;
+  else
+    counts[e] = resolvePruned(counts, pruned, domID);
+  return(counts[e]);
+}
+
+
+// The optimal edge profiler numbers the edges of each function as the
+// edge profiler does, plus a virtual exit edge (BB,0) after the edges of
+// each block without successors.  The uncounted edges form a spanning
+// tree of each function's CFG with the virtual node 0 (the caller), so
+// they follow from flow conservation at the blocks (and at 0): solve
+// the blocks with a single unknown edge until none is left.  Parallel
+// edges (a switch with several cases to one block) are one unknown;
+// all of its count goes to the first of them.
+bool CombinedEdgeProfile::expandOptimalCounts(
+  Module& M, const std::vector<unsigned>& optimal, 
+  std::vector<unsigned>& counts)
+{
+  typedef std::pair<BasicBlock*,BasicBlock*> Edge;  // NULL: node 0
+
+  counts.clear();
+  unsigned o = 0;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+
+    // the function's slots: edge, count (-1: unknown), index in counts
+    std::vector<Edge> edges;
+    std::vector<long long> value;
+    std::vector<int> index;
+    
+    edges.push_back(Edge((BasicBlock*)NULL, &F->getEntryBlock()));
+    index.push_back(counts.size());
+    counts.push_back(0);
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      TerminatorInst* TI = BB->getTerminator();
+      if(TI->getNumSuccessors() == 0)
+      {
+        edges.push_back(Edge(BB, (BasicBlock*)NULL));
+        index.push_back(-1);
+      }
+      for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+      {
+        edges.push_back(Edge(BB, TI->getSuccessor(s)));
+        index.push_back(counts.size());
+        counts.push_back(0);
+      }
+    }
+
+    if(o + edges.size() > optimal.size())
+      return(false);
+    for(unsigned e = 0, EE = edges.size(); e != EE; ++e, ++o)
+      value.push_back( (optimal[o] == ProfileInfoLoader::Uncounted) 
+                       ? -1 : (long long)optimal[o] );
+
+    // the unknowns, and the parallel slots of each
+    std::map<Edge, std::vector<unsigned> > unknown;
+    for(unsigned e = 0, EE = edges.size(); e != EE; ++e)
+      if(value[e] < 0)
+        unknown[edges[e]].push_back(e);
+
+    bool progress = true;
+    while( !unknown.empty() && progress )
+    {
+      progress = false;
+
+      // flow into and out of each node, and its unknown edges
+      std::map<BasicBlock*, long long> balance;   // in - out
+      std::map<BasicBlock*, unsigned> open;
+      std::map<BasicBlock*, Edge> last;
+      for(unsigned e = 0, EE = edges.size(); e != EE; ++e)
+      {
+        Edge& edge = edges[e];
+        if(edge.first == edge.second) continue;   // a self loop
+        if(value[e] >= 0)
+        {
+          balance[edge.second] += value[e];
+          balance[edge.first] -= value[e];
+        }
+        else if(unknown[edge][0] == e)
+        {
+          open[edge.first]++;
+          open[edge.second]++;
+          last[edge.first] = edge;
+          last[edge.second] = edge;
+        }
+      }
+
+      for(std::map<BasicBlock*, unsigned>::iterator N = open.begin(), 
+            NE = open.end(); N != NE; ++N)
+      {
+        if(N->second != 1) continue;
+        Edge edge = last[N->first];
+        if(!unknown.count(edge)) continue;   // solved at its other end
+
+        // in = out at the node
+        long long flow = (edge.second == N->first) 
+          ? -balance[N->first] : balance[N->first];
+        if(flow < 0) flow = 0;               // inconsistent counters
+        if(flow > UINT_MAX) flow = UINT_MAX;
+        std::vector<unsigned>& slots = unknown[edge];
+        for(unsigned i = 0, IE = slots.size(); i != IE; ++i)
+          value[slots[i]] = i ? 0 : flow;
+        unknown.erase(edge);
+        progress = true;
+      }
+    }
+
+    // a self loop (or a corrupt profile) can't be recovered
+    for(std::map<Edge, std::vector<unsigned> >::iterator U = unknown.begin(),
+          UE = unknown.end(); U != UE; ++U)
+      for(unsigned i = 0, IE = U->second.size(); i != IE; ++i)
+        value[U->second[i]] = 0;
+    if(!unknown.empty())
+      errs() << "CEP::expandOptimalCounts: warning: " << unknown.size()
+             << " edges of " << F->getName() << " not recovered\n";
+
+    for(unsigned e = 0, EE = edges.size(); e != EE; ++e)
+      if(index[e] >= 0)
+        counts[index[e]] = (unsigned)value[e];
+  }
+
+  return(o == optimal.size());
 }
 
 
@@ -161,6 +403,15 @@ unsigned CombinedEdgeProfile::serialize(FILE* f)
     }
     written++;
 	}
+
+  if( !serializeUnknown(f) ) {
+    errs() << "error: unable to write unknown edge weights to file.\n";
+    return(0);
+  }
+  if( !serializeLayout(f, moduleLayout()) ) {
+    errs() << "error: unable to write edge CFG checksums to file.\n";
+    return(0);
+  }
   return(written);
 }
 
@@ -192,6 +443,10 @@ bool CombinedEdgeProfile::deserialize(FILE* f) {
       return false;
     }
 
+    // a profile of another version of the module may have more edges
+    // (remapLayout maps them onto this one)
+    if((unsigned)index >= _histograms.size())
+      _histograms.resize(index + 1, NULL);
     _histograms[index] = newHist;
 	}
 
@@ -220,6 +475,7 @@ bool CombinedEdgeProfile::buildFromList(CPList& list, unsigned binCount)
     _bincount = binCount;
 
   _weight = 0;
+  _unknown.clear();
 
 	if(list.size() == 0)
 		return true;
@@ -261,6 +517,7 @@ bool CombinedEdgeProfile::buildFromList(CPList& list, unsigned binCount)
       errs() << "CEP::buildFromList: edge count mismatch! " 
              << edges << " vs " << edgeCount << "\n";
   }
+  mergeUnknown(list);
 
 	// Merge each set of histograms
 	for( unsigned i = 0; i < edgeCount; i++ ) 
@@ -277,7 +534,7 @@ bool CombinedEdgeProfile::buildFromList(CPList& list, unsigned binCount)
         cphl.push_back((*cp)[i]);
     }
     
-    _histograms[i] = new CPHistogram(_bincount, _weight, cphl);
+    _histograms[i] = new CPHistogram(_bincount, getKnownWeight(i), cphl);
 	}
 
   //errs() << "<-- CEP::buildFromList\n";
@@ -285,6 +542,44 @@ bool CombinedEdgeProfile::buildFromList(CPList& list, unsigned binCount)
 }
 
 
+unsigned CombinedEdgeProfile::getDominatorIndex(unsigned e) const
+{
+  return(_edt->getDominatorIndex(e));
+}
+
+
+// the edge layout of the module, with the edge dominator of each edge
+const CFGLayout& CombinedEdgeProfile::moduleLayout()
+{
+  if( !_moduleLayout.empty() )
+    return(_moduleLayout);
+
+  CFGChecksum::edgeLayout(_module, _moduleLayout);
+  for(unsigned f = 0, E = _moduleLayout.size(); f != E; ++f)
+  {
+    CFGFunctionLayout& fl = _moduleLayout[f];
+    for(unsigned c = 0; c != fl.entry.count; ++c)
+      fl.dominators.push_back(_edt->getDominatorIndex(fl.entry.first + c));
+  }
+  return(_moduleLayout);
+}
+
+
+// A combined profile of another version of the module: keep the
+// histograms of the edges that match
+bool CombinedEdgeProfile::remapLayout(const CFGLayout& layout)
+{
+  remapHistograms(layout, moduleLayout());
+  if(_histograms.size() != _edt->getEdgeCount())
+  {
+    errs() << "CEP::remapLayout: error: " << _histograms.size()
+           << " edges mapped, " << _edt->getEdgeCount() << " in the module\n";
+    return(false);
+  }
+  return(true);
+}
+
+
 CPHistogram* CombinedEdgeProfile::operator[](const int index) {
   if( _histograms[index] == NULL )
     _histograms[index] = new CPHistogram();
@@ -0,0 +1,100 @@
+//===- CombinedICallProfile.cpp -------------------------------*- C++ -*---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Combined profile of indirect call targets (see ICallProfiling.cpp for
+// the instrumentation).  The histograms are those of a value profile.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cp-icallprof"
+
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/Constants.h"
+#include "llvm/InlineAsm.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CallSite.h"
+
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPHistogram.h"
+
+#include <algorithm>
+
+
+using namespace llvm;
+
+// ----------------------------------------------------------------------------
+// Combined indirect call profile implementation
+// ----------------------------------------------------------------------------
+
+CombinedICallProfile::CombinedICallProfile(Module& M)
+{
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if (F->isDeclaration()) continue;
+    _functionRef.push_back(F);
+  }
+
+  // number the sites as the instrumentation does
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if (F->isDeclaration()) continue;
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if(isICallSite(I))
+          addSite(I, 0);
+  }
+}
+
+
+Function* CombinedICallProfile::getTarget(uint64_t number) const
+{
+  if( (number == 0) || (number > _functionRef.size()) )
+    return(NULL);
+  return(_functionRef[number - 1]);
+}
+
+
+namespace {
+  struct MoreStable {
+    bool operator()(const ICallTarget& a, const ICallTarget& b) const
+    {return(a.first > b.first);}
+  };
+}
+
+void CombinedICallProfile::getStableTargets(ValueSiteIndex site,
+                                            std::vector<ICallTarget>& targets)
+{
+  CVPHistogramMap::iterator V = _values.lower_bound(ValueID(site, 0));
+  for(CVPHistogramMap::iterator E = _values.end();
+      (V != E) && (V->first.first == site); ++V)
+  {
+    Function* target = getTarget(V->first.second);
+    if(target == NULL)
+      continue;
+    double stability = _histograms[V->second]->mean(true);
+    if(stability > 0)
+      targets.push_back(ICallTarget(stability, target));
+  }
+  std::stable_sort(targets.begin(), targets.end(), MoreStable());
+}
+
+
+// Calls through a pointer; a constant callee (a cast of a function, or
+// null) is not a target that varies.  The profiler finds its sites with
+// this too.
+bool CombinedICallProfile::isICallSite(Instruction* I)
+{
+  CallSite cs(cast<Value>(I));
+  if(!cs) return(false);
+  if(cs.getCalledFunction() != NULL) return(false);
+
+  Value* callee = cs.getCalledValue();
+  return( !isa<Constant>(callee) && !isa<InlineAsm>(callee) );
+}
@@ -0,0 +1,315 @@
+//===- CombinedLoopPathProfile.cpp ----------------------------*- C++ -*---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Combined profile of the paths of consecutive loop iterations (see
+// PathProfiling.cpp, -path-profile-iterations, for the instrumentation).
+//
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "cp-looppath"
+
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+
+using namespace llvm;
+
+// ----------------------------------------------------------------------------
+// Combined loop path profile implementation
+// ----------------------------------------------------------------------------
+
+CombinedLoopPathProfile::CombinedLoopPathProfile(Module& module) :
+  _functionCount(0)
+{
+  for( Module::iterator F = module.begin(), E = module.end(); F != E; ++F )
+    if( !F->isDeclaration() )
+      _functionCount++;
+}
+
+
+// Reads the header.length path numbers of a loop path.
+bool CombinedLoopPathProfile::readLoopPath(FILE* f,
+                                           const LoopPathHeader& header,
+                                           LoopPathID& path) const
+{
+  if( (header.length < 2) || (header.length > PP_MAX_ITERATIONS) )
+  {
+    errs() << "CLPP: bad loop path length " << header.length << "\n";
+    return(false);
+  }
+  if( (header.fnNumber == 0) || (header.fnNumber > _functionCount) )
+  {
+    errs() << "CLPP: bad function " << header.fnNumber << " ("
+           << _functionCount << " functions)\n";
+    return(false);
+  }
+
+  path.first = LoopID(header.fnNumber, header.loopNumber);
+  path.second.clear();
+  for(unsigned i = 0; i < header.length; ++i)
+  {
+    unsigned number[2];
+    if( fread(number, sizeof(number), 1, f) != 1 )
+    {
+      errs() << "CLPP: failed to read loop path\n";
+      return(false);
+    }
+    path.second.push_back(((PathIndex)number[1] << 32) | number[0]);
+  }
+  return(true);
+}
+
+
+unsigned CombinedLoopPathProfile::serialize(FILE* f)
+{
+  unsigned pathCount = 0;
+  for(CLPPHistogramMap::iterator P = _paths.begin(), E = _paths.end();
+      P != E; ++P)
+    if(_histograms[P->second]->nonZero())
+      pathCount++;
+
+	// Output information about the profile
+  ProfilingType ptype = getProfilingType();
+	if( (fwrite(&ptype, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&_weight, sizeof(double), 1, f) != 1) ||
+      (fwrite(&pathCount, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&_bincount, sizeof(unsigned), 1, f) != 1) )
+  {
+		errs() << "error: unable to write CLPP header to file.\n";
+		return(0);
+	}
+
+  // each histogram follows its function, loop, length and paths
+  unsigned written = 0;
+  for(CLPPHistogramMap::iterator P = _paths.begin(), E = _paths.end();
+      P != E; ++P)
+  {
+    CPHistogram* hist = _histograms[P->second];
+    if( !hist->nonZero() )
+      continue;
+
+    const std::vector<PathIndex>& iterations = P->first.second;
+    unsigned header[3] = { P->first.first.first, P->first.first.second,
+                           (unsigned)iterations.size() };
+    bool ok = (fwrite(header, sizeof(header), 1, f) == 1);
+    for(unsigned i = 0; ok && (i < iterations.size()); ++i)
+    {
+      unsigned number[2] = { (unsigned)iterations[i],
+                             (unsigned)(iterations[i] >> 32) };
+      ok = (fwrite(number, sizeof(number), 1, f) == 1);
+    }
+
+    if( !ok || !hist->serialize(written, f) )
+    {
+      errs() << "error: CLPP::serialize failed to serialize histogram: f:"
+             << P->first.first.first << ", l:" << P->first.first.second
+             << "\n";
+      return(0);
+    }
+    written++;
+  }
+
+  return(written);
+}
+
+
+bool CombinedLoopPathProfile::deserialize(FILE* f)
+{
+	unsigned pathCount;
+
+	if( !fread(&_weight, sizeof(double), 1, f) ||
+		  !fread(&pathCount, sizeof(unsigned), 1, f) ||
+		  !fread(&_bincount, sizeof(unsigned), 1, f) ) {
+		errs() << "warning: combined loop path profiling data corrupt.\n";
+		return false;
+	}
+
+  for(unsigned p = 0; p < pathCount; p++)
+  {
+    unsigned number[3];
+    LoopPathHeader header;
+    LoopPathID path;
+    bool ok = (fread(number, sizeof(number), 1, f) == 1);
+    if(ok)
+    {
+      header.fnNumber = number[0];
+      header.loopNumber = number[1];
+      header.length = number[2];
+      ok = readLoopPath(f, header, path);
+    }
+    if( !ok )
+    {
+      errs() << "CLPP::deserialize Error: failed to read loop path "
+             << p << " of " << pathCount << "\n";
+      return(false);
+    }
+
+    CPHistogram* hist = new CPHistogram();
+    unsigned ID;
+    if( !hist->deserialize(_bincount, _weight, f, ID) )
+    {
+      errs() << "CLPP::deserialize Error: failed to read histogram "
+             << p << " of " << pathCount << "\n";
+      delete hist;
+      return(false);
+    }
+
+    _paths[path] = _histograms.size();
+    _histograms.push_back(hist);
+  }
+
+	return true;
+}
+
+
+// Reads in a raw loop path profile and adds, for every loop path, its
+// share of the loop paths of the same loop and length to its add list.
+bool CombinedLoopPathProfile::addProfile(FILE* f)
+{
+  unsigned pathCount;
+  if( fread(&pathCount, sizeof(unsigned), 1, f) != 1 )
+  {
+    errs() << "  error: loop path profiling info has no header\n";
+    return(false);
+  }
+
+  // (loop, length) --> executions of its loop paths
+  typedef std::pair<LoopID,unsigned> LoopKey;
+  std::map<LoopKey,double> totals;
+  std::vector<std::pair<LoopPathID,unsigned> > counts;
+  for(unsigned p = 0; p < pathCount; ++p)
+  {
+    LoopPathHeader header;
+    LoopPathID path;
+    if( (fread(&header, sizeof(LoopPathHeader), 1, f) != 1)
+        || !readLoopPath(f, header, path) )
+    {
+      errs() << "  error: bad loop path profiling file syntax\n";
+      return(false);
+    }
+    if(header.pathCounter == 0)
+      continue;
+
+    counts.push_back(std::make_pair(path, header.pathCounter));
+    totals[LoopKey(path.first, header.length)] += header.pathCounter;
+  }
+
+  addWeight(1.0);
+
+  for(unsigned p = 0, E = counts.size(); p != E; ++p)
+  {
+    const LoopPathID& path = counts[p].first;
+    double total = totals[LoopKey(path.first, path.second.size())];
+    getHistogram(path).addToList(counts[p].second / total);
+  }
+
+  return(true);
+}
+
+
+// Even though list is a generic CPList, it should only contain CLPPs
+bool CombinedLoopPathProfile::buildFromList(CPList& list, unsigned binCount)
+{
+	if(list.size() == 0)
+		return true;
+
+  ProfilingType myType = getProfilingType();
+
+  if(binCount == 0)
+    _bincount = calcBinCount(list);
+  else
+    _bincount = binCount;
+
+  // collect the histograms of each loop path from all CPs in the list
+  std::map<LoopPathID,CPHistogramList> clpphm;
+	for(CPList::iterator CP = list.begin(), E = list.end(); CP != E; ++CP)
+  {
+    if((*CP)->getProfilingType() != myType)
+    {
+      errs() << "CLPP::buildFromList Warning: CP in list is not a CLPP\n";
+      continue;
+    }
+
+    CombinedLoopPathProfile* cp = (CombinedLoopPathProfile*)(*CP);
+		_weight += cp->_weight;
+
+    for(CLPPHistogramMap::iterator P = cp->_paths.begin(),
+          PE = cp->_paths.end(); P != PE; ++P)
+    {
+      CPHistogram* hist = cp->_histograms[P->second];
+      if( hist->nonZeroWeight() != 0 )
+        clpphm[P->first].push_back(hist);
+    }
+  }
+
+  for(std::map<LoopPathID,CPHistogramList>::iterator P = clpphm.begin(),
+        E = clpphm.end(); P != E; ++P)
+  {
+    _paths[P->first] = _histograms.size();
+    _histograms.push_back(new CPHistogram(_bincount, _weight, P->second));
+  }
+
+	return true;
+}
+
+
+bool CombinedLoopPathProfile::valid(const LoopPathID& path) const
+{
+  return(_paths.count(path) > 0);
+}
+
+
+CPHistogram& CombinedLoopPathProfile::getHistogram(const LoopPathID& path)
+{
+  CLPPHistogramMap::iterator P = _paths.find(path);
+  if(P != _paths.end())
+    return(*_histograms[P->second]);
+
+  CPHistogram* hist = new CPHistogram();
+  _paths[path] = _histograms.size();
+  _histograms.push_back(hist);
+  return(*hist);
+}
+
+
+void CombinedLoopPathProfile::getLoopPathSet(LoopPathSet& paths) const
+{
+  for(CLPPHistogramMap::const_iterator P = _paths.begin(), E = _paths.end();
+      P != E; ++P)
+    paths.insert(P->first);
+}
+
+
+namespace {
+  typedef std::pair<double,std::vector<PathIndex> > MeanLoopPath;
+
+  bool hotterFirst(const MeanLoopPath& a, const MeanLoopPath& b)
+  {
+    return(a.first > b.first);
+  }
+}
+
+void CombinedLoopPathProfile::getLoopPaths(const LoopID& loop,
+    std::vector<std::pair<double,std::vector<PathIndex> > >& paths)
+{
+  LoopPathID first(loop, std::vector<PathIndex>());
+  for(CLPPHistogramMap::iterator P = _paths.lower_bound(first),
+        E = _paths.end(); P != E; ++P)
+  {
+    if(P->first.first != loop)
+      break;
+    paths.push_back(std::make_pair(_histograms[P->second]->mean(true),
+                                   P->first.second));
+  }
+  std::stable_sort(paths.begin(), paths.end(), hotterFirst);
+}
@@ -31,6 +31,13 @@ using namespace llvm;
 // ----------------------------------------------------------------------------
 
 
+// the 64-bit path number of a raw path profile entry
+static PathIndex getPathNumber(const PathTableEntry& pte)
+{
+  return(((PathIndex)pte.pathNumberHi << 32) | pte.pathNumberLo);
+}
+
+
 // PB: could probably make _fuinctionRef a class variable and only do
 // this once, but will we need to worry about instances that use
 // different modules?
@@ -68,13 +75,17 @@ unsigned CombinedPathProfile::serialize(FILE* f) {
 			return(0);
 		}
 
-		// Iterate through each executed path in the function
+		// Iterate through each executed path in the function.  The high
+		// word of the path number precedes the histogram, whose ID is the
+		// low word.
 		for( CPPHistogramMap::iterator H = F->second.begin(), HE = F->second.end();
 				H != HE; ++H ) 
     {
       CPHistogram* hist = _histograms[H->second];
+      unsigned pathHi = (unsigned)(H->first >> 32);
       //if( !H->second->serialize(H->first, f) )
-      if( !hist->serialize(H->first, f) )
+      if( (fwrite(&pathHi, sizeof(unsigned), 1, f) != 1) ||
+          !hist->serialize((unsigned)H->first, f) )
       {
         errs() << "error: CPP::serialize failed to serialize histogram: f:" 
                << F->first << ", p:" << H->first << " @" << H->second << "\n";
@@ -83,6 +94,11 @@ unsigned CombinedPathProfile::serialize(FILE* f) {
       written++;
 		}
 	}
+
+  if( !serializeUnknown(f) ) {
+    errs() << "error: unable to write unknown path weights to file.\n";
+    return(0);
+  }
   return(written);
 }
 
@@ -116,16 +132,19 @@ bool CombinedPathProfile::deserialize(FILE* f) {
     {
       CPHistogram* hist = new CPHistogram();
 
-      int pathnum = hist->deserialize(_bincount, _weight, f);
-      if(pathnum == -1)
+      unsigned pathHi, pathLo;
+      if( (fread(&pathHi, sizeof(unsigned), 1, f) != 1) ||
+          !hist->deserialize(_bincount, _weight, f, pathLo) )
       {
         errs() << "CPP::deserialize Error: failed to read histogram\n";
         delete hist;
         return(false);
       }
+      PathIndex pathnum = ((PathIndex)pathHi << 32) | pathLo;
 
       // PB should we check if we're replacing an existing histogram?
       _histograms.push_back(hist);
+      setHistogramFunction(histIndex, ph.fnNumber);
 			_functions[ph.fnNumber][pathnum] = histIndex++;
 		}
 	}
@@ -154,6 +173,21 @@ bool CombinedPathProfile::addProfile(FILE* f)
 
   addWeight(1.0);
 
+  // the functions the run did not instrument (they write no paths) are
+  // unknown in this run
+  for(unsigned f = 0, F = _counterMap.size(); f != F; ++f)
+    if( !isInstrumented(f) )
+      addUnknown(_counterMap[f].first);
+
+  // A function pruned from the instrumentation (-profile-prune-cp)
+  // because it always took one path writes no paths either: that path
+  // ran every time
+  for(unsigned p = 0; p + 3 <= _pruned.size(); p += 3)
+  {
+    PathIndex pathNumber = ((PathIndex)_pruned[p+2] << 32) | _pruned[p+1];
+    getHistogram(_pruned[p], pathNumber).addToList(1.0);
+  }
+
   // Iterate through each function
   for(unsigned i = 0; i < functionCount; ++i) 
   {
@@ -190,9 +224,11 @@ bool CombinedPathProfile::addProfile(FILE* f)
         errs() << "  error: bad path profiling file syntax\n";
         return(false);
       }
+      PathIndex pathNumber = getPathNumber(pte);
+
       newPaths.push_back(pte);
 
-      BallLarusEdge* edge = dag.getFirstBLEdge(pte.pathNumber);
+      BallLarusEdge* edge = dag.getFirstBLEdge(pathNumber);
       if( edge->getType() == BallLarusEdge::NORMAL 
           && totalNumberExecuted < 0xffffffff ) 
       {
@@ -212,7 +248,7 @@ bool CombinedPathProfile::addProfile(FILE* f)
       if(P->pathCounter > 0)
       {
         double pathFreq = double(P->pathCounter)/totalNumberExecuted;
-        CPHistogram& hist = getHistogram(funcNum, P->pathNumber);
+        CPHistogram& hist = getHistogram(funcNum, getPathNumber(*P));
         hist.addToList(pathFreq);
       }
     }
@@ -264,6 +300,7 @@ bool CombinedPathProfile::buildFromList(CPList& list, unsigned binCount)
     CombinedPathProfile* cp = (CombinedPathProfile*)(*CP);
 		_weight += cp->_weight;
   }
+  mergeUnknown(list);
 
 	// Iterate through all the potential functions in the program and
 	// collect all the histograms for each path from all CPs in the list
@@ -271,7 +308,7 @@ bool CombinedPathProfile::buildFromList(CPList& list, unsigned binCount)
   {
 		// Function path combined profiling histogram map
     // pathNumber --> CPHistogramList
-		std::map<unsigned,CPHistogramList> fpcphm;
+		std::map<PathIndex,CPHistogramList> fpcphm;
 
 		// Iterate through the list of profiles
 		for( CPList::iterator CP = list.begin(), E = list.end(); CP != E; ++CP) 
@@ -285,7 +322,7 @@ bool CombinedPathProfile::buildFromList(CPList& list, unsigned binCount)
 					HE = cp->_functions[funcID].end(); H != HE; ++H ) 
       {
         // add this CPs histogram for this path to the list for this path
-        unsigned pathnum = H->first;
+        PathIndex pathnum = H->first;
         CPHistogram& hist = cp->getHistogram(funcID, pathnum);
 				fpcphm[pathnum].push_back(&hist);
 			}
@@ -296,11 +333,13 @@ bool CombinedPathProfile::buildFromList(CPList& list, unsigned binCount)
 
     // build a single merged CP from the collected list for each path
     unsigned histIndex = _histograms.size();  // index of first new histogram
-		for( std::map<unsigned,CPHistogramList>::iterator H = fpcphm.begin(),
+		for( std::map<PathIndex,CPHistogramList>::iterator H = fpcphm.begin(),
 				E = fpcphm.end(); H != E; ++H ) 
     {
-      CPHistogram* hist = new CPHistogram(_bincount, _weight, H->second);
+      CPHistogram* hist = 
+        new CPHistogram(_bincount, getKnownWeight(funcID), H->second);
       _histograms.push_back(hist);
+      setHistogramFunction(histIndex, funcID);
 			_functions[funcID][H->first] = histIndex++; 
 		}
 	}
@@ -415,12 +454,31 @@ CPHistogram& CombinedPathProfile::getHistogram(const FunctionIndex funcIndex,
     unsigned histIndex = _histograms.size();
     hist = new CPHistogram();
     _histograms.push_back(hist);
+    setHistogramFunction(histIndex, funcIndex);
     funcPaths[pathIndex] = histIndex;
   }
   return(*hist);
 }
 
 
+void CombinedPathProfile::setHistogramFunction(unsigned h,
+                                               FunctionIndex funcIndex)
+{
+  if(h >= _histFunction.size())
+    _histFunction.resize(h+1, 0);
+  _histFunction[h] = funcIndex;
+}
+
+
+// the unknown weights of path profiles are kept by function
+double CombinedPathProfile::histogramWeight(unsigned h) const
+{
+  if(h >= _histFunction.size())
+    return(_weight);
+  return(getKnownWeight(_histFunction[h]));
+}
+
+
 CPHistogram& CombinedPathProfile::getHistogram(const PathID& path)
 {
   return(getHistogram(path.first, path.second));
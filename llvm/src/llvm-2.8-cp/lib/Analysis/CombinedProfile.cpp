@@ -58,11 +58,218 @@ void CombinedProfile::buildHistograms(unsigned binCount)
   for(unsigned i = 0, E = _histograms.size(); i != E; ++i)
   {
     if(_histograms[i] != NULL)
-      _histograms[i]->buildFromList(_bincount, _weight);
+      _histograms[i]->buildFromList(_bincount, histogramWeight(i));
   }
 }
 
 
+double CombinedProfile::getKnownWeight(unsigned key) const
+{
+  std::map<unsigned,double>::const_iterator U = _unknown.find(key);
+  if(U == _unknown.end())
+    return(_weight);
+  return(U->second < _weight ? _weight - U->second : 0);
+}
+
+
+void CombinedProfile::mergeUnknown(CPList& list)
+{
+  for(CPList::iterator CP = list.begin(), E = list.end(); CP != E; ++CP)
+  {
+    if((*CP)->getProfilingType() != getProfilingType()) continue;
+    std::map<unsigned,double>& unknown = (*CP)->_unknown;
+    for(std::map<unsigned,double>::iterator U = unknown.begin(),
+          UE = unknown.end(); U != UE; ++U)
+      addUnknown(U->first, U->second);
+  }
+}
+
+
+bool CombinedProfile::remapCounters(const CFGLayout& current, unsigned size,
+                                    std::vector<unsigned>& counts,
+                                    std::vector<bool>& unknown,
+                                    std::vector<int>& function)
+{
+  std::vector<unsigned> source;
+  if( _layout.empty()
+      || !CFGChecksum::match(_layout, current, function, source) )
+    return(false);
+
+  std::vector<unsigned> remapped(size, 0);
+  CounterMapVec map;
+  std::set<unsigned> wasPruned(_pruned.begin(), _pruned.end());
+  std::vector<unsigned> pruned;
+  unknown.assign(size, false);
+  unsigned changed = 0, dropped = 0;
+  for(unsigned f = 0, F = current.size(); f != F; ++f)
+  {
+    const CFGChecksumEntry& entry = current[f].entry;
+    int old = function[f];
+    for(unsigned c = entry.first; (c < entry.first + entry.count)
+          && (c < size); ++c)
+    {
+      if( (old < 0) || (source[c] >= counts.size()) )
+        unknown[c] = true;
+      else
+      {
+        remapped[c] = counts[source[c]];
+        if(wasPruned.count(source[c]))
+          pruned.push_back(c);
+      }
+    }
+
+    // the functions the run did not instrument stay unknown
+    CounterMapEntry mapEntry = { entry.first,
+                                 (old >= 0) && isInstrumented(old) };
+    map.push_back(mapEntry);
+    if(old < 0)
+      dropped++;
+    else if(_layout[old].entry.checksum != entry.checksum)
+      changed++;
+  }
+
+  errs() << "CP::remapCounters: stale " << getNameStr() << " profile: "
+         << changed << " changed functions matched, " << dropped
+         << " of " << current.size() << " functions dropped\n";
+  counts.swap(remapped);
+  _counterMap = map;
+  _pruned.swap(pruned);
+  return(true);
+}
+
+
+void CombinedProfile::remapHistograms(const CFGLayout& old,
+                                      const CFGLayout& current)
+{
+  std::vector<int> function;
+  std::vector<unsigned> source;
+  if( !CFGChecksum::match(old, current, function, source) )
+    return;
+
+  // A histogram of frequencies normalized by a dominator (combined edge
+  // profiles) only keeps its meaning if the counter's old dominator maps
+  // to its new one
+  std::map<unsigned,unsigned> oldDominator, newDominator;
+  for(unsigned f = 0, E = old.size(); f != E; ++f)
+    for(unsigned c = 0, CE = old[f].dominators.size(); c != CE; ++c)
+      oldDominator[old[f].entry.first + c] = old[f].dominators[c];
+  for(unsigned f = 0, E = current.size(); f != E; ++f)
+    for(unsigned c = 0, CE = current[f].dominators.size(); c != CE; ++c)
+      newDominator[current[f].entry.first + c] = current[f].dominators[c];
+
+  CPHistVec histograms(source.size(), NULL);
+  std::map<unsigned,double> unknown;
+  unsigned dropped = 0;
+  for(unsigned c = 0, E = source.size(); c != E; ++c)
+  {
+    unsigned s = source[c];
+    std::map<unsigned,unsigned>::iterator O = oldDominator.find(s);
+    std::map<unsigned,unsigned>::iterator N = newDominator.find(c);
+    if( (O != oldDominator.end()) && (N != newDominator.end()) )
+    {
+      unsigned dom = N->second;
+      unsigned mappedDom = (dom < E) ? source[dom] : CFGChecksum::NoCounter;
+      if(mappedDom != O->second)
+        s = CFGChecksum::NoCounter;
+    }
+
+    if( (s < _histograms.size()) && (_histograms[s] != NULL) )
+    {
+      histograms[c] = _histograms[s];
+      _histograms[s] = NULL;
+      if(_unknown.count(s))
+        unknown[c] = _unknown[s];
+    }
+    else
+    {
+      histograms[c] = new CPHistogram();
+      unknown[c] = _weight;
+      dropped++;
+    }
+  }
+
+  for(unsigned i = 0, E = _histograms.size(); i != E; ++i)
+    if(_histograms[i] != NULL)
+      delete _histograms[i];
+  _histograms.swap(histograms);
+  _unknown.swap(unknown);
+
+  errs() << "CP::remapHistograms: stale " << getNameStr() << " profile: "
+         << dropped << " of " << _histograms.size()
+         << " histograms not matched\n";
+}
+
+
+// CFGChecksumInfo: the number of words, then the words of the layout
+bool CombinedProfile::serializeLayout(FILE* f, const CFGLayout& current) const
+{
+  std::vector<unsigned> words;
+  CFGChecksum::encode(getProfilingType(), current, words);
+
+  ProfilingType ptype = CFGChecksumInfo;
+  unsigned count = words.size();
+  return( (fwrite(&ptype, sizeof(unsigned), 1, f) == 1)
+          && (fwrite(&count, sizeof(unsigned), 1, f) == 1)
+          && (fwrite(&words[0], sizeof(unsigned), count, f) == count) );
+}
+
+
+// CombinedUnknownInfo: the type of the profile, the number of keys, and
+// a (key, weight) pair for each
+bool CombinedProfile::serializeUnknown(FILE* f) const
+{
+  if(_unknown.empty())
+    return(true);
+
+  ProfilingType ptype = CombinedUnknownInfo;
+  ProfilingType cptype = getProfilingType();
+  unsigned count = _unknown.size();
+  if( (fwrite(&ptype, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&cptype, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&count, sizeof(unsigned), 1, f) != 1) )
+    return(false);
+
+  for(std::map<unsigned,double>::const_iterator U = _unknown.begin(),
+        E = _unknown.end(); U != E; ++U)
+    if( (fwrite(&U->first, sizeof(unsigned), 1, f) != 1) ||
+        (fwrite(&U->second, sizeof(double), 1, f) != 1) )
+      return(false);
+  return(true);
+}
+
+
+// read the unknown weights (after the CombinedUnknownInfo type), and
+// take them out of the weights of the histograms already read
+bool CombinedProfile::deserializeUnknown(FILE* f)
+{
+  unsigned cptype, count;
+  if( !fread(&cptype, sizeof(unsigned), 1, f) ||
+      !fread(&count, sizeof(unsigned), 1, f) )
+    return(false);
+  if(cptype != (unsigned)getProfilingType())
+  {
+    errs() << "warning: unknown weights of a " << cptype 
+           << " profile follow a " << getNameStr() << " profile\n";
+    return(false);
+  }
+
+  while( count-- )
+  {
+    unsigned key;
+    double weight;
+    if( !fread(&key, sizeof(unsigned), 1, f) ||
+        !fread(&weight, sizeof(double), 1, f) )
+      return(false);
+    addUnknown(key, weight);
+  }
+
+  for(unsigned i = 0, E = _histograms.size(); i != E; ++i)
+    if( (_histograms[i] != NULL) && (_histograms[i]->totalWeight() > 0) )
+      _histograms[i]->setTotalWeight(histogramWeight(i));
+  return(true);
+}
+
+
 void CombinedProfile::print(llvm::raw_ostream& stream)
 {
   int binsUsed = 0;
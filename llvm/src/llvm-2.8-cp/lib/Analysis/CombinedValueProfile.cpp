@@ -0,0 +1,344 @@
+//===- CombinedValueProfile.cpp -------------------------------*- C++ -*---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Combined profile of call argument values (see ValueProfiling.cpp for
+// the instrumentation).
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cp-valueprof"
+
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/Module.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/CallSite.h"
+
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPHistogram.h"
+
+
+using namespace llvm;
+
+// ----------------------------------------------------------------------------
+// Combined value profile implementation
+// ----------------------------------------------------------------------------
+
+CombinedValueProfile::CombinedValueProfile(Module& M)
+{
+  // number the sites as the instrumentation does
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if (F->isDeclaration()) continue;
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      {
+        if(!isFDOInliningCandidate(I))
+          continue;
+
+        CallSite cs(cast<Value>(I));
+        for(unsigned a = 0, AE = cs.arg_size(); a != AE; ++a)
+        {
+          if(isValueSite(cs, a))
+            addSite(I, a);
+        }
+      }
+  }
+}
+
+
+void CombinedValueProfile::addSite(Instruction* call, unsigned argNo)
+{
+  _siteIndex[std::make_pair(call, argNo)] = _siteCalls.size();
+  _siteCalls.push_back(call);
+  _siteArgs.push_back(argNo);
+}
+
+
+unsigned CombinedValueProfile::serialize(FILE* f)
+{
+  unsigned valueCount = 0;
+  for(CVPHistogramMap::iterator V = _values.begin(), E = _values.end();
+      V != E; ++V)
+    if(_histograms[V->second]->nonZero())
+      valueCount++;
+
+	// Output information about the profile
+  ProfilingType ptype = getProfilingType();
+	if( (fwrite(&ptype, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&_weight, sizeof(double), 1, f) != 1) ||
+      (fwrite(&valueCount, sizeof(unsigned), 1, f) != 1) ||
+      (fwrite(&_bincount, sizeof(unsigned), 1, f) != 1) )
+  {
+		errs() << "error: unable to write CPValue header to file.\n";
+		return(0);
+	}
+
+  unsigned written = 0;
+  for(CVPHistogramMap::iterator V = _values.begin(), E = _values.end();
+      V != E; ++V)
+  {
+    CPHistogram* hist = _histograms[V->second];
+    if( !hist->nonZero() )
+      continue;
+
+    ValueHeader vh = { V->first.first, (unsigned)V->first.second,
+                       (unsigned)(V->first.second >> 32) };
+    if( (fwrite(&vh, sizeof(ValueHeader), 1, f) != 1)
+        || !hist->serialize(V->first.first, f) )
+    {
+      errs() << "error: CVP::serialize failed to serialize histogram: s:"
+             << V->first.first << ", v:" << V->first.second << "\n";
+      return(0);
+    }
+    written++;
+  }
+
+  return(written);
+}
+
+
+bool CombinedValueProfile::deserialize(FILE* f)
+{
+	unsigned valueCount;
+
+	if( !fread(&_weight, sizeof(double), 1, f) ||
+		  !fread(&valueCount, sizeof(unsigned), 1, f) ||
+		  !fread(&_bincount, sizeof(unsigned), 1, f) ) {
+		errs() << "warning: combined value profiling data corrupt.\n";
+		return false;
+	}
+
+  for(unsigned v = 0; v < valueCount; v++)
+  {
+    ValueHeader vh;
+    if( fread(&vh, sizeof(ValueHeader), 1, f) != 1 )
+    {
+      errs() << "CVP::deserialize Error: failed to read value header\n";
+      return(false);
+    }
+
+    CPHistogram* hist = new CPHistogram();
+    if( hist->deserialize(_bincount, _weight, f) < 0 )
+    {
+      errs() << "CVP::deserialize Error: failed to read histogram "
+             << v << " of " << valueCount << "\n";
+      delete hist;
+      return(false);
+    }
+
+    if(vh.site >= getSiteCount())
+    {
+      errs() << "CVP::deserialize Error: bad site " << vh.site << " ("
+             << getSiteCount() << " sites)\n";
+      delete hist;
+      return(false);
+    }
+
+    ValueID id(vh.site, ((uint64_t)vh.valueHi << 32) | vh.valueLo);
+    _values[id] = _histograms.size();
+    _histograms.push_back(hist);
+  }
+
+	return true;
+}
+
+
+// Reads in a raw value profile and adds, for every value in a site's
+// table, the fraction of the site's calls with that value to the
+// value's add list.
+bool CombinedValueProfile::addProfile(FILE* file)
+{
+  unsigned wordCount;
+  if( fread(&wordCount, sizeof(unsigned), 1, file) != 1 )
+  {
+    errs() << "  error: value profiling info has no header\n";
+    return(false);
+  }
+
+  const unsigned siteWords = sizeof(ValueProfileSite) / sizeof(unsigned);
+  if(wordCount != getSiteCount() * siteWords)
+  {
+    errs() << "addProfile: Error: " << wordCount << " profile words, but "
+           << getSiteCount() * siteWords << " needed (" << getSiteCount()
+           << " value sites)\n";
+    return(false);
+  }
+
+  std::vector<ValueProfileSite> sites(getSiteCount());
+  if( (getSiteCount() > 0)
+      && (fread(&sites[0], sizeof(ValueProfileSite), getSiteCount(), file)
+          != getSiteCount()) )
+  {
+    errs() << "  warning: value profiling info header/data mismatch\n";
+    return(false);
+  }
+
+  addWeight(1.0);
+
+  for(ValueSiteIndex s = 0, E = sites.size(); s != E; ++s)
+  {
+    const ValueProfileSite& site = sites[s];
+    if(site.total == 0)
+      continue;
+    if(site.total == 0xffffffff)
+      errs() << "CombinedValueProfile::addProfile Warning: saturated site "
+             << "count (" << s << ")\n";
+
+    for(unsigned k = 0; k != VP_TOPK; ++k)
+    {
+      const ValueProfileSlot& slot = site.slots[k];
+      if(slot.count == 0)
+        continue;
+
+      ValueID id(s, ((uint64_t)slot.valueHi << 32) | slot.valueLo);
+      getHistogram(id).addToList((double)slot.count / (double)site.total);
+    }
+  }
+
+  return(true);
+}
+
+
+// Even though list is a generic CPList, it should only contain CVPs
+bool CombinedValueProfile::buildFromList(CPList& list, unsigned binCount)
+{
+	if(list.size() == 0)
+		return true;
+
+  ProfilingType myType = getProfilingType();
+
+  if(binCount == 0)
+    _bincount = calcBinCount(list);
+  else
+    _bincount = binCount;
+
+  // collect the histograms of each value from all CPs in the list
+  std::map<ValueID,CPHistogramList> vcphm;
+	for(CPList::iterator CP = list.begin(), E = list.end(); CP != E; ++CP)
+  {
+    if((*CP)->getProfilingType() != myType)
+    {
+      errs() << "CVP::buildFromList Warning: CP in list is not a CVP\n";
+      continue;
+    }
+
+    CombinedValueProfile* cp = (CombinedValueProfile*)(*CP);
+		_weight += cp->_weight;
+
+    for(CVPHistogramMap::iterator V = cp->_values.begin(),
+          VE = cp->_values.end(); V != VE; ++V)
+    {
+      CPHistogram* hist = cp->_histograms[V->second];
+      if( hist->nonZeroWeight() != 0 )
+        vcphm[V->first].push_back(hist);
+    }
+  }
+
+  for(std::map<ValueID,CPHistogramList>::iterator V = vcphm.begin(),
+        E = vcphm.end(); V != E; ++V)
+  {
+    _values[V->first] = _histograms.size();
+    _histograms.push_back(new CPHistogram(_bincount, _weight, V->second));
+  }
+
+	return true;
+}
+
+
+bool CombinedValueProfile::findSite(Instruction* call, unsigned argNo,
+                                    ValueSiteIndex& site) const
+{
+  std::map<std::pair<Instruction*,unsigned>,ValueSiteIndex>::const_iterator
+    i = _siteIndex.find(std::make_pair(call, argNo));
+  if(i == _siteIndex.end())
+    return(false);
+  site = i->second;
+  return(true);
+}
+
+
+bool CombinedValueProfile::valid(const ValueID& value) const
+{
+  return(_values.count(value) > 0);
+}
+
+
+CPHistogram& CombinedValueProfile::getHistogram(const ValueID& value)
+{
+  CVPHistogramMap::iterator V = _values.find(value);
+  if(V != _values.end())
+    return(*_histograms[V->second]);
+
+  CPHistogram* hist = new CPHistogram();
+  _values[value] = _histograms.size();
+  _histograms.push_back(hist);
+  return(*hist);
+}
+
+
+void CombinedValueProfile::getValueSet(ValueSet& values) const
+{
+  for(CVPHistogramMap::const_iterator V = _values.begin(), E = _values.end();
+      V != E; ++V)
+    values.insert(V->first);
+}
+
+
+double CombinedValueProfile::getStableValue(ValueSiteIndex site,
+                                            uint64_t& value)
+{
+  double best = 0;
+  CVPHistogramMap::iterator V = _values.lower_bound(ValueID(site, 0));
+  for(CVPHistogramMap::iterator E = _values.end();
+      (V != E) && (V->first.first == site); ++V)
+  {
+    double stability = _histograms[V->second]->mean(true);
+    if(stability > best)
+    {
+      best = stability;
+      value = V->first.second;
+    }
+  }
+  return(best);
+}
+
+
+// Basic checking to see if an instruction is an inlining candidate
+// (same as CombinedCallProfile)
+bool CombinedValueProfile::isFDOInliningCandidate(Instruction* I)
+{
+  if(I == NULL) return(false);
+
+  CallSite cs(cast<Value>(I));
+  if(!cs) return(false);
+  if(isa<IntrinsicInst>(I)) return(false);
+
+  Function* callee = cs.getCalledFunction();
+  if(callee == NULL) return(false);
+  if(callee == cs.getCaller()) return(false);
+  if(callee->isDeclaration()) return(false);
+
+  return(true);
+}
+
+
+// Integer arguments (up to 64 bits) that are not already constants;
+// must match ValueProfiler::isValueSite
+bool CombinedValueProfile::isValueSite(CallSite cs, unsigned argNo)
+{
+  if(argNo >= cs.getCalledFunction()->arg_size()) return(false);
+
+  Value* arg = cs.getArgument(argNo);
+  if(isa<Constant>(arg)) return(false);
+
+  const IntegerType* IT = dyn_cast<IntegerType>(arg->getType());
+  return( (IT != NULL) && (IT->getBitWidth() <= 64) );
+}
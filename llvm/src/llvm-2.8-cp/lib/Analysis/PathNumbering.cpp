@@ -53,6 +53,13 @@ static cl::opt<bool> ProcessEarlyTermination("process-early-termination",
 	cl::desc("In path profiling, insert extra instrumentation to account for "
            "unexpected function termination."));
 
+// Nodes with more paths to the exit are split off into regions of their
+// own (see calculatePathNumbers)
+static cl::opt<unsigned long long> PathSplitThreshold("path-split-threshold",
+	cl::init(100000000),
+	cl::desc("In path profiling, split the DAG at nodes with more paths to "
+           "the exit than this (default 100000000)"));
+
 // Initializes a new Node for the given BasicBlock
 BallLarusNode::BallLarusNode(BasicBlock* BB) :
 	_basicBlock(BB), _numberPaths(0), _color(WHITE) {}
@@ -63,12 +70,12 @@ BasicBlock* BallLarusNode::getBlock() {
 }
 
 // Returns the number of paths to the exit starting at the node.
-unsigned BallLarusNode::getNumberPaths() {
+uint64_t BallLarusNode::getNumberPaths() {
   return(_numberPaths);
 }
 
 // Sets the number of paths to the exit starting at the node.
-void BallLarusNode::setNumberPaths(unsigned numberPaths) {
+void BallLarusNode::setNumberPaths(uint64_t numberPaths) {
   _numberPaths = numberPaths;
 }
 
@@ -194,12 +201,12 @@ void BallLarusEdge::setType(EdgeType type) {
 
 // Returns the weight of this edge.  Used to decode path numbers to sequences
 // of basic blocks.
-unsigned BallLarusEdge::getWeight() {
+uint64_t BallLarusEdge::getWeight() {
   return(_weight);
 }
 
 // Sets the weight of the edge.  Used during path numbering.
-void BallLarusEdge::setWeight(unsigned weight) {
+void BallLarusEdge::setWeight(uint64_t weight) {
   _weight = weight;
 }
 
@@ -287,11 +294,12 @@ void BallLarusDag::calculatePathNumbers() {
     DEBUG(dbgs() << "calculatePathNumbers on " << node->getName() << "\n");
 
     bfsQueue.pop();
-    unsigned prevPathNumber = node->getNumberPaths();
+    uint64_t prevPathNumber = node->getNumberPaths();
     calculatePathNumbersFrom(node);
 
-		// Check for DAG splitting
-		if( node->getNumberPaths() > 100000000 && node != getRoot() ) {
+		// Check for DAG splitting.  A count that overflowed saturates at
+		// UINT64_MAX, so the node is split as well.
+		if( node->getNumberPaths() > PathSplitThreshold && node != getRoot() ) {
 			// Add new phony edge from the split-node to the DAG's exit
 			BallLarusEdge* exitEdge = addEdge(node, getExit(), 0);
 			exitEdge->setType(BallLarusEdge::SPLITEDGE_PHONY);
@@ -346,16 +354,30 @@ void BallLarusDag::calculatePathNumbers() {
   }
 
   DEBUG(dbgs() << "\tNumber of paths: " << getRoot()->getNumberPaths() << "\n");
+
+  if( hasPathOverflow() )
+    errs() << "Path numbering of function '" << _function.getName()
+           << "' overflowed 64 bits.\n";
 }
 
 // Returns the number of paths for the Dag.
-unsigned BallLarusDag::getNumberOfPaths() {
+uint64_t BallLarusDag::getNumberOfPaths() {
   return(getRoot()->getNumberPaths());
 }
 
+// True if the number of paths from the root overflowed 64 bits.
+bool BallLarusDag::hasPathOverflow() {
+  return(getRoot()->getNumberPaths() == UINT64_MAX);
+}
+
+// True if paths also end at the blocks with calls.
+bool BallLarusDag::hasCallEdges() {
+  return(ProcessEarlyTermination);
+}
+
 // get the first edge of the path
 // PB: taken directly from llvm-cprof.cpp, where it is called on a root.
-BallLarusEdge* BallLarusDag::getFirstBLEdge(unsigned int pathNumber) {
+BallLarusEdge* BallLarusDag::getFirstBLEdge(uint64_t pathNumber) {
   BallLarusEdge* best = 0;
 
   if(!_root){
@@ -372,6 +394,43 @@ BallLarusEdge* BallLarusDag::getFirstBLEdge(unsigned int pathNumber) {
   return best;
 }
 
+// Walk a path from the root, taking the largest-weight edge that fits
+// in the remaining path number.
+void BallLarusDag::getPathBlocks(uint64_t pathNumber,
+                                 std::vector<BasicBlock*>& blocks) {
+  blocks.clear();
+  BallLarusNode* currentNode = _root;
+  uint64_t increment = pathNumber;
+
+  while( currentNode && currentNode != _exit ) {
+    BallLarusEdge* next = 0;
+    for( BLEdgeIterator succ = currentNode->succBegin(),
+           end = currentNode->succEnd(); succ != end; succ++ ) {
+      if( (*succ)->getType() != BallLarusEdge::BACKEDGE &&
+          (*succ)->getType() != BallLarusEdge::SPLITEDGE &&
+          (*succ)->getWeight() <= increment &&
+          (!next || next->getWeight() < (*succ)->getWeight()) )
+        next = *succ;
+    }
+
+    if( !next ) {
+      errs() << "getPathBlocks: invalid path number " << pathNumber << "\n";
+      return;
+    }
+    increment -= next->getWeight();
+
+    if( next->getType() == BallLarusEdge::NORMAL )
+      blocks.push_back(currentNode->getBlock());
+    else if( next->getTarget() == _exit ) {
+      // path ends on a backedge
+      blocks.push_back(currentNode->getBlock());
+      blocks.push_back(next->getRealEdge()->getTarget()->getBlock());
+    }
+
+    currentNode = next->getTarget();
+  }
+}
+
 // Returns the root (i.e. entry) node for the DAG.
 BallLarusNode* BallLarusDag::getRoot() {
   return _root;
@@ -473,13 +532,13 @@ void BallLarusDag::buildEdge(BLBlockNodeMap& inDag, std::stack<BallLarusNode*>&
 }
 
 // The weight on each edge is the increment required along any path that
-// contains that edge.
+// contains that edge.  The sum saturates at UINT64_MAX on overflow.
 void BallLarusDag::calculatePathNumbersFrom(BallLarusNode* node) {
   if(node == getExit())
     // The Exit node must be base case
     node->setNumberPaths(1);
   else {
-    unsigned sumPaths = 0;
+    uint64_t sumPaths = 0;
     BallLarusNode* succNode;
     bool isReady = true;
 
@@ -492,9 +551,12 @@ void BallLarusDag::calculatePathNumbersFrom(BallLarusNode* node) {
       BallLarusEdge* currEdge = *succ;
       currEdge->setWeight(sumPaths);
       succNode = currEdge->getTarget();
-      unsigned succPaths = succNode->getNumberPaths();
+      uint64_t succPaths = succNode->getNumberPaths();
       isReady = isReady && (succPaths != 0);
-      sumPaths += succPaths;
+      if( succPaths > UINT64_MAX - sumPaths )
+        sumPaths = UINT64_MAX;
+      else
+        sumPaths += succPaths;
     }
 
     if(isReady)
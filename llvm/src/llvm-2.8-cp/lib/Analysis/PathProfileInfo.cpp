@@ -23,6 +23,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cstdio>
+#include <vector>
 
 using namespace llvm;
 
@@ -35,7 +36,7 @@ PathProfileInfoFilename("path-profile-loader-file", cl::init("llvmprof.out"),
 namespace {
   class PathProfileLoaderPass : public ModulePass, public PathProfileInfo {
   public:
-    PathProfileLoaderPass() : ModulePass(ID) { }
+    PathProfileLoaderPass() : ModulePass(ID), _sampleScale(1.0) { }
     ~PathProfileLoaderPass();
 
     // this pass doesn't change anything (only loads information)
@@ -71,6 +72,18 @@ namespace {
     // process path number information from the input file
     void handlePathInfo();
 
+    // process the sampling rate of a run from the input file
+    void handleSampleInfo();
+
+    // skip a block of words this loader does not use
+    bool skipWordBlock();
+
+    // skip the context paths of a run (-path-profile-context)
+    bool skipContextPaths();
+
+    // skip the loop paths of a run (-path-profile-iterations)
+    bool skipLoopPaths();
+
     // array of references to the functions in the module
     std::vector<Function*> _functions;
 
@@ -79,6 +92,9 @@ namespace {
 
     // path profile file name
     std::string _filename;
+
+    // inverse of the sampling rate of the current run
+    double _sampleScale;
   };
 }
 
@@ -119,7 +135,7 @@ BasicBlock* PathEdge::getTarget() {
 // Path implementation
 //
 
-Path::Path (unsigned int number, unsigned int count, double countStdDev, PathProfileInfo* ppi) :
+Path::Path (uint64_t number, unsigned int count, double countStdDev, PathProfileInfo* ppi) :
   _number(number) , _count(count), _countStdDev(countStdDev), _ppi(ppi) {
 }
 
@@ -128,7 +144,7 @@ double Path::getFrequency() const {
     double(_ppi->_functionPathCounts[_ppi->_currentFunction]);
 }
 
-unsigned int Path::getNumber() const {
+uint64_t Path::getNumber() const {
   return _number;
 }
 
@@ -141,7 +157,7 @@ double Path::getCountStdDev() const {
 }
 
 static BallLarusEdge* getNextEdge (BallLarusNode* node,
-    unsigned int pathNumber) {
+    uint64_t pathNumber) {
   BallLarusEdge* best = 0;
 
   for( BLEdgeIterator next = node->succBegin(),
@@ -158,7 +174,7 @@ static BallLarusEdge* getNextEdge (BallLarusNode* node,
 
 PathEdgeVector* Path::getPathEdges() const {
   BallLarusNode* currentNode = _ppi->_currentDag->getRoot ();
-  unsigned int increment = _number;
+  uint64_t increment = _number;
   PathEdgeVector* pev = new PathEdgeVector;
 
   while (currentNode != _ppi->_currentDag->getExit()) {
@@ -194,27 +210,8 @@ PathEdgeVector* Path::getPathEdges() const {
 }
 
 PathBlockVector* Path::getPathBlocks() const {
-  BallLarusNode* currentNode = _ppi->_currentDag->getRoot ();
-  unsigned int increment = _number;
   PathBlockVector* pbv = new PathBlockVector;
-
-  while (currentNode != _ppi->_currentDag->getExit()) {
-    BallLarusEdge* next = getNextEdge(currentNode, increment);
-    increment -= next->getWeight();
-
-    // add block to the block list if it is a real edge
-    if( next->getType() == BallLarusEdge::NORMAL)
-      pbv->push_back (currentNode->getBlock());
-    // make the back edge the last edge since we are at the end
-    else if( next->getTarget() == _ppi->_currentDag->getExit() ) {
-      pbv->push_back (currentNode->getBlock());
-      pbv->push_back (next->getRealEdge()->getTarget()->getBlock());
-    }
-
-    // set the new node
-    currentNode = next->getTarget();
-  }
-
+  _ppi->_currentDag->getPathBlocks(_number, *pbv);
   return pbv;
 }
 
@@ -269,12 +266,12 @@ BasicBlock* PathProfileInfo::getCurrentFunctionEntry() {
 }
 
 // return the path based on its number
-Path* PathProfileInfo::getPath(unsigned int number) {
+Path* PathProfileInfo::getPath(uint64_t number) {
   return _functionPaths[_currentFunction][number];
 }
 
 // return the number of paths which a function may potentially execute
-unsigned int PathProfileInfo::getPotentialPathCount() {
+uint64_t PathProfileInfo::getPotentialPathCount() {
   return _currentDag ? _currentDag->getNumberOfPaths() : 0;
 }
 
@@ -327,6 +324,35 @@ bool PathProfileLoaderPass::runOnModule(Module &M) {
     case PathInfo:
       handlePathInfo ();
       break;
+    case SampleInfo:
+      handleSampleInfo ();
+      break;
+    case CounterMapInfo:
+      // the functions a run did not instrument have no paths in it
+    case PrunedCounterInfo:
+      // the paths of pruned functions were not counted: leave them out
+      if( !skipWordBlock() ) {
+        errs () << "error: bad path profiling file syntax\n";
+        fclose (_file);
+        return false;
+      }
+      break;
+    case ContextPathInfo:
+      // the paths in context are also in the path profile
+      if( !skipContextPaths() ) {
+        errs () << "error: bad context path profiling file syntax\n";
+        fclose (_file);
+        return false;
+      }
+      break;
+    case LoopPathInfo:
+      // the iterations of a loop path are also in the path profile
+      if( !skipLoopPaths() ) {
+        errs () << "error: bad loop path profiling file syntax\n";
+        fclose (_file);
+        return false;
+      }
+      break;
     default:
       errs () << "error: bad path profiling file syntax\n";
       fclose (_file);
@@ -370,6 +396,66 @@ void PathProfileLoaderPass::handleArgumentInfo() {
 
   // byte alignment
 	fseek(_file, (4-(savedArgsLength&3))%4, SEEK_CUR);
+
+  // a new run, not sampled unless it says so
+  _sampleScale = 1.0;
+}
+
+// Handle the sampling rate of a run: its path counts are scaled back up
+void PathProfileLoaderPass::handleSampleInfo() {
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, _file) != 1 ) {
+    errs() << "warning: sample info header/data mismatch\n";
+    return;
+  }
+
+  std::vector<unsigned> rate(count);
+  if( count && fread(&rate[0], sizeof(unsigned), count, _file) != count ) {
+    errs() << "warning: sample info header/data mismatch\n";
+    return;
+  }
+
+  _sampleScale = 1.0;
+  if( count >= 2 && rate[1] > 0 )
+    _sampleScale = (double)rate[0] / rate[1];
+}
+
+// Skip a block that is a count of words and the words
+bool PathProfileLoaderPass::skipWordBlock() {
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, _file) != 1 )
+    return false;
+  return fseek(_file, count * sizeof(unsigned), SEEK_CUR) == 0;
+}
+
+// Skip the context paths: a count, then each a header and its frames
+bool PathProfileLoaderPass::skipContextPaths() {
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, _file) != 1 )
+    return false;
+  for( unsigned i = 0; i < count; i++ ) {
+    PathContextHeader header;
+    if( fread(&header, sizeof(PathContextHeader), 1, _file) != 1
+        || fseek(_file, header.depth * sizeof(PathContextFrame),
+                 SEEK_CUR) != 0 )
+      return false;
+  }
+  return true;
+}
+
+// Skip the loop paths: a count, then each a header and its path numbers
+bool PathProfileLoaderPass::skipLoopPaths() {
+  unsigned count;
+  if( fread(&count, sizeof(unsigned), 1, _file) != 1 )
+    return false;
+  for( unsigned i = 0; i < count; i++ ) {
+    LoopPathHeader header;
+    if( fread(&header, sizeof(LoopPathHeader), 1, _file) != 1
+        || fseek(_file, header.length * 2 * sizeof(unsigned),
+                 SEEK_CUR) != 0 )
+      return false;
+  }
+  return true;
 }
 
 // Handle path profile information in the output file
@@ -404,9 +490,14 @@ void PathProfileLoaderPass::handlePathInfo () {
     // Build a new path for the current function
     unsigned int totalPaths = 0;
     for (unsigned int j = 0; j < pathHeader.numEntries; j++) {
+      if( _sampleScale != 1.0 )
+        pathTable[j].pathCounter =
+          (unsigned)(pathTable[j].pathCounter * _sampleScale + 0.5);
       totalPaths += pathTable[j].pathCounter;
-      _functionPaths[f][pathTable[j].pathNumber]
-        = new Path(pathTable[j].pathNumber, pathTable[j].pathCounter, 0, this);
+      uint64_t pathNumber = ((uint64_t)pathTable[j].pathNumberHi << 32)
+        | pathTable[j].pathNumberLo;
+      _functionPaths[f][pathNumber]
+        = new Path(pathNumber, pathTable[j].pathCounter, 0, this);
     }
 
     _functionPathCounts[f] = totalPaths;
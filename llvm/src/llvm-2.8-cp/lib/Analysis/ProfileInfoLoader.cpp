@@ -39,9 +39,45 @@ static unsigned AddCounts(unsigned A, unsigned B) {
   return A + B;
 }
 
+// ScaleCount - Scale a sampled count back up to the whole run.
+static unsigned ScaleCount(unsigned C, double Scale) {
+  if (Scale == 1.0 || C == ProfileInfoLoader::Uncounted) return C;
+  double S = C * Scale + 0.5;
+  if (S >= ProfileInfoLoader::Uncounted) return ProfileInfoLoader::Uncounted-1;
+  return (unsigned)S;
+}
+
+// MaskUncovered - Mark the counters of the functions that a counter map
+// (CounterMapInfo: the ProfilingType, then a first counter and an
+// instrumented flag per function) says were not instrumented Uncounted.
+static void MaskUncovered(std::vector<unsigned> &Counts,
+                          const std::vector<unsigned> &Map) {
+  for (unsigned i = 1; i + 1 < Map.size(); i += 2) {
+    if (Map[i+1])
+      continue;
+    unsigned End = i + 2 < Map.size() ? Map[i+2] : Counts.size();
+    for (unsigned c = Map[i]; c < End && c < Counts.size(); ++c)
+      Counts[c] = ProfileInfoLoader::Uncounted;
+  }
+}
+
+// MaskPruned - Mark the counters that a pruned counter block
+// (PrunedCounterInfo: the ProfilingType, then counter indices) says the
+// instrumentation left out Uncounted.  They ran as often as the counter
+// they are normalized by, which this loader does not know.
+static void MaskPruned(std::vector<unsigned> &Counts,
+                       const std::vector<unsigned> &Pruned) {
+  for (unsigned i = 1; i < Pruned.size(); ++i)
+    if (Pruned[i] < Counts.size())
+      Counts[Pruned[i]] = ProfileInfoLoader::Uncounted;
+}
+
 static void ReadProfilingBlock(const char *ToolName, FILE *F,
                                bool ShouldByteSwap,
-                               std::vector<unsigned> &Data) {
+                               std::vector<unsigned> &Data,
+                               double Scale = 1.0,
+                               const std::vector<unsigned> *Map = 0,
+                               const std::vector<unsigned> *Pruned = 0) {
   // Read the number of entries...
   unsigned NumEntries;
   if (fread(&NumEntries, sizeof(unsigned), 1, F) != 1) {
@@ -61,6 +97,13 @@ static void ReadProfilingBlock(const char *ToolName, FILE *F,
     exit(1);
   }
 
+  // The counters of uninstrumented functions are unknown, not 0.
+  // (Uncounted reads the same in either byte order.)
+  if (Map)
+    MaskUncovered(TempSpace, *Map);
+  if (Pruned)
+    MaskPruned(TempSpace, *Pruned);
+
   // Make sure we have enough space... The space is initialised to -1 to
   // facitiltate the loading of missing values for OptimalEdgeProfiling.
   if (Data.size() < NumEntries)
@@ -69,11 +112,12 @@ static void ReadProfilingBlock(const char *ToolName, FILE *F,
   // Accumulate the data we just read into the data.
   if (!ShouldByteSwap) {
     for (unsigned i = 0; i != NumEntries; ++i) {
-      Data[i] = AddCounts(TempSpace[i], Data[i]);
+      Data[i] = AddCounts(ScaleCount(TempSpace[i], Scale), Data[i]);
     }
   } else {
     for (unsigned i = 0; i != NumEntries; ++i) {
-      Data[i] = AddCounts(ByteSwap(TempSpace[i], true), Data[i]);
+      Data[i] = AddCounts(ScaleCount(ByteSwap(TempSpace[i], true), Scale),
+                          Data[i]);
     }
   }
 }
@@ -95,8 +139,13 @@ ProfileInfoLoader::ProfileInfoLoader(const char *ToolName,
     exit(1);
   }
 
-  // Keep reading packets until we run out of them.
+  // Keep reading packets until we run out of them.  The counts of a run
+  // that was sampled are scaled by the inverse of its sampling rate, and
+  // the edge counts of a partially instrumented run are masked by its
+  // counter map and its pruned counters.
   unsigned PacketType;
+  double Scale = 1.0;
+  std::vector<unsigned> EdgeMap, EdgePruned;
   while (fread(&PacketType, sizeof(unsigned), 1, F) == 1) {
     // If the low eight bits of the packet are zero, we must be dealing with an
     // endianness mismatch.  Byteswap all words read from the profiling
@@ -124,23 +173,60 @@ ProfileInfoLoader::ProfileInfoLoader(const char *ToolName,
           exit(1);
         }
       CommandLines.push_back(std::string(&Chars[0], &Chars[ArgLength]));
+      Scale = 1.0;
+      EdgeMap.clear();
+      EdgePruned.clear();
+      break;
+    }
+
+    case CounterMapInfo: {
+      std::vector<unsigned> Map;
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, Map);
+      if (!Map.empty() && Map[0] == EdgeInfo)
+        EdgeMap = Map;
+      break;
+    }
+
+    case PrunedCounterInfo: {
+      std::vector<unsigned> Pruned;
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, Pruned);
+      if (!Pruned.empty() && Pruned[0] == EdgeInfo)
+        EdgePruned = Pruned;
+      break;
+    }
+
+    case CFGChecksumInfo: {
+      // only the combined profiles match the counters of changed code
+      std::vector<unsigned> Checksums;
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, Checksums);
+      break;
+    }
+
+    case SampleInfo: {
+      std::vector<unsigned> Rate;
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, Rate);
+      Scale = 1.0;
+      if (Rate.size() >= 2 && Rate[1] != 0)
+        Scale = (double)Rate[0] / Rate[1];
       break;
     }
 
     case FunctionInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, FunctionCounts);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, FunctionCounts, Scale);
       break;
 
     case BlockInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, BlockCounts);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, BlockCounts, Scale);
       break;
 
     case EdgeInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, EdgeCounts);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, EdgeCounts, Scale,
+                         EdgeMap.empty() ? 0 : &EdgeMap,
+                         EdgePruned.empty() ? 0 : &EdgePruned);
       break;
 
     case OptEdgeInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, OptimalEdgeCounts);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, OptimalEdgeCounts, Scale);
       break;
 
     case BBTraceInfo:
@@ -9,7 +9,11 @@
 
 #define DEBUG_TYPE "calcspillweights"
 
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
 #include "llvm/Function.h"
+#include "llvm/InstrTypes.h"
+#include "llvm/Metadata.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/CodeGen/CalcSpillWeights.h"
 #include "llvm/CodeGen/LiveIntervalAnalysis.h"
@@ -17,6 +21,7 @@
 #include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/SlotIndexes.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetInstrInfo.h"
@@ -24,6 +29,11 @@
 #include "llvm/Target/TargetRegisterInfo.h"
 using namespace llvm;
 
+static cl::opt<bool>
+SpillWeightProfile("spill-weight-profile", cl::init(true), cl::Hidden,
+  cl::desc("Weigh the uses of a register by the profiled frequency of "
+           "their block (!cp.freq) instead of by its loop depth"));
+
 char CalculateSpillWeights::ID = 0;
 INITIALIZE_PASS(CalculateSpillWeights, "calcspillweights",
                 "Calculate spill weights", false, false);
@@ -82,12 +92,60 @@ static unsigned copyHint(const MachineInstr *mi, unsigned reg,
   return tri.getMatchingSuperReg(hreg, sub, rc);
 }
 
+// Return the profiled executions of bb per call of the function, as attached
+// to its terminator by -FDOBlockFreqs, or -1 if there are none.  Blocks that
+// never ran get a small weight, so their uses still count.
+static float blockFrequency(const BasicBlock *bb) {
+  if (!bb->getTerminator())
+    return -1;
+  const MDNode *node = bb->getTerminator()->getMetadata("cp.freq");
+  if (!node || node->getNumOperands() != 1)
+    return -1;
+  const ConstantInt *freq = dyn_cast_or_null<ConstantInt>(node->getOperand(0));
+  if (!freq)
+    return -1;
+  return std::max(freq->getZExtValue(), (uint64_t)1) / 1000.0f;
+}
+
+// The profiled frequencies and the 10^d estimate of the loop depth are on
+// unrelated scales, so the uses of a function are only weighed by the former
+// if every block of it has one.
+bool VirtRegAuxInfo::hasProfiledFrequencies(const MachineFunction &mf) {
+  if (!SpillWeightProfile)
+    return false;
+  const Function *fn = mf.getFunction();
+  for (Function::const_iterator bb = fn->begin(), e = fn->end(); bb != e; ++bb)
+    if (blockFrequency(bb) < 0)
+      return false;
+  return true;
+}
+
+// Return the profiled executions of mbb per call of the function.  A block
+// the code generator created, with no IR block, runs on an edge or a part of
+// one of its neighbours: it takes the largest frequency of its predecessors
+// (or else successors), or that of the entry.
+static float profiledFrequency(const MachineBasicBlock *mbb) {
+  if (const BasicBlock *bb = mbb->getBasicBlock())
+    return blockFrequency(bb);
+  float freq = -1;
+  for (MachineBasicBlock::const_pred_iterator pi = mbb->pred_begin(),
+       pe = mbb->pred_end(); pi != pe; ++pi)
+    if (const BasicBlock *bb = (*pi)->getBasicBlock())
+      freq = std::max(freq, blockFrequency(bb));
+  for (MachineBasicBlock::const_succ_iterator si = mbb->succ_begin(),
+       se = mbb->succ_end(); freq < 0 && si != se; ++si)
+    if (const BasicBlock *bb = (*si)->getBasicBlock())
+      freq = std::max(freq, blockFrequency(bb));
+  return freq < 0 ? 1 : freq;
+}
+
 void VirtRegAuxInfo::CalculateWeightAndHint(LiveInterval &li) {
   MachineRegisterInfo &mri = mf_.getRegInfo();
   const TargetRegisterInfo &tri = *mf_.getTarget().getRegisterInfo();
   MachineBasicBlock *mbb = 0;
   MachineLoop *loop = 0;
   unsigned loopDepth = 0;
+  float freq = -1;
   bool isExiting = false;
   float totalWeight = 0;
   SmallPtrSet<MachineInstr*, 8> visited;
@@ -111,13 +169,18 @@ void VirtRegAuxInfo::CalculateWeightAndHint(LiveInterval &li) {
       mbb = mi->getParent();
       loop = loops_.getLoopFor(mbb);
       loopDepth = loop ? loop->getLoopDepth() : 0;
+      freq = profiled_ ? profiledFrequency(mbb) : -1;
       isExiting = loop ? loop->isLoopExiting(mbb) : false;
     }
 
     // Calculate instr weight.
     bool reads, writes;
     tie(reads, writes) = mi->readsWritesVirtualRegister(li.reg);
-    float weight = LiveIntervals::getSpillWeight(writes, reads, loopDepth);
+    // The profiled frequency replaces the 10^d estimate of the loop depth;
+    // the function entry weighs 1 in both.
+    float weight = freq >= 0 ? (writes + reads) * freq
+                             : LiveIntervals::getSpillWeight(writes, reads,
+                                                             loopDepth);
 
     // Give extra weight to what looks like a loop induction variable update.
     if (writes && isExiting && lis_.isLiveOutOfMBB(li, mbb))
@@ -28,6 +28,7 @@
 #include "llvm/Intrinsics.h"
 #include "llvm/IntrinsicInst.h"
 #include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
 #include "llvm/Module.h"
 #include "llvm/CodeGen/Analysis.h"
 #include "llvm/CodeGen/FastISel.h"
@@ -57,6 +58,7 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <map>
 using namespace llvm;
 
 /// LimitFloatPrecision - Generate low-precision inline sequences for
@@ -70,6 +72,12 @@ LimitFPPrecision("limit-float-precision",
                  cl::location(LimitFloatPrecision),
                  cl::init(0));
 
+static cl::opt<unsigned>
+SwitchPeelPercent("switch-peel-percent", cl::init(40), cl::Hidden,
+                  cl::desc("Test a switch case ahead of the rest of the "
+                           "switch if it takes at least this percentage of "
+                           "the profiled executions (!cp.weights, 0: never)"));
+
 static SDValue getCopyFromPartsVector(SelectionDAG &DAG, DebugLoc DL,
                                       const SDValue *Parts, unsigned NumParts,
                                       EVT PartVT, EVT ValueVT);
@@ -1737,8 +1745,16 @@ bool SelectionDAGBuilder::handleSmallSwitchRange(CaseRec& CR,
   // use bit manipulation to do two compares at once.  For example:
   // "if (X == 6 || X == 4)" -> "if ((X|2) == 6)"
 
+  // With a profile, test the most frequent cases first.
+  bool Profiled = false;
+  for (CaseItr I = CR.Range.first, E = CR.Range.second; I != E; ++I)
+    Profiled |= I->Weight != 0;
+  if (Profiled)
+    std::stable_sort(CR.Range.first, CR.Range.second, CaseWeightCmp());
+
   // Rearrange the case blocks so that the last one falls through if possible.
-  if (NextBlock && Default != NextBlock && BackCase.BB != NextBlock) {
+  if (!Profiled && NextBlock && Default != NextBlock &&
+      BackCase.BB != NextBlock) {
     // The last case block won't fall through into 'NextBlock' if we emit the
     // branches in this order.  See if rearranging a case value would help.
     for (CaseItr I = CR.Range.first, E = CR.Range.second-1; I != E; ++I) {
@@ -2167,12 +2183,31 @@ size_t SelectionDAGBuilder::Clusterify(CaseVector& Cases,
                                        const SwitchInst& SI) {
   size_t numCmps = 0;
 
+  // Profiled case frequencies (see -FDOBranchWeights): the default's
+  // weight, then pairs of case value and weight.  A case the profile did
+  // not see has none.
+  std::map<const ConstantInt*, uint64_t> CaseWeights;
+  if (const MDNode *Weights = SI.getMetadata("cp.weights"))
+    for (unsigned i = 1; i + 1 < Weights->getNumOperands(); i += 2) {
+      const ConstantInt *V = dyn_cast_or_null<ConstantInt>(
+                               Weights->getOperand(i));
+      const ConstantInt *W = dyn_cast_or_null<ConstantInt>(
+                               Weights->getOperand(i + 1));
+      if (V && W)
+        CaseWeights[V] = W->getZExtValue();
+    }
+
   // Start with "simple" cases
   for (size_t i = 1; i < SI.getNumSuccessors(); ++i) {
     MachineBasicBlock *SMBB = FuncInfo.MBBMap[SI.getSuccessor(i)];
+    uint64_t Weight = 0;
+    std::map<const ConstantInt*, uint64_t>::iterator W =
+      CaseWeights.find(SI.getCaseValue(i));
+    if (W != CaseWeights.end())
+      Weight = W->second;
     Cases.push_back(Case(SI.getSuccessorValue(i),
                          SI.getSuccessorValue(i),
-                         SMBB));
+                         SMBB, Weight));
   }
   std::sort(Cases.begin(), Cases.end(), CaseCmp());
 
@@ -2190,6 +2225,7 @@ size_t SelectionDAGBuilder::Clusterify(CaseVector& Cases,
       // into a single case.
       if ((nextValue - currentValue == 1) && (currentBB == nextBB)) {
         I->High = J->High;
+        I->Weight += J->Weight;
         J = Cases.erase(J);
       } else {
         I = J++;
@@ -2205,6 +2241,69 @@ size_t SelectionDAGBuilder::Clusterify(CaseVector& Cases,
   return numCmps;
 }
 
+/// peelHotSwitchCases - Test the cases that take most of the profiled
+/// executions one by one, hottest first, ahead of the rest of the switch
+/// (which may become a jump table).  Returns the block in which the rest of
+/// the switch is lowered.
+MachineBasicBlock *
+SelectionDAGBuilder::peelHotSwitchCases(CaseVector& Cases,
+                                        const SwitchInst &SI,
+                                        MachineBasicBlock *SwitchBB) {
+  if (SwitchPeelPercent == 0)
+    return SwitchBB;
+
+  uint64_t Remaining = 0;
+  for (CaseItr I = Cases.begin(), E = Cases.end(); I != E; ++I)
+    Remaining += I->Weight;
+  if (Remaining == 0)
+    return SwitchBB;
+  const MDNode *Weights = SI.getMetadata("cp.weights");
+  if (const ConstantInt *W =
+        dyn_cast_or_null<ConstantInt>(Weights->getOperand(0)))
+    Remaining += W->getZExtValue();
+
+  MachineFunction *CurMF = FuncInfo.MF;
+  const Value *SV = SI.getCondition();
+  MachineBasicBlock *CurBlock = SwitchBB;
+  while (Cases.size() > 1) {
+    CaseItr Hot = Cases.begin();
+    for (CaseItr I = Cases.begin(), E = Cases.end(); I != E; ++I)
+      if (I->Weight > Hot->Weight)
+        Hot = I;
+    if (Hot->Weight * 100 < Remaining * SwitchPeelPercent)
+      break;
+
+    MachineBasicBlock *Rest =
+      CurMF->CreateMachineBasicBlock(CurBlock->getBasicBlock());
+    MachineFunction::iterator BBI = CurBlock;
+    CurMF->insert(++BBI, Rest);
+    ExportFromCurrentBlock(SV);
+
+    const Value *RHS, *LHS, *MHS;
+    ISD::CondCode CC;
+    if (Hot->High == Hot->Low) {
+      CC = ISD::SETEQ;
+      LHS = SV; RHS = Hot->High; MHS = NULL;
+    } else {
+      CC = ISD::SETLE;
+      LHS = Hot->Low; MHS = SV; RHS = Hot->High;
+    }
+    CaseBlock CB(CC, LHS, RHS, MHS, Hot->BB, Rest, CurBlock);
+    if (CurBlock == SwitchBB)
+      visitSwitchCase(CB, SwitchBB);
+    else
+      SwitchCases.push_back(CB);
+
+    DEBUG(dbgs() << "Peeled switch case with weight " << Hot->Weight
+                 << " of " << Remaining << '\n');
+    Remaining -= Hot->Weight;
+    Cases.erase(Hot);
+    CurBlock = Rest;
+  }
+
+  return CurBlock;
+}
+
 void SelectionDAGBuilder::visitSwitch(const SwitchInst &SI) {
   MachineBasicBlock *SwitchMBB = FuncInfo.MBB;
 
@@ -2241,9 +2340,12 @@ void SelectionDAGBuilder::visitSwitch(const SwitchInst &SI) {
   // search tree.
   const Value *SV = SI.getOperand(0);
 
+  // Test the hot cases first, if profiled.
+  MachineBasicBlock *CaseMBB = peelHotSwitchCases(Cases, SI, SwitchMBB);
+
   // Push the initial CaseRec onto the worklist
   CaseRecVector WorkList;
-  WorkList.push_back(CaseRec(SwitchMBB,0,0,
+  WorkList.push_back(CaseRec(CaseMBB,0,0,
                              CaseRange(Cases.begin(),Cases.end())));
 
   while (!WorkList.empty()) {
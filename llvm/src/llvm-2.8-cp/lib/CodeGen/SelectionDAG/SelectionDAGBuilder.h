@@ -129,15 +129,18 @@ private:
   unsigned SDNodeOrder;
 
   /// Case - A struct to record the Value for a switch case, and the
-  /// case's target basic block.
+  /// case's target basic block.  Weight is the case's profiled frequency
+  /// (from !cp.weights), or 0.
   struct Case {
     Constant* Low;
     Constant* High;
     MachineBasicBlock* BB;
+    uint64_t Weight;
 
-    Case() : Low(0), High(0), BB(0) { }
-    Case(Constant* low, Constant* high, MachineBasicBlock* bb) :
-      Low(low), High(high), BB(bb) { }
+    Case() : Low(0), High(0), BB(0), Weight(0) { }
+    Case(Constant* low, Constant* high, MachineBasicBlock* bb,
+         uint64_t weight = 0) :
+      Low(low), High(high), BB(bb), Weight(weight) { }
     APInt size() const {
       const APInt &rHigh = cast<ConstantInt>(High)->getValue();
       const APInt &rLow  = cast<ConstantInt>(Low)->getValue();
@@ -190,6 +193,13 @@ private:
     }
   };
 
+  /// Orders switch cases by decreasing profiled frequency.
+  struct CaseWeightCmp {
+    bool operator()(const Case &C1, const Case &C2) {
+      return C1.Weight > C2.Weight;
+    }
+  };
+
   struct CaseBitsCmp {
     bool operator()(const CaseBits &C1, const CaseBits &C2) {
       return C1.Bits > C2.Bits;
@@ -407,6 +417,9 @@ private:
   void visitUnreachable(const UnreachableInst &I) { /* noop */ }
 
   // Helpers for visitSwitch
+  MachineBasicBlock *peelHotSwitchCases(CaseVector& Cases,
+                                        const SwitchInst &SI,
+                                        MachineBasicBlock *SwitchBB);
   bool handleSmallSwitchRange(CaseRec& CR,
                               CaseRecVector& WorkList,
                               const Value* SV,
@@ -15,14 +15,18 @@
 
 #include "llvm/IntrinsicInst.h"
 #include "llvm/Function.h"
+#include "llvm/Module.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/PathNumbering.h"
 #include "llvm/Transforms/FDO/CPCallRecord.h"
 #include "llvm/Transforms/FDO/TStream.h"
 
 #include <cstdlib>
+#include <cstring>
 
 using namespace llvm;
 
@@ -32,17 +36,32 @@ using namespace llvm;
 static cl::list<double> 
 FDIQList("FDI-Q", cl::CommaSeparated, cl::desc("FDI quantile point(s)"));
 
+// with a path profile: blocks at or below this heat are cold
+static cl::opt<double> 
+FDIPathCold("FDI-path-cold", cl::init(0.0), 
+            cl::desc("FDI block heat (fraction of paths) considered cold"));
+
+// with a value profile: arguments at or above this stability are
+// treated as (guarded) constants
+static cl::opt<double> 
+FDIValueStable("FDI-value-stable", cl::init(0.9), 
+               cl::desc("FDI argument value stability treated as constant"));
+
 
 unsigned CPCallRecord::CurrID = 0;
 MetricNameMap CPCallRecord::_metricmap;
 FDOInlineMetric CPCallRecord::_metric;
 
 FuncAttrMap CPCallRecord::_funcAttr;  // function attribute cache
+BlockHeatMap CPCallRecord::_blockHeat;
+uint64_t CPCallRecord::_pathDigest = 0;
+ArgStabilityMap CPCallRecord::_argStability;
+uint64_t CPCallRecord::_valueDigest = 0;
 
 // initializing ctor
 CPCallRecord::CPCallRecord(CallSite C, const CPHistogram* P, 
                                        double V) : 
-  cs(C), mval(V), ignored(false)
+  cs(C), mval(V), mraw(V), mbenefit(0), ignored(false)
 {
   ID = CurrID++;
   zID = rand();
@@ -54,7 +73,8 @@ CPCallRecord::CPCallRecord(CallSite C, const CPHistogram* P,
 
 // copy ctor
 CPCallRecord::CPCallRecord(const CPCallRecord& rhs) :
-  cs(rhs.cs), mval(rhs.mval), ignored(rhs.ignored), history(rhs.history), 
+  cs(rhs.cs), mval(rhs.mval), mraw(rhs.mraw), mbenefit(rhs.mbenefit),
+  ignored(rhs.ignored), history(rhs.history), 
   historyString(rhs.historyString), ID(rhs.ID), zID(rhs.zID)
 {
   cphist = new CPHistogram(*(rhs.cphist));
@@ -68,7 +88,7 @@ CPCallRecord::CPCallRecord(const CPCallRecord& callRec, // for inlined call
                            const CPCallRecord& oldRec,  // for original callsite
                            Function* inlinedFunc, // original caller
                            const CallSite newCall) :    // new callsite
-  cs(newCall), ignored(false)
+  cs(newCall), mval(0), mraw(0), mbenefit(0), ignored(false)
 {
   ID = CurrID++;
   if( (callRec.cphist != NULL) && (oldRec.cphist != NULL) )
@@ -124,6 +144,10 @@ void CPCallRecord::freeStaticData()
       delete[] (i->second).argImpact;
   }
   _funcAttr.clear();
+  _blockHeat.clear();
+  _pathDigest = 0;
+  _argStability.clear();
+  _valueDigest = 0;
 }
 
 
@@ -251,11 +275,21 @@ void CPCallRecord::print(TStream& stream, BasicBlock* BB,
 
 // returns change in function size vs current size value
 int CPCallRecord::recalcFunctionAttr(Function* f)
+{
+  if( (f == NULL) || f->isDeclaration() ) return(0);
+
+  prepareFunctionAttr(f);
+  return(analyzeFunctionAttr(f, false));
+}
+
+
+// The part of recalcFunctionAttr that creates the attribute record
+// and modifies the IR.  Not thread-safe.
+void CPCallRecord::prepareFunctionAttr(Function* f)
 {
   FunctionAttr* attr;
-  bool isNew = false;
 
-  if( (f == NULL) || f->isDeclaration() ) return(0);
+  if( (f == NULL) || f->isDeclaration() ) return;
 
   // get or create the attributes record
   FuncAttrMap::iterator attrIter = _funcAttr.find(f);
@@ -263,7 +297,6 @@ int CPCallRecord::recalcFunctionAttr(Function* f)
   {
     attr = &(_funcAttr[f]);
     (*attr) = ZeroFunctionAttr;
-    isNew = true;
   }
   else
   {
@@ -279,9 +312,26 @@ int CPCallRecord::recalcFunctionAttr(Function* f)
   attr->args = f->arg_size();
   if( (attr->argImpact == NULL) && (attr->args > 0) )
     attr->argImpact = new ArgImpact[attr->args];
-  // delay calculating the benefit of a constant argument (to
-  // getConstImpact) until we need to eval a call that actually
-  // has a constant argument
+}
+
+
+// The analysis part of recalcFunctionAttr.  Only reads the IR and
+// writes the (prepared) record of f, so different functions can be
+// analyzed on different threads.  Unless argImpacts is set,
+// calculating the benefit of a constant argument is delayed (to
+// getArgImpact) until we need to eval a call that actually has a
+// constant argument.
+// Returns change in function size vs current size value.
+int CPCallRecord::analyzeFunctionAttr(Function* f, bool argImpacts)
+{
+  FuncAttrMap::iterator attrIter = _funcAttr.find(f);
+  if(attrIter == _funcAttr.end())
+  {
+    errs() << "CPCallRecord::analyzeFunctionAttr Error: " 
+           << f->getName().str() << " not prepared\n";
+    return(0);
+  }
+  FunctionAttr* attr = &(attrIter->second);
 
   // if we did something that invalidated the FunctionAttr (ie,
   // inlined into the function), this probably also invalidates our
@@ -315,8 +365,9 @@ int CPCallRecord::recalcFunctionAttr(Function* f)
   //       << " = " << growth << "\n";
 
   attr->size = newAttr.size;
-  if(isNew)
+  if(!attr->valid)
     attr->startSize = attr->size;
+  attr->valid = true;
 
   // selectively copy over recalculated values
   attr->externCalls = newAttr.externCalls;
@@ -324,6 +375,16 @@ int CPCallRecord::recalcFunctionAttr(Function* f)
   attr->indirectCalls = newAttr.indirectCalls;
   attr->cannotInline = newAttr.cannotInline;
 
+  if(argImpacts)
+  {
+    Function::arg_iterator I = f->arg_begin();
+    for(unsigned arg = 0; arg < attr->args; ++arg, ++I)
+    {
+      calcConstantImpact(I, &(attr->argImpact[arg]));
+      calcAllocaImpact(I, &(attr->argImpact[arg]));
+    }
+  }
+
   return(growth);
 }
 
@@ -785,15 +846,18 @@ double CPCallRecord::evalMetric()
   
   double benefit = inlineBenefit();
   double cost = inlineCost();
+  mbenefit = benefit;
 
   // can't get improvement from negative benefits without negative costs
   if( (cost >= 0) && (benefit <= 0) )
   {
     mval = -1;
+    mraw = -1;
   }
   else  // apply the selected metric
   {
     mval = (*_metric)(*this, benefit);
+    mraw = mval;
     
     //if(cost == 0) leave mval unmodified.
     if(cost > 0)
@@ -817,6 +881,28 @@ double CPCallRecord::evalMetric()
 
 
 
+double CPCallRecord::evalFrequency()
+{
+  if(_metric == NULL)
+    return(0);
+  return((*_metric)(*this, 1.0));
+}
+
+
+void CPCallRecord::setQList(const std::vector<double>& qs)
+{
+  FDIQList.clear();
+  for(unsigned i = 0, E = qs.size(); i != E; ++i)
+    FDIQList.push_back(qs[i]);
+}
+
+
+void CPCallRecord::getQList(std::vector<double>& qs)
+{
+  qs.assign(FDIQList.begin(), FDIQList.end());
+}
+
+
 // Per-call (dynamic) benefit of inlining (mostly instructions saved).
 // The caller should weight this benefit by, eg., expected frequency,
 // as appropriate.  Benefit is determined by:
@@ -825,6 +911,10 @@ double CPCallRecord::evalMetric()
 // - setup/return overhead
 double CPCallRecord::inlineBenefit()
 {
+  // with a path profile for the callee, only count hot-path savings
+  if(hasPathProfile(cs.getCalledFunction()))
+    return(inlineHotBenefit());
+
   // start off with the savings for call/return overhead
   unsigned benefit = inlineWeights::callReturn;
 
@@ -842,7 +932,7 @@ double CPCallRecord::inlineBenefit()
   FunctionAttr* attr = getFunctionAttr(cs.getCalledFunction());
   benefit += attr->indirectCalls;
 
-  return(benefit);
+  return(benefit + stableArgBenefit());
 }
 
 
@@ -856,10 +946,324 @@ double CPCallRecord::inlineCost()
   //if(size > 0) cost += size;
 
   //return(cost);
+
+  // Cold callee blocks still grow the code (inlineSize, and thus the
+  // budget), but they don't compete for the i-cache on hot paths.
+  Function* callee = cs.getCalledFunction();
+  if(hasPathProfile(callee))
+    return((double)inlineSize() - calcColdSize(callee));
+
   return(inlineSize());
 }
 
 
+//===================================================================//
+//                                                                   //
+//      PATH PROFILE                                                 //
+//                                                                   //
+//===================================================================//
+
+// Block heat is the expected (mean over runs, weighted by coverage)
+// fraction of the function's Ball-Larus paths that contain the block.
+// Paths are acyclic, so this approximates executions per call for
+// blocks outside of loops and underestimates it inside loops.
+unsigned CPCallRecord::setPathProfile(Module& M, CombinedPathProfile& cpp)
+{
+  _blockHeat.clear();
+  unsigned pathFuncs = 0;
+
+  // path profile function indices are 1-based, over defined functions
+  std::vector<Function*> funcs;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if(!F->isDeclaration())
+      funcs.push_back(F);
+
+  PathSet paths;
+  cpp.getPathSet(paths);
+
+  // PathSet is ordered by function, so each DAG is built once
+  BallLarusDag* dag = NULL;
+  FunctionIndex dagFunc = 0;
+  std::vector<BasicBlock*> blocks;
+  for(PathSet::iterator P = paths.begin(), E = paths.end(); P != E; ++P)
+  {
+    FunctionIndex funcNum = P->first;
+    if( (funcNum == 0) || (funcNum > funcs.size()) )
+    {
+      errs() << "CPCallRecord::setPathProfile: bad function index " 
+             << funcNum << "\n";
+      continue;
+    }
+
+    Function* F = funcs[funcNum-1];
+    if(funcNum != dagFunc)
+    {
+      delete dag;
+      dag = new BallLarusDag(*F);
+      dag->init();
+      dag->calculatePathNumbers();
+      dagFunc = funcNum;
+
+      // every block of a profiled function has a heat, even if 0
+      if(!hasPathProfile(F))
+      {
+        for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+          _blockHeat[BB] = 0;
+        pathFuncs++;
+      }
+    }
+
+    CPHistogram& hist = cpp.getHistogram(*P);
+    double weight = hist.mean() * hist.coverage();
+    if(weight <= 0)
+      continue;
+
+    // a path ending on a backedge can list its header twice
+    dag->getPathBlocks(P->second, blocks);
+    std::set<BasicBlock*> seen;
+    for(unsigned b = 0, BE = blocks.size(); b != BE; ++b)
+      if(seen.insert(blocks[b]).second)
+        _blockHeat[blocks[b]] += weight;
+  }
+  delete dag;
+
+  // digest of all heats, in module order (used in cache keys)
+  _pathDigest = 14695981039346656037ULL;
+  for(unsigned f = 0, FE = funcs.size(); f != FE; ++f)
+  {
+    if(!hasPathProfile(funcs[f]))
+      continue;
+    for(Function::iterator BB = funcs[f]->begin(), BE = funcs[f]->end(); 
+        BB != BE; ++BB)
+    {
+      double heat = _blockHeat[BB];
+      const unsigned char* p = (const unsigned char*)&heat;
+      for(unsigned i = 0; i != sizeof(heat); ++i)
+        _pathDigest = (_pathDigest ^ p[i]) * 1099511628211ULL;
+    }
+  }
+
+  return(pathFuncs);
+}
+
+
+// Every block of a profiled function has a heat, and inlining keeps
+// the caller's entry block.
+bool CPCallRecord::hasPathProfile(Function* F)
+{
+  return( (F != NULL) && !F->isDeclaration()
+          && (_blockHeat.count(&F->getEntryBlock()) > 0) );
+}
+
+
+// Blocks created after the profile was loaded (ie, by inlining) have
+// no heat; they are treated as cold for benefits, and hot for costs.
+double CPCallRecord::blockHeat(BasicBlock* BB)
+{
+  BlockHeatMap::iterator heat = _blockHeat.find(BB);
+  if(heat == _blockHeat.end())
+    return(0);
+  return(heat->second);
+}
+
+
+unsigned CPCallRecord::calcColdSize(Function* F)
+{
+  unsigned cold = 0;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+  {
+    BlockHeatMap::iterator heat = _blockHeat.find(BB);
+    if( (heat != _blockHeat.end()) && (heat->second <= FDIPathCold) )
+      cold += calcBlockSize(BB);
+  }
+  return(cold);
+}
+
+
+// Path-profile version of inlineBenefit: the savings from constant
+// and alloca arguments only count on the callee paths that run.
+double CPCallRecord::inlineHotBenefit()
+{
+  Function* callee = cs.getCalledFunction();
+
+  // call/return overhead, ~1 instruction per arg, icall bonus
+  double benefit = inlineWeights::callReturn;
+  benefit += cs.arg_size();
+  benefit += getFunctionAttr(callee)->indirectCalls;
+
+  CallSite::arg_iterator actual = cs.arg_begin();
+  Function::arg_iterator formal = callee->arg_begin();
+  for(unsigned argNum = 0; argNum < cs.arg_size(); ++argNum, ++actual)
+  {
+    if(formal == callee->arg_end())
+      break;  // vararg
+
+    if(isa<Constant>(actual))
+      benefit += calcHotConstantImpact(formal);
+    if(isa<AllocaInst>(actual))
+      benefit += calcHotAllocaImpact(formal);
+    ++formal;
+  }
+
+  return(benefit + stableArgBenefit());
+}
+
+
+//===================================================================//
+//                                                                   //
+//      VALUE PROFILE                                                //
+//                                                                   //
+//===================================================================//
+
+unsigned CPCallRecord::setValueProfile(CombinedValueProfile& cvp)
+{
+  _argStability.clear();
+  _valueDigest = 14695981039346656037ULL;
+
+  for(ValueSiteIndex site = 0, E = cvp.getSiteCount(); site != E; ++site)
+  {
+    uint64_t value = 0;
+    double stability = cvp.getStableValue(site, value);
+    if( (stability <= 0) || (stability < FDIValueStable) )
+      continue;
+
+    _argStability[cvp.getSiteCall(site)][cvp.getSiteArg(site)] = stability;
+
+    // digest of the stable sites, in site order (used in cache keys)
+    unsigned char bytes[sizeof(site) + sizeof(stability)];
+    memcpy(bytes, &site, sizeof(site));
+    memcpy(bytes + sizeof(site), &stability, sizeof(stability));
+    for(unsigned i = 0; i != sizeof(bytes); ++i)
+      _valueDigest = (_valueDigest ^ bytes[i]) * 1099511628211ULL;
+  }
+
+  return(_argStability.size());
+}
+
+
+// Savings of the stable (but not constant) arguments, weighted by
+// stability.  Only original call sites have value profiles.
+double CPCallRecord::stableArgBenefit()
+{
+  if(_argStability.empty())
+    return(0);
+
+  ArgStabilityMap::iterator site = _argStability.find(cs.getInstruction());
+  if(site == _argStability.end())
+    return(0);
+
+  Function* callee = cs.getCalledFunction();
+  bool hot = hasPathProfile(callee);
+
+  double benefit = 0;
+  Function::arg_iterator formal = callee->arg_begin();
+  for(unsigned argNum = 0; argNum < cs.arg_size(); ++argNum, ++formal)
+  {
+    if(formal == callee->arg_end())
+      break;  // vararg
+
+    std::map<unsigned,double>::iterator stable = site->second.find(argNum);
+    if( (stable == site->second.end()) 
+        || isa<Constant>(cs.getArgument(argNum)) )
+      continue;
+
+    double saved;
+    if(hot)
+      saved = calcHotConstantImpact(formal);
+    else
+    {
+      ArgImpact* impact = getArgImpact(callee, argNum);
+      saved = impact->instrRemIfConst  * inlineWeights::instr
+        + impact->branchRemIfConst * inlineWeights::branch
+        + impact->icallRemIfConst  * inlineWeights::icall;
+    }
+    benefit += stable->second * saved;
+  }
+
+  return(benefit);
+}
+
+
+// calcConstantImpact, but returns the heat-weighted dynamic savings
+// instead of static counts
+double CPCallRecord::calcHotConstantImpact(Value* V)
+{
+  double saved = 0;
+
+  for(Value::use_iterator UI = V->use_begin(), E = V->use_end(); UI != E;++UI)
+  {
+    User *U = *UI;
+    Instruction* I = dyn_cast<Instruction>(U);
+    if(I == NULL)
+      continue;
+    double heat = blockHeat(I->getParent());
+
+    if (isa<BranchInst>(U) || isa<SwitchInst>(U)) 
+    {
+      // the branch folds; only the path actually taken is left
+      saved += heat * inlineWeights::branch;
+    } 
+    else if (CallInst *CI = dyn_cast<CallInst>(U)) 
+    {
+      if (CI->getCalledValue() == V)
+        saved += heat * inlineWeights::icall;
+    } 
+    else if (InvokeInst *II = dyn_cast<InvokeInst>(U)) 
+    {
+      if (II->getCalledValue() == V)
+        saved += heat * inlineWeights::icall;
+    } 
+    else 
+    {
+      if (I->mayReadFromMemory() || I->mayHaveSideEffects() ||
+          isa<AllocaInst>(I))
+        continue;
+
+      bool AllOperandsConstant = true;
+      for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+        if (!isa<Constant>(I->getOperand(i)) && I->getOperand(i) != V) 
+        {
+          AllOperandsConstant = false;
+          break;
+        }
+
+      if (AllOperandsConstant) 
+      {
+        saved += heat * inlineWeights::instr;
+        saved += calcHotConstantImpact(I);
+      }
+    }
+  }
+
+  return(saved);
+}
+
+
+// calcAllocaImpact, weighted by heat
+double CPCallRecord::calcHotAllocaImpact(Value* V)
+{
+  double saved = 0;
+
+  if (!V->getType()->isPointerTy()) return(0);
+
+  for (Value::use_iterator UI = V->use_begin(), E = V->use_end(); UI != E;++UI)
+  {
+    Instruction *I = cast<Instruction>(*UI);
+    if (isa<LoadInst>(I) || isa<StoreInst>(I))
+      saved += blockHeat(I->getParent()) * inlineWeights::alloca;
+    else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(I)) 
+    {
+      if (GEP->hasAllConstantIndices())
+        saved += calcHotAllocaImpact(GEP);
+    } 
+    else if (BitCastInst *BCI = dyn_cast<BitCastInst>(I)) 
+      saved += calcHotAllocaImpact(BCI);
+  }
+
+  return(saved);
+}
+
+
 
 double CPCallRecord::nullMetric(CPCallRecord& rec, double benefit) 
 { 
@@ -20,3 +20,47 @@ using namespace llvm;
 void LLVMAddFDOInlinerPass(LLVMPassManagerRef PM) {
   unwrap(PM)->add(createFDOInlinerPass());
 }
+
+void LLVMAddFDOInlineSimPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOInlineSimPass());
+}
+
+void LLVMAddFDOValueSpecPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOValueSpecPass());
+}
+
+void LLVMAddFDOICallPromotionPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOICallPromotionPass());
+}
+
+void LLVMAddFDOBlockLayoutPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOBlockLayoutPass());
+}
+
+void LLVMAddFDOColdSplitPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOColdSplitPass());
+}
+
+void LLVMAddFDOFunctionOrderPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOFunctionOrderPass());
+}
+
+void LLVMAddFDOTripCountsPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOTripCountsPass());
+}
+
+void LLVMAddFDOSuperblocksPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOSuperblocksPass());
+}
+
+void LLVMAddFDOBranchWeightsPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOBranchWeightsPass());
+}
+
+void LLVMAddFDOBlockFreqsPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOBlockFreqsPass());
+}
+
+void LLVMAddFDOMultiversionPass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createFDOMultiversionPass());
+}
@@ -0,0 +1,185 @@
+//===- FDOBlockFreqs.cpp - Block frequencies from a combined profile ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Annotates every block of a module with its profiled executions per
+// call of the function, from a combined edge profile, for the register
+// allocator: the spill weights (CalcSpillWeights.cpp) count the uses
+// of a live interval by the frequency of their block instead of by
+// its loop depth (-spill-weight-profile).
+//
+// The annotation is metadata on the block's terminator, in thousandths
+// of an execution per call (the entry block weighs 1000):
+//
+//   br ..., !cp.freq !{i64 f}
+//
+// The frequency of a block is the sum of the weights of the edges into
+// it, chained up the edge dominator tree (see CPEdgeMap) with one
+// statistic of the per-run histograms.  By default that is a high
+// quantile (-FDBF-q), not the mean: a block that is hot in a few runs
+// keeps its values in registers even if it is cool on average.  A
+// negative -FDBF-q selects the mean.
+//
+// Inlining scales the frequencies of the inlined blocks (per call of
+// the callee) by that of the call site, and unrolling divides those of
+// the unrolled loop among its copies.  Blocks cloned by other passes
+// keep the frequency of their original, and blocks created by the code
+// generator take that of a neighbour.  A function with a block without
+// a frequency falls back to the loop depth as a whole.  The profile
+// must match the IR: run this before any other transformation.
+//
+// Example:
+//   opt -FDOBlockFreqs -FDBF-prof=edge.cp -FDBF-q=0.9 -O3 prog.bc -o o.bc
+//   llc o.bc -o prog.s
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOBlockFreqs"
+#include "llvm/Pass.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumBlocks, "Number of blocks annotated");
+
+static cl::opt<std::string>
+FDBFProfile("FDBF-prof", cl::init("edge.cp"),
+            cl::desc("FDO block frequencies combined edge-profile file name"));
+
+static cl::opt<double>
+FDBFQuantile("FDBF-q", cl::init(0.9),
+             cl::desc("FDO block frequencies: quantile of the per-run edge "
+                      "frequencies (negative: mean)"));
+
+
+namespace llvm {
+
+  class FDOBlockFreqs : public ModulePass {
+  public:
+    static char ID;
+    FDOBlockFreqs() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Block Frequencies";}
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+
+    bool runOnModule(Module& M);
+
+  protected:
+    double frequency(BasicBlock* BB, CPEdgeMap& map,
+                     std::vector<double>& weights, unsigned first);
+  };
+
+} // namespace llvm
+
+
+char FDOBlockFreqs::ID = 0;
+INITIALIZE_PASS(FDOBlockFreqs, "FDOBlockFreqs",
+                "FDO block frequencies from a combined edge profile",
+                false, false);
+
+ModulePass* llvm::createFDOBlockFreqsPass() { return new FDOBlockFreqs(); }
+
+
+bool FDOBlockFreqs::runOnModule(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDBFProfile);
+  if( !fact->hasEdgeCP() )
+  {
+    errs() << "FDOBlockFreqs: no edge profile found in file '"
+           << FDBFProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedEdgeProfile* edgeCP = fact->takeEdgeCP();
+  delete fact;
+
+  CPEdgeMap map(M, *edgeCP);
+  if( !map.valid() )
+  {
+    errs() << "FDOBlockFreqs: edge profile '" << FDBFProfile
+           << "' does not match the module\n";
+    delete edgeCP;
+    return(false);
+  }
+
+  CPEdgeMap::EdgeStat stat = CPEdgeMap::quantileStat;
+  if(FDBFQuantile < 0)
+    stat = CPEdgeMap::meanStat;
+
+  LLVMContext& Context = M.getContext();
+  unsigned kind = Context.getMDKindID("cp.freq");
+  std::vector<double> weights;
+  bool changed = false;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration() || !map.hasFunction(F)) continue;
+
+    map.chainWeights(F, stat, FDBFQuantile, 1.0, weights);
+    unsigned first = map.entryEdge(F);
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      double freq = frequency(BB, map, weights, first);
+      Value* op = ConstantInt::get(Type::getInt64Ty(Context),
+                                   (uint64_t)(freq * 1000 + 0.5));
+      BB->getTerminator()->setMetadata(kind, MDNode::get(Context, &op, 1));
+      NumBlocks++;
+      changed = true;
+
+      DEBUG(dbgs() << "  " << F->getName() << ":" << BB->getName()
+                   << " " << freq << "\n");
+    }
+  }
+
+  delete edgeCP;
+  errs() << "FDOBlockFreqs: " << NumBlocks << " blocks annotated\n";
+  return(changed);
+}
+
+
+// executions of BB per call: the weights of the edges into it
+double FDOBlockFreqs::frequency(BasicBlock* BB, CPEdgeMap& map,
+                                std::vector<double>& weights, unsigned first)
+{
+  double freq = 0;
+  if(BB == &BB->getParent()->getEntryBlock())
+    freq += weights[0];  // the entry edge
+
+  std::set<BasicBlock*> seen;  // a pred is listed once per edge
+  for(pred_iterator P = pred_begin(BB), PE = pred_end(BB); P != PE; ++P)
+  {
+    if( !seen.insert(*P).second ) continue;
+    TerminatorInst* TI = (*P)->getTerminator();
+    for(unsigned s = 0, count = TI->getNumSuccessors(); s != count; ++s)
+      if(TI->getSuccessor(s) == BB)
+        freq += weights[map.edge(*P, s) - first];
+  }
+  return(freq);
+}
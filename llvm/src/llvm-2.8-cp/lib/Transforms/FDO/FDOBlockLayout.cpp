@@ -0,0 +1,388 @@
+//===- FDOBlockLayout.cpp - Combined-profile basic block layout -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Basic block placement driven by a combined edge profile.  Like
+// -block-placement, blocks are placed depth first from the entry, each
+// block followed by its "best" unplaced successor, but the choice uses
+// the distribution of the branch over the profiled runs instead of one
+// count.
+//
+// The out-edges of a block share their edge dominator, so their
+// normalized frequencies have the same denominator in every run and can
+// be compared.  For each candidate edge e of block B, the pass computes
+//
+//   r(e) = product over the other out-edges s of B of P(X_s < X_e)
+//
+// (an estimate of the probability that e is the most frequent out-edge
+// of B in a run, treating the edges as independent) and places the
+// target of the edge with the largest r(e); the mean chained weight
+// breaks ties.  An edge that is slightly more frequent on average but
+// loses in most runs is thus not made the fall-through.  Blocks that
+// did not execute in any profiled run are moved to the end of the
+// function.
+//
+// -FDBL-eval=<llvmprof.out files> compares the taken branches (control
+// transfers to a block other than the next one) of the original
+// layout, a mean-count layout (as -block-placement with the mean
+// profile) and the combined-profile layout, on raw edge profiles of
+// held-out inputs (not used to build the combined profile).  The
+// layouts are computed before any block moves, since the profiles are
+// numbered by the original block order.  -FDBL-eval-only leaves the
+// module unchanged.
+//
+// Example:
+//   opt -FDOBlockLayout -FDBL-prof=edge.cp -FDBL-eval=run7.out,run8.out
+//       prog.bc -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOBlockLayout"
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Analysis/ProfileInfoLoader.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumMoved,  "Number of basic blocks moved by FDO layout");
+STATISTIC(NumCold,   "Number of never-executed blocks moved to the end");
+
+static cl::opt<std::string>
+FDBLProfile("FDBL-prof", cl::init("edge.cp"),
+            cl::desc("FDO block layout combined edge-profile file name"));
+
+static cl::list<std::string>
+FDBLEval("FDBL-eval", cl::CommaSeparated,
+         cl::desc("FDO block layout: raw edge profiles (llvmprof.out) of "
+                  "held-out runs to count taken branches on"));
+
+static cl::opt<bool>
+FDBLEvalOnly("FDBL-eval-only", cl::init(false),
+             cl::desc("FDO block layout: only compare the layouts, do not "
+                      "change the module"));
+
+
+namespace llvm {
+
+  class FDOBlockLayout : public ModulePass {
+  public:
+    static char ID;
+    FDOBlockLayout() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Basic Block Layout";}
+
+    bool runOnModule(Module& M);
+
+  protected:
+    typedef std::vector<BasicBlock*> Layout;
+    enum LayoutKind { LayoutOriginal, LayoutMean, LayoutCP, LayoutCount };
+
+    struct FunctionLayouts {
+      Function* F;
+      Layout layouts[LayoutCount];
+    };
+
+    void buildLayouts(Function* F, FunctionLayouts& fl);
+    void place(BasicBlock* BB, bool robust, std::set<BasicBlock*>& placed,
+               Layout& layout);
+    BasicBlock* bestSuccessor(BasicBlock* BB, bool robust,
+                              std::set<BasicBlock*>& placed);
+    double robustness(BasicBlock* BB, unsigned succ);
+
+    void evaluate(Module& M, std::vector<FunctionLayouts>& all);
+    static void countBranches(FunctionLayouts& fl, CPEdgeMap& map,
+                              const std::vector<unsigned>& counts,
+                              double taken[LayoutCount]);
+    static bool apply(const Layout& layout);
+
+    CPEdgeMap* _map;
+    std::vector<double> _weights;   // mean chained edge weights of F
+    unsigned _first;                // entry edge of F
+  };
+
+} // namespace llvm
+
+
+char FDOBlockLayout::ID = 0;
+INITIALIZE_PASS(FDOBlockLayout, "FDOBlockLayout",
+                "FDO basic block layout from a combined edge profile",
+                false, false);
+
+ModulePass* llvm::createFDOBlockLayoutPass() { return new FDOBlockLayout(); }
+
+
+bool FDOBlockLayout::runOnModule(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDBLProfile);
+  if( !fact->hasEdgeCP() )
+  {
+    errs() << "FDOBlockLayout: no edge profile found in file '"
+           << FDBLProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedEdgeProfile* edgeCP = fact->takeEdgeCP();
+  delete fact;
+
+  _map = new CPEdgeMap(M, *edgeCP);
+  if( !_map->valid() )
+  {
+    errs() << "FDOBlockLayout: edge profile '" << FDBLProfile
+           << "' does not match the module\n";
+    delete _map;
+    delete edgeCP;
+    return(false);
+  }
+
+  // all layouts first: the profiles are numbered by the current layout
+  std::vector<FunctionLayouts> all;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+    all.push_back(FunctionLayouts());
+    buildLayouts(F, all.back());
+  }
+
+  if(!FDBLEval.empty())
+    evaluate(M, all);
+
+  delete _map;
+  delete edgeCP;
+
+  if(FDBLEvalOnly)
+    return(false);
+
+  bool changed = false;
+  for(unsigned f = 0, E = all.size(); f != E; ++f)
+    changed |= apply(all[f].layouts[LayoutCP]);
+  return(changed);
+}
+
+
+void FDOBlockLayout::buildLayouts(Function* F, FunctionLayouts& fl)
+{
+  fl.F = F;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    fl.layouts[LayoutOriginal].push_back(BB);
+
+  _first = _map->entryEdge(F);
+  _map->chainWeights(F, CPEdgeMap::meanStat, 0, 1.0, _weights);
+
+  for(unsigned k = LayoutMean; k != LayoutCount; ++k)
+  {
+    std::set<BasicBlock*> placed;
+    Layout& layout = fl.layouts[k];
+    bool robust = (k == LayoutCP);
+
+    // never-executed blocks are not placed by the walk
+    if(robust)
+      for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+        if( (&*BB != &F->getEntryBlock()) && _map->neverExecuted(BB) )
+          placed.insert(BB);
+
+    place(&F->getEntryBlock(), robust, placed, layout);
+
+    // then the rest, in their original order
+    std::set<BasicBlock*> done(layout.begin(), layout.end());
+    for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+      if(!done.count(BB))
+      {
+        layout.push_back(BB);
+        if(robust) NumCold++;
+      }
+  }
+}
+
+
+// Place BB, then its unplaced successors, best first (as BlockPlacement)
+void FDOBlockLayout::place(BasicBlock* BB, bool robust,
+                           std::set<BasicBlock*>& placed, Layout& layout)
+{
+  placed.insert(BB);
+  layout.push_back(BB);
+
+  while(BasicBlock* next = bestSuccessor(BB, robust, placed))
+    place(next, robust, placed, layout);
+}
+
+
+BasicBlock* FDOBlockLayout::bestSuccessor(BasicBlock* BB, bool robust,
+                                          std::set<BasicBlock*>& placed)
+{
+  TerminatorInst* TI = BB->getTerminator();
+  BasicBlock* best = NULL;
+  double bestScore = -1, bestWeight = -1;
+
+  // the weight of a target is the sum over its (duplicate) edges
+  std::map<BasicBlock*, double> weight;
+  for(unsigned s = 0, E = TI->getNumSuccessors(); s != E; ++s)
+    weight[TI->getSuccessor(s)] += _weights[_map->edge(BB, s) - _first];
+
+  for(unsigned s = 0, E = TI->getNumSuccessors(); s != E; ++s)
+  {
+    BasicBlock* succ = TI->getSuccessor(s);
+    if(placed.count(succ))
+      continue;
+
+    double score = robust ? robustness(BB, s) : 0;
+    double w = weight[succ];
+    if( (score > bestScore) || ((score == bestScore) && (w > bestWeight)) )
+    {
+      best = succ;
+      bestScore = score;
+      bestWeight = w;
+    }
+  }
+
+  return(best);
+}
+
+
+// r(e): the probability that out-edge succ of BB is more frequent than
+// each of the other out-edges (to other blocks) in a run
+double FDOBlockLayout::robustness(BasicBlock* BB, unsigned succ)
+{
+  TerminatorInst* TI = BB->getTerminator();
+  CPHistogram& X = _map->histogram(_map->edge(BB, succ));
+
+  double r = 1;
+  for(unsigned s = 0, E = TI->getNumSuccessors(); s != E; ++s)
+  {
+    if(TI->getSuccessor(s) == TI->getSuccessor(succ))
+      continue;
+    r *= CPEdgeMap::probLess(_map->histogram(_map->edge(BB, s)), X);
+  }
+
+  DEBUG(dbgs() << "  " << BB->getName() << " -> "
+               << TI->getSuccessor(succ)->getName() << ": r = "
+               << format("%.3f", r) << "\n");
+  return(r);
+}
+
+
+void FDOBlockLayout::evaluate(Module& M, std::vector<FunctionLayouts>& all)
+{
+  static const char* names[LayoutCount] = { "original", "mean", "cp" };
+  double total[LayoutCount] = { 0, 0, 0 };
+  double totalBranches = 0;
+
+  errs() << "FDOBlockLayout: taken branches on held-out runs\n";
+  for(unsigned p = 0, PE = FDBLEval.size(); p != PE; ++p)
+  {
+    std::string file = FDBLEval[p];
+    ProfileInfoLoader PIL("FDOBlockLayout", file, M);
+    const std::vector<unsigned>& counts = PIL.getRawEdgeCounts();
+    if(counts.size() != _map->size())
+    {
+      errs() << "  " << file << ": no matching edge profile, skipped\n";
+      continue;
+    }
+
+    double taken[LayoutCount] = { 0, 0, 0 };
+    double branches = 0;
+    for(unsigned f = 0, E = all.size(); f != E; ++f)
+    {
+      countBranches(all[f], *_map, counts, taken);
+
+      // control transfers out of blocks (entry edge excluded)
+      unsigned first = _map->entryEdge(all[f].F);
+      for(unsigned e = first + 1, EE = first + _map->edgeCount(all[f].F);
+          e != EE; ++e)
+        if(counts[e] != ProfileInfoLoader::Uncounted)
+          branches += counts[e];
+    }
+
+    errs() << "  " << file << ": " << format("%.0f", branches)
+           << " transfers;";
+    for(unsigned k = 0; k != LayoutCount; ++k)
+    {
+      errs() << " " << names[k] << " " << format("%.0f", taken[k]);
+      total[k] += taken[k];
+    }
+    errs() << "\n";
+    totalBranches += branches;
+  }
+
+  errs() << "  total: " << format("%.0f", totalBranches) << " transfers;";
+  for(unsigned k = 0; k != LayoutCount; ++k)
+  {
+    errs() << " " << names[k] << " " << format("%.0f", total[k]);
+    if(totalBranches > 0)
+      errs() << format(" (%.2f%%)", 100 * total[k] / totalBranches);
+  }
+  errs() << "\n";
+}
+
+
+// Adds the executions of the edges that do not fall through to the next
+// block of each layout
+void FDOBlockLayout::countBranches(FunctionLayouts& fl, CPEdgeMap& map,
+                                   const std::vector<unsigned>& counts,
+                                   double taken[LayoutCount])
+{
+  for(unsigned k = 0; k != LayoutCount; ++k)
+  {
+    const Layout& layout = fl.layouts[k];
+    for(unsigned i = 0, E = layout.size(); i != E; ++i)
+    {
+      BasicBlock* BB = layout[i];
+      BasicBlock* next = (i + 1 != E) ? layout[i + 1] : NULL;
+      TerminatorInst* TI = BB->getTerminator();
+      for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+      {
+        unsigned c = counts[map.edge(BB, s)];
+        if( (c != ProfileInfoLoader::Uncounted)
+            && (TI->getSuccessor(s) != next) )
+          taken[k] += c;
+      }
+    }
+  }
+}
+
+
+bool FDOBlockLayout::apply(const Layout& layout)
+{
+  if(layout.empty())
+    return(false);
+
+  Function::BasicBlockListType& blocks =
+    layout[0]->getParent()->getBasicBlockList();
+  Function::iterator pos = blocks.begin();
+  unsigned moved = 0;
+  for(unsigned i = 0, E = layout.size(); i != E; ++i)
+  {
+    if(&*pos == layout[i])
+      ++pos;
+    else
+    {
+      blocks.splice(pos, blocks, layout[i]);
+      moved++;
+    }
+  }
+
+  NumMoved += moved;
+  return(moved != 0);
+}
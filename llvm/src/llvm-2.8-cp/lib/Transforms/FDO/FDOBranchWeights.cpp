@@ -0,0 +1,175 @@
+//===- FDOBranchWeights.cpp - Branch weights from a combined profile ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Annotates the switches of a module with the expected frequencies of
+// their cases, from a combined edge profile, for the code generator.
+// SelectionDAG lowering of switches tests the cases that take most of
+// the executions (-switch-peel-percent) ahead of the jump table or
+// search tree, and orders the compares of small case ranges by
+// frequency.
+//
+// The annotation is metadata on the switch: the weight of the default,
+// then each case value with its weight:
+//
+//   switch ..., !cp.weights !{i32 w0, i32 v1, i32 w1, i32 v2, i32 w2, ...}
+//
+// The weights are the mean executions of the edges per call of the
+// function (chained up the edge dominator tree, see CPEdgeMap), in
+// millionths of the switch's total.  Switches that never ran are not
+// annotated.  The cases are found by value, so a switch whose cases are
+// later removed, added or reordered keeps the weights of the others; a
+// new case has none.
+//
+// Conditional branches are not annotated: which successor falls
+// through is decided by the block order (-FDOBlockLayout), and the
+// lowering already branches around the next block.  The profile must
+// match the IR: run this before any other transformation.
+//
+// Example:
+//   opt -FDOBranchWeights -FDBW-prof=edge.cp -O3 prog.bc -o prog.opt.bc
+//   llc prog.opt.bc -o prog.s
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOBranchWeights"
+#include "llvm/Pass.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+#include "llvm/Transforms/FDO/FDOBranchWeights.h"
+
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumSwitches, "Number of switches annotated");
+
+static cl::opt<std::string>
+FDBWProfile("FDBW-prof", cl::init("edge.cp"),
+            cl::desc("FDO branch weights combined edge-profile file name"));
+
+
+namespace llvm {
+
+  class FDOBranchWeights : public ModulePass {
+  public:
+    static char ID;
+    FDOBranchWeights() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Branch Weights";}
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+
+    bool runOnModule(Module& M);
+  };
+
+} // namespace llvm
+
+
+char FDOBranchWeights::ID = 0;
+INITIALIZE_PASS(FDOBranchWeights, "FDOBranchWeights",
+                "FDO switch weights from a combined edge profile",
+                false, false);
+
+ModulePass* llvm::createFDOBranchWeightsPass() { return new FDOBranchWeights(); }
+
+
+bool FDOBranchWeights::runOnModule(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDBWProfile);
+  if( !fact->hasEdgeCP() )
+  {
+    errs() << "FDOBranchWeights: no edge profile found in file '"
+           << FDBWProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedEdgeProfile* edgeCP = fact->takeEdgeCP();
+  delete fact;
+
+  CPEdgeMap map(M, *edgeCP);
+  if( !map.valid() )
+  {
+    errs() << "FDOBranchWeights: edge profile '" << FDBWProfile
+           << "' does not match the module\n";
+    delete edgeCP;
+    return(false);
+  }
+
+  std::vector<double> weights;
+  bool changed = false;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration() || !map.hasFunction(F)) continue;
+
+    map.chainWeights(F, CPEdgeMap::meanStat, 0, 1.0, weights);
+    unsigned first = map.entryEdge(F);
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      if( !setBranchWeights(BB, map, weights, first) ) continue;
+      NumSwitches++;
+      changed = true;
+    }
+  }
+
+  delete edgeCP;
+  errs() << "FDOBranchWeights: " << NumSwitches << " switches annotated\n";
+  return(changed);
+}
+
+
+bool llvm::setBranchWeights(BasicBlock* BB, CPEdgeMap& map,
+                            const std::vector<double>& weights, unsigned first)
+{
+  SwitchInst* SI = dyn_cast<SwitchInst>(BB->getTerminator());
+  if(SI == NULL)
+    return(false);
+  unsigned count = SI->getNumSuccessors();
+
+  double total = 0;
+  for(unsigned s = 0; s != count; ++s)
+    total += weights[map.edge(BB, s) - first];
+  if(total <= 0)
+    return(false);  // never ran
+
+  // the default's weight, then each case by value
+  LLVMContext& Context = BB->getContext();
+  std::vector<Value*> ops;
+  for(unsigned s = 0; s != count; ++s)
+  {
+    if(s > 0)
+      ops.push_back(SI->getCaseValue(s));
+    double w = weights[map.edge(BB, s) - first] / total;
+    ops.push_back(ConstantInt::get(Type::getInt32Ty(Context),
+                                   (unsigned)(w * 1000000 + 0.5)));
+  }
+
+  MDNode* node = MDNode::get(Context, &ops[0], ops.size());
+  SI->setMetadata(Context.getMDKindID("cp.weights"), node);
+
+  DEBUG(dbgs() << "  " << BB->getParent()->getName() << ":"
+               << BB->getName() << " " << *node << "\n");
+  return(true);
+}
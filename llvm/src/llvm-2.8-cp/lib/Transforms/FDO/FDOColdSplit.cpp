@@ -0,0 +1,317 @@
+//===- FDOColdSplit.cpp - Hot/cold function splitting ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Moves code that is reliably cold over the profiled runs out of hot
+// functions, into separate (noinline) functions placed in a cold section
+// (-FDCS-section), so that the hot code is packed into fewer cache lines
+// and pages.
+//
+// A block is cold when, in every combined edge profile given with
+// -FDCS-prof (eg, one per class of inputs) that called its function:
+//
+//   - it ran in at most -FDCS-max-coverage of the runs that called its
+//     function (by the coverage of the edge histograms, ie, one minus
+//     the zero weight), and
+//   - its mean executions per call of the function are at most
+//     -FDCS-max-weight.
+//
+// With the defaults (0 and 0) only code that never ran in any run is
+// split: code that is merely cool on average, or that some inputs do
+// run, stays in place.  Functions that no profile called are left
+// alone (they are cold as a whole).
+//
+// Cold blocks are grouped into single-entry regions (a cold block whose
+// immediate dominator is not cold, and the cold blocks it dominates that
+// are entered only from within the region); regions of at least
+// -FDCS-min-size instructions are extracted with the CodeExtractor.
+//
+// The profiles must match the IR: the regions are found before any
+// extraction.
+//
+// Example:
+//   opt -FDOColdSplit -FDCS-prof=train.cp,ref.cp prog.bc -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOColdSplit"
+#include "llvm/Pass.h"
+#include "llvm/Attributes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+#include "llvm/Transforms/FDO/FDOColdSplit.h"
+#include "llvm/Transforms/Utils/FunctionUtils.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumColdBlocks,  "Number of blocks found cold in every profile");
+STATISTIC(NumRegions,     "Number of cold regions split out");
+STATISTIC(NumSplitBlocks, "Number of blocks split out");
+
+static cl::list<std::string>
+FDCSProfiles("FDCS-prof", cl::CommaSeparated,
+             cl::desc("FDO cold splitting: combined edge profiles (eg, one "
+                      "per input class); code must be cold in all of them"));
+
+static cl::opt<double>
+FDCSMaxCoverage("FDCS-max-coverage", cl::init(0.0),
+                cl::desc("FDO cold splitting: largest fraction of the "
+                         "function's runs in which a cold block ran"));
+
+static cl::opt<double>
+FDCSMaxWeight("FDCS-max-weight", cl::init(0.0),
+              cl::desc("FDO cold splitting: largest mean executions of a "
+                       "cold block per call of its function"));
+
+static cl::opt<unsigned>
+FDCSMinSize("FDCS-min-size", cl::init(8),
+            cl::desc("FDO cold splitting: smallest region (instructions) "
+                     "that is split out"));
+
+static cl::opt<std::string>
+FDCSSection("FDCS-section", cl::init(".text.unlikely"),
+            cl::desc("FDO cold splitting: section of the split functions "
+                     "(empty: the default section)"));
+
+
+namespace llvm {
+
+  class FDOColdSplit : public ModulePass {
+  public:
+    static char ID;
+    FDOColdSplit() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Hot/Cold Splitting";}
+
+    bool runOnModule(Module& M);
+
+  protected:
+    typedef std::set<BasicBlock*> BlockSet;
+
+    void findHotBlocks(Module& M, CPEdgeMap& map, BlockSet& hot,
+                       std::set<Function*>& called);
+  };
+
+} // namespace llvm
+
+
+char FDOColdSplit::ID = 0;
+INITIALIZE_PASS(FDOColdSplit, "FDOColdSplit",
+                "FDO hot/cold splitting from combined edge profiles",
+                false, false);
+
+ModulePass* llvm::createFDOColdSplitPass() { return new FDOColdSplit(); }
+
+
+bool FDOColdSplit::runOnModule(Module& M)
+{
+  if(FDCSProfiles.empty())
+  {
+    errs() << "FDOColdSplit: no edge profiles given (-FDCS-prof)\n";
+    return(false);
+  }
+
+  // cold: not hot in any profile, in a function that some profile called
+  BlockSet hot;
+  std::set<Function*> called;
+  for(unsigned p = 0, E = FDCSProfiles.size(); p != E; ++p)
+  {
+    CPFactory* fact = new CPFactory(M);
+    fact->buildProfiles(FDCSProfiles[p]);
+    if( !fact->hasEdgeCP() )
+    {
+      errs() << "FDOColdSplit: no edge profile found in file '"
+             << FDCSProfiles[p] << "'\n";
+      delete fact;
+      return(false);
+    }
+    CombinedEdgeProfile* edgeCP = fact->takeEdgeCP();
+    delete fact;
+
+    CPEdgeMap map(M, *edgeCP);
+    if( !map.valid() )
+    {
+      errs() << "FDOColdSplit: edge profile '" << FDCSProfiles[p]
+             << "' does not match the module\n";
+      delete edgeCP;
+      return(false);
+    }
+
+    findHotBlocks(M, map, hot, called);
+    delete edgeCP;
+  }
+
+  BlockSet cold;
+  for(std::set<Function*>::iterator F = called.begin(), E = called.end();
+      F != E; ++F)
+    for(Function::iterator BB = (*F)->begin(), BE = (*F)->end(); BB != BE;
+        ++BB)
+      if( (&*BB != &(*F)->getEntryBlock()) && !hot.count(BB) )
+        cold.insert(BB);
+  NumColdBlocks += cold.size();
+
+  std::vector<ColdRegion> regions;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if(!F->isDeclaration())
+      findColdRegions(F, cold, FDCSMinSize, regions);
+
+  bool changed = false;
+  for(unsigned r = 0, E = regions.size(); r != E; ++r)
+    if(extractColdRegion(regions[r], FDCSSection) != NULL)
+    {
+      NumRegions++;
+      NumSplitBlocks += regions[r].size();
+      changed = true;
+    }
+
+  errs() << "FDOColdSplit: " << cold.size() << " cold blocks, "
+         << NumRegions << " regions split\n";
+  return(changed);
+}
+
+
+// Adds the blocks that are not cold in this profile to hot, and the
+// functions it called to called
+void FDOColdSplit::findHotBlocks(Module& M, CPEdgeMap& map, BlockSet& hot,
+                                 std::set<Function*>& called)
+{
+  std::vector<double> weights;
+
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+    double entryCoverage = map.coverage(&F->getEntryBlock());
+    if(entryCoverage <= 0) continue;  // not called in these runs
+    called.insert(F);
+
+    map.chainWeights(F, CPEdgeMap::meanStat, 0, 1.0, weights);
+    unsigned first = map.entryEdge(F);
+
+    // mean executions per call: the sum of the incoming edge weights
+    std::map<BasicBlock*, double> blockWeight;
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      TerminatorInst* TI = BB->getTerminator();
+      for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+        blockWeight[TI->getSuccessor(s)] += weights[map.edge(BB, s) - first];
+    }
+
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    {
+      double coverage = map.coverage(BB) / entryCoverage;
+      if( (coverage > FDCSMaxCoverage) || (blockWeight[BB] > FDCSMaxWeight) )
+        hot.insert(BB);
+    }
+  }
+}
+
+
+// The regions and their extraction are shared with the partial inlining
+// of the FDO inliner (see FDOColdSplit.h)
+void llvm::findColdRegions(Function* F, const std::set<BasicBlock*>& cold,
+                           unsigned minSize, std::vector<ColdRegion>& regions)
+{
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+  {
+    BasicBlock* header = BB;
+    if(!cold.count(header)) continue;
+    DomTreeNode* node = DT.getNode(header);
+    if(node == NULL) continue;  // unreachable
+    if(node->getIDom() && cold.count(node->getIDom()->getBlock()))
+      continue;  // not a region header
+
+    // the cold blocks dominated by the header...
+    std::set<BasicBlock*> members;
+    std::vector<DomTreeNode*> work(1, node);
+    while(!work.empty())
+    {
+      DomTreeNode* N = work.back();
+      work.pop_back();
+      members.insert(N->getBlock());
+      for(DomTreeNode::iterator C = N->begin(), CE = N->end(); C != CE; ++C)
+        if(cold.count((*C)->getBlock()))
+          work.push_back(*C);
+    }
+
+    // ... that are only entered from within the region
+    bool shrunk = true;
+    while(shrunk)
+    {
+      shrunk = false;
+      for(std::set<BasicBlock*>::iterator M = members.begin(),
+          ME = members.end(); M != ME; ++M)
+      {
+        if(*M == header) continue;
+        for(pred_iterator P = pred_begin(*M), PE = pred_end(*M); P != PE; ++P)
+          if(!members.count(*P))
+          {
+            members.erase(M);
+            shrunk = true;
+            break;
+          }
+        if(shrunk) break;
+      }
+    }
+
+    // the header first, as the CodeExtractor expects
+    ColdRegion region(1, header);
+    unsigned size = header->size();
+    for(Function::iterator R = F->begin(); R != E; ++R)
+      if( (&*R != header) && members.count(R) )
+      {
+        region.push_back(R);
+        size += R->size();
+      }
+
+    DEBUG(dbgs() << "  " << F->getName() << ": region at "
+                 << header->getName() << ", " << region.size()
+                 << " blocks, " << size << " instructions\n");
+    if(size >= minSize)
+      regions.push_back(region);
+  }
+}
+
+
+Function* llvm::extractColdRegion(ColdRegion& region,
+                                  const std::string& section)
+{
+  Function* F = region[0]->getParent();
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+
+  Function* split = ExtractCodeRegion(DT, region);
+  if(split == NULL)
+    return(NULL);  // not eligible (allocas, va_start, ...)
+
+  split->setName(F->getName() + ".cold");
+  split->addFnAttr(Attribute::NoInline);
+  split->addFnAttr(Attribute::OptimizeForSize);
+  if(!section.empty())
+    split->setSection(section);
+
+  return(split);
+}
@@ -0,0 +1,178 @@
+//===- FDOFunctionOrder.cpp - Call-profile-driven function layout ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Lays out the functions of a module in the order computed by
+// CPFunctionOrder from a combined call profile (call-chain clustering,
+// see CPFunctionOrder.h):
+//
+//   - the module's function list is reordered, so the code generator
+//     (AsmPrinter) emits the functions in that order;
+//   - with -FDFO-sections (ELF only: .text.<name> is not a Mach-O
+//     section), each function without a section is put in its own, so
+//     the linker can place it.  Functions that may be overridden or
+//     are linkonce or weak keep theirs, so the linker still merges
+//     their copies;
+//   - -FDFO-order-file writes the order for the linker: section names
+//     for gold's --section-ordering-file (also through the gold plugin,
+//     which keeps the sections), or symbol names with
+//     -FDFO-order-symbols.
+//
+// The call profile must match the IR: run this first, on the profiled
+// program.  The new order renumbers the functions, so later passes in
+// the same run can only use profiles that are matched by function name
+// (the edge and call profiles' CFG checksums, see CFGChecksum.h).  The
+// order can also be computed without changing the module with
+// llvm-cporder.
+//
+// Example:
+//   opt -FDOFunctionOrder -FDFO-prof=call.cp -FDFO-sections
+//       -FDFO-order-file=prog.order prog.bc -o prog.opt.bc
+//   llc prog.opt.bc -o prog.s
+//   gcc -c prog.s && ld.gold --section-ordering-file prog.order ...
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOFunctionOrder"
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPFunctionOrder.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumOrdered,  "Number of functions ordered by the call profile");
+STATISTIC(NumSections, "Number of functions put in their own section");
+
+static cl::opt<std::string>
+FDFOProfile("FDFO-prof", cl::init("call.cp"),
+            cl::desc("FDO function order combined call-profile file name"));
+
+static cl::opt<double>
+FDFOQuantile("FDFO-q", cl::init(0.5),
+             cl::desc("FDO function order: quantile of the call "
+                      "frequency distributions"));
+
+static cl::opt<unsigned>
+FDFOMaxCluster("FDFO-max-cluster", cl::init(1024),
+               cl::desc("FDO function order: largest cluster of functions "
+                        "(instructions)"));
+
+static cl::opt<bool>
+FDFOSections("FDFO-sections", cl::init(false),
+             cl::desc("FDO function order: put each function in its own "
+                      "section"));
+
+static cl::opt<std::string>
+FDFOOrderFile("FDFO-order-file", cl::init(""),
+              cl::desc("FDO function order: write the link order to this "
+                       "file"));
+
+static cl::opt<bool>
+FDFOOrderSymbols("FDFO-order-symbols", cl::init(false),
+                 cl::desc("FDO function order: write symbol names instead "
+                          "of section names to the order file"));
+
+
+namespace llvm {
+
+  class FDOFunctionOrder : public ModulePass {
+  public:
+    static char ID;
+    FDOFunctionOrder() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Function Ordering";}
+
+    bool runOnModule(Module& M);
+  };
+
+} // namespace llvm
+
+
+char FDOFunctionOrder::ID = 0;
+INITIALIZE_PASS(FDOFunctionOrder, "FDOFunctionOrder",
+                "FDO function layout from a combined call profile",
+                false, false);
+
+ModulePass* llvm::createFDOFunctionOrderPass() { return new FDOFunctionOrder(); }
+
+
+bool FDOFunctionOrder::runOnModule(Module& M)
+{
+  // the call profile's structure maps may be of an earlier module
+  CombinedCallProfile::freeStaticData();
+
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDFOProfile);
+  if( !fact->hasCallCP() )
+  {
+    errs() << "FDOFunctionOrder: no call profile found in file '"
+           << FDFOProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedCallProfile* callCP = fact->takeCallCP();
+  delete fact;
+
+  CPFunctionOrder order(M, *callCP, FDFOQuantile, FDFOMaxCluster);
+  delete callCP;
+  CombinedCallProfile::freeStaticData();
+
+  const CPFunctionOrder::Order& functions = order.getOrder();
+
+  // the defined functions, in order, after the declarations
+  std::vector<Function*> before;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    before.push_back(F);
+  Module::FunctionListType& list = M.getFunctionList();
+  for(unsigned f = 0, E = functions.size(); f != E; ++f)
+  {
+    list.splice(list.end(), list, functions[f]);
+    NumOrdered++;
+  }
+
+  bool changed = false;
+  Module::iterator F = M.begin();
+  for(unsigned f = 0, E = before.size(); !changed && (f != E); ++f, ++F)
+    changed = (before[f] != &*F);
+
+  if(FDFOSections)
+    for(unsigned f = 0, E = functions.size(); f != E; ++f)
+    {
+      Function* fn = functions[f];
+      // an explicit section would take a function out of its COMDAT
+      if( fn->hasSection() || fn->mayBeOverridden()
+          || fn->hasLinkOnceLinkage() || fn->hasWeakLinkage() )
+        continue;
+      fn->setSection(CPFunctionOrder::getSectionName(fn));
+      NumSections++;
+      changed = true;
+    }
+
+  if(!FDFOOrderFile.empty())
+  {
+    std::string error;
+    raw_fd_ostream out(FDFOOrderFile.c_str(), error);
+    if(!error.empty())
+      errs() << "FDOFunctionOrder: " << error << "\n";
+    else
+      order.writeOrderFile(out, !FDFOOrderSymbols);
+  }
+
+  errs() << "FDOFunctionOrder: " << functions.size() << " functions ordered\n";
+  return(changed);
+}
@@ -0,0 +1,203 @@
+//===- FDOICallPromotion.cpp - Indirect call promotion from a profile -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Promotes indirect calls to guarded direct calls of their stable
+// targets, using a combined indirect call profile
+// (-insert-icall-profiling, llvm-cprof).  For each target whose
+// stability (expected fraction of the site's calls that went to it)
+// is at least -FDICP-stable, most stable first and up to
+// -FDICP-max-targets per site, the call is guarded:
+//
+//   head:     %g = icmp eq %fp, @f
+//             br %g, label %direct, label %indirect
+//   direct:   %r.direct = call @f(...)
+//             br label %join
+//   indirect: %r = call %fp(...)
+//             br label %join
+//   join:     phi [%r.direct, %direct], [%r, %indirect]
+//
+// The next target guards the remaining indirect call the same way.
+// Targets whose type differs from the called pointer's (calls through
+// a cast) are not promoted, nor are invokes.
+//
+// The direct calls are FDO inlining candidates.  The icall profile must
+// match the IR: run this before any other transformation, then call
+// profile the promoted program (the call profile is keyed by the
+// blocks of the profiled IR) for the FDO inliner.
+//
+// Example:
+//   opt -FDOICallPromotion -FDICP-prof=icall.cp prog.bc -o prog.icp.bc
+//   (profile prog.icp.bc with -insert-call-profiling, llvm-cprof)
+//   opt -FDOInliner -FDI-cprof=call.cp prog.icp.bc -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOICallPromotion"
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumPromotedSites, "Number of indirect call sites promoted");
+STATISTIC(NumPromoted, "Number of guarded direct calls inserted");
+
+static cl::opt<std::string>
+FDICPProfile("FDICP-prof", cl::init("icall.cp"),
+             cl::desc("FDO indirect call promotion combined icall-profile "
+                      "file name"));
+
+static cl::opt<double>
+FDICPStable("FDICP-stable", cl::init(0.4),
+            cl::desc("FDO indirect call promotion: minimum stability of a "
+                     "promoted target"));
+
+static cl::opt<unsigned>
+FDICPMaxTargets("FDICP-max-targets", cl::init(2),
+                cl::desc("FDO indirect call promotion: most targets "
+                         "promoted per call site"));
+
+
+namespace llvm {
+
+  class FDOICallPromotion : public ModulePass {
+  public:
+    static char ID;
+    FDOICallPromotion() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Indirect Call Promotion";}
+
+    bool runOnModule(Module& M);
+
+  protected:
+    typedef std::vector<ICallTarget> TargetVec;
+
+    void promote(CallInst* call, const ICallTarget& target);
+  };
+
+} // namespace llvm
+
+
+char FDOICallPromotion::ID = 0;
+INITIALIZE_PASS(FDOICallPromotion, "FDOICallPromotion",
+                "FDO promotion of indirect calls to their stable targets",
+                false, false);
+
+ModulePass* llvm::createFDOICallPromotionPass()
+{ return new FDOICallPromotion(); }
+
+
+bool FDOICallPromotion::runOnModule(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDICPProfile);
+  if( !fact->hasICallCP() )
+  {
+    errs() << "FDOICallPromotion: no icall profile found in file '"
+           << FDICPProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedICallProfile* icallCP = fact->takeICallCP();
+  delete fact;
+
+  // pick the targets of every site before changing the IR
+  std::vector<std::pair<CallInst*,TargetVec> > sites;
+  for(ValueSiteIndex s = 0, E = icallCP->getSiteCount(); s != E; ++s)
+  {
+    CallInst* call = dyn_cast<CallInst>(icallCP->getSiteCall(s));
+    if(call == NULL)
+      continue;  // invokes are not promoted
+
+    TargetVec stable, targets;
+    icallCP->getStableTargets(s, stable);
+    const Type* calleeType = call->getCalledValue()->getType();
+    for(TargetVec::iterator T = stable.begin(), TE = stable.end();
+        (T != TE) && (targets.size() < FDICPMaxTargets); ++T)
+      if( (T->first >= FDICPStable) && (T->second->getType() == calleeType) )
+        targets.push_back(*T);
+
+    if( !targets.empty() )
+      sites.push_back(std::make_pair(call, targets));
+  }
+  delete icallCP;
+
+  errs() << "FDOICallPromotion: " << sites.size() << " indirect calls with "
+         << "stable targets (>= " << format("%.2f", (double)FDICPStable)
+         << ")\n";
+
+  for(unsigned i = 0, E = sites.size(); i != E; ++i)
+  {
+    for(TargetVec::iterator T = sites[i].second.begin(),
+          TE = sites[i].second.end(); T != TE; ++T)
+      promote(sites[i].first, *T);
+    NumPromotedSites++;
+  }
+
+  return(!sites.empty());
+}
+
+
+// Guard call with a direct call of target.  call stays the fallback,
+// in its own block, so the next target can guard it in turn.
+void FDOICallPromotion::promote(CallInst* call, const ICallTarget& target)
+{
+  Function* callee = target.second;
+  Value* pointer = call->getCalledValue();
+  LLVMContext& Context = call->getContext();
+
+  errs() << "  " << call->getParent()->getParent()->getName() << " -> "
+         << callee->getName() << " (" << format("%.2f", target.first)
+         << ")\n";
+
+  // head: ... ; indirect: call ; join: rest of the block
+  BasicBlock* head = call->getParent();
+  BasicBlock* indirect = head->splitBasicBlock(call, "icp.indirect");
+  BasicBlock::iterator next = call;
+  ++next;
+  BasicBlock* join = indirect->splitBasicBlock(next, "icp.join");
+
+  // direct: the call of the target
+  Function* F = head->getParent();
+  BasicBlock* direct = BasicBlock::Create(Context, "icp.direct", F,
+                                          indirect);
+  CallInst* directCall = cast<CallInst>(call->clone());
+  directCall->setCalledFunction(callee);
+  direct->getInstList().push_back(directCall);
+  BranchInst::Create(join, direct);
+
+  // guard
+  head->getTerminator()->eraseFromParent();
+  ICmpInst* guard = new ICmpInst(*head, ICmpInst::ICMP_EQ, pointer, callee,
+                                 "icp.guard");
+  BranchInst::Create(direct, indirect, guard, head);
+
+  // merge the results
+  if(!call->getType()->isVoidTy())
+  {
+    PHINode* phi = PHINode::Create(call->getType(), "icp.ret",
+                                   join->begin());
+    call->replaceAllUsesWith(phi);
+    phi->addIncoming(directCall, direct);
+    phi->addIncoming(call, indirect);
+  }
+
+  NumPromoted++;
+}
@@ -0,0 +1,345 @@
+//===- FDOInlineCache.cpp - Persistent FDO inlining decisions -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// See FDOInlineCache.h
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Transforms/FDO/FDOInlineCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace llvm;
+
+// bump when the file format, the hashing, or inlineWeights change
+static const unsigned CacheVersion = 1;
+
+
+namespace {
+
+  // 64-bit FNV-1a
+  const uint64_t FNVOffset = 14695981039346656037ULL;
+  const uint64_t FNVPrime  = 1099511628211ULL;
+
+  inline void hashBytes(uint64_t& h, const void* data, unsigned len)
+  {
+    const unsigned char* p = (const unsigned char*)data;
+    for(unsigned i = 0; i != len; ++i)
+    {
+      h ^= p[i];
+      h *= FNVPrime;
+    }
+  }
+
+  inline void hashInt(uint64_t& h, uint64_t v)
+  {
+    hashBytes(h, &v, sizeof(v));
+  }
+
+  inline void hashDouble(uint64_t& h, double v)
+  {
+    hashBytes(h, &v, sizeof(v));
+  }
+
+  inline void hashString(uint64_t& h, StringRef s)
+  {
+    hashInt(h, s.size());
+    hashBytes(h, s.data(), s.size());
+  }
+
+  void hashType(uint64_t& h, const Type* T)
+  {
+    hashInt(h, T->getTypeID());
+    if(const IntegerType* IT = dyn_cast<IntegerType>(T))
+      hashInt(h, IT->getBitWidth());
+  }
+
+} // namespace
+
+
+bool InlineCacheKey::operator<(const InlineCacheKey& rhs) const
+{
+  if(caller != rhs.caller) return(caller < rhs.caller);
+  if(callee != rhs.callee) return(callee < rhs.callee);
+  if(ordinal != rhs.ordinal) return(ordinal < rhs.ordinal);
+  if(digest != rhs.digest) return(digest < rhs.digest);
+  return(metric < rhs.metric);
+}
+
+
+FDOInlineCache::FDOInlineCache() : _hits(0), _misses(0)
+{
+}
+
+
+// Structural hash: name, signature, and every instruction's opcode,
+// type and operands.  Operands are hashed by position (instructions,
+// blocks, arguments), value (integer constants) or name (globals), so
+// the hash is stable between compilations.
+uint64_t FDOInlineCache::functionHash(Function* F)
+{
+  std::map<Function*, uint64_t>::iterator cached = _funcHash.find(F);
+  if(cached != _funcHash.end())
+    return(cached->second);
+
+  uint64_t h = FNVOffset;
+  hashString(h, F->getName());
+  hashInt(h, F->arg_size());
+  hashInt(h, F->isVarArg());
+
+  // number the blocks and instructions first (phis use values defined
+  // later)
+  std::map<const Value*, unsigned> ordinal;
+  unsigned next = 0;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+  {
+    ordinal[BB] = next++;
+    for(BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      ordinal[I] = next++;
+  }
+  unsigned argNo = 0;
+  for(Function::arg_iterator A = F->arg_begin(), E = F->arg_end();
+      A != E; ++A, ++argNo)
+    ordinal[A] = argNo;
+
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+  {
+    hashInt(h, BB->size());
+    for(BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+    {
+      hashInt(h, I->getOpcode());
+      hashType(h, I->getType());
+      hashInt(h, I->getNumOperands());
+
+      for(unsigned o = 0, OE = I->getNumOperands(); o != OE; ++o)
+      {
+        Value* V = I->getOperand(o);
+        if(V == NULL)
+        {
+          hashInt(h, 0);
+          continue;
+        }
+
+        hashInt(h, V->getValueID());
+        if(GlobalValue* GV = dyn_cast<GlobalValue>(V))
+          hashString(h, GV->getName());
+        else if(ConstantInt* CI = dyn_cast<ConstantInt>(V))
+          hashInt(h, CI->getValue().getLimitedValue());
+        else if(ConstantFP* CF = dyn_cast<ConstantFP>(V))
+          hashInt(h, CF->getValueAPF().bitcastToAPInt().getLimitedValue());
+        else
+        {
+          std::map<const Value*, unsigned>::iterator ord = ordinal.find(V);
+          if(ord != ordinal.end())
+            hashInt(h, ord->second);
+          else
+            hashType(h, V->getType());  // other constants
+        }
+      }
+    }
+  }
+
+  _funcHash[F] = h;
+  return(h);
+}
+
+
+uint64_t FDOInlineCache::histogramDigest(const CPHistogram& hist)
+{
+  uint64_t h = FNVOffset;
+  unsigned bins = hist.bins();
+  hashInt(h, bins);
+  hashDouble(h, hist.totalWeight());
+  hashDouble(h, hist.zeroWeight());
+  if(bins == 0)
+    return(h);
+
+  hashDouble(h, hist.getBinLowerLimit(0));
+  hashDouble(h, hist.getBinUpperLimit(bins-1));
+  for(unsigned b = 0; b != bins; ++b)
+    hashDouble(h, hist.getBinWeight(b));
+  return(h);
+}
+
+
+uint64_t FDOInlineCache::metricKey(const std::string& metric,
+                                   const std::vector<double>& qs)
+{
+  uint64_t h = FNVOffset;
+  hashInt(h, CacheVersion);
+  hashString(h, metric);
+  hashInt(h, qs.size());
+  for(unsigned i = 0, E = qs.size(); i != E; ++i)
+    hashDouble(h, qs[i]);
+  return(h);
+}
+
+
+bool FDOInlineCache::replay(const InlineCacheKey& key, CPCallRecord& rec)
+{
+  _byID[rec.ID] = key;
+
+  EntryMap::iterator prev = _previous.find(key);
+  if(prev == _previous.end())
+  {
+    _misses++;
+    return(false);
+  }
+
+  const InlineCacheEntry& entry = prev->second;
+  rec.mval = entry.mval;
+  rec.mraw = entry.mraw;
+  rec.mbenefit = entry.mbenefit;
+  rec.totalImpact = entry.totalImpact;
+
+  InlineCacheEntry& cur = _current[key];
+  cur = entry;
+  cur.inlined = false;
+
+  _hits++;
+  return(true);
+}
+
+
+void FDOInlineCache::update(const CPCallRecord& rec)
+{
+  std::map<unsigned, InlineCacheKey>::iterator key = _byID.find(rec.ID);
+  if(key == _byID.end())
+    return;
+
+  InlineCacheEntry& cur = _current[key->second];
+  cur.mval = rec.mval;
+  cur.mraw = rec.mraw;
+  cur.mbenefit = rec.mbenefit;
+  cur.totalImpact = rec.totalImpact;
+  cur.inlined = false;
+}
+
+
+void FDOInlineCache::markInlined(unsigned recID)
+{
+  std::map<unsigned, InlineCacheKey>::iterator key = _byID.find(recID);
+  if(key == _byID.end())
+    return;  // not an original call site
+
+  EntryMap::iterator cur = _current.find(key->second);
+  if(cur != _current.end())
+    cur->second.inlined = true;
+}
+
+
+unsigned FDOInlineCache::changedDecisions() const
+{
+  unsigned changed = 0;
+  for(EntryMap::const_iterator cur = _current.begin(), E = _current.end();
+      cur != E; ++cur)
+  {
+    EntryMap::const_iterator prev = _previous.find(cur->first);
+    if( (prev != _previous.end())
+        && (prev->second.inlined != cur->second.inlined) )
+      changed++;
+  }
+  return(changed);
+}
+
+
+bool FDOInlineCache::load(const std::string& filename)
+{
+  _previous.clear();
+
+  FILE* f = fopen(filename.c_str(), "r");
+  if(f == NULL)
+    return(true);  // no cache yet
+
+  unsigned version = 0;
+  if( (fscanf(f, "FDI-cache %u\n", &version) != 1)
+      || (version != CacheVersion) )
+  {
+    errs() << "FDOInlineCache: ignoring '" << filename
+           << "' (unknown version)\n";
+    fclose(f);
+    return(false);
+  }
+
+  while(true)
+  {
+    unsigned long long caller, callee, digest, metric;
+    InlineCacheKey key;
+    InlineCacheEntry entry;
+    char decision;
+
+    int n = fscanf(f, "%llx %llx %u %llx %llx %lg %lg %lg %u %u %u %u %c\n",
+                   &caller, &callee, &key.ordinal, &digest, &metric,
+                   &entry.mval, &entry.mraw, &entry.mbenefit,
+                   &entry.totalImpact.instrRemIfConst,
+                   &entry.totalImpact.branchRemIfConst,
+                   &entry.totalImpact.icallRemIfConst,
+                   &entry.totalImpact.instrRemIfAlloca, &decision);
+    if(n == EOF)
+      break;
+    if(n != 13)
+    {
+      errs() << "FDOInlineCache: ignoring '" << filename
+             << "' (malformed entry " << _previous.size()+1 << ")\n";
+      _previous.clear();
+      fclose(f);
+      return(false);
+    }
+
+    key.caller = caller;
+    key.callee = callee;
+    key.digest = digest;
+    key.metric = metric;
+    entry.inlined = (decision == 'I');
+    _previous[key] = entry;
+  }
+
+  fclose(f);
+  return(true);
+}
+
+
+bool FDOInlineCache::save(const std::string& filename) const
+{
+  FILE* f = fopen(filename.c_str(), "w");
+  if(f == NULL)
+  {
+    errs() << "FDOInlineCache: could not write '" << filename << "'\n";
+    return(false);
+  }
+
+  fprintf(f, "FDI-cache %u\n", CacheVersion);
+  for(EntryMap::const_iterator i = _current.begin(), E = _current.end();
+      i != E; ++i)
+  {
+    const InlineCacheKey& key = i->first;
+    const InlineCacheEntry& entry = i->second;
+    fprintf(f, "%016llx %016llx %u %016llx %016llx %.17g %.17g %.17g "
+            "%u %u %u %u %c\n",
+            (unsigned long long)key.caller, (unsigned long long)key.callee,
+            key.ordinal, (unsigned long long)key.digest,
+            (unsigned long long)key.metric,
+            entry.mval, entry.mraw, entry.mbenefit,
+            entry.totalImpact.instrRemIfConst,
+            entry.totalImpact.branchRemIfConst,
+            entry.totalImpact.icallRemIfConst,
+            entry.totalImpact.instrRemIfAlloca,
+            entry.inlined ? 'I' : 'N');
+  }
+
+  fclose(f);
+  return(true);
+}
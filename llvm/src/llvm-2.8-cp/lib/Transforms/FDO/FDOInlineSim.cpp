@@ -0,0 +1,622 @@
+//===- FDOInlineSim.cpp - Dry-run model of the FDO inliner ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Predicts the inline set, code growth and dynamic-call savings of the
+// FDO inliner for a sweep of -FDI-metric/-FDI-Q/-FDI-budget/-FDI-depth
+// settings, without mutating the IR.  See FDOInlineSim.h for the model.
+//
+// Example:
+//   opt -FDOInlineSim -FDI-cprof=call.cp -FDIS-metrics=mean,QPLinear
+//       -FDIS-Q=50,25:75 -FDIS-budgets=1,500,2000 -FDIS-depths=0,4
+//       -FDIS-threads=8 prog.bc -o /dev/null
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOInlineSim"
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Transforms/FDO.h"
+
+#include "llvm/Transforms/FDO/CPCallRecord.h"
+#include "llvm/Transforms/FDO/FDOInlinerPass.h"
+#include "llvm/Transforms/FDO/FDOInlineSim.h"
+#include "llvm/Transforms/FDO/FDOThreads.h"
+
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <queue>
+
+using namespace llvm;
+
+static cl::list<std::string>
+FDISMetrics("FDIS-metrics", cl::CommaSeparated,
+            cl::desc("FDO inlining simulator: metrics to sweep "
+                     "(default: -FDI-metric)"));
+
+static cl::list<std::string>
+FDISQSets("FDIS-Q", cl::CommaSeparated,
+          cl::desc("FDO inlining simulator: quantile sets to sweep; "
+                   "separate values within a set with ':' (default: -FDI-Q)"));
+
+static cl::list<unsigned>
+FDISBudgets("FDIS-budgets", cl::CommaSeparated,
+            cl::desc("FDO inlining simulator: budgets to sweep "
+                     "(default: -FDI-budget)"));
+
+static cl::list<unsigned>
+FDISDepths("FDIS-depths", cl::CommaSeparated,
+           cl::desc("FDO inlining simulator: depths to sweep "
+                    "(default: -FDI-depth)"));
+
+static cl::opt<unsigned>
+FDISThreads("FDIS-threads", cl::init(4),
+            cl::desc("FDO inlining simulator: worker threads"));
+
+static cl::opt<unsigned>
+FDISMaxInlines("FDIS-max-inlines", cl::init(1000000),
+               cl::desc("FDO inlining simulator: give up on a "
+                        "configuration after this many inlines"));
+
+static cl::opt<std::string>
+FDISOut("FDIS-out", cl::init("-"),
+        cl::desc("FDO inlining simulator: output table ('-' for stdout)"));
+
+
+char FDOInlineSim::ID = 0;
+INITIALIZE_PASS(FDOInlineSim, "FDOInlineSim",
+                "FDO Inliner dry-run simulation", false, true);
+
+ModulePass* llvm::createFDOInlineSimPass() { return new FDOInlineSim(); }
+
+
+FDOInlineSim::FDOInlineSim() : ModulePass(ID), _totalSize(0)
+{
+}
+
+
+void FDOInlineSim::getAnalysisUsage(AnalysisUsage &Info) const
+{
+  Info.setPreservesAll();
+}
+
+
+namespace {
+
+  // A call site during a simulation: either an original site, or a
+  // copy made when its containing function was inlined
+  struct LiveSite {
+    unsigned caller;
+    unsigned callee;
+    int less;
+    bool never;
+    bool ignored;
+    bool dead;
+    unsigned depth;
+    unsigned version;   // bumped on re-evaluation (lazy queue deletion)
+    double mraw;
+    double benefit;
+    double freq;
+    double mean;
+  };
+
+  // <mval, <site, version>>
+  typedef std::pair<double, std::pair<unsigned,unsigned> > QueueEntry;
+  typedef std::priority_queue<QueueEntry> SimQueue;
+
+  // same cost normalization as CPCallRecord::evalMetric
+  double simMval(const LiveSite& s, int calleeSize)
+  {
+    int cost = calleeSize - s.less;
+    if( (cost >= 0) && (s.benefit <= 0) )
+      return(-1);
+
+    double m = s.mraw;
+    if(cost > 0)
+      m = m / cost;
+    else if(cost < 0)
+      m = m * (-cost);
+    return(m);
+  }
+
+  bool isStaticMetric(const std::string& name)
+  {
+    return( (name == "null") || (name == "never")
+            || (name == "anti") || (name == "benefit") );
+  }
+
+  // "25:75" --> {25, 75}
+  void parseQSet(const std::string& str, std::vector<double>& qs)
+  {
+    qs.clear();
+    std::string::size_type start = 0;
+    while(start <= str.size())
+    {
+      std::string::size_type end = str.find(':', start);
+      if(end == std::string::npos)
+        end = str.size();
+      std::string val = str.substr(start, end-start);
+      if(!val.empty())
+        qs.push_back(strtod(val.c_str(), NULL));
+      start = end+1;
+    }
+  }
+
+} // namespace
+
+
+void FDOInlineSim::simulate(const std::vector<SimFunc>& funcs,
+                            const std::vector<SimSite>& sites,
+                            const SimMetric& metric, const SimConfig& config,
+                            SimResult& result)
+{
+  unsigned numFuncs = funcs.size();
+
+  result.inlined = 0;
+  result.tooBig = 0;
+  result.tooDeep = 0;
+  result.never = 0;
+  result.deadFuncs = 0;
+  result.budgetUsed = 0;
+  result.finalSize = 0;
+  result.callsSaved = 0;
+  result.instrSaved = 0;
+
+  std::vector<int> size(numFuncs);
+  std::vector<unsigned> calls(numFuncs, 0);   // live sites calling f
+  std::vector<bool> dead(numFuncs, false);
+  std::vector< std::vector<unsigned> > contains(numFuncs);  // sites in f
+  std::vector< std::vector<unsigned> > calledBy(numFuncs);  // sites --> f
+  std::vector<LiveSite> live;
+  SimQueue queue;
+
+  for(unsigned f = 0; f != numFuncs; ++f)
+    size[f] = funcs[f].size;
+
+  live.reserve(sites.size());
+  for(unsigned i = 0, E = sites.size(); i != E; ++i)
+  {
+    LiveSite s;
+    s.caller = sites[i].caller;
+    s.callee = sites[i].callee;
+    s.less = sites[i].less;
+    s.never = sites[i].never;
+    s.ignored = false;
+    s.dead = false;
+    s.depth = 0;
+    s.version = 0;
+    s.mraw = metric.mraw[i];
+    s.benefit = metric.benefit[i];
+    s.freq = metric.freq[i];
+    s.mean = metric.mean[i];
+    live.push_back(s);
+
+    contains[s.caller].push_back(i);
+    calledBy[s.callee].push_back(i);
+    calls[s.callee]++;
+    queue.push(std::make_pair(simMval(s, size[s.callee]),
+                              std::make_pair(i, 0u)));
+  }
+
+  int64_t budget = config.budget;
+
+  while( (budget > 0) && !queue.empty()
+         && (result.inlined < FDISMaxInlines) )
+  {
+    QueueEntry top = queue.top();
+    queue.pop();
+
+    unsigned id = top.second.first;
+    if( live[id].dead || live[id].ignored
+        || (live[id].version != top.second.second) )
+      continue;  // stale entry
+
+    // no more beneficial candidates?
+    if(top.first <= 0)
+      break;
+
+    LiveSite inl = live[id];  // copy: live grows below
+    int iSize = size[inl.callee] - inl.less;
+
+    if(iSize > budget)
+    {
+      result.tooBig++;
+      live[id].ignored = true;
+      continue;
+    }
+
+    if(inl.never)
+    {
+      result.never++;
+      live[id].ignored = true;
+      continue;
+    }
+
+    if( (config.depth > 0) && (inl.depth >= config.depth) )
+    {
+      result.tooDeep++;
+      live[id].ignored = true;
+      continue;
+    }
+
+    // "inline" it
+    live[id].dead = true;
+    calls[inl.callee]--;
+    result.inlined++;
+    result.callsSaved += inl.mean;
+    result.instrSaved += inl.mean * inl.benefit;
+    size[inl.caller] += iSize;
+    budget -= iSize;
+
+    // the callee's call sites are copied into the caller
+    const std::vector<unsigned>& inCallee = contains[inl.callee];
+    for(unsigned c = 0, E = inCallee.size(); c != E; ++c)
+    {
+      LiveSite t = live[inCallee[c]];
+      if(t.dead)
+        continue;
+      // immediately-recursive calls are not candidates
+      if(t.callee == inl.caller)
+        continue;
+
+      LiveSite n = t;
+      n.caller = inl.caller;
+      n.depth = inl.depth + t.depth + 1;
+      n.version = 0;
+      n.mraw = inl.freq * t.mraw;
+      n.freq = inl.freq * t.freq;
+      n.mean = inl.mean * t.mean;
+
+      unsigned nid = live.size();
+      live.push_back(n);
+      contains[n.caller].push_back(nid);
+      calledBy[n.callee].push_back(nid);
+      calls[n.callee]++;
+      if(!n.ignored)
+        queue.push(std::make_pair(simMval(n, size[n.callee]),
+                                  std::make_pair(nid, 0u)));
+    }
+
+    // remove dead callees (recursively)
+    std::vector<unsigned> worklist(1, inl.callee);
+    while(!worklist.empty())
+    {
+      unsigned f = worklist.back();
+      worklist.pop_back();
+      if( dead[f] || (calls[f] != 0)
+          || funcs[f].addressTaken || funcs[f].isMain )
+        continue;
+
+      dead[f] = true;
+      result.deadFuncs++;
+      for(unsigned c = 0, E = contains[f].size(); c != E; ++c)
+      {
+        LiveSite& t = live[contains[f][c]];
+        if(t.dead)
+          continue;
+        t.dead = true;
+        calls[t.callee]--;
+        worklist.push_back(t.callee);
+      }
+    }
+
+    // the caller grew: re-evaluate the calls to the caller
+    const std::vector<unsigned>& toCaller = calledBy[inl.caller];
+    for(unsigned c = 0, E = toCaller.size(); c != E; ++c)
+    {
+      LiveSite& t = live[toCaller[c]];
+      if(t.dead || t.ignored)
+        continue;
+      t.version++;
+      queue.push(std::make_pair(simMval(t, size[t.callee]),
+                                std::make_pair(toCaller[c], t.version)));
+    }
+  } // simulated inlining loop
+
+  result.budgetUsed = (int)(config.budget - budget);
+  for(unsigned f = 0; f != numFuncs; ++f)
+    if(!dead[f])
+      result.finalSize += size[f];
+}
+
+
+// worker-thread entry: simulate configuration 'item'
+void FDOInlineSim::runConfig(void* context, unsigned item)
+{
+  FDOInlineSim* sim = (FDOInlineSim*)context;
+  const SimConfig& config = sim->_configs[item];
+  simulate(sim->_funcs, sim->_sites, sim->_metrics[config.metric], config,
+           sim->_results[item]);
+}
+
+
+// Snapshot function sizes and per-site metric values for every
+// metric setting.  This is the only part that looks at the IR.
+bool FDOInlineSim::buildModel(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(CPCallFile);
+
+  if( !fact->hasCallCP() )
+  {
+    errs() << "FDOInlineSim: no call profile found in file '"
+           << CPCallFile << "'\n";
+    delete fact;
+    return(false);
+  }
+
+  CombinedCallProfile* callCP = fact->takeCallCP();
+  delete fact;
+
+  FuncAttrMap* attrs = CPCallRecord::getFuncAttrMap();
+  std::map<Function*,unsigned> index;
+  _totalSize = 0;
+
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration())
+      continue;
+
+    CPCallRecord::recalcFunctionAttr(F);
+    FunctionAttr& attr = (*attrs)[F];
+
+    SimFunc sf;
+    sf.name = F->getName().str();
+    sf.size = attr.size;
+    sf.addressTaken = attr.addressTaken;
+    sf.isMain = (F->getName() == "main");
+
+    index[F] = _funcs.size();
+    _funcs.push_back(sf);
+    _totalSize += sf.size;
+  }
+
+  // one call record per original candidate
+  std::vector<CPCallRecord*> records;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for(BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      {
+        if(!callCP->isFDOInliningCandidate(I))
+          continue;
+
+        CallSite cs(cast<Value>(I));
+        CPCallRecord* rec = new CPCallRecord(cs, &(*callCP)[BB]);
+
+        SimSite site;
+        site.caller = index[F];
+        site.callee = index[cs.getCalledFunction()];
+        site.less = 0;
+        site.never = rec->neverInline();
+
+        _funcs[site.caller].sites.push_back(_sites.size());
+        _sites.push_back(site);
+        records.push_back(rec);
+      }
+
+  delete callCP;
+
+  // evaluate every metric setting on every site
+  std::vector<double> savedQ;
+  CPCallRecord::getQList(savedQ);
+  bool haveLess = false;
+
+  for(unsigned m = 0, E = _metrics.size(); m != E; ++m)
+  {
+    SimMetric& metric = _metrics[m];
+    CPCallRecord::setQList(metric.qs);
+    metric.valid = CPCallRecord::selectMetric(metric.name);
+    if(!metric.valid)
+      continue;
+
+    bool isStatic = isStaticMetric(metric.name);
+    unsigned numSites = records.size();
+    metric.mraw.resize(numSites);
+    metric.benefit.resize(numSites);
+    metric.freq.resize(numSites);
+    metric.mean.resize(numSites);
+
+    for(unsigned i = 0; i != numSites; ++i)
+    {
+      CPCallRecord* rec = records[i];
+      rec->evalMetric();
+      metric.mraw[i] = rec->mraw;
+      metric.benefit[i] = rec->mbenefit;
+      metric.freq[i] = isStatic ? 1.0 : rec->evalFrequency();
+      metric.mean[i] = rec->cphist->mean() * rec->cphist->coverage();
+
+      // argument savings don't depend on the metric
+      if(!haveLess)
+        _sites[i].less = _funcs[_sites[i].callee].size - rec->inlineSize();
+    }
+    haveLess = true;
+  }
+
+  CPCallRecord::setQList(savedQ);
+
+  for(unsigned i = 0, E = records.size(); i != E; ++i)
+    delete records[i];
+
+  return(true);
+}
+
+
+// cross product of the swept settings.  Unset lists default to the
+// corresponding -FDI- option.
+void FDOInlineSim::buildConfigs()
+{
+  // an empty name (e.g. from a trailing comma) is not a metric
+  std::vector<std::string> metrics;
+  for(unsigned m = 0, ME = FDISMetrics.size(); m != ME; ++m)
+    if(!FDISMetrics[m].empty())
+      metrics.push_back(FDISMetrics[m]);
+  if(metrics.empty() && !FDIMetric.empty())
+    metrics.push_back(FDIMetric);
+
+  std::vector<std::string> qsets(FDISQSets.begin(), FDISQSets.end());
+  std::vector<double> currentQ;
+  CPCallRecord::getQList(currentQ);
+  if(qsets.empty())
+  {
+    std::string str;
+    for(unsigned i = 0, E = currentQ.size(); i != E; ++i)
+    {
+      if(i != 0) str += ":";
+      std::string num;
+      raw_string_ostream os(num);
+      os << currentQ[i];
+      str += os.str();
+    }
+    qsets.push_back(str);
+  }
+
+  std::vector<unsigned> budgets(FDISBudgets.begin(), FDISBudgets.end());
+  if(budgets.empty())
+    budgets.push_back(FDIBudget);
+
+  std::vector<unsigned> depths(FDISDepths.begin(), FDISDepths.end());
+  if(depths.empty())
+    depths.push_back(FDIDepth);
+
+  // quantiles only matter for the Q metrics
+  for(unsigned m = 0, ME = metrics.size(); m != ME; ++m)
+  {
+    bool usesQ = (metrics[m][0] == 'Q');
+    for(unsigned q = 0, QE = (usesQ ? qsets.size() : 1); q != QE; ++q)
+    {
+      SimMetric metric;
+      metric.name = metrics[m];
+      metric.valid = false;
+      if(usesQ)
+      {
+        metric.qstr = qsets[q];
+        parseQSet(qsets[q], metric.qs);
+      }
+      else
+        metric.qstr = "-";
+      _metrics.push_back(metric);
+    }
+  }
+
+  for(unsigned m = 0, ME = _metrics.size(); m != ME; ++m)
+    for(unsigned b = 0, BE = budgets.size(); b != BE; ++b)
+      for(unsigned d = 0, DE = depths.size(); d != DE; ++d)
+      {
+        SimConfig config;
+        config.metric = m;
+        config.budgetOpt = budgets[b];
+        config.budget = 0;  // needs the program size
+        config.depth = depths[d];
+        _configs.push_back(config);
+      }
+}
+
+
+void FDOInlineSim::printTable(raw_ostream& stream)
+{
+  // format() only takes a few arguments, so each row is built in pieces
+  stream << "# FDO inlining simulation: " << _funcs.size() << " functions, "
+         << _sites.size() << " call sites, size " << _totalSize << "\n";
+  stream << "#cfg  metric     Q                budget depth inlined   big  deep "
+            "never    growth growth%     final  dead   callsSaved     instrSaved\n";
+
+  for(unsigned c = 0, E = _configs.size(); c != E; ++c)
+  {
+    const SimConfig& config = _configs[c];
+    const SimMetric& metric = _metrics[config.metric];
+    const SimResult& r = _results[c];
+
+    std::string budget;
+    raw_string_ostream bs(budget);
+    if(config.budgetOpt == 0)
+      bs << "inf";
+    else
+      bs << config.budget;
+    bs.flush();
+
+    stream << format("%-5u %-10s ", c, metric.name.c_str())
+           << format("%-12s %10s %5u ", metric.qstr.c_str(), budget.c_str(),
+                     config.depth);
+
+    if(!metric.valid)
+    {
+      stream << " (invalid metric)\n";
+      continue;
+    }
+
+    double pct = _totalSize ? 100.0 * r.budgetUsed / _totalSize : 0.0;
+    stream << format("%7u %5u %5u ", r.inlined, r.tooBig, r.tooDeep)
+           << format("%5u %9d %7.2f ", r.never, r.budgetUsed, pct)
+           << format("%9d %5u %12.4f ", r.finalSize, r.deadFuncs,
+                     r.callsSaved)
+           << format("%14.2f\n", r.instrSaved);
+  }
+}
+
+
+bool FDOInlineSim::runOnModule(Module& M)
+{
+  buildConfigs();
+
+  if(!buildModel(M))
+  {
+    errs() << "FDOInlineSim: Error: Failed to initialize\n";
+    CPCallRecord::freeStaticData();
+    return(false);
+  }
+
+  for(unsigned c = 0, E = _configs.size(); c != E; ++c)
+    _configs[c].budget = FDOInliner::calcBudget(_configs[c].budgetOpt,
+                                                _totalSize);
+
+  // Run the configurations.  Invalid metrics are still simulated (on
+  // empty data) so that the table has a row for them.
+  for(unsigned m = 0, E = _metrics.size(); m != E; ++m)
+    if(!_metrics[m].valid)
+    {
+      _metrics[m].mraw.assign(_sites.size(), -1);
+      _metrics[m].benefit.assign(_sites.size(), 0);
+      _metrics[m].freq.assign(_sites.size(), 0);
+      _metrics[m].mean.assign(_sites.size(), 0);
+    }
+
+  _results.resize(_configs.size());
+  unsigned threads = runFDOWorkers(&FDOInlineSim::runConfig, this,
+                                   _configs.size(), FDISThreads);
+  errs() << "FDOInlineSim: simulated " << _configs.size()
+         << " configurations on " << threads << " thread(s)\n";
+
+  if(FDISOut == "-")
+    printTable(outs());
+  else
+  {
+    std::string error;
+    raw_fd_ostream out(FDISOut.c_str(), error);
+    if(!error.empty())
+    {
+      errs() << "FDOInlineSim: " << error << "\n";
+      printTable(outs());
+    }
+    else
+      printTable(out);
+  }
+
+  CPCallRecord::freeStaticData();
+
+  // the IR is never changed
+  return(false);
+}
@@ -8,6 +8,10 @@
 //
 // A Feedback-Directed Inliner.
 //
+// With a combined edge profile (-FDI-eprof), callees that are too big
+// for the remaining budget are inlined partially: their regions that
+// were cold in all the profiled runs are first outlined (as for
+// -FDOColdSplit), so only the hot shell is charged to the budget.
 //
 //  TODO:
 //    - tune scaling on budget function
@@ -22,15 +26,21 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/FDO.h"
 #include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
 #include "llvm/Analysis/CPHistogram.h"
 #include "llvm/Analysis/CPFactory.h"
 
+#include "llvm/Transforms/FDO/FDOColdSplit.h"
+#include "llvm/Transforms/FDO/FDOInlineCache.h"
 #include "llvm/Transforms/FDO/FDOInlinerPass.h"
+#include "llvm/Transforms/FDO/FDOThreads.h"
 #include "llvm/Transforms/FDO/TStream.h"
 
 #include <limits>
@@ -40,22 +50,63 @@ using namespace llvm;
 //STATISTIC(FDOInlineCount, "Counts number of function inlining opportunities");
 
 
+// The budget, profile, metric and depth options are also read by the
+// inlining simulator and other FDO passes (see FDOInlinerPass.h).
+
 // if FDIBudget == 1, automatically compute budget
-static cl::opt<unsigned>
-FDIBudget("FDI-budget", cl::Hidden, cl::init(1),
-        cl::desc("FDO inlining code-growth budget (IR instructions)"));
+cl::opt<unsigned>
+llvm::FDIBudget("FDI-budget", cl::Hidden, cl::init(1),
+              cl::desc("FDO inlining code-growth budget (IR instructions)"));
+
+cl::opt<std::string> 
+llvm::CPCallFile("FDI-cprof", cl::init("call.cp"), 
+                 cl::desc("FDO Inlining combined call-profile file name"));
+
+static cl::opt<std::string> 
+CPPathFile("FDI-pprof", cl::init(""), 
+           cl::desc("FDO Inlining combined path-profile file name "
+                    "(optional: path-aware inlining benefits)"));
+
+static cl::opt<std::string> 
+CPValueFile("FDI-vprof", cl::init(""), 
+            cl::desc("FDO Inlining combined value-profile file name "
+                     "(optional: stable arguments as guarded constants)"));
 
 static cl::opt<std::string> 
-CPCallFile("FDI-cprof", cl::init("call.cp"), 
-           cl::desc("FDO Inlining combined call-profile file name"));
+CPEdgeFile("FDI-eprof", cl::init(""), 
+           cl::desc("FDO Inlining combined edge-profile file name "
+                    "(optional: partial inlining of large callees)"));
+
+static cl::opt<unsigned> 
+FDIPartialMinSize("FDI-partial-min-size", cl::init(8), 
+                  cl::desc("FDO Inlining: smallest cold region "
+                           "(instructions) outlined for partial inlining"));
 
 static cl::opt<std::string> 
-FDIMetric("FDI-metric", cl::init("mean"), 
-          cl::desc("FDO Inlining metric name"));
+FDIPartialSection("FDI-partial-section", cl::init(".text.unlikely"), 
+                  cl::desc("FDO Inlining: section of the outlined cold "
+                           "regions (empty: the default section)"));
+
+cl::opt<std::string> 
+llvm::FDIMetric("FDI-metric", cl::init("mean"), 
+                cl::desc("FDO Inlining metric name"));
+
+cl::opt<unsigned> 
+llvm::FDIDepth("FDI-depth", cl::init(0), 
+                cl::desc("FDO Inlining maximum call-string depth"));
+
+static cl::opt<bool> 
+FDISCCOrder("FDI-scc", cl::init(false), 
+            cl::desc("FDO Inlining: inline call-graph SCCs bottom-up "
+                     "instead of in global metric order"));
 
 static cl::opt<unsigned> 
-FDIDepth("FDI-depth", cl::init(0), 
-          cl::desc("FDO Inlining maximum call-string depth"));
+FDIThreads("FDI-threads", cl::init(1), 
+           cl::desc("FDO Inlining: worker threads for function analysis"));
+
+static cl::opt<std::string> 
+FDICache("FDI-cache", cl::init(""), 
+         cl::desc("FDO Inlining decision cache file (for incremental builds)"));
 
 static cl::opt<std::string> 
 FDILogBase("FDI-log", cl::init("FDIlog"), 
@@ -85,6 +136,7 @@ void FDOInliner::getAnalysisUsage(AnalysisUsage &Info) const {
 FDOInliner::~FDOInliner()
 {
   CPCallRecord::freeStaticData();
+  delete _cache;
   if(countFD != NULL)
     countFD->close();
   if(csevalFD != NULL)
@@ -115,7 +167,7 @@ llvm::raw_fd_ostream* FDOInliner::initLog(TStream& ts,
     return(fd);
 }
 
-FDOInliner::FDOInliner() : ModulePass(ID)
+FDOInliner::FDOInliner() : ModulePass(ID), _cache(NULL)
 {
 
   // create the debug stream, overriding stderr priority
@@ -185,6 +237,74 @@ unsigned FDOInliner::initialize(Module& M, CallGraph& CG, const TargetData* TD)
   CombinedCallProfile* callCP = fact->takeCallCP();
   delete fact;
 
+  // Load (optional) Path Profiling info
+  if(CPPathFile != "")
+  {
+    CPFactory* pathFact = new CPFactory(M);
+    pathFact->buildProfiles(CPPathFile);
+    if(pathFact->hasPathCP())
+    {
+      CombinedPathProfile* pathCP = pathFact->takePathCP();
+      unsigned pathFuncs = CPCallRecord::setPathProfile(M, *pathCP);
+      debug(vl::info) << "    Path profile: " << pathFuncs 
+                      << " functions with path-aware benefits\n";
+      delete pathCP;
+    }
+    else
+      debug(vl::warn) << "FDOInliner: no path profile found in file '" 
+                      << CPPathFile << "', using static benefits\n";
+    delete pathFact;
+  }
+
+  // Load (optional) Value Profiling info
+  if(CPValueFile != "")
+  {
+    CPFactory* valueFact = new CPFactory(M);
+    valueFact->buildProfiles(CPValueFile);
+    if(valueFact->hasValueCP())
+    {
+      CombinedValueProfile* valueCP = valueFact->takeValueCP();
+      unsigned stableArgs = CPCallRecord::setValueProfile(*valueCP);
+      debug(vl::info) << "    Value profile: " << stableArgs 
+                      << " stable arguments\n";
+      delete valueCP;
+    }
+    else
+      debug(vl::warn) << "FDOInliner: no value profile found in file '" 
+                      << CPValueFile << "', ignoring argument values\n";
+    delete valueFact;
+  }
+
+  // Load (optional) Edge Profiling info: the blocks that never ran
+  // (in functions that did), for partial inlining
+  _coldBlocks.clear();
+  _outlined.clear();
+  if(CPEdgeFile != "")
+  {
+    CPFactory* edgeFact = new CPFactory(M);
+    edgeFact->buildProfiles(CPEdgeFile);
+    if(edgeFact->hasEdgeCP())
+    {
+      CombinedEdgeProfile* edgeCP = edgeFact->takeEdgeCP();
+      CPEdgeMap map(M, *edgeCP);
+      if(map.valid())
+      {
+        findColdBlocks(M, map);
+        debug(vl::info) << "    Edge profile: " << _coldBlocks.size() 
+                        << " blocks cold in all runs\n";
+      }
+      else
+        debug(vl::warn) << "FDOInliner: edge profile '" << CPEdgeFile 
+                        << "' does not match the module, "
+                        << "no partial inlining\n";
+      delete edgeCP;
+    }
+    else
+      debug(vl::warn) << "FDOInliner: no edge profile found in file '" 
+                      << CPEdgeFile << "', no partial inlining\n";
+    delete edgeFact;
+  }
+
   // set the correct metric
   std::string& metric = FDIMetric;
   if( !CPCallRecord::selectMetric(metric) )
@@ -221,17 +341,46 @@ unsigned FDOInliner::initialize(Module& M, CallGraph& CG, const TargetData* TD)
     _funcInfo.insert(std::make_pair(&(*F), IFI)); // insert copies
 
     debug(vl::verbose) << "      " << F->size() << " blocks\n";
-    totalSize += CPCallRecord::recalcFunctionAttr(&(*F));
+    if(FDIThreads > 1)
+      CPCallRecord::prepareFunctionAttr(&(*F));  // analyzed below
+    else
+      totalSize += CPCallRecord::recalcFunctionAttr(&(*F));
   }
+
+  if(FDISCCOrder || (FDIThreads > 1))
+    buildSCCs(CG);
+
+  if(FDIThreads > 1)
+    totalSize = analyzeFunctions(M);
   
   // the callee function might not be processed yet, so we can't
   // evaluate candidates until later...
 
+  // Unchanged call sites are replayed from the decision cache
+  std::set<unsigned> replayed;
+  uint64_t metricKey = 0;
+  if(FDICache != "")
+  {
+    _cache = new FDOInlineCache();
+    _cache->load(FDICache);
+    std::vector<double> qs;
+    CPCallRecord::getQList(qs);
+    std::string key = metric;
+    if(CPPathFile != "")  // path-aware benefits depend on the path profile
+      key += "+path:" + utohexstr(CPCallRecord::getPathProfileDigest());
+    if(CPValueFile != "")  // so do stable-argument benefits
+      key += "+value:" + utohexstr(CPCallRecord::getValueProfileDigest());
+    if(CPEdgeFile != "")   // and sizes, on partial inlining
+      key += "+partial";
+    metricKey = FDOInlineCache::metricKey(key, qs);
+  }
+
   debug(vl::trace) << "    Scanning for inlining candidates in " 
                    << funcCnt << " functions...\n";
   // Scan for call sites and create call records.
   for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) 
   {
+    unsigned ordinal = 0;  // candidate number within F (cache key)
     for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) 
     {
       debug(vl::verbose) << "        " << BB->getName().str() << ": " 
@@ -261,6 +410,19 @@ unsigned FDOInliner::initialize(Module& M, CallGraph& CG, const TargetData* TD)
           _candidates.push_back(rec);
           _records[cs] = &(_candidates.back());
           debug(vl::verbose) << " C\n";
+
+          if(_cache != NULL)
+          {
+            InlineCacheKey key;
+            key.caller = _cache->functionHash(caller);
+            key.callee = _cache->functionHash(callee);
+            key.ordinal = ordinal;
+            key.digest = FDOInlineCache::histogramDigest(cp);
+            key.metric = metricKey;
+            if(_cache->replay(key, _candidates.back()))
+              replayed.insert(rec.ID);
+          }
+          ordinal++;
         } // isFDOInliningCandidate
       } // for instruction in block
       debug(vl::verbose) << "        (finished " << BB->getName().str() << ")\n";
@@ -275,9 +437,18 @@ unsigned FDOInliner::initialize(Module& M, CallGraph& CG, const TargetData* TD)
   for(CallList::iterator i = _candidates.begin(), E = _candidates.end();
       i != E; ++i)
   {
+    if(replayed.count(i->ID))
+      continue;
     i->evalMetric(); // RR: could use random values here
+    if(_cache != NULL)
+      _cache->update(*i);
   }
 
+  if(_cache != NULL)
+    debug(vl::info) << "    Replayed " << _cache->hits() << " of " 
+                    << _cache->hits() + _cache->misses() 
+                    << " call sites from " << FDICache << "\n";
+
   // sort (asending) all inlining candidates by metric value
   debug(vl::info) << "    Sort canidates\n";
   _candidates.sort();
@@ -295,6 +466,186 @@ unsigned FDOInliner::initialize(Module& M, CallGraph& CG, const TargetData* TD)
 }
 
 
+// The blocks that never ran in any profiled run (other than entries),
+// in the functions that were called
+void FDOInliner::findColdBlocks(Module& M, CPEdgeMap& map)
+{
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration() || !map.hasFunction(F)) continue;
+    if(map.neverExecuted(&F->getEntryBlock())) continue;
+
+    for(Function::iterator BB = ++F->begin(), BE = F->end(); BB != BE; ++BB)
+      if(map.neverExecuted(BB))
+        _coldBlocks.insert(BB);
+  }
+}
+
+
+// Partial inlining: outline the (remaining) cold regions of F, once.
+// The call graph, call records and function attributes follow the
+// moved calls; growth is the change in program size.  Returns true if
+// anything was outlined.
+bool FDOInliner::outlineColdRegions(Function* F, CallGraph& CG, int& growth)
+{
+  growth = 0;
+  if(!_outlined.insert(F).second)
+    return(false);
+
+  std::vector<ColdRegion> regions;
+  findColdRegions(F, _coldBlocks, FDIPartialMinSize, regions);
+
+  CallGraphNode* node = CG.getOrInsertFunction(F);
+  unsigned outlined = 0;
+  for(unsigned r = 0, RE = regions.size(); r != RE; ++r)
+  {
+    Function* cold = extractColdRegion(regions[r], FDIPartialSection);
+    if(cold == NULL)
+      continue;
+    outlined++;
+
+    // the call-graph edges of the calls that moved
+    CallGraphNode* coldNode = CG.getOrInsertFunction(cold);
+    std::vector<std::pair<CallSite, CallGraphNode*> > moved;
+    for(CallGraphNode::iterator I = node->begin(), E = node->end(); 
+        I != E; ++I)
+    {
+      Instruction* call = dyn_cast_or_null<Instruction>(I->first);
+      if( (call != NULL) && (call->getParent()->getParent() == cold) )
+        moved.push_back(std::make_pair(CallSite(call), I->second));
+    }
+    for(unsigned m = 0, ME = moved.size(); m != ME; ++m)
+    {
+      node->removeCallEdgeFor(moved[m].first);
+      coldNode->addCalledFunction(moved[m].first, moved[m].second);
+    }
+
+    // their records can't be inlined from there (cold is never inlined)
+    for(Function::iterator BB = cold->begin(), BE = cold->end(); 
+        BB != BE; ++BB)
+      for(BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if(isFDOInliningCandidate(I))
+          ignore(CallSite(cast<Value>(I)));
+
+    // the call of the outlined region
+    for(Value::use_iterator U = cold->use_begin(), UE = cold->use_end(); 
+        U != UE; ++U)
+    {
+      CallSite cs(*U);
+      if(!cs || (cs.getCaller() != F)) continue;
+      node->addCalledFunction(cs, coldNode);
+      _callers[cold].insert(cs);
+      ignore(cs);
+    }
+
+    _funcInfo.insert(std::make_pair(cold, _funcInfo[F]));
+    growth += CPCallRecord::recalcFunctionAttr(cold);
+    debug(vl::info) << "    outlined " << regions[r].size() 
+                    << " cold blocks of " << F->getName().str() << "\n";
+  }
+
+  if(outlined == 0)
+    return(false);
+
+  growth += CPCallRecord::recalcFunctionAttr(F);
+  return(true);
+}
+
+
+// Call-graph SCCs in bottom-up order (callees before callers)
+void FDOInliner::buildSCCs(CallGraph& CG)
+{
+  _sccs.clear();
+  _sccOf.clear();
+  for(scc_iterator<CallGraph*> I = scc_begin(&CG), E = scc_end(&CG); 
+      I != E; ++I)
+  {
+    FuncSet scc;
+    std::vector<CallGraphNode*>& nodes = *I;
+    for(unsigned n = 0, NE = nodes.size(); n != NE; ++n)
+    {
+      Function* F = nodes[n]->getFunction();
+      if( (F != NULL) && !F->isDeclaration() )
+      {
+        scc.insert(F);
+        _sccOf[F] = _sccs.size();
+      }
+    }
+    if(!scc.empty())
+      _sccs.push_back(scc);
+  }
+
+  debug(vl::info) << "    " << _sccs.size() << " call-graph SCCs\n";
+}
+
+
+namespace {
+  // FDOWorkFunc: analyze the functions of one SCC
+  void analyzeSCC(void* context, unsigned item)
+  {
+    const FuncSet& scc = (*(std::vector<FuncSet>*)context)[item];
+    for(FuncSet::const_iterator F = scc.begin(), E = scc.end(); F != E; ++F)
+      CPCallRecord::analyzeFunctionAttr(*F, true);
+  }
+}
+
+
+// Analyze all (prepared) functions on worker threads, one SCC per
+// work item.  Returns the total program size.
+unsigned FDOInliner::analyzeFunctions(Module& M)
+{
+  unsigned threads = runFDOWorkers(&analyzeSCC, &_sccs, _sccs.size(), 
+                                   FDIThreads);
+  debug(vl::info) << "    Analyzed " << _sccs.size() << " SCCs on " 
+                  << threads << " threads\n";
+
+  // functions not reached from the call graph (should not happen)
+  unsigned totalSize = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) 
+  {
+    if (F->isDeclaration()) 
+      continue;
+
+    FunctionAttr& attr = (*_funcAttr)[F];
+    if(!attr.valid)
+      CPCallRecord::analyzeFunctionAttr(F, true);
+    totalSize += attr.size;
+  }
+
+  return(totalSize);
+}
+
+
+// Scan (from the best) for a candidate called from the current SCC;
+// move on to the next SCC when the current one has no beneficial
+// candidates left.  Returns _candidates.end() when all SCCs are done.
+// One scan finds the lowest SCC with a beneficial candidate, and its
+// best candidate, rather than a scan per SCC.
+CallList::iterator FDOInliner::nextSCCCandidate(unsigned& scc)
+{
+  CallList::iterator best = _candidates.end();
+  unsigned bestSCC = _sccs.size();
+  CallList::iterator cand = _candidates.end();
+  while( (cand != _candidates.begin()) && (bestSCC != scc) )
+  {
+    --cand;
+    if(cand->mval <= 0)
+      break;  // sorted: nothing better below
+    std::map<const Function*, unsigned>::iterator S = 
+      _sccOf.find(cand->cs.getCaller());
+    if( (S != _sccOf.end()) && (S->second >= scc) && (S->second < bestSCC) )
+    {
+      best = cand;
+      bestSCC = S->second;
+    }
+  }
+
+  for(; scc < bestSCC; ++scc)
+    debug(vl::trace) << "    SCC " << scc << " done\n";
+  return(best);
+}
+
+
 bool FDOInliner::runOnModule(Module &M) 
 {  
  
@@ -330,6 +681,7 @@ bool FDOInliner::runOnModule(Module &M)
   unsigned missingRecord = 0;
   unsigned tooDeep = 0;
   unsigned tooBig = 0;
+  unsigned partial = 0;
   unsigned newCand = 0;
   unsigned newIgnore = 0;
   unsigned newNotCand = 0;
@@ -343,12 +695,24 @@ bool FDOInliner::runOnModule(Module &M)
 
   // Try to inline (best first) until the budget is consumed or there
   // are no candidates remaining
+  unsigned currSCC = 0;
   while( !error && (budget > 0) && (_candidates.size() > 0) )
   {
     // remember, _candidates is sorted ascending, start at the back
-    CPCallRecord& crec = _candidates.back();
     CallList::iterator candIter = --_candidates.end();
 
+    // bottom-up: the best candidate of the lowest unfinished SCC
+    if(FDISCCOrder)
+    {
+      candIter = nextSCCCandidate(currSCC);
+      if(candIter == _candidates.end())
+      {
+        debug(vl::info) << "    no benefit in remaining SCCs\n";
+        break;
+      }
+    }
+    CPCallRecord& crec = *candIter;
+
     Function* caller = crec.cs.getCaller();
     Function* callee = crec.cs.getCalledFunction();
     
@@ -369,6 +733,25 @@ bool FDOInliner::runOnModule(Module &M)
     // candidate is too large? (and more than one caller)
     //if((int)(*_funcAttr)[callee].size > budget) 
     int iSize = crec.inlineSize();
+    if( (iSize > budget) && !_coldBlocks.empty() )
+    {
+      // partial inlining: outline the callee's cold regions, if any,
+      // and charge only the hot shell
+      int growth;
+      if(outlineColdRegions(callee, CG, growth))
+      {
+        partial++;
+        budget -= growth;
+        iSize = crec.inlineSize();
+        debug(vl::info) << "    cold regions outlined, hot shell: " 
+                        << iSize << "\n";
+        if(!updateCallers(callee))
+        {
+          error = true;
+          break;
+        }
+      }
+    }
     if(iSize > budget)
     {
       tooBig++;
@@ -431,6 +814,8 @@ bool FDOInliner::runOnModule(Module &M)
 
     // Inlining successful!
     inlineCount++;
+    if(_cache != NULL)
+      _cache->markInlined(tmpRec.ID);
     (*_funcAttr)[caller].inlineCount += (*_funcAttr)[callee].inlineCount + 1;
     
     // print the call record
@@ -570,6 +955,8 @@ bool FDOInliner::runOnModule(Module &M)
   {
     debug(vl::error) << "\n\nFDO Inlining finished with errors\n\n";
     CPFactory::freeStaticData();
+    _coldBlocks.clear();
+    _outlined.clear();
     return(inlineCount > 0);
   }
 
@@ -594,6 +981,7 @@ bool FDOInliner::runOnModule(Module &M)
           << "  Missing records: " << missingRecord << "\n"
           << "  Rejected (deep): " << tooDeep << "\n"
           << "  Rejected (big):  " << tooBig - endSkip << "\n"
+          << "  Cold outlined:   " << partial << " callees\n"
           << "  Calls made dead: " << deadCalls 
           << " (" << _removed.size() << " removed)\n"
           << "  Candidates left: " << _candidates.size() + endSkip 
@@ -604,9 +992,22 @@ bool FDOInliner::runOnModule(Module &M)
           << " of " << totalSize
           << ")\n";
 
+  if(_cache != NULL)
+  {
+    count() << "  Cache replayed:  " << _cache->hits() << " of " 
+            << _cache->hits() + _cache->misses() << "\n"
+            << "  Cache changed:   " << _cache->changedDecisions() 
+            << " decisions\n";
+    _cache->save(FDICache);
+  }
+
 
   CPCallRecord::freeStaticData();
 
+  // the dead callees (and their blocks) are erased after this pass
+  _coldBlocks.clear();
+  _outlined.clear();
+
   return(inlineCount > 0);
 }
 
@@ -1032,13 +1433,28 @@ int FDOInliner::computeBudget(int size)
 {
   debug(vl::detail) << "--> FDOInliner::computeBudget\n";
 
-  int b = FDIBudget;
+  int b = calcBudget(FDIBudget, size);
+
+  debug(vl::info) << "** Inlining Budget: " << size
+                  << " +" << format("%2.1f", 100.0*b/size) << "% = " 
+                  << b << "\n";
 
-  if(FDIBudget == 0)
+  debug(vl::detail) << "<-- FDOInliner::computeBudget\n";
+  return(b);
+}
+
+
+// The budget for a requested budget setting: 0 is unlimited, 1 is
+// computed from the program size, anything else is used as-is.
+int FDOInliner::calcBudget(unsigned requested, int size)
+{
+  int b = requested;
+
+  if(requested == 0)
   {
     b = std::numeric_limits<int>::max();
   }
-  else if(FDIBudget == 1)
+  else if(requested == 1)
   {
     const double minPct = 0.05;      // y-shift on sqrt(size)
     const double maxPct = 10.0;      // upper-bound
@@ -1069,11 +1485,6 @@ int FDOInliner::computeBudget(int size)
     b = (int)floor(growthFactor*size);
   }
 
-  debug(vl::info) << "** Inlining Budget: " << size
-                  << " +" << format("%2.1f", 100.0*b/size) << "% = " 
-                  << b << "\n";
-
-  debug(vl::detail) << "<-- FDOInliner::computeBudget\n";
   return(b);
 }
 
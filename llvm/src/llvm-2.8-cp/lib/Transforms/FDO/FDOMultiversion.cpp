@@ -0,0 +1,424 @@
+//===- FDOMultiversion.cpp - Function versions per input class ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Specializes functions for classes of inputs that execute them
+// differently, from one combined edge profile per class (llvm-cpcluster
+// clusters the profiled runs by their edge frequencies).
+//
+// The dispatch has to be cheap and known at the call, so the classes
+// are told apart by the function's entry branch, when its condition
+// only depends on the arguments (entry block instructions that neither
+// read memory nor have side effects).  The clusters that take the
+// branch in at least half of their calls form the taken group, the
+// others the not-taken group.  A function is versioned when the groups'
+// branch probabilities are at least -FDMV-min-spread apart; the
+// -FDMV-top functions with the largest spread are versioned, while the
+// copies fit in the FDO code-growth budget (-FDI-budget):
+//
+//   f:      %c = <entry condition>
+//           br %c, label %mv1, label %mv0
+//   mv1:    %r1 = tail call @f.mv1(args)      ; the taken group's copy
+//           ret %r1
+//   mv0:    %r0 = tail call @f.mv0(args)      ; the not-taken group's copy
+//           ret %r0
+//
+// Each copy has its entry branch folded, so the test is made once, at
+// the call, and code specialized on it (by constant propagation, or
+// the inliner folding the dispatch into the callers) is per class.
+// The copies' switches carry the !cp.weights of their group's runs (see
+// FDOBranchWeights.cpp: the cluster profiles weighted by their number
+// of runs), for switch lowering.  Nothing else reads the class
+// profiles: the other FDO passes take one profile of the module, whose
+// numbering the copies are not in.
+//
+// The profiles must match the IR: run this before any other
+// transformation.  The module no longer matches them afterwards.
+//
+// Example:
+//   llvm-cpcluster -k=2 prog.bc llvmprof.*.out
+//   opt -FDOMultiversion -FDMV-prof=cluster0.cp,cluster1.cp -O3 prog.bc
+//       -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOMultiversion"
+#include "llvm/Pass.h"
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+#include "llvm/Transforms/FDO/FDOBranchWeights.h"
+#include "llvm/Transforms/FDO/FDOInlinerPass.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumCandidates, "Number of functions whose input classes differ");
+STATISTIC(NumVersioned,  "Number of functions versioned per input class");
+
+static cl::list<std::string>
+FDMVProfiles("FDMV-prof", cl::CommaSeparated,
+             cl::desc("FDO multiversioning: combined edge profiles, one "
+                      "per input class (llvm-cpcluster)"));
+
+static cl::opt<unsigned>
+FDMVTop("FDMV-top", cl::init(8),
+        cl::desc("FDO multiversioning: most functions versioned"));
+
+static cl::opt<double>
+FDMVMinSpread("FDMV-min-spread", cl::init(0.5),
+              cl::desc("FDO multiversioning: smallest difference between "
+                       "the classes' entry branch probabilities"));
+
+
+namespace llvm {
+
+  class FDOMultiversion : public ModulePass {
+  public:
+    static char ID;
+    FDOMultiversion() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Multiversioning";}
+
+    bool runOnModule(Module& M);
+
+  protected:
+    struct Candidate {
+      Function* F;
+      BranchInst* branch;                 // the entry branch
+      std::vector<Instruction*> predicate; // its condition, in order
+      std::vector<double> taken;          // edge weights of each group
+      std::vector<double> notTaken;
+      double spread;
+      unsigned size;
+
+      bool operator<(const Candidate& other) const
+      {
+        if(spread != other.spread)
+          return(spread > other.spread);
+        return(size > other.size);
+      }
+    };
+
+    bool entryPredicate(Function* F, std::vector<Instruction*>& predicate);
+    bool evaluate(Candidate& cand, std::vector<CPEdgeMap*>& maps,
+                  std::vector<double>& runs);
+    Function* version(Candidate& cand, CPEdgeMap& map, bool taken);
+    void dispatch(Candidate& cand, Function* takenF, Function* notTakenF);
+    static unsigned functionSize(Function* F);
+  };
+
+} // namespace llvm
+
+
+char FDOMultiversion::ID = 0;
+INITIALIZE_PASS(FDOMultiversion, "FDOMultiversion",
+                "FDO function versions per input class",
+                false, false);
+
+ModulePass* llvm::createFDOMultiversionPass() { return new FDOMultiversion(); }
+
+
+bool FDOMultiversion::runOnModule(Module& M)
+{
+  if(FDMVProfiles.size() < 2)
+  {
+    errs() << "FDOMultiversion: needs an edge profile per input class "
+           << "(-FDMV-prof)\n";
+    return(false);
+  }
+
+  // load all the profiles before changing the IR
+  std::vector<CombinedEdgeProfile*> profiles;
+  std::vector<CPEdgeMap*> maps;
+  std::vector<double> runs;
+  bool loaded = true;
+  for(unsigned p = 0, E = FDMVProfiles.size(); (p != E) && loaded; ++p)
+  {
+    CPFactory* fact = new CPFactory(M);
+    fact->buildProfiles(FDMVProfiles[p]);
+    if( !fact->hasEdgeCP() )
+    {
+      errs() << "FDOMultiversion: no edge profile found in file '"
+             << FDMVProfiles[p] << "'\n";
+      delete fact;
+      loaded = false;
+      break;
+    }
+    profiles.push_back(fact->takeEdgeCP());
+    delete fact;
+
+    maps.push_back(new CPEdgeMap(M, *profiles.back()));
+    runs.push_back(profiles.back()->getTotalWeight());
+    if( !maps.back()->valid() )
+    {
+      errs() << "FDOMultiversion: edge profile '" << FDMVProfiles[p]
+             << "' does not match the module\n";
+      loaded = false;
+    }
+  }
+
+  std::vector<Candidate> candidates;
+  unsigned size = 0;
+  for(Module::iterator F = M.begin(), E = M.end(); loaded && (F != E); ++F)
+  {
+    if(F->isDeclaration()) continue;
+    size += functionSize(F);
+
+    Candidate cand;
+    cand.F = F;
+    if( F->isVarArg() || F->mayBeOverridden()
+        || !entryPredicate(F, cand.predicate) )
+      continue;
+    cand.branch = cast<BranchInst>(F->getEntryBlock().getTerminator());
+    if( !evaluate(cand, maps, runs) )
+      continue;
+    cand.size = functionSize(F);
+    candidates.push_back(cand);
+  }
+  NumCandidates += candidates.size();
+  std::sort(candidates.begin(), candidates.end());
+
+  // copy the most divergent functions, within the budget
+  int budget = FDOInliner::calcBudget(FDIBudget, size);
+  unsigned versioned = 0;
+  for(unsigned c = 0, E = candidates.size();
+      (c != E) && (versioned < FDMVTop); ++c)
+  {
+    Candidate& cand = candidates[c];
+    int growth = cand.size + cand.predicate.size() + 4;
+    if(growth > budget)
+      continue;
+    budget -= growth;
+
+    errs() << "  " << cand.F->getName() << ": entry branch spread "
+           << format("%.2f", cand.spread) << ", " << cand.size
+           << " instructions\n";
+
+    Function* takenF = version(cand, *maps[0], true);
+    Function* notTakenF = version(cand, *maps[0], false);
+    dispatch(cand, takenF, notTakenF);
+    versioned++;
+  }
+  NumVersioned += versioned;
+
+  for(unsigned p = 0, E = profiles.size(); p != E; ++p)
+    delete profiles[p];
+  for(unsigned p = 0, E = maps.size(); p != E; ++p)
+    delete maps[p];
+
+  errs() << "FDOMultiversion: " << candidates.size() << " candidates, "
+         << versioned << " functions versioned\n";
+  return(versioned > 0);
+}
+
+
+// The instructions that compute the entry branch's condition, if they
+// can be recomputed at the call: all in the entry block, and free of
+// memory reads and side effects.
+bool FDOMultiversion::entryPredicate(Function* F,
+                                     std::vector<Instruction*>& predicate)
+{
+  BasicBlock* entry = &F->getEntryBlock();
+  BranchInst* br = dyn_cast<BranchInst>(entry->getTerminator());
+  if( (br == NULL) || !br->isConditional()
+      || (br->getSuccessor(0) == br->getSuccessor(1)) )
+    return(false);
+
+  // the copies and the dispatch can't share blocks with their addresses
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    if(BB->hasAddressTaken())
+      return(false);
+
+  std::set<Instruction*> needed;
+  std::vector<Value*> work(1, br->getCondition());
+  while(!work.empty())
+  {
+    Instruction* I = dyn_cast<Instruction>(work.back());
+    work.pop_back();
+    if( (I == NULL) || needed.count(I) )
+      continue;  // an argument or constant
+    if( (I->getParent() != entry) || isa<PHINode>(I) || isa<AllocaInst>(I)
+        || I->mayReadFromMemory() || I->mayHaveSideEffects() )
+      return(false);
+    needed.insert(I);
+    for(unsigned o = 0, E = I->getNumOperands(); o != E; ++o)
+      work.push_back(I->getOperand(o));
+  }
+
+  predicate.clear();
+  for(BasicBlock::iterator I = entry->begin(), E = entry->end(); I != E; ++I)
+    if(needed.count(I))
+      predicate.push_back(I);
+  return(true);
+}
+
+
+// Splits the classes by their entry branch probability, and computes
+// each group's edge weights.  False if the function is not worth it.
+bool FDOMultiversion::evaluate(Candidate& cand, std::vector<CPEdgeMap*>& maps,
+                               std::vector<double>& runs)
+{
+  Function* F = cand.F;
+  BasicBlock* entry = &F->getEntryBlock();
+  double low = 1, high = 0;
+  double takenRuns = 0, notTakenRuns = 0;
+  std::vector<double> weights;
+
+  cand.taken.clear();
+  cand.notTaken.clear();
+  for(unsigned p = 0, E = maps.size(); p != E; ++p)
+  {
+    CPEdgeMap& map = *maps[p];
+    if( !map.hasFunction(F) )
+      return(false);
+    map.chainWeights(F, CPEdgeMap::meanStat, 0, 1.0, weights);
+    unsigned first = map.entryEdge(F);
+    double w0 = weights[map.edge(entry, 0) - first];
+    double w1 = weights[map.edge(entry, 1) - first];
+    if(w0 + w1 <= 0)
+      continue;  // this class never calls F
+
+    double prob = w0 / (w0 + w1);
+    low = std::min(low, prob);
+    high = std::max(high, prob);
+
+    bool taken = (prob >= 0.5);
+    std::vector<double>& group = taken ? cand.taken : cand.notTaken;
+    group.resize(weights.size(), 0);
+    for(unsigned e = 0, EE = weights.size(); e != EE; ++e)
+      group[e] += runs[p] * weights[e];
+    (taken ? takenRuns : notTakenRuns) += runs[p];
+  }
+
+  cand.spread = high - low;
+  if( (takenRuns <= 0) || (notTakenRuns <= 0)
+      || (cand.spread < FDMVMinSpread) )
+    return(false);
+
+  for(unsigned e = 0, E = cand.taken.size(); e != E; ++e)
+  {
+    cand.taken[e] /= takenRuns;
+    cand.notTaken[e] /= notTakenRuns;
+  }
+  DEBUG(dbgs() << "  " << F->getName() << ": classes take the entry "
+               << "branch in " << low << " to " << high << "\n");
+  return(true);
+}
+
+
+// An internal copy of F with one group's branch weights, and its entry
+// branch folded for that group.
+Function* FDOMultiversion::version(Candidate& cand, CPEdgeMap& map, bool taken)
+{
+  Function* F = cand.F;
+  std::vector<double>& weights = taken ? cand.taken : cand.notTaken;
+  unsigned first = map.entryEdge(F);
+  unsigned kind = F->getContext().getMDKindID("cp.weights");
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+  {
+    BB->getTerminator()->setMetadata(kind, NULL);  // the other group's
+    setBranchWeights(BB, map, weights, first);
+  }
+
+  ValueMap<const Value*, Value*> VMap;
+  Function* clone = CloneFunction(F, VMap, false);
+  clone->setName(F->getName() + (taken ? ".mv1" : ".mv0"));
+  clone->setLinkage(GlobalValue::InternalLinkage);
+  F->getParent()->getFunctionList().push_back(clone);
+
+  BranchInst* br = cast<BranchInst>(VMap[cand.branch]);
+  BasicBlock* live = br->getSuccessor(taken ? 0 : 1);
+  BasicBlock* dead = br->getSuccessor(taken ? 1 : 0);
+  dead->removePredecessor(br->getParent());
+  BranchInst::Create(live, br);
+  br->eraseFromParent();
+
+  return(clone);
+}
+
+
+// Replaces the body of F with the dispatch to its versions.
+void FDOMultiversion::dispatch(Candidate& cand, Function* takenF,
+                               Function* notTakenF)
+{
+  Function* F = cand.F;
+  LLVMContext& Context = F->getContext();
+  std::vector<BasicBlock*> body;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    body.push_back(BB);
+
+  // the condition, recomputed from the arguments
+  BasicBlock* head = BasicBlock::Create(Context, "mv.dispatch", F, body[0]);
+  ValueMap<const Value*, Value*> VMap;
+  for(unsigned i = 0, E = cand.predicate.size(); i != E; ++i)
+  {
+    Instruction* I = cand.predicate[i]->clone();
+    for(unsigned o = 0, OE = I->getNumOperands(); o != OE; ++o)
+      if(VMap.count(I->getOperand(o)))
+        I->setOperand(o, VMap[I->getOperand(o)]);
+    I->setName(cand.predicate[i]->getName());
+    head->getInstList().push_back(I);
+    VMap[cand.predicate[i]] = I;
+  }
+  Value* cond = cand.branch->getCondition();
+  if(VMap.count(cond))
+    cond = VMap[cond];
+
+  std::vector<Value*> args;
+  for(Function::arg_iterator A = F->arg_begin(), E = F->arg_end(); A != E; ++A)
+    args.push_back(A);
+
+  BasicBlock* calls[2];
+  Function* versions[2] = { takenF, notTakenF };
+  for(unsigned v = 0; v != 2; ++v)
+  {
+    calls[v] = BasicBlock::Create(Context, v ? "mv0" : "mv1", F, body[0]);
+    CallInst* call = CallInst::Create(versions[v], args.begin(), args.end(),
+                                      "", calls[v]);
+    if( !F->getReturnType()->isVoidTy() )
+      call->setName("mv.ret");
+    call->setCallingConv(F->getCallingConv());
+    call->setAttributes(F->getAttributes());
+    call->setTailCall();
+    ReturnInst::Create(Context,
+                       F->getReturnType()->isVoidTy() ? NULL : call, calls[v]);
+  }
+  BranchInst::Create(calls[0], calls[1], cond, head);
+
+  // the old body is dead
+  for(unsigned b = 0, E = body.size(); b != E; ++b)
+    body[b]->dropAllReferences();
+  for(unsigned b = 0, E = body.size(); b != E; ++b)
+    body[b]->eraseFromParent();
+}
+
+
+unsigned FDOMultiversion::functionSize(Function* F)
+{
+  unsigned size = 0;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    size += BB->size();
+  return(size);
+}
@@ -0,0 +1,363 @@
+//===- FDOSuperblocks.cpp - Superblocks from a combined path profile ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Forms superblocks (single-entry traces) along the Ball-Larus paths
+// that are hot in most of the profiled runs, so that later passes
+// (GVN, scheduling) see the hot code as straight-line code.
+//
+// A path is hot when the -FDSB-q quantile of its histogram (the
+// path's fraction of its function's paths in each run, zeros
+// included: q = 0.25 means in at least three quarters of the runs) is
+// at least -FDSB-min-freq.  Hot paths are taken hottest first; each
+// one's trace is its blocks from its start (the entry or a loop
+// header) up to the first block that is a loop header, is in a hotter
+// trace already, or can't be duplicated.
+//
+// Side entrances into a trace are removed by tail duplication (as in
+// TailDuplication.cpp, but along the whole trace): from the first
+// block with a side entrance, each block is copied for its side
+// entrances, which makes the next block's copy necessary too.  Values
+// used outside of their block are repaired with the SSAUpdater, so
+// nothing is demoted to the stack.  Copies grow the program: a trace
+// is only formed while its copies fit in the FDO code-growth budget
+// (-FDI-budget, of the program at this point).
+//
+// The profile must match the IR: the traces are found before any
+// duplication.  Run -simplifycfg afterwards to clean up.
+//
+// Example:
+//   opt -FDOSuperblocks -FDSB-prof=path.cp -simplifycfg -O3 prog.bc
+//       -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOSuperblocks"
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PathNumbering.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+#include "llvm/Transforms/FDO/FDOInlinerPass.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumHotPaths,   "Number of paths hot in most runs");
+STATISTIC(NumTraces,     "Number of superblocks formed");
+STATISTIC(NumDuplicated, "Number of blocks duplicated for superblocks");
+
+static cl::opt<std::string>
+FDSBProfile("FDSB-prof", cl::init("path.cp"),
+            cl::desc("FDO superblocks combined path-profile file name"));
+
+static cl::opt<double>
+FDSBQuantile("FDSB-q", cl::init(0.25),
+             cl::desc("FDO superblocks: quantile of the path frequency "
+                      "distributions"));
+
+static cl::opt<double>
+FDSBMinFreq("FDSB-min-freq", cl::init(0.2),
+            cl::desc("FDO superblocks: smallest fraction of its function's "
+                     "paths (at the quantile) of a hot path"));
+
+
+namespace llvm {
+
+  class FDOSuperblocks : public ModulePass {
+  public:
+    static char ID;
+    FDOSuperblocks() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Superblock Formation";}
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+    }
+
+    bool runOnModule(Module& M);
+
+  protected:
+    typedef std::vector<BasicBlock*> Trace;
+
+    void findTraces(Module& M, CombinedPathProfile& cpp,
+                    std::vector<Trace>& traces);
+    static bool canDuplicate(BasicBlock* BB);
+    static unsigned firstSideEntrance(Trace& trace);
+    static void duplicate(BasicBlock* BB, BasicBlock* tracePred);
+  };
+
+} // namespace llvm
+
+
+char FDOSuperblocks::ID = 0;
+INITIALIZE_PASS(FDOSuperblocks, "FDOSuperblocks",
+                "FDO superblock formation from a combined path profile",
+                false, false);
+
+ModulePass* llvm::createFDOSuperblocksPass() { return new FDOSuperblocks(); }
+
+
+bool FDOSuperblocks::runOnModule(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDSBProfile);
+  if( !fact->hasPathCP() )
+  {
+    errs() << "FDOSuperblocks: no path profile found in file '"
+           << FDSBProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedPathProfile* pathCP = fact->takePathCP();
+  delete fact;
+
+  std::vector<Trace> traces;
+  findTraces(M, *pathCP, traces);
+  delete pathCP;
+
+  unsigned size = 0;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for(Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      size += BB->size();
+  int budget = FDOInliner::calcBudget(FDIBudget, size);
+
+  for(unsigned t = 0, E = traces.size(); t != E; ++t)
+  {
+    Trace& trace = traces[t];
+    unsigned first = firstSideEntrance(trace);
+
+    int cost = 0;
+    for(unsigned b = first, BE = trace.size(); b != BE; ++b)
+      cost += trace[b]->size();
+    if(cost > budget)
+    {
+      DEBUG(dbgs() << "  trace at " << trace[0]->getName() << ": "
+                   << cost << " instructions over budget\n");
+      continue;
+    }
+
+    for(unsigned b = first, BE = trace.size(); b != BE; ++b)
+      duplicate(trace[b], trace[b - 1]);
+    budget -= cost;
+    NumDuplicated += trace.size() - first;
+    NumTraces++;
+  }
+
+  errs() << "FDOSuperblocks: " << NumTraces << " superblocks, "
+         << NumDuplicated << " blocks duplicated\n";
+  return(NumDuplicated > 0);
+}
+
+
+// The traces of the hot paths, hottest first, without shared blocks
+void FDOSuperblocks::findTraces(Module& M, CombinedPathProfile& cpp,
+                                std::vector<Trace>& traces)
+{
+  // path profile function indices are 1-based, over defined functions
+  std::vector<Function*> funcs;
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if(!F->isDeclaration())
+      funcs.push_back(F);
+
+  typedef std::pair<double, PathID> HotPath;
+  std::vector<HotPath> hot;
+  PathSet paths;
+  cpp.getPathSet(paths);
+  for(PathSet::iterator P = paths.begin(), E = paths.end(); P != E; ++P)
+  {
+    if( (P->first == 0) || (P->first > funcs.size()) )
+    {
+      errs() << "FDOSuperblocks: bad function index " << P->first << "\n";
+      continue;
+    }
+    double freq = CPEdgeMap::quantileStat(cpp.getHistogram(*P), FDSBQuantile);
+    if(freq >= FDSBMinFreq)
+      hot.push_back(HotPath(freq, *P));
+  }
+  std::sort(hot.begin(), hot.end(), std::greater<HotPath>());
+  NumHotPaths += hot.size();
+
+  std::map<FunctionIndex, BallLarusDag*> dags;
+  std::set<BasicBlock*> claimed;
+  std::vector<BasicBlock*> blocks;
+  for(unsigned h = 0, E = hot.size(); h != E; ++h)
+  {
+    FunctionIndex funcNum = hot[h].second.first;
+    Function* F = funcs[funcNum - 1];
+    BallLarusDag*& dag = dags[funcNum];
+    if(dag == NULL)
+    {
+      dag = new BallLarusDag(*F);
+      dag->init();
+      dag->calculatePathNumbers();
+    }
+    dag->getPathBlocks(hot[h].second.second, blocks);
+
+    LoopInfo& LI = getAnalysis<LoopInfo>(*F);
+    Trace trace;
+    for(unsigned b = 0, BE = blocks.size(); b != BE; ++b)
+    {
+      BasicBlock* BB = blocks[b];
+      if( claimed.count(BB)
+          || ((b > 0) && (LI.isLoopHeader(BB) || !canDuplicate(BB))) )
+        break;
+      trace.push_back(BB);
+      claimed.insert(BB);
+    }
+
+    DEBUG(dbgs() << "  " << F->getName() << ": path "
+                 << hot[h].second.second << " (" << hot[h].first << "), "
+                 << trace.size() << " of " << blocks.size() << " blocks\n");
+    if(trace.size() > 1)
+      traces.push_back(trace);
+  }
+
+  for(std::map<FunctionIndex, BallLarusDag*>::iterator D = dags.begin(),
+        E = dags.end(); D != E; ++D)
+    delete D->second;
+}
+
+
+bool FDOSuperblocks::canDuplicate(BasicBlock* BB)
+{
+  if(BB->hasAddressTaken())
+    return(false);
+
+  // the copy can't be reached from an indirectbr
+  for(pred_iterator P = pred_begin(BB), E = pred_end(BB); P != E; ++P)
+    if(isa<IndirectBrInst>((*P)->getTerminator()))
+      return(false);
+
+  return(true);
+}
+
+
+// The first block of the trace entered from outside of the trace
+// (trace.size() if none)
+unsigned FDOSuperblocks::firstSideEntrance(Trace& trace)
+{
+  for(unsigned b = 1, E = trace.size(); b != E; ++b)
+    for(pred_iterator P = pred_begin(trace[b]), PE = pred_end(trace[b]);
+        P != PE; ++P)
+      if(*P != trace[b - 1])
+        return(b);
+  return(trace.size());
+}
+
+
+// Copies BB for its predecessors other than tracePred, and moves them
+// to the copy
+void FDOSuperblocks::duplicate(BasicBlock* BB, BasicBlock* tracePred)
+{
+  Function* F = BB->getParent();
+  BasicBlock* copy = BasicBlock::Create(BB->getContext(),
+                                        BB->getName() + ".sb", F);
+
+  std::map<Value*, Value*> mapping;
+  for(BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+  {
+    Instruction* New = I->clone();
+    New->setName(I->getName());
+    copy->getInstList().push_back(New);
+    mapping[I] = New;
+  }
+  for(BasicBlock::iterator I = copy->begin(), E = copy->end(); I != E; ++I)
+    for(unsigned op = 0, OE = I->getNumOperands(); op != OE; ++op)
+    {
+      std::map<Value*, Value*>::iterator M = mapping.find(I->getOperand(op));
+      if(M != mapping.end())
+        I->setOperand(op, M->second);
+    }
+
+  // the copy's PHIs keep the side entrances only
+  for(BasicBlock::iterator I = copy->begin(); isa<PHINode>(I); ++I)
+  {
+    PHINode* PN = cast<PHINode>(I);
+    int idx;
+    while( (idx = PN->getBasicBlockIndex(tracePred)) != -1 )
+      PN->removeIncomingValue(idx, false);
+  }
+
+  // the successors are entered from the copy too
+  for(succ_iterator S = succ_begin(BB), E = succ_end(BB); S != E; ++S)
+    for(BasicBlock::iterator I = (*S)->begin(); isa<PHINode>(I); ++I)
+    {
+      PHINode* PN = cast<PHINode>(I);
+      Value* V = PN->getIncomingValueForBlock(BB);
+      std::map<Value*, Value*>::iterator M = mapping.find(V);
+      PN->addIncoming((M != mapping.end()) ? M->second : V, copy);
+    }
+
+  // uses outside of BB see the original, the copy, or a PHI of both
+  SSAUpdater SSAUpdate;
+  std::vector<Use*> uses;
+  for(BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+  {
+    for(Value::use_iterator U = I->use_begin(), UE = I->use_end();
+        U != UE; ++U)
+    {
+      Instruction* user = cast<Instruction>(*U);
+      if(PHINode* PN = dyn_cast<PHINode>(user))
+      {
+        if(PN->getIncomingBlock(U) == BB)
+          continue;
+      }
+      else if(user->getParent() == BB)
+        continue;
+      uses.push_back(&U.getUse());
+    }
+    if(uses.empty())
+      continue;
+
+    SSAUpdate.Initialize(I->getType(), I->getName());
+    SSAUpdate.AddAvailableValue(BB, I);
+    SSAUpdate.AddAvailableValue(copy, mapping[I]);
+    while(!uses.empty())
+    {
+      SSAUpdate.RewriteUse(*uses.back());
+      uses.pop_back();
+    }
+  }
+
+  // move the side entrances (pred_iterator lists a block once per edge)
+  std::set<BasicBlock*> sides(pred_begin(BB), pred_end(BB));
+  sides.erase(tracePred);
+  for(std::set<BasicBlock*>::iterator P = sides.begin(), E = sides.end();
+      P != E; ++P)
+  {
+    TerminatorInst* TI = (*P)->getTerminator();
+    for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+      if(TI->getSuccessor(s) == BB)
+      {
+        BB->removePredecessor(*P, true);
+        TI->setSuccessor(s, copy);
+      }
+  }
+
+  DEBUG(dbgs() << "    duplicated " << BB->getName() << " for "
+               << sides.size() << " side entrances\n");
+}
@@ -0,0 +1,98 @@
+//===- FDOThreads.cpp - Worker threads for FDO analyses ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// See FDOThreads.h
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/config.h"
+#include "llvm/System/Atomic.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/FDO/FDOThreads.h"
+
+#include <vector>
+
+#if defined(ENABLE_THREADS) && ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define FDO_HAVE_THREADS 1
+#endif
+
+using namespace llvm;
+
+namespace {
+
+  // shared by all workers of one runFDOWorkers call
+  struct WorkQueue {
+    FDOWorkFunc work;
+    void* context;
+    unsigned numItems;
+    volatile sys::cas_flag next;  // next item to hand out (+1)
+  };
+
+  void drainQueue(WorkQueue* q)
+  {
+    while(true)
+    {
+      // AtomicIncrement returns the new value, so items are 1-based here
+      unsigned item = (unsigned)sys::AtomicIncrement(&q->next) - 1;
+      if(item >= q->numItems)
+        break;
+      q->work(q->context, item);
+    }
+  }
+
+#ifdef FDO_HAVE_THREADS
+  void* workerMain(void* arg)
+  {
+    drainQueue((WorkQueue*)arg);
+    return(NULL);
+  }
+#endif
+
+} // namespace
+
+
+unsigned llvm::runFDOWorkers(FDOWorkFunc work, void* context,
+                             unsigned numItems, unsigned numThreads)
+{
+  WorkQueue q;
+  q.work = work;
+  q.context = context;
+  q.numItems = numItems;
+  q.next = 0;
+
+  if(numThreads > numItems)
+    numThreads = numItems;
+
+#ifdef FDO_HAVE_THREADS
+  if(numThreads > 1)
+  {
+    // the calling thread is also a worker
+    std::vector<pthread_t> threads(numThreads-1);
+    unsigned started = 0;
+    for(unsigned t = 0, E = threads.size(); t != E; ++t, ++started)
+      if(pthread_create(&threads[t], NULL, &workerMain, &q) != 0)
+      {
+        errs() << "runFDOWorkers: Warning: could only start " << started+1
+               << " of " << numThreads << " threads\n";
+        break;
+      }
+
+    drainQueue(&q);
+
+    for(unsigned t = 0; t != started; ++t)
+      pthread_join(threads[t], NULL);
+
+    return(started+1);
+  }
+#endif
+
+  drainQueue(&q);
+  return(1);
+}
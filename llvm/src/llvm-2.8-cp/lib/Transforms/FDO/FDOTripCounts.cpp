@@ -0,0 +1,246 @@
+//===- FDOTripCounts.cpp - Loop trip counts from a combined profile -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Annotates loops with the distribution of their trip counts (header
+// executions per entry of the loop) over the profiled runs, taken from a
+// combined edge profile, for -loop-unroll to choose unroll counts.
+//
+// For a loop with one entry edge e and one back edge b, the back edge's
+// normalized frequency, chained up the edge dominator tree to e, is the
+// number of back edges taken per entry, ie, the trip count minus one.
+// When e is b's edge dominator (eg, single-block loops), b's histogram
+// is exactly the distribution of that number over the runs; otherwise
+// it is scaled by the (non-zero) means of the edges in between, as if
+// they were independent.  Runs that do not enter the loop (by the
+// coverage of e) are left out.
+//
+// The annotation is metadata on the terminators of the loop's header
+// and latch (which survive most loop canonicalizations):
+//
+//   br ..., !cp.tripcount !{i32 low, i32 median, i32 high}
+//
+// with the -FDTC-low-q, 0.5 and -FDTC-high-q quantiles, rounded.
+// Loops with several entry or back edges are not annotated.  The
+// profile must match the IR: run this before any other transformation.
+//
+// Example:
+//   opt -FDOTripCounts -FDTC-prof=edge.cp -O3 prog.bc -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOTripCounts"
+#include "llvm/Pass.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPEdgeMap.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+
+#include <set>
+
+using namespace llvm;
+
+STATISTIC(NumAnnotated, "Number of loops annotated with trip counts");
+
+static cl::opt<std::string>
+FDTCProfile("FDTC-prof", cl::init("edge.cp"),
+            cl::desc("FDO trip counts combined edge-profile file name"));
+
+static cl::opt<double>
+FDTCLowQ("FDTC-low-q", cl::init(0.1),
+         cl::desc("FDO trip counts: quantile of the low trip count"));
+
+static cl::opt<double>
+FDTCHighQ("FDTC-high-q", cl::init(0.9),
+          cl::desc("FDO trip counts: quantile of the high trip count"));
+
+
+namespace llvm {
+
+  class FDOTripCounts : public ModulePass {
+  public:
+    static char ID;
+    FDOTripCounts() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Loop Trip Counts";}
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.setPreservesAll();
+    }
+
+    bool runOnModule(Module& M);
+
+  protected:
+    void annotate(Loop* L, CPEdgeMap& map);
+    bool findEdge(BasicBlock* header, bool inside, Loop* L, CPEdgeMap& map,
+                  unsigned& edge);
+    static double backEdgesPerEntry(CPHistogram& back, double entered,
+                                    double q);
+  };
+
+} // namespace llvm
+
+
+char FDOTripCounts::ID = 0;
+INITIALIZE_PASS(FDOTripCounts, "FDOTripCounts",
+                "FDO loop trip-count annotation from a combined edge profile",
+                false, false);
+
+ModulePass* llvm::createFDOTripCountsPass() { return new FDOTripCounts(); }
+
+
+bool FDOTripCounts::runOnModule(Module& M)
+{
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDTCProfile);
+  if( !fact->hasEdgeCP() )
+  {
+    errs() << "FDOTripCounts: no edge profile found in file '"
+           << FDTCProfile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedEdgeProfile* edgeCP = fact->takeEdgeCP();
+  delete fact;
+
+  CPEdgeMap map(M, *edgeCP);
+  if( !map.valid() )
+  {
+    errs() << "FDOTripCounts: edge profile '" << FDTCProfile
+           << "' does not match the module\n";
+    delete edgeCP;
+    return(false);
+  }
+
+  for(Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if(F->isDeclaration()) continue;
+
+    LoopInfo& LI = getAnalysis<LoopInfo>(*F);
+    std::vector<Loop*> work(LI.begin(), LI.end());
+    while(!work.empty())
+    {
+      Loop* L = work.back();
+      work.pop_back();
+      work.insert(work.end(), L->begin(), L->end());
+      annotate(L, map);
+    }
+  }
+
+  delete edgeCP;
+  return(NumAnnotated > 0);
+}
+
+
+void FDOTripCounts::annotate(Loop* L, CPEdgeMap& map)
+{
+  BasicBlock* header = L->getHeader();
+  unsigned entry, back;
+  if( !findEdge(header, false, L, map, entry)
+      || !findEdge(header, true, L, map, back) )
+    return;
+
+  // chain the back edge up to the entry edge
+  double scale = 1;
+  unsigned e = map.dominator(back);
+  while(e != entry)
+  {
+    if(map.dominator(e) == e)
+      return;  // the entry edge does not dominate the back edge
+    CPHistogram& hist = map.histogram(e);
+    scale *= hist.nonZero() ? hist.mean(false) : 0;
+    e = map.dominator(e);
+  }
+
+  CPHistogram& entryHist = map.histogram(entry);
+  double entered = entryHist.nonZero() ? entryHist.coverage() : 0;
+  if(entered <= 0)
+    return;  // never entered
+
+  CPHistogram& backHist = map.histogram(back);
+  double q[3] = { FDTCLowQ, 0.5, FDTCHighQ };
+  Value* counts[3];
+  LLVMContext& Context = header->getContext();
+  for(unsigned i = 0; i != 3; ++i)
+  {
+    double trips = 1 + scale * backEdgesPerEntry(backHist, entered, q[i]);
+    counts[i] = ConstantInt::get(Type::getInt32Ty(Context),
+                                 (unsigned)(trips + 0.5));
+  }
+
+  MDNode* node = MDNode::get(Context, counts, 3);
+  unsigned kind = Context.getMDKindID("cp.tripcount");
+  header->getTerminator()->setMetadata(kind, node);
+  if(BasicBlock* latch = L->getLoopLatch())
+    latch->getTerminator()->setMetadata(kind, node);
+
+  DEBUG(dbgs() << "  " << header->getParent()->getName() << ":"
+               << header->getName() << " trips " << *node << "\n");
+  NumAnnotated++;
+}
+
+
+// The only edge into the header from outside (inside: from inside) L
+bool FDOTripCounts::findEdge(BasicBlock* header, bool inside, Loop* L,
+                             CPEdgeMap& map, unsigned& edge)
+{
+  unsigned found = 0;
+
+  // pred_iterator lists a predecessor once per edge
+  std::set<BasicBlock*> preds(pred_begin(header), pred_end(header));
+  for(std::set<BasicBlock*>::iterator P = preds.begin(), E = preds.end();
+      P != E; ++P)
+  {
+    if(L->contains(*P) != inside)
+      continue;
+    TerminatorInst* TI = (*P)->getTerminator();
+    for(unsigned s = 0, SE = TI->getNumSuccessors(); s != SE; ++s)
+      if(TI->getSuccessor(s) == header)
+      {
+        edge = map.edge(*P, s);
+        found++;
+      }
+  }
+
+  return(found == 1);
+}
+
+
+// Back edges per entry, over the runs that enter the loop (a fraction
+// entered of all runs); the others are zeros of back's histogram too
+double FDOTripCounts::backEdgesPerEntry(CPHistogram& back, double entered,
+                                        double q)
+{
+  double taken = back.nonZero() ? back.coverage() : 0;
+  double zeros = (entered - taken) / entered;  // entered, no back edge
+  if(zeros < 0)
+    zeros = 0;
+
+  if( (taken <= 0) || (q <= zeros) )
+    return(0);
+  if(back.isPoint())
+    return(back.min());
+  return(back.quantile((q - zeros) / (1 - zeros)));
+}
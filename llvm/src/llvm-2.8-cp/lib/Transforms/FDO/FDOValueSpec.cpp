@@ -0,0 +1,267 @@
+//===- FDOValueSpec.cpp - Value-profile-guided call specialization --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Specializes call sites for the stable values of their arguments,
+// using a combined value profile (-insert-value-profiling, llvm-cprof).
+// For each call with an argument whose most frequent value has a
+// stability (expected fraction of the calls with that value) of at
+// least -FDVS-stable, the call is guarded:
+//
+//   head:    %g = icmp eq %arg, V
+//            br %g, label %spec, label %generic
+//   spec:    %r.spec = call @f.vspec(..., V, ...)
+//            br label %join
+//   generic: %r = call @f(..., %arg, ...)
+//            br label %join
+//   join:    phi [%r.spec, %spec], [%r, %generic]
+//
+// f.vspec is a clone of f with the formal replaced by V (shared by all
+// call sites with the same callee, argument and value).  Callees larger
+// than -FDVS-max-size are not cloned; the guarded call then just passes
+// the constant, which still lets the (FDO) inliner fold it.
+//
+// The value profile must match the IR: run this before any other
+// transformation of the profiled program.  The guards add blocks and
+// the clones add functions, so a call profile of the profiled program
+// no longer matches: call profile the specialized program (the call
+// profile is keyed by the blocks of the profiled IR) for the FDO
+// inliner.
+//
+// Example:
+//   opt -FDOValueSpec -FDVS-vprof=value.cp prog.bc -o prog.vs.bc
+//   (profile prog.vs.bc with -insert-call-profiling, llvm-cprof)
+//   opt -FDOInliner -FDI-cprof=call.cp prog.vs.bc -o prog.opt.bc
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "FDOValueSpec"
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Transforms/FDO.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <map>
+
+using namespace llvm;
+
+STATISTIC(NumGuarded, "Number of call sites specialized for a value");
+STATISTIC(NumCloned,  "Number of value-specialized function clones");
+
+static cl::opt<std::string>
+FDVSValueFile("FDVS-vprof", cl::init("value.cp"),
+              cl::desc("FDO value specialization combined value-profile "
+                       "file name"));
+
+static cl::opt<double>
+FDVSStable("FDVS-stable", cl::init(0.9),
+           cl::desc("FDO value specialization: minimum stability of the "
+                    "specialized value"));
+
+static cl::opt<unsigned>
+FDVSMaxSize("FDVS-max-size", cl::init(500),
+            cl::desc("FDO value specialization: largest callee "
+                     "(instructions) that is cloned"));
+
+static cl::opt<bool>
+FDVSClone("FDVS-clone", cl::init(true),
+          cl::desc("FDO value specialization: clone callees (otherwise "
+                   "only guard the call)"));
+
+
+namespace llvm {
+
+  class FDOValueSpec : public ModulePass {
+  public:
+    static char ID;
+    FDOValueSpec() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const
+    {return "FDO Value Specialization";}
+
+    bool runOnModule(Module& M);
+
+  protected:
+    struct SpecSite {
+      CallInst* call;
+      unsigned argNo;
+      uint64_t value;
+      double stability;
+    };
+
+    typedef std::pair<Function*,unsigned> CloneArg;
+    typedef std::map<std::pair<CloneArg,uint64_t>, Function*> CloneMap;
+
+    void specialize(const SpecSite& site);
+    Function* getClone(Function* F, unsigned argNo, Constant* C,
+                       uint64_t value);
+    static unsigned functionSize(Function* F);
+
+    CloneMap _clones;
+  };
+
+} // namespace llvm
+
+
+char FDOValueSpec::ID = 0;
+INITIALIZE_PASS(FDOValueSpec, "FDOValueSpec",
+                "FDO call specialization for stable argument values",
+                false, false);
+
+ModulePass* llvm::createFDOValueSpecPass() { return new FDOValueSpec(); }
+
+
+bool FDOValueSpec::runOnModule(Module& M)
+{
+  _clones.clear();
+
+  CPFactory* fact = new CPFactory(M);
+  fact->buildProfiles(FDVSValueFile);
+  if( !fact->hasValueCP() )
+  {
+    errs() << "FDOValueSpec: no value profile found in file '"
+           << FDVSValueFile << "'\n";
+    delete fact;
+    return(false);
+  }
+  CombinedValueProfile* valueCP = fact->takeValueCP();
+  delete fact;
+
+  // pick the most stable argument of each call, before changing the IR
+  std::map<CallInst*, SpecSite> best;
+  for(ValueSiteIndex s = 0, E = valueCP->getSiteCount(); s != E; ++s)
+  {
+    CallInst* call = dyn_cast<CallInst>(valueCP->getSiteCall(s));
+    if(call == NULL)
+      continue;  // invokes are not specialized
+
+    SpecSite site;
+    site.call = call;
+    site.argNo = valueCP->getSiteArg(s);
+    site.value = 0;
+    site.stability = valueCP->getStableValue(s, site.value);
+    if( (site.stability <= 0) || (site.stability < FDVSStable) )
+      continue;
+
+    std::map<CallInst*, SpecSite>::iterator prev = best.find(call);
+    if( (prev == best.end()) || (prev->second.stability < site.stability) )
+      best[call] = site;
+  }
+  delete valueCP;
+
+  errs() << "FDOValueSpec: " << best.size() << " call sites with stable "
+         << "arguments (>= " << format("%.2f", (double)FDVSStable) << ")\n";
+
+  for(std::map<CallInst*, SpecSite>::iterator i = best.begin(),
+        E = best.end(); i != E; ++i)
+    specialize(i->second);
+
+  return(!best.empty());
+}
+
+
+void FDOValueSpec::specialize(const SpecSite& site)
+{
+  CallInst* call = site.call;
+  Function* callee = call->getCalledFunction();
+  Value* arg = call->getArgOperand(site.argNo);
+  Constant* C = ConstantInt::get(arg->getType(), site.value);
+  LLVMContext& Context = call->getContext();
+
+  errs() << "  " << call->getParent()->getParent()->getName() << " -> "
+         << callee->getName() << " arg " << site.argNo << " == "
+         << site.value << " (" << format("%.2f", site.stability) << ")\n";
+
+  // head: ... ; generic: call ; join: rest of the block
+  BasicBlock* head = call->getParent();
+  BasicBlock* generic = head->splitBasicBlock(call, "vspec.generic");
+  BasicBlock::iterator next = call;
+  ++next;
+  BasicBlock* join = generic->splitBasicBlock(next, "vspec.join");
+
+  // spec: the call with the constant argument
+  Function* F = head->getParent();
+  BasicBlock* spec = BasicBlock::Create(Context, "vspec", F, generic);
+  CallInst* specCall = cast<CallInst>(call->clone());
+  specCall->setArgOperand(site.argNo, C);
+  if(FDVSClone)
+  {
+    Function* clone = getClone(callee, site.argNo, C, site.value);
+    if(clone != NULL)
+      specCall->setCalledFunction(clone);
+  }
+  spec->getInstList().push_back(specCall);
+  BranchInst::Create(join, spec);
+
+  // guard
+  head->getTerminator()->eraseFromParent();
+  ICmpInst* guard = new ICmpInst(*head, ICmpInst::ICMP_EQ, arg, C,
+                                 "vspec.guard");
+  BranchInst::Create(spec, generic, guard, head);
+
+  // merge the results
+  if(!call->getType()->isVoidTy())
+  {
+    PHINode* phi = PHINode::Create(call->getType(), "vspec.ret",
+                                   join->begin());
+    call->replaceAllUsesWith(phi);
+    phi->addIncoming(specCall, spec);
+    phi->addIncoming(call, generic);
+  }
+
+  NumGuarded++;
+}
+
+
+// The clone keeps the signature of F (so the call's attributes still
+// apply); the specialized formal is just no longer used.
+Function* FDOValueSpec::getClone(Function* F, unsigned argNo, Constant* C,
+                                 uint64_t value)
+{
+  std::pair<CloneArg,uint64_t> key(CloneArg(F, argNo), value);
+  CloneMap::iterator prev = _clones.find(key);
+  if(prev != _clones.end())
+    return(prev->second);
+
+  Function* clone = NULL;
+  if( !F->mayBeOverridden() && (functionSize(F) <= FDVSMaxSize) )
+  {
+    clone = CloneFunction(F);
+    clone->setName(F->getName() + ".vspec");
+    clone->setLinkage(GlobalValue::InternalLinkage);
+    F->getParent()->getFunctionList().push_back(clone);
+
+    Function::arg_iterator formal = clone->arg_begin();
+    for(unsigned a = 0; a != argNo; ++a)
+      ++formal;
+    formal->replaceAllUsesWith(C);
+
+    NumCloned++;
+  }
+
+  _clones[key] = clone;
+  return(clone);
+}
+
+
+unsigned FDOValueSpec::functionSize(Function* F)
+{
+  unsigned size = 0;
+  for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    size += BB->size();
+  return(size);
+}
@@ -12,6 +12,12 @@
 // each proceedure.  An additional counter is inserted into any
 // (non-entry) block containing a callsite.
 //
+// With -profile-prune-cp, the blocks whose combined call profile has
+// converged are not counted: a block that never ran keeps a count of 0,
+// and a block that always ran once per call of its function is listed in
+// the profile (PrunedCounterInfo), which CombinedCallProfile reads as the
+// function's entry count.  Entry counters are always kept.
+//
 //===----------------------------------------------------------------------===//
 #define DEBUG_TYPE "insert-call-profiling"
 
@@ -19,6 +25,8 @@
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPFactory.h"
 #include "llvm/Support/CallSite.h"
 
 #include "llvm/Support/raw_ostream.h"
@@ -28,6 +36,8 @@
 #include <set>
 using namespace llvm;
 
+STATISTIC(NumCallBlocksPruned, "The # of converged call blocks not counted");
+
 
 namespace llvm{
 
@@ -63,6 +73,10 @@ bool CallProfiler::runOnModule(Module &M) {
   }
 
 
+  // The functions not to instrument keep their counters (at 0).
+  std::set<const Function*> Skipped;
+  SelectInstrumentedFunctions(M, Skipped);
+
   std::vector<BasicBlock*> CallBBs;
   std::vector<BasicBlock*> EntryBBs;
   for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) 
@@ -86,9 +100,45 @@ bool CallProfiler::runOnModule(Module &M) {
   unsigned NumCallBBs = CallBBs.size();
   unsigned NumCounters = NumFuncs + NumCallBBs;
 
-  errs() << "\n\nCall Profiling: Inserting " << NumCounters << " counters: " 
-         << NumFuncs << " entry blocks and " << NumCallBBs 
-         << " blocks with calls\n\n\n";
+  // The checksums of the CFG before the sample checks change it; the
+  // entry counters are matched with their functions.
+  CFGLayout Layout;
+  CFGChecksum::blockLayout(M, CallBBs, NumFuncs, Layout);
+
+  // Find the call blocks that have converged in earlier runs
+  std::vector<bool> Pruned(NumCallBBs, false);
+  std::vector<unsigned> Converged;  // the pruned counters that always ran
+  unsigned NumPruned = 0;
+  if (CPFactory *Fact = LoadPruningProfile(M)) {
+    CombinedCallProfile *CallCP = Fact->takeCallCP();
+    delete Fact;
+    if (CallCP) {
+      for (unsigned i = 0; i < NumCallBBs; i++) {
+        CPHistogram *H = &(*CallCP)[CallBBs[i]];
+        // the runs that instrumented the block
+        double Runs = CallCP->getKnownWeight(CallCP->getCallIndex(CallBBs[i]));
+        if (HasConvergedTo(H, Runs, 0)) {
+          Pruned[i] = true;
+        } else if (HasConvergedTo(H, Runs, 1.0)) {
+          Pruned[i] = true;
+          Converged.push_back(i+NumFuncs);
+        }
+        if (Pruned[i])
+          NumPruned++;
+      }
+    }
+    delete CallCP;
+  }
+  NumCallBlocksPruned = NumPruned;
+
+  errs() << "\n\nCall Profiling: Inserting " << NumCounters-NumPruned 
+         << " counters: " << NumFuncs << " entry blocks and " 
+         << NumCallBBs-NumPruned << " blocks with calls";
+  if (NumPruned)
+    errs() << " (" << NumPruned << " converged blocks pruned)";
+  if (!Skipped.empty())
+    errs() << " (" << Skipped.size() << " functions skipped)";
+  errs() << "\n\n\n";
 
   // profile counter data
   const Type *ATy = ArrayType::get(Type::getInt32Ty(M.getContext()), 
@@ -103,16 +153,33 @@ bool CallProfiler::runOnModule(Module &M) {
   // instead of wrapping
 
   // Insert counters in procedure entry nodes
-  for(unsigned i = 0; i < NumFuncs; i++)
-    IncrementCounterInBlock(EntryBBs[i], i, Counters, false, true); 
+  std::vector<unsigned> First;  // the entry counter of each function
+  for(unsigned i = 0; i < NumFuncs; i++) {
+    First.push_back(i);
+    if(!Skipped.count(EntryBBs[i]->getParent()))
+      IncrementCounterInBlock(EntryBBs[i], i, Counters, false, true); 
+  }
   // Insert counters at the start of blocks that have calls
   // counter indexes are after the those for entry nodes ( +NumFuncs)
   for(unsigned i = 0; i < NumCallBBs; i++)
-    IncrementCounterInBlock(CallBBs[i], i+NumFuncs, Counters, false, true);
+    if(!Pruned[i] && !Skipped.count(CallBBs[i]->getParent()))
+      IncrementCounterInBlock(CallBBs[i], i+NumFuncs, Counters, false, true);
+
+  // Sample the counters (-profile-sample-interval), and keep the
+  // counters of loops in registers, flushed before each call
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (Skipped.count(F)) continue;
+    InsertSampleChecks(*F, Counters);
+    PromoteCounterIncrements(*F, Counters);
+  }
 
 
-  // Add the initialization call to main.
+  // Add the initialization calls to main.
   InsertProfilingInitCall(Main, "llvm_start_call_profiling", Counters);
+  InsertSampleInfoInitCall(Main);
+  InsertCounterMapInitCall(Main, CallInfo, First, Skipped);
+  InsertCFGChecksumInitCall(Main, CallInfo, Layout);
+  InsertPrunedCountersInitCall(Main, CallInfo, Converged);
   return true;
 }
 
@@ -15,11 +15,23 @@
 // edge in the program, instead of using control flow information to prune the
 // number of counters inserted.
 //
+// With -profile-prune-cp, the edges whose combined-profile histogram has
+// converged are not counted.  An edge that never ran keeps a count of 0.
+// An edge that always ran as often as its edge dominator is listed in the
+// profile (PrunedCounterInfo), and CombinedEdgeProfile gives it the count
+// of its dominator when reading the profile back in.  The function entry
+// edges (the roots) are always counted.
+//
+// With -profile-sample-interval, the counters only run in samples (see
+// InsertSampleChecks).
+//
 //===----------------------------------------------------------------------===//
 #define DEBUG_TYPE "insert-edge-profiling"
 #include "ProfilingUtils.h"
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPFactory.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Instrumentation.h"
@@ -28,6 +40,8 @@
 using namespace llvm;
 
 STATISTIC(NumEdgesInserted, "The # of edges inserted.");
+STATISTIC(NumEdgesPruned, "The # of converged edges not counted.");
+STATISTIC(NumEdgesSkipped, "The # of edges of uninstrumented functions.");
 
 namespace {
   class EdgeProfiler : public ModulePass {
@@ -56,11 +70,17 @@ bool EdgeProfiler::runOnModule(Module &M) {
     return false;  // No main, no instrumentation!
   }
 
+  // The functions not to instrument keep their counters (at 0).
+  std::set<const Function*> Skipped;
+  SelectInstrumentedFunctions(M, Skipped);
+
   std::set<BasicBlock*> BlocksToInstrument;
+  std::vector<unsigned> First;  // of each function, for the counter map
   unsigned NumEdges = 0;
   for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
     if (F->isDeclaration()) continue;
     // Reserve space for (0,entry) edge.
+    First.push_back(NumEdges);
     ++NumEdges;
     for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
       // Keep track of which blocks need to be instrumented.  We don't want to
@@ -71,17 +91,61 @@ bool EdgeProfiler::runOnModule(Module &M) {
     }
   }
 
+  // The checksums of the CFG before it changes, so the runs can be
+  // matched to later versions of the module.
+  CFGLayout Layout;
+  CFGChecksum::edgeLayout(M, Layout);
+
+  // Find the edges that have converged in earlier runs, before the CFG
+  // changes.
+  std::vector<bool> Pruned(NumEdges, false);
+  std::vector<unsigned> Converged;  // the pruned edges that always ran
+  unsigned NumPruned = 0;
+  if (CPFactory *Fact = LoadPruningProfile(M)) {
+    CombinedEdgeProfile *EdgeCP = Fact->takeEdgeCP();
+    delete Fact;
+    if (EdgeCP && EdgeCP->size() != NumEdges)
+      errs() << "WARNING: edge profile to prune by does not match the "
+             << "module, instrumenting every edge\n";
+    else if (EdgeCP) {
+      for (unsigned e = 0; e != NumEdges; ++e) {
+        if (EdgeCP->getDominatorIndex(e) == e)
+          continue;  // a root: the function's entry count
+        // the runs that instrumented the edge
+        double Runs = EdgeCP->getKnownWeight(e);
+        if (HasConvergedTo((*EdgeCP)[e], Runs, 0)) {
+          Pruned[e] = true;
+        } else if (HasConvergedTo((*EdgeCP)[e], Runs, 1.0)) {
+          Pruned[e] = true;
+          Converged.push_back(e);
+        }
+        if (Pruned[e])
+          ++NumPruned;
+      }
+    }
+    delete EdgeCP;
+    // its edge dominator tree is of the CFG before the edges are split
+    CombinedEdgeProfile::freeStaticData();
+  }
+
   const Type *ATy = ArrayType::get(Type::getInt32Ty(M.getContext()), NumEdges);
   GlobalVariable *Counters =
     new GlobalVariable(M, ATy, false, GlobalValue::InternalLinkage,
                        Constant::getNullValue(ATy), "EdgeProfCounters");
-  NumEdgesInserted = NumEdges;
+  NumEdgesPruned = NumPruned;
 
   // Instrument all of the edges...
-  unsigned i = 0;
+  unsigned i = 0, f = 0, NumSkipped = 0;
   for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
     if (F->isDeclaration()) continue;
-    // Create counter for (0,entry) edge.
+    ++f;
+    if (Skipped.count(F)) {
+      unsigned End = f < First.size() ? First[f] : NumEdges;
+      for (; i != End; ++i)
+        NumSkipped += !Pruned[i];
+      continue;
+    }
+    // Create counter for (0,entry) edge.  It is a root, never pruned.
     IncrementCounterInBlock(&F->getEntryBlock(), i++, Counters);
     for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
       if (BlocksToInstrument.count(BB)) {  // Don't instrument inserted blocks
@@ -90,6 +154,11 @@ bool EdgeProfiler::runOnModule(Module &M) {
         // in the source or destination of the edge.
         TerminatorInst *TI = BB->getTerminator();
         for (unsigned s = 0, e = TI->getNumSuccessors(); s != e; ++s) {
+          if (Pruned[i]) {
+            ++i;
+            continue;
+          }
+
           // If the edge is critical, split it.
           SplitCriticalEdge(TI, s, this);
 
@@ -107,10 +176,29 @@ bool EdgeProfiler::runOnModule(Module &M) {
       }
   }
 
-  // Add the initialization call to main.
+  NumEdgesInserted = NumEdges - NumPruned - NumSkipped;
+  NumEdgesSkipped = NumSkipped;
+
+  // Sample the counters, and keep the counters of loops in registers.
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (Skipped.count(F)) continue;
+    InsertSampleChecks(*F, Counters);
+    PromoteCounterIncrements(*F, Counters);
+  }
+
+  // Add the initialization calls to main.
   InsertProfilingInitCall(Main, "llvm_start_edge_profiling", Counters);
+  InsertSampleInfoInitCall(Main);
+  InsertCounterMapInitCall(Main, EdgeInfo, First, Skipped);
+  InsertCFGChecksumInitCall(Main, EdgeInfo, Layout);
+  InsertPrunedCountersInitCall(Main, EdgeInfo, Converged);
 
-  errs() << "Instrumented " << NumEdges << " edges\n";
+  errs() << "Instrumented " << NumEdges - NumPruned - NumSkipped << " edges";
+  if (NumPruned)
+    errs() << " (" << NumPruned << " converged edges pruned)";
+  if (NumSkipped)
+    errs() << " (" << NumSkipped << " edges of skipped functions)";
+  errs() << "\n";
 
   return true;
 }
@@ -0,0 +1,173 @@
+//===- ICallProfiling.cpp - Insert indirect call target profiling ---------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass instruments the specified program to record the most
+// frequent targets of indirect calls.  Every call through a pointer is
+// a site; a call to llvm_value_profile before the call records the
+// called address in the site's table of VP_TOPK (value, count) slots,
+// as for argument values.
+//
+// Addresses change from run to run, so the pass also gives the runtime
+// the address of every defined function (llvm_icall_targets).  At exit
+// the runtime replaces the recorded addresses by function numbers
+// (1-based, module order) before writing the profile.
+//
+// Sites are numbered in module order: functions, blocks, calls, and
+// found by CombinedICallProfile::isICallSite, as the profile reader
+// finds them.
+//
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "insert-icall-profiling"
+
+#include "ProfilingUtils.h"
+#include "llvm/Constants.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CallSite.h"
+
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Instrumentation.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumICallSites, "The # of indirect call profiling sites");
+
+
+namespace llvm{
+
+  class ICallProfiler : public ModulePass {
+    bool runOnModule(Module &M);
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    ICallProfiler() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const {return "ICall Profiler";}
+
+  protected:
+    void insertTargetTable(Module &M, Function *Main);
+  };
+}
+
+
+char ICallProfiler::ID = 0;
+INITIALIZE_PASS(ICallProfiler, "insert-icall-profiling",
+                "Insert instrumentation for indirect call target profiling",
+                false, false);
+
+ModulePass *llvm::createICallProfilerPass() { return new ICallProfiler(); }
+
+
+bool ICallProfiler::runOnModule(Module &M) {
+  Function *Main = M.getFunction("main");
+  if (Main == 0) {
+    errs() << "WARNING: cannot insert icall profiling into a module"
+           << " with no main function!\n";
+    return false;  // No main, no instrumentation!
+  }
+
+  // collect the sites before instrumenting
+  std::vector<Instruction*> Sites;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if (F->isDeclaration()) continue;
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if(CombinedICallProfile::isICallSite(I))
+          Sites.push_back(I);
+  }
+
+  unsigned NumSites = Sites.size();
+  NumICallSites += NumSites;
+
+  errs() << "\n\nICall Profiling: Inserting " << NumSites
+         << " indirect call probes\n\n\n";
+
+  if (NumSites == 0)
+    return false;
+
+  // one ValueProfileSite per indirect call, as an array of unsigned
+  LLVMContext &Context = M.getContext();
+  const unsigned SiteWords = sizeof(ValueProfileSite) / sizeof(unsigned);
+  const Type *Int32 = Type::getInt32Ty(Context);
+  const Type *Int64 = Type::getInt64Ty(Context);
+  const Type *ATy = ArrayType::get(Int32, NumSites * SiteWords);
+  GlobalVariable *Table =
+    new GlobalVariable(M, ATy, false, GlobalValue::InternalLinkage,
+                       Constant::getNullValue(ATy), "ICallProfTable");
+
+  Constant *ProfileFn =
+    M.getOrInsertFunction("llvm_value_profile", Type::getVoidTy(Context),
+                          PointerType::getUnqual(Int32), Int64, NULL);
+
+  for (unsigned s = 0; s < NumSites; ++s)
+  {
+    Instruction *Call = Sites[s];
+    CallSite cs(Call);
+
+    std::vector<Constant*> Indices(2);
+    Indices[0] = Constant::getNullValue(Int32);
+    Indices[1] = ConstantInt::get(Int32, s * SiteWords);
+    Constant *Site = ConstantExpr::getGetElementPtr(Table, &Indices[0], 2);
+
+    Value *Target = new PtrToIntInst(cs.getCalledValue(), Int64, "icprof",
+                                     Call);
+    Value *Args[2] = { Site, Target };
+    CallInst::Create(ProfileFn, Args, Args+2, "", Call);
+  }
+
+  // Add the initialization calls to main.
+  insertTargetTable(M, Main);
+  InsertProfilingInitCall(Main, "llvm_start_icall_profiling", Table);
+  return true;
+}
+
+
+// Gives the runtime the address of every defined function, in module
+// order, so it can number the targets.  Functions whose address is
+// never taken cannot be called indirectly and stay null.
+void ICallProfiler::insertTargetTable(Module &M, Function *Main) {
+  LLVMContext &Context = M.getContext();
+  const PointerType *Int8Ptr = Type::getInt8PtrTy(Context);
+  const Type *Int32 = Type::getInt32Ty(Context);
+
+  std::vector<Constant*> Targets;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if (F->isDeclaration()) continue;
+    if (F->hasAddressTaken())
+      Targets.push_back(ConstantExpr::getBitCast(F, Int8Ptr));
+    else
+      Targets.push_back(Constant::getNullValue(Int8Ptr));
+  }
+
+  const ArrayType *ATy = ArrayType::get(Int8Ptr, Targets.size());
+  GlobalVariable *TargetTable =
+    new GlobalVariable(M, ATy, true, GlobalValue::InternalLinkage,
+                       ConstantArray::get(ATy, Targets), "ICallTargets");
+
+  Constant *TargetsFn =
+    M.getOrInsertFunction("llvm_icall_targets", Type::getVoidTy(Context),
+                          PointerType::getUnqual(Int8Ptr), Int32, NULL);
+
+  // Skip over any allocas in the entry block.
+  BasicBlock *Entry = Main->begin();
+  BasicBlock::iterator InsertPos = Entry->begin();
+  while (isa<AllocaInst>(InsertPos)) ++InsertPos;
+
+  std::vector<Constant*> Indices(2, Constant::getNullValue(Int32));
+  Value *Args[2] = {
+    ConstantExpr::getGetElementPtr(TargetTable, &Indices[0], 2),
+    ConstantInt::get(Int32, Targets.size())
+  };
+  CallInst::Create(TargetsFn, Args, Args+2, "", InsertPos);
+}
+
@@ -32,6 +32,35 @@
 //									vertices and is a tree.
 // Chord					- An edge not in the spanning tree.
 //
+// With -profile-prune-cp, functions whose combined path profile has
+// converged are not instrumented: a function that never ran writes no
+// paths, and a function that always took one path is listed with that
+// path in the profile (PrunedCounterInfo), which CombinedPathProfile
+// reads as a frequency of 1.
+//
+// With -profile-sample-interval, the paths are only counted in samples
+// (see InsertSampleChecks): a sample starts at the function entry or at a
+// loop header, where a Ball-Larus path starts.
+//
+// With -path-profile-context=K (and -process-early-termination, whose
+// paths also end at the blocks with calls), the paths of each function
+// are also counted in the context of their callers: the runtime keeps a
+// stack of (function, path prefix) frames, pushed around every call
+// with the number of the path that ends at the call's block.  Every
+// completed path is recorded with the top K frames (ContextPathInfo).
+// Functions that are not instrumented push no frames.  The push returns
+// the depth of the stack, which the pop restores, so the frames of calls
+// left by a longjmp are dropped at the next pop; a function with landing
+// pads restores its entry depth at each of them, for the frames of the
+// calls an exception unwound.
+//
+// With -path-profile-iterations=K, the paths that end at a loop's
+// backedge are also counted as sequences of up to K consecutive
+// iterations of the loop (LoopPathInfo), so the correlation between
+// iterations survives the cut at the backedge.  A loop is numbered by
+// the position of its header in the function's blocks; the header
+// tells the runtime when the loop is entered afresh.
+//
 // [Ball96]
 //  T. Ball and J. R. Larus. "Efficient Path Profiling."
 //  International Symposium on Microarchitecture, pages 46-57, 1996.
@@ -46,11 +75,15 @@
 #define DEBUG_TYPE "insert-path-profiling"
 
 #include "ProfilingUtils.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/CPFactory.h"
 #include "llvm/Analysis/PathNumbering.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
+#include "llvm/InlineAsm.h"
 #include "llvm/InstrTypes.h"
 #include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
@@ -62,13 +95,18 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Instrumentation.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
 #include <map>
+#include <set>
 #include <vector>
 
 #define HASH_THRESHHOLD 100000
 
 using namespace llvm;
 
+STATISTIC(NumFunctionsPruned, "Number of converged functions not instrumented");
+
 namespace {
   class BLInstrumentationNode;
   class BLInstrumentationEdge;
@@ -136,8 +174,8 @@ namespace {
       // weight.  The counter increment counts the number of executions of
       // some path, whereas the path number keeps track of which path number
       // the program is on.
-      long getIncrement() const;
-      void setIncrement(long increment);
+      int64_t getIncrement() const;
+      void setIncrement(int64_t increment);
 
       // Get/set whether the edge has been instrumented.
       bool hasInstrumentation();
@@ -148,7 +186,7 @@ namespace {
 
     private:
       // The increment that the code will be instrumented with.
-      long long _increment;
+      int64_t _increment;
 
       // Whether this edge is in the spanning tree.
       bool _isInSpanningTree;
@@ -180,6 +218,9 @@ namespace {
       // with function calls
       BLEdgeVector getCallPhonyEdges();
 
+      // Returns the backedges of the DAG (before any edge is split)
+      const BLEdgeVector& getBackEdges() { return(_backEdges); }
+
       // Gets/sets the path counter array
 			GlobalVariable* getCounterArray();
 			void setCounterArray(GlobalVariable* c);
@@ -251,7 +292,7 @@ namespace {
 
       // Depth first algorithm for determining the chord increments.f
       void calculateChordIncrementsDfs(
-        long weight, BallLarusNode* v, BallLarusEdge* e);
+        int64_t weight, BallLarusNode* v, BallLarusEdge* e);
 
       // Determines the relative direction of two edges.
       int calculateChordIncrementsDir(BallLarusEdge* e, BallLarusEdge* f);
@@ -273,15 +314,67 @@ namespace {
     Constant* llvmIncrementHashFunction;
 		Constant* llvmDecrementHashFunction;
 
+    // The context path profiling runtime (-path-profile-context): the
+    // callers' path prefixes, and the paths counted in their context
+    bool profileContexts;
+    Constant* llvmContextPushFunction;
+    Constant* llvmContextPopFunction;
+    Constant* llvmContextDepthFunction;
+    Constant* llvmIncrementContextFunction;
+
+    // The calls of the current function, by block, before instrumenting
+    std::map<BasicBlock*, std::vector<CallInst*> > contextCalls;
+
+    // Collects the calls of F that push a context frame
+    void findContextCalls(Function &F);
+
+    // Pushes the path prefix pathNumber around every call of block
+    void insertContextFrames(BasicBlock* block, Value* pathNumber);
+
+    // Restores the entry depth of the stack at the landing pads of F
+    void insertContextRestores(Function &F);
+
+    // The loop path runtime (-path-profile-iterations): the paths that
+    // end at a backedge, and the entries of the loop headers
+    bool profileIterations;
+    Constant* llvmLoopPathFunction;
+    Constant* llvmLoopHeaderFunction;
+
+    // The loop headers of the current function --> their block number
+    std::map<BasicBlock*, unsigned> loopHeaders;
+
+    // Numbers the loop headers (backedge targets) of dag's function
+    void findLoopHeaders(BLInstrumentationDag& dag);
+
+    // Reports the iteration path pathNumber of the loop of header
+    void insertLoopPath(BasicBlock* header, Value* pathNumber,
+                        BasicBlock::iterator insertPoint);
+
+    // Marks the entries of the loop headers
+    void insertLoopHeaders();
+
+    // Functions not instrumented (-profile-prune-cp): function number -->
+    // the one path it always takes, NoPath if it never ran
+    std::map<unsigned,PathIndex> prunedFunctions;
+    static const PathIndex NoPath = ~(PathIndex)0;
+
+    // Finds the functions whose path profile has converged
+    void findPrunedFunctions(Module &M);
+
+    // Adds the function table entry of a function that is not instrumented
+    void addPrunedFunction(std::vector<Constant*> &ftInit);
+
     // Instruments each function with path profiling.  'main' is instrumented
     // with code to save the profile to disk.
     bool runOnModule(Module &M);
 
     // Analyzes the function for Ball-Larus path profiling, and inserts code.
-    void runOnFunction(std::vector<Constant*> &ftInit, Function &F, Module &M);
+    // Returns false if the function could not be numbered and was left
+    // uninstrumented.
+    bool runOnFunction(std::vector<Constant*> &ftInit, Function &F, Module &M);
 
     // Creates an increment constant representing incr.
-    ConstantInt* createIncrementConstant(long incr, int bitsize);
+    ConstantInt* createIncrementConstant(int64_t incr, int bitsize);
 
     // Creates an increment constant representing the value in
     // edge->getIncrement().
@@ -308,12 +401,14 @@ namespace {
     void insertNumberIncrement(BLInstrumentationNode* node, Value* addition, bool atBeginning);
 
     // Creates a counter increment in the given node.  The Value* in node is
-    // taken as the index into a hash table.
+    // taken as the index into a hash table.  pathEnds is false for the
+    // prefixes counted in case the program exits in a call.
     void insertCounterIncrement(
       Value* incValue,
       BasicBlock::iterator insertPoint,
       BLInstrumentationDag* dag,
-      bool increment = true);
+      bool increment = true,
+      bool pathEnds = true);
 
     // A PHINode is created in the node, and its values initialized to -1U.
     void preparePHI(BLInstrumentationNode* node);
@@ -344,7 +439,8 @@ namespace {
 
   public:
     static char ID; // Pass identification, replacement for typeid
-    PathProfiler() : ModulePass(ID) { }
+    PathProfiler() : ModulePass(ID), profileContexts(false),
+      profileIterations(false) { }
   };
 }
 
@@ -437,13 +533,13 @@ void BLInstrumentationEdge::setIsCounterIncrement(bool isCounterIncrement) {
 // weight.  The counter increment is counts the number of executions of
 // some path, whereas the path number keeps track of which path number
 // the program is on.
-long BLInstrumentationEdge::getIncrement() const {
+int64_t BLInstrumentationEdge::getIncrement() const {
   return(_increment);
 }
 
 // Set whether this edge will be instrumented with a path number
 // increment.
-void BLInstrumentationEdge::setIncrement(long increment) {
+void BLInstrumentationEdge::setIncrement(int64_t increment) {
   _increment = increment;
 }
 
@@ -664,7 +760,7 @@ void BLInstrumentationDag::generateDotGraph() {
 		dotFile << "\t\"" << sourceName.c_str() << "\" -> \""
 			<< targetName.c_str() << "\" ";
 
-		long inc = ((BLInstrumentationEdge*)(*edge))->getIncrement();
+		int64_t inc = ((BLInstrumentationEdge*)(*edge))->getIncrement();
 
 		switch( (*edge)->getType() ) {
 		case BallLarusEdge::NORMAL:
@@ -824,7 +920,7 @@ void BLInstrumentationDag::pushCountersFromEdge(BLInstrumentationEdge* edge) {
 }
 
 // Depth first algorithm for determining the chord increments.
-void BLInstrumentationDag::calculateChordIncrementsDfs(long weight,
+void BLInstrumentationDag::calculateChordIncrementsDfs(int64_t weight,
     BallLarusNode* v, BallLarusEdge* e) {
   BLInstrumentationEdge* f;
 
@@ -869,6 +965,19 @@ int BLInstrumentationDag::calculateChordIncrementsDir(BallLarusEdge* e,
 static cl::opt<bool> DotPathDag("dot-pathdag",
 	cl::desc("Output the path profiling DAG for each function."));
 
+// Loop path profiling: the iterations recorded with each backedge path
+static cl::opt<unsigned> PathIterations("path-profile-iterations",
+	cl::init(0),
+	cl::desc("In path profiling, also count the paths of up to this many "
+           "consecutive iterations of each loop"));
+
+// Interprocedural path profiling: the callers recorded with each path
+static cl::opt<unsigned> PathContextDepth("path-profile-context",
+	cl::init(0),
+	cl::desc("In path profiling, also count the paths of each function in "
+           "the context of the path prefixes of up to this many callers "
+           "(needs -process-early-termination)"));
+
 // Register the path profiler as a pass
 char PathProfiler::ID = 0;
 static RegisterPass<PathProfiler>
@@ -878,16 +987,16 @@ X("insert-path-profiling",
 ModulePass *llvm::createPathProfilerPass() { return new PathProfiler(); }
 
 // Creates an increment constant representing incr.
-ConstantInt* PathProfiler::createIncrementConstant(long incr,
+ConstantInt* PathProfiler::createIncrementConstant(int64_t incr,
     int bitsize) {
-  return(ConstantInt::get(IntegerType::get(*Context, 32), incr));
+  return(ConstantInt::get(IntegerType::get(*Context, bitsize), incr, true));
 }
 
 // Creates an increment constant representing the value in
-// edge->getIncrement().
+// edge->getIncrement().  Path numbers are 64-bit.
 ConstantInt* PathProfiler::createIncrementConstant(
 		BLInstrumentationEdge* edge) {
-  return(createIncrementConstant(edge->getIncrement(), 32));
+  return(createIncrementConstant(edge->getIncrement(), 64));
 }
 
 // Finds the insertion point after pathNumber in block.  PathNumber may
@@ -918,7 +1027,7 @@ BasicBlock::iterator PathProfiler::getInsertionPoint(BasicBlock* block, Value*
 void PathProfiler::preparePHI(BLInstrumentationNode* node) {
 	BasicBlock* block = node->getBlock();
 	BasicBlock::iterator insertPoint = block->getFirstNonPHI();
-	PHINode* phi = PHINode::Create(Type::getInt32Ty(*Context), "pathNumber",
+	PHINode* phi = PHINode::Create(Type::getInt64Ty(*Context), "pathNumber",
 		insertPoint );
 	node->setPathPHI(phi);
 	node->setStartingPathNumber(phi);
@@ -929,7 +1038,7 @@ void PathProfiler::preparePHI(BLInstrumentationNode* node) {
 		BasicBlock* pred = (*predIt);
 
 		if(pred != NULL)
-			phi->addIncoming(createIncrementConstant((long)-1, 32), pred);
+			phi->addIncoming(createIncrementConstant(-1, 64), pred);
 	}
 }
 
@@ -999,7 +1108,7 @@ void PathProfiler::insertNumberIncrement(BLInstrumentationNode* node,
 // is a call to the runtime.
 void PathProfiler::insertCounterIncrement(Value* incValue,
 		BasicBlock::iterator insertPoint,
-		BLInstrumentationDag* dag, bool increment) {
+		BLInstrumentationDag* dag, bool increment, bool pathEnds) {
 	// Counter increment for array
 	if( dag->getNumberOfPaths() <= HASH_THRESHHOLD ) {
 		// Get pointer to the array location
@@ -1038,6 +1147,108 @@ void PathProfiler::insertCounterIncrement(Value* incValue,
 			increment ? llvmIncrementHashFunction : llvmDecrementHashFunction,
 			args.begin(), args.end(), "", insertPoint);
 	}
+
+	// Count the path in the context of the callers
+	if( profileContexts && increment && pathEnds ) {
+		Value* args[2] = {
+			ConstantInt::get(Type::getInt32Ty(*Context), currentFunctionNumber),
+			incValue };
+		CallInst::Create(llvmIncrementContextFunction, args, args+2, "",
+			insertPoint);
+	}
+}
+
+// Numbers the loop headers (the backedge targets) by their position in
+// the function, before the instrumentation adds blocks.
+void PathProfiler::findLoopHeaders(BLInstrumentationDag& dag) {
+	loopHeaders.clear();
+	std::set<BasicBlock*> headers;
+	const BLEdgeVector& backEdges = dag.getBackEdges();
+	for( unsigned i = 0, E = backEdges.size(); i != E; ++i )
+		headers.insert(backEdges[i]->getTarget()->getBlock());
+
+	Function& F = dag.getFunction();
+	unsigned blockNumber = 0;
+	for( Function::iterator BB = F.begin(), E = F.end(); BB != E;
+			++BB, ++blockNumber )
+		if( headers.count(BB) )
+			loopHeaders[BB] = blockNumber;
+}
+
+// Reports the iteration path pathNumber of the loop of header.
+void PathProfiler::insertLoopPath(BasicBlock* header, Value* pathNumber,
+		BasicBlock::iterator insertPoint) {
+	std::map<BasicBlock*, unsigned>::iterator loop = loopHeaders.find(header);
+	if( loop == loopHeaders.end() )
+		return;
+
+	Value* args[3] = {
+		ConstantInt::get(Type::getInt32Ty(*Context), currentFunctionNumber),
+		ConstantInt::get(Type::getInt32Ty(*Context), loop->second),
+		pathNumber };
+	CallInst::Create(llvmLoopPathFunction, args, args+3, "", insertPoint);
+}
+
+// Every execution of a header (fresh or after a backedge) tells the
+// runtime; a header not reached from a backedge starts a new sequence.
+void PathProfiler::insertLoopHeaders() {
+	for( std::map<BasicBlock*, unsigned>::iterator H = loopHeaders.begin(),
+			E = loopHeaders.end(); H != E; ++H ) {
+		Value* args[2] = {
+			ConstantInt::get(Type::getInt32Ty(*Context), currentFunctionNumber),
+			ConstantInt::get(Type::getInt32Ty(*Context), H->second) };
+		CallInst::Create(llvmLoopHeaderFunction, args, args+2, "",
+			H->first->getFirstNonPHI());
+	}
+}
+
+// Collects the calls of F that push a context frame: those that may
+// reach instrumented code.
+void PathProfiler::findContextCalls(Function &F) {
+	contextCalls.clear();
+	for( Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB )
+		for( BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I ) {
+			CallInst* call = dyn_cast<CallInst>(I);
+			if( call && !isa<IntrinsicInst>(call)
+					&& !isa<InlineAsm>(call->getCalledValue()) )
+				contextCalls[BB].push_back(call);
+		}
+}
+
+// Pushes the path prefix pathNumber (the path that ends at block) around
+// every call of block.
+void PathProfiler::insertContextFrames(BasicBlock* block, Value* pathNumber) {
+	std::vector<CallInst*>& calls = contextCalls[block];
+	for( unsigned i = 0, E = calls.size(); i != E; ++i ) {
+		Value* args[2] = {
+			ConstantInt::get(Type::getInt32Ty(*Context), currentFunctionNumber),
+			pathNumber };
+		CallInst* depth = CallInst::Create(llvmContextPushFunction, args, args+2,
+			"contextDepth", calls[i]);
+
+		BasicBlock::iterator after = calls[i];
+		++after;
+		CallInst::Create(llvmContextPopFunction, depth, "", after);
+	}
+}
+
+// Restores the depth of the stack at the entry of F at its landing pads:
+// the calls an exception unwound did not pop their frames.
+void PathProfiler::insertContextRestores(Function &F) {
+	std::set<BasicBlock*> landingPads;
+	for( Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB )
+		if( InvokeInst* invoke = dyn_cast<InvokeInst>(BB->getTerminator()) )
+			landingPads.insert(invoke->getUnwindDest());
+	if( landingPads.empty() )
+		return;
+
+	BasicBlock& entry = F.getEntryBlock();
+	CallInst* depth = CallInst::Create(llvmContextDepthFunction,
+		"contextDepth", entry.getFirstNonPHI());
+	for( std::set<BasicBlock*>::iterator BB = landingPads.begin(),
+			E = landingPads.end(); BB != E; ++BB )
+		CallInst::Create(llvmContextPopFunction, depth, "",
+			(*BB)->getFirstNonPHI());
 }
 
 // Inserts instrumentation for the given edge
@@ -1107,8 +1318,8 @@ void PathProfiler::insertInstrumentationStartingAt(BLInstrumentationEdge* edge,
 
 		// split edge has yet to be initialized
 		if( !instrumentNode->getEndingPathNumber() ) {
-			instrumentNode->setStartingPathNumber(createIncrementConstant(0,32));
-			instrumentNode->setEndingPathNumber(createIncrementConstant(0,32));
+			instrumentNode->setStartingPathNumber(createIncrementConstant(0,64));
+			instrumentNode->setEndingPathNumber(createIncrementConstant(0,64));
 		}
 
 		BasicBlock::iterator insertPoint = atBeginning ? instrumentNode->getBlock()->getFirstNonPHI() : instrumentNode->getBlock()->getTerminator();
@@ -1122,6 +1333,11 @@ void PathProfiler::insertInstrumentationStartingAt(BLInstrumentationEdge* edge,
 
 		insertCounterIncrement(instrumentNode->getEndingPathNumber(), insertPoint, dag);
 
+		// the path of one iteration of the loop
+		if( profileIterations && edge->getType() == BallLarusEdge::BACKEDGE )
+			insertLoopPath(targetNode->getBlock(),
+				instrumentNode->getEndingPathNumber(), insertPoint);
+
 		if( atBeginning )
 			instrumentNode->setStartingPathNumber(createIncrementConstant(top));
 
@@ -1206,20 +1422,23 @@ void PathProfiler::insertInstrumentation(
 		if( node->getStartingPathNumber() ) {
 			if ( ((BLInstrumentationEdge*)(*edge))->getIncrement() )
 				newpn = BinaryOperator::Create(Instruction::Add, node->getStartingPathNumber(),
-					createIncrementConstant(((BLInstrumentationEdge*)(*edge))->getIncrement(),32), "pathNumber", insertPoint);
+					createIncrementConstant((BLInstrumentationEdge*)(*edge)), "pathNumber", insertPoint);
 			else
 				newpn = node->getStartingPathNumber();
 		} else {
-			newpn = (Value*)createIncrementConstant(((BLInstrumentationEdge*)(*edge))->getIncrement(), 32);
+			newpn = (Value*)createIncrementConstant((BLInstrumentationEdge*)(*edge));
 		}
 
-		insertCounterIncrement(newpn, insertPoint, &dag);
+		insertCounterIncrement(newpn, insertPoint, &dag, true, false);
 		insertCounterIncrement(newpn, node->getBlock()->getTerminator(), &dag, false);
+
+		if( profileContexts )
+			insertContextFrames(node->getBlock(), newpn);
 	}
 }
 
 // Entry point of the module
-void PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Module &M) {
+bool PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Module &M) {
   // Build DAG from CFG
   BLInstrumentationDag dag = BLInstrumentationDag(F);
   dag.init();
@@ -1227,6 +1446,13 @@ void PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Mo
   // give each path a unique integer value
   dag.calculatePathNumbers();
 
+  // Even after splitting the count overflowed (-path-split-threshold is
+  // too large): leave the function out, as if it were skipped
+  if( dag.hasPathOverflow() ) {
+    addPrunedFunction(ftInit);
+    return(false);
+  }
+
   // modify path increments to increase the efficiency
   // of instrumentation
   dag.calculateSpanningTree();
@@ -1239,6 +1465,11 @@ void PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Mo
   if (DotPathDag)
 		dag.generateDotGraph ();
 
+	if( profileContexts )
+		findContextCalls(F);
+	if( profileIterations )
+		findLoopHeaders(dag);
+
 	// Should we store the information in an array or hash
 	if( dag.getNumberOfPaths() <= HASH_THRESHHOLD ) {
 		const Type* t = ArrayType::get(Type::getInt32Ty(*Context),
@@ -1249,6 +1480,16 @@ void PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Mo
 	}
 
 	insertInstrumentation(dag, M);
+	if( profileContexts )
+		insertContextRestores(F);
+	if( profileIterations )
+		insertLoopHeaders();
+
+	// Sample the counters (-profile-sample-interval), and keep the
+	// counters of paths with a constant number in registers
+	InsertSampleChecks(F, dag.getCounterArray());
+	if( dag.getCounterArray() )
+		PromoteCounterIncrements(F, dag.getCounterArray());
 
 	// Add to global function reference table
 	unsigned type;
@@ -1260,9 +1501,12 @@ void PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Mo
 		type = PP_HASH;
 	}
 
+	// the size is only read for arrays; hash tables may not fit in it
+	uint64_t numberOfPaths = dag.getNumberOfPaths();
 	std::vector<Constant*> entryArray(3);
 	entryArray[0] = createIncrementConstant(type,32);
-	entryArray[1] = createIncrementConstant(dag.getNumberOfPaths(),32);
+	entryArray[1] = createIncrementConstant(
+		numberOfPaths > ~0U ? ~0U : numberOfPaths, 32);
 	entryArray[2] = dag.getCounterArray() ?
 		ConstantExpr::getBitCast(dag.getCounterArray(), voidPtr) :
 		Constant::getNullValue(voidPtr);
@@ -1270,6 +1514,68 @@ void PathProfiler::runOnFunction(std::vector<Constant*> &ftInit, Function &F, Mo
 	const StructType* at = ftEntryTypeBuilder::get(*Context);
   ConstantStruct* functionEntry = (ConstantStruct*)ConstantStruct::get(at, entryArray);
   ftInit.push_back(functionEntry);
+  return(true);
+}
+
+// A function converged if the profile has enough runs and, in every run,
+// it never ran or it took one path only.
+void PathProfiler::findPrunedFunctions(Module &M) {
+  prunedFunctions.clear();
+  CPFactory* fact = LoadPruningProfile(M);
+  if( !fact )
+    return;
+  CombinedPathProfile* pathCP = fact->takePathCP();
+  delete fact;
+  if( !pathCP )
+    return;
+
+  PathSet paths;
+  pathCP->getPathSet(paths);
+
+  // function number --> its paths that ran in some run.  A function
+  // counts the runs that instrumented it.
+  std::map<unsigned, std::vector<PathIndex> > livePaths;
+  for( PathSet::iterator P = paths.begin(), E = paths.end(); P != E; ++P )
+    if( !HasConvergedTo(&pathCP->getHistogram(*P),
+                        pathCP->getKnownWeight(P->first), 0) )
+      livePaths[P->first].push_back(P->second);
+
+  unsigned functionNumber = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; F++) {
+    if (F->isDeclaration())
+      continue;
+    functionNumber++;
+    double runs = pathCP->getKnownWeight(functionNumber);
+
+    std::map<unsigned, std::vector<PathIndex> >::iterator live =
+      livePaths.find(functionNumber);
+    if( live == livePaths.end() ) {
+      if( HasConvergedTo(0, runs, 0) )
+        prunedFunctions[functionNumber] = NoPath;
+    } else if( live->second.size() == 1 ) {
+      PathIndex path = live->second[0];
+      if( HasConvergedTo(&pathCP->getHistogram(functionNumber, path),
+                         runs, 1.0) )
+        prunedFunctions[functionNumber] = path;
+    }
+  }
+
+  NumFunctionsPruned += prunedFunctions.size();
+  delete pathCP;
+}
+
+// A function that is not instrumented has an empty array: it writes no
+// paths.
+void PathProfiler::addPrunedFunction(std::vector<Constant*> &ftInit) {
+  const Type* voidPtr = TypeBuilder<types::i<8>*, true>::get(*Context);
+
+  std::vector<Constant*> entryArray(3);
+  entryArray[0] = createIncrementConstant(PP_ARRAY,32);
+  entryArray[1] = createIncrementConstant(0,32);
+  entryArray[2] = Constant::getNullValue(voidPtr);
+
+  const StructType* at = ftEntryTypeBuilder::get(*Context);
+  ftInit.push_back(ConstantStruct::get(at, entryArray));
 }
 
 // Output the bitcode if we want to observe instrumentation changess
@@ -1307,16 +1613,68 @@ bool PathProfiler::runOnModule(Module &M) {
   llvmIncrementHashFunction = M.getOrInsertFunction("llvm_increment_path_count",
       Type::getVoidTy(*Context), // return type
       Type::getInt32Ty(*Context), // function number
-      Type::getInt32Ty(*Context), // path number
+      Type::getInt64Ty(*Context), // path number
       NULL );
 
 	llvmDecrementHashFunction = M.getOrInsertFunction("llvm_decrement_path_count",
       Type::getVoidTy(*Context), // return type
       Type::getInt32Ty(*Context), // function number
-      Type::getInt32Ty(*Context), // path number
+      Type::getInt64Ty(*Context), // path number
       NULL );
 
+  // Context paths need the paths that end at calls
+  profileContexts = PathContextDepth > 0;
+  if( profileContexts && !BallLarusDag::hasCallEdges() ) {
+    errs() << "WARNING: -path-profile-context needs "
+           << "-process-early-termination, ignoring it\n";
+    profileContexts = false;
+  }
+  if( profileContexts ) {
+    llvmContextPushFunction = M.getOrInsertFunction("llvm_path_context_push",
+        Type::getInt32Ty(*Context), // return type: the depth before
+        Type::getInt32Ty(*Context), // function number
+        Type::getInt64Ty(*Context), // path prefix number
+        NULL );
+    llvmContextPopFunction = M.getOrInsertFunction("llvm_path_context_pop",
+        Type::getVoidTy(*Context), // return type
+        Type::getInt32Ty(*Context), // the depth to restore
+        NULL );
+    llvmContextDepthFunction = M.getOrInsertFunction(
+        "llvm_path_context_depth",
+        Type::getInt32Ty(*Context), NULL );
+    llvmIncrementContextFunction = M.getOrInsertFunction(
+        "llvm_increment_context_path",
+        Type::getVoidTy(*Context), // return type
+        Type::getInt32Ty(*Context), // function number
+        Type::getInt64Ty(*Context), // path number
+        NULL );
+  }
+
+  // Sequences of iterations need at least two
+  profileIterations = PathIterations > 1;
+  if( profileIterations ) {
+    llvmLoopPathFunction = M.getOrInsertFunction("llvm_loop_path",
+        Type::getVoidTy(*Context), // return type
+        Type::getInt32Ty(*Context), // function number
+        Type::getInt32Ty(*Context), // loop (header block) number
+        Type::getInt64Ty(*Context), // path number
+        NULL );
+    llvmLoopHeaderFunction = M.getOrInsertFunction("llvm_loop_header",
+        Type::getVoidTy(*Context), // return type
+        Type::getInt32Ty(*Context), // function number
+        Type::getInt32Ty(*Context), // loop (header block) number
+        NULL );
+  }
+
+  // The functions not to instrument keep their function numbers.
+  std::set<const Function*> skipped;
+  SelectInstrumentedFunctions(M, skipped);
+
+  findPrunedFunctions(M);
+
 	std::vector<Constant*> ftInit;
+  std::vector<unsigned> first;  // the function numbers, for the counter map
+  std::vector<unsigned> converged;  // function, path pairs that always ran
   unsigned functionNumber = 0;
   for (Module::iterator F = M.begin(), E = M.end(); F != E; F++) {
     if (F->isDeclaration())
@@ -1324,10 +1682,31 @@ bool PathProfiler::runOnModule(Module &M) {
 
     DEBUG(dbgs() << "Function: " << F->getNameStr() << "\n");
     functionNumber++;
+    first.push_back(functionNumber);
+
+    if( skipped.count(F) ) {
+      DEBUG(dbgs() << "  skipped, not instrumented\n");
+      addPrunedFunction(ftInit);
+      continue;
+    }
+
+    std::map<unsigned,PathIndex>::iterator pruned =
+      prunedFunctions.find(functionNumber);
+    if( pruned != prunedFunctions.end() ) {
+      DEBUG(dbgs() << "  converged, not instrumented\n");
+      addPrunedFunction(ftInit);
+      if( pruned->second != NoPath ) {
+        converged.push_back(functionNumber);
+        converged.push_back((unsigned)pruned->second);
+        converged.push_back((unsigned)(pruned->second >> 32));
+      }
+      continue;
+    }
 
     // set function number
 		currentFunctionNumber = functionNumber;
-		runOnFunction(ftInit, *F, M);
+		if( !runOnFunction(ftInit, *F, M) )
+		  skipped.insert(F);
   }
 
 	const Type *t = ftEntryTypeBuilder::get(*Context);
@@ -1342,6 +1721,34 @@ bool PathProfiler::runOnModule(Module &M) {
 
   InsertProfilingInitCall(Main, "llvm_start_path_profiling", functionTable,
 		PointerType::getUnqual(ftArrayType->getTypeAtIndex((unsigned)0)));
+  InsertSampleInfoInitCall(Main);
+  InsertCounterMapInitCall(Main, PathInfo, first, skipped);
+  InsertPrunedCountersInitCall(Main, PathInfo, converged);
+
+  // The runtime records at most PP_MAX_CONTEXT callers
+  if( profileContexts ) {
+    unsigned depth = std::min((unsigned)PathContextDepth,
+                              (unsigned)PP_MAX_CONTEXT);
+    const ArrayType* infoType = ArrayType::get(Type::getInt32Ty(*Context), 1);
+    std::vector<Constant*> info(1, createIncrementConstant(depth, 32));
+    GlobalVariable* contextInfo = new GlobalVariable(M, infoType, true,
+        GlobalValue::InternalLinkage, ConstantArray::get(infoType, info),
+        "PathContextInfo");
+    InsertProfilingInitCall(Main, "llvm_start_context_path_profiling",
+        contextInfo);
+  }
+
+  // The runtime records at most PP_MAX_ITERATIONS iterations
+  if( profileIterations ) {
+    unsigned iterations = std::min((unsigned)PathIterations,
+                                   (unsigned)PP_MAX_ITERATIONS);
+    const ArrayType* infoType = ArrayType::get(Type::getInt32Ty(*Context), 1);
+    std::vector<Constant*> info(1, createIncrementConstant(iterations, 32));
+    GlobalVariable* loopInfo = new GlobalVariable(M, infoType, true,
+        GlobalValue::InternalLinkage, ConstantArray::get(infoType, info),
+        "PathLoopInfo");
+    InsertProfilingInitCall(Main, "llvm_start_loop_path_profiling", loopInfo);
+  }
 
   DEBUG(PRINT_MODULE);
 
@@ -14,12 +14,96 @@
 //
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "profiling-utils"
 #include "ProfilingUtils.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
+#include "llvm/Operator.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPHistogram.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ProfileInfoLoader.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+using namespace llvm;
+
+STATISTIC(NumCountersPromoted, "Number of loop counters kept in registers");
+STATISTIC(NumCounterFlushes, "Number of promoted counter flushes inserted");
+STATISTIC(NumFunctionsSampled, "Number of functions given a checking copy");
+STATISTIC(NumSampleChecks, "Number of sampling checks inserted");
+STATISTIC(NumFunctionsSkipped, "Number of functions left uninstrumented");
+
+static cl::opt<bool>
+PromoteCounters("profile-promote-counters", cl::init(true), cl::Hidden,
+                cl::desc("Keep the profile counters of loops in registers"));
+
+static cl::opt<unsigned>
+PromoteMaxFlushes("profile-promote-max-flushes", cl::init(256), cl::Hidden,
+                  cl::desc("Max flushes of promoted counters per loop nest"));
+
+static cl::opt<std::string>
+PruneProfile("profile-prune-cp", cl::init(""),
+             cl::desc("Do not instrument what has converged in this "
+                      "(combined) profile"));
+
+static cl::opt<unsigned>
+PruneMinRuns("profile-prune-min-runs", cl::init(10),
+             cl::desc("Runs a profile needs before pruning by it"));
+
+static cl::opt<double>
+PruneEps("profile-prune-eps", cl::init(0.0),
+         cl::desc("Spread around 0 or 1.0 that still counts as converged"));
+
+static cl::opt<unsigned>
+SampleInterval("profile-sample-interval", cl::init(0),
+               cl::desc("Run the instrumented code once every N checks "
+                        "(0: always)"));
+
+static cl::opt<unsigned>
+SampleBurst("profile-sample-burst", cl::init(1),
+            cl::desc("Checks instrumented per sample (at most the "
+                     "interval)"));
+
+static cl::opt<std::string>
+ProfileOnly("profile-only", cl::init(""),
+            cl::desc("Only instrument the functions matching this regex"));
+
+static cl::opt<std::string>
+ProfileSkip("profile-skip", cl::init(""),
+            cl::desc("Do not instrument the functions matching this regex"));
+
+static cl::opt<std::string>
+ProfileList("profile-list", cl::init(""),
+            cl::desc("File of functions to instrument, one per line "
+                     "(!name: do not instrument)"));
+
+static cl::opt<std::string>
+ProfileHot("profile-hot", cl::init(""),
+           cl::desc("Only instrument the hot functions of this raw edge "
+                    "profile"));
+
+static cl::opt<double>
+ProfileHotCoverage("profile-hot-coverage", cl::init(0.99),
+                   cl::desc("Fraction of the edge executions of -profile-hot "
+                            "the hot functions cover"));
 
 void llvm::InsertProfilingInitCall(Function *MainFn, const char *FnName,
                                    GlobalValue *Array,
@@ -155,3 +239,1030 @@ void llvm::IncrementCounterInBlock(BasicBlock *BB, unsigned CounterNum,
   new StoreInst(NewVal, ElementPtr, InsertPos);
 
 }
+
+namespace {
+  // One counter increment as emitted by IncrementCounterInBlock: a load,
+  // an add of 1 (or of "Old < UINT_MAX" when saturating) and a store.
+  struct CounterIncrement {
+    StoreInst *Store;
+    unsigned Counter;
+    unsigned Segment;   // calls before the increment in its block
+    bool Saturating;
+  };
+
+  // Counters that are always incremented together share one delta.
+  struct CounterGroup {
+    std::vector<unsigned> Counters;
+    bool Saturating;
+  };
+
+  // A place where the deltas are added to the array: before Pos, with the
+  // value the deltas have at the end of Block.
+  struct CounterFlush {
+    Instruction *Pos;
+    BasicBlock *Block;
+  };
+}
+
+/// getCounterNum - Return the number of the counter of CounterArray that
+/// Ptr points to, or -1 if Ptr is not a constant index into the array.
+static int getCounterNum(Value *Ptr, GlobalValue *CounterArray) {
+  GEPOperator *GEP = dyn_cast<GEPOperator>(Ptr);
+  if (!GEP || GEP->getPointerOperand() != CounterArray ||
+      GEP->getNumIndices() != 2)
+    return -1;
+  ConstantInt *Zero = dyn_cast<ConstantInt>(GEP->getOperand(1));
+  ConstantInt *Idx = dyn_cast<ConstantInt>(GEP->getOperand(2));
+  if (!Zero || !Zero->isZero() || !Idx)
+    return -1;
+  return (int)Idx->getZExtValue();
+}
+
+/// refersToArray - Return true if V is CounterArray or an address in it.
+static bool refersToArray(Value *V, GlobalValue *CounterArray) {
+  V = V->stripPointerCasts();
+  if (GEPOperator *GEP = dyn_cast<GEPOperator>(V))
+    V = GEP->getPointerOperand()->stripPointerCasts();
+  return V == CounterArray;
+}
+
+/// isFlushingCall - Calls may read the counters (the profile is written
+/// at exit) or increment them again (recursion): the promoted counters
+/// are flushed before them.  Intrinsics do neither.
+static bool isFlushingCall(Instruction *I) {
+  return (isa<CallInst>(I) || isa<InvokeInst>(I)) && !isa<IntrinsicInst>(I);
+}
+
+/// matchIncrement - Recognize the increment sequence that ends in SI.
+static bool matchIncrement(StoreInst *SI, GlobalValue *CounterArray,
+                           CounterIncrement &Inc) {
+  int Counter = getCounterNum(SI->getPointerOperand(), CounterArray);
+  if (Counter < 0 || SI->isVolatile())
+    return false;
+  BinaryOperator *Add = dyn_cast<BinaryOperator>(SI->getValueOperand());
+  if (!Add || Add->getOpcode() != Instruction::Add || !Add->hasOneUse() ||
+      Add->getParent() != SI->getParent())
+    return false;
+  LoadInst *Old = dyn_cast<LoadInst>(Add->getOperand(0));
+  if (!Old || Old->isVolatile() || Old->getParent() != SI->getParent() ||
+      getCounterNum(Old->getPointerOperand(), CounterArray) != Counter)
+    return false;
+
+  Value *Step = Add->getOperand(1);
+  if (ConstantInt *One = dyn_cast<ConstantInt>(Step)) {
+    if (!One->isOne() || !Old->hasOneUse())
+      return false;
+    Inc.Saturating = false;
+  } else {
+    // select (icmp ult Old, UINT_MAX), 1, 0
+    SelectInst *Sel = dyn_cast<SelectInst>(Step);
+    if (!Sel || !Sel->hasOneUse())
+      return false;
+    ICmpInst *Cmp = dyn_cast<ICmpInst>(Sel->getCondition());
+    ConstantInt *T = dyn_cast<ConstantInt>(Sel->getTrueValue());
+    ConstantInt *F = dyn_cast<ConstantInt>(Sel->getFalseValue());
+    if (!Cmp || !Cmp->hasOneUse() || !T || !T->isOne() || !F || !F->isZero())
+      return false;
+    ConstantInt *Max = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+    if (Cmp->getPredicate() != CmpInst::ICMP_ULT ||
+        Cmp->getOperand(0) != Old || !Max || !Max->isAllOnesValue() ||
+        Old->getNumUses() != 2)
+      return false;
+    Inc.Saturating = true;
+  }
+
+  // Nothing may write memory between the load and the store.
+  for (BasicBlock::iterator I = Old; &*I != SI; ++I)
+    if (I->mayWriteToMemory())
+      return false;
+
+  Inc.Store = SI;
+  Inc.Counter = Counter;
+  return true;
+}
+
+/// eraseIncrement - Delete the load/add/store sequence of Inc.
+static void eraseIncrement(const CounterIncrement &Inc) {
+  BinaryOperator *Add = cast<BinaryOperator>(Inc.Store->getValueOperand());
+  LoadInst *Old = cast<LoadInst>(Add->getOperand(0));
+  Value *Step = Add->getOperand(1);
+  Value *Ptr = Old->getPointerOperand();
+  Value *StorePtr = Inc.Store->getPointerOperand();
+
+  Inc.Store->eraseFromParent();
+  Add->eraseFromParent();
+  if (SelectInst *Sel = dyn_cast<SelectInst>(Step)) {
+    Instruction *Cmp = cast<Instruction>(Sel->getCondition());
+    Sel->eraseFromParent();
+    Cmp->eraseFromParent();
+  }
+  Old->eraseFromParent();
+
+  // The path profiler addresses the counter with a GEP instruction.
+  if (Instruction *GEP = dyn_cast<Instruction>(Ptr))
+    if (GEP->use_empty())
+      GEP->eraseFromParent();
+  if (StorePtr != Ptr)
+    if (Instruction *GEP = dyn_cast<Instruction>(StorePtr))
+      if (GEP->use_empty())
+        GEP->eraseFromParent();
+}
+
+/// emitFlush - Add Delta to every counter of G, before Pos.  A saturating
+/// counter adds the 64-bit delta and saturates once, which gives the same
+/// count as saturating at each increment.  The uses of Delta are added to
+/// DeltaUses, if given.
+static void emitFlush(const CounterGroup &G, GlobalValue *CounterArray,
+                      Value *Delta, Instruction *Pos,
+                      std::vector<Use*> *DeltaUses = 0) {
+  LLVMContext &Context = Pos->getContext();
+  const Type *Int32 = Type::getInt32Ty(Context);
+  const Type *Int64 = Type::getInt64Ty(Context);
+  for (unsigned i = 0, e = G.Counters.size(); i != e; ++i) {
+    Constant *Indices[2];
+    Indices[0] = Constant::getNullValue(Int32);
+    Indices[1] = ConstantInt::get(Int32, G.Counters[i]);
+    Constant *ElementPtr =
+      ConstantExpr::getGetElementPtr(CounterArray, Indices, 2);
+
+    Value *OldVal = new LoadInst(ElementPtr, "OldCounter", Pos);
+    Value *NewVal;
+    if (G.Saturating) {
+      Value *Wide = new ZExtInst(OldVal, Int64, "OldCounter.ext", Pos);
+      BinaryOperator *Sum = BinaryOperator::Create(Instruction::Add, Wide,
+                                                   Delta, "SumCounter", Pos);
+      if (DeltaUses)
+        DeltaUses->push_back(&Sum->getOperandUse(1));
+      Value *Over = new ICmpInst(Pos, CmpInst::ICMP_UGT, Sum,
+                                 ConstantInt::get(Int64, 0xffffffffULL),
+                                 "isOver");
+      Value *Low = new TruncInst(Sum, Int32, "SumCounter.trunc", Pos);
+      NewVal = SelectInst::Create(Over, ConstantInt::get(Int32, 0xffffffff),
+                                  Low, "NewCounter", Pos);
+    } else {
+      BinaryOperator *Add = BinaryOperator::Create(Instruction::Add, OldVal,
+                                                   Delta, "NewCounter", Pos);
+      if (DeltaUses)
+        DeltaUses->push_back(&Add->getOperandUse(1));
+      NewVal = Add;
+    }
+    new StoreInst(NewVal, ElementPtr, Pos);
+  }
+  ++NumCounterFlushes;
+}
+
+/// promoteInLoop - Promote the counters of CounterArray incremented in
+/// the loop nest L.  Returns the number of counters promoted.
+static unsigned promoteInLoop(Loop *L, GlobalValue *CounterArray) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return 0;
+
+  // Find the increments, and the counters that are used otherwise.
+  std::vector<CounterIncrement> Incs;
+  std::set<Instruction*> Matched;
+  std::set<unsigned> Unsafe;
+  unsigned NumCalls = 0;
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+        CounterIncrement Inc;
+        if (matchIncrement(SI, CounterArray, Inc)) {
+          Inc.Segment = NumCalls;
+          Incs.push_back(Inc);
+          BinaryOperator *Add = cast<BinaryOperator>(SI->getValueOperand());
+          Matched.insert(SI);
+          Matched.insert(Add);
+          Matched.insert(cast<Instruction>(Add->getOperand(0)));
+          if (SelectInst *Sel = dyn_cast<SelectInst>(Add->getOperand(1))) {
+            Matched.insert(Sel);
+            Matched.insert(cast<Instruction>(Sel->getCondition()));
+          }
+        }
+      }
+      if (isFlushingCall(I))
+        ++NumCalls;
+    }
+  if (Incs.empty())
+    return 0;
+
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      // Calls see the flushed counters; GEPs are checked at their users.
+      if (Matched.count(I) || isFlushingCall(I) || isa<GetElementPtrInst>(I))
+        continue;
+      for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+           OI != OE; ++OI) {
+        if (!refersToArray(*OI, CounterArray))
+          continue;
+        int Counter = getCounterNum((*OI)->stripPointerCasts(),
+                                    CounterArray);
+        if (Counter < 0)
+          return 0;   // may touch any counter
+        Unsafe.insert(Counter);
+      }
+    }
+
+  // Group the counters by the places they are incremented at.
+  std::map<unsigned, std::vector<std::pair<BasicBlock*, unsigned> > > Places;
+  std::map<unsigned, bool> Saturating;
+  for (unsigned i = 0, e = Incs.size(); i != e; ++i) {
+    unsigned Counter = Incs[i].Counter;
+    if (Saturating.count(Counter) &&
+        Saturating[Counter] != Incs[i].Saturating)
+      Unsafe.insert(Counter);
+    Saturating[Counter] = Incs[i].Saturating;
+    Places[Counter].push_back(std::make_pair(Incs[i].Store->getParent(),
+                                             Incs[i].Segment));
+  }
+
+  typedef std::pair<bool, std::vector<std::pair<BasicBlock*, unsigned> > >
+    GroupKey;
+  std::map<GroupKey, unsigned> GroupOf;
+  std::vector<CounterGroup> Groups;
+  std::map<unsigned, unsigned> CounterGroupOf;
+  unsigned NumPromoted = 0;
+  for (std::map<unsigned, bool>::iterator CI = Saturating.begin(),
+       CE = Saturating.end(); CI != CE; ++CI) {
+    if (Unsafe.count(CI->first))
+      continue;
+    GroupKey Key(CI->second, Places[CI->first]);
+    std::map<GroupKey, unsigned>::iterator GI = GroupOf.find(Key);
+    if (GI == GroupOf.end()) {
+      GI = GroupOf.insert(std::make_pair(Key, (unsigned)Groups.size())).first;
+      Groups.push_back(CounterGroup());
+      Groups.back().Saturating = CI->second;
+    }
+    Groups[GI->second].Counters.push_back(CI->first);
+    CounterGroupOf[CI->first] = GI->second;
+    ++NumPromoted;
+  }
+  if (Groups.empty())
+    return 0;
+
+  // Find where the loop is left.  A dedicated exit block gets one flush;
+  // other exit edges are flushed in the exiting block or split.
+  std::vector<std::pair<TerminatorInst*, unsigned> > SplitEdges;
+  std::vector<CounterFlush> Flushes;
+  std::set<BasicBlock*> Flushed;
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI) {
+    TerminatorInst *TI = (*BI)->getTerminator();
+    for (unsigned s = 0, e = TI->getNumSuccessors(); s != e; ++s) {
+      BasicBlock *Exit = TI->getSuccessor(s);
+      if (L->contains(Exit))
+        continue;
+      bool Dedicated = true;
+      for (pred_iterator PI = pred_begin(Exit), PE = pred_end(Exit);
+           PI != PE; ++PI)
+        if (!L->contains(*PI))
+          Dedicated = false;
+      if (Dedicated || e == 1) {
+        BasicBlock *Block = Dedicated ? Exit : *BI;
+        if (!Flushed.insert(Block).second)
+          continue;
+        CounterFlush Flush;
+        Flush.Pos = Dedicated ? Exit->getFirstNonPHI() : TI;
+        Flush.Block = Block;
+        Flushes.push_back(Flush);
+      } else if (isa<IndirectBrInst>(TI)) {
+        return 0;
+      } else {
+        SplitEdges.push_back(std::make_pair(TI, s));
+      }
+    }
+  }
+  if ((Flushes.size() + SplitEdges.size() + NumCalls) * Groups.size() >
+      PromoteMaxFlushes)
+    return 0;
+
+  for (unsigned i = 0, e = SplitEdges.size(); i != e; ++i) {
+    BasicBlock *NewBB = SplitCriticalEdge(SplitEdges[i].first,
+                                          SplitEdges[i].second);
+    CounterFlush Flush;
+    Flush.Pos = NewBB->getTerminator();
+    Flush.Block = NewBB;
+    Flushes.push_back(Flush);
+  }
+
+  // The increments of the first counter of a group stand for all of them.
+  std::set<StoreInst*> Leaders;
+  for (unsigned i = 0, e = Incs.size(); i != e; ++i) {
+    std::map<unsigned, unsigned>::iterator GI =
+      CounterGroupOf.find(Incs[i].Counter);
+    if (GI == CounterGroupOf.end())
+      continue;
+    if (Groups[GI->second].Counters[0] == Incs[i].Counter)
+      Leaders.insert(Incs[i].Store);
+  }
+
+  // Rewrite each group into a delta register: zero in the preheader, one
+  // more at each increment, flushed and reset to zero at each call.
+  for (unsigned g = 0, ge = Groups.size(); g != ge; ++g) {
+    CounterGroup &G = Groups[g];
+    LLVMContext &Context = Preheader->getContext();
+    const IntegerType *DeltaTy = G.Saturating ? Type::getInt64Ty(Context) :
+                                                Type::getInt32Ty(Context);
+    Constant *Zero = ConstantInt::get(DeltaTy, 0);
+    Constant *One = ConstantInt::get(DeltaTy, 1);
+    Value *Undef = UndefValue::get(DeltaTy);
+
+    SSAUpdater SSA;
+    SSA.Initialize(DeltaTy, "cnt.delta");
+    SSA.AddAvailableValue(Preheader, Zero);
+
+    std::vector<std::pair<BasicBlock*, std::vector<Use*> > > LiveIns;
+    for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+         BI != BE; ++BI) {
+      Value *Cur = 0;   // the value live into the block
+      std::vector<Use*> Uses;
+      std::vector<Instruction*> Insts;
+      for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+           I != E; ++I)
+        Insts.push_back(I);
+
+      for (unsigned i = 0, e = Insts.size(); i != e; ++i) {
+        Instruction *I = Insts[i];
+        if (isFlushingCall(I)) {
+          if (Cur != Zero)
+            emitFlush(G, CounterArray, Cur ? Cur : Undef, I,
+                      Cur ? 0 : &Uses);
+          Cur = Zero;
+        } else if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+          if (!Leaders.count(SI))
+            continue;
+          int Counter = getCounterNum(SI->getPointerOperand(), CounterArray);
+          if (CounterGroupOf[Counter] != g)
+            continue;
+          BinaryOperator *Add =
+            BinaryOperator::Create(Instruction::Add, Cur ? Cur : Undef, One,
+                                   "cnt.delta", SI);
+          if (!Cur)
+            Uses.push_back(&Add->getOperandUse(0));
+          Cur = Add;
+        }
+      }
+      if (Cur)
+        SSA.AddAvailableValue(*BI, Cur);
+      if (!Uses.empty())
+        LiveIns.push_back(std::make_pair(*BI, Uses));
+    }
+
+    for (unsigned i = 0, e = LiveIns.size(); i != e; ++i) {
+      Value *V = SSA.GetValueInMiddleOfBlock(LiveIns[i].first);
+      for (unsigned u = 0, ue = LiveIns[i].second.size(); u != ue; ++u)
+        LiveIns[i].second[u]->set(V);
+    }
+    for (unsigned i = 0, e = Flushes.size(); i != e; ++i)
+      emitFlush(G, CounterArray, SSA.GetValueAtEndOfBlock(Flushes[i].Block),
+                Flushes[i].Pos);
+  }
+
+  for (unsigned i = 0, e = Incs.size(); i != e; ++i)
+    if (CounterGroupOf.count(Incs[i].Counter))
+      eraseIncrement(Incs[i]);
+
+  NumCountersPromoted += NumPromoted;
+  return NumPromoted;
+}
+
+// Counter increments in loops serialize on memory.  Promote the counters
+// of each outermost loop to registers; the array is brought up to date
+// before every call and when the loop is left, so the profile written at
+// exit is the same.
+bool llvm::PromoteCounterIncrements(Function &F, GlobalValue *CounterArray) {
+  if (!PromoteCounters || !CounterArray || F.isDeclaration())
+    return false;
+
+  DominatorTreeBase<BasicBlock> DT(false);
+  DT.recalculate(F);
+  LoopInfoBase<BasicBlock, Loop> LI;
+  LI.Calculate(DT);
+
+  unsigned NumPromoted = 0;
+  for (LoopInfoBase<BasicBlock, Loop>::iterator I = LI.begin(), E = LI.end();
+       I != E; ++I)
+    NumPromoted += promoteInLoop(*I, CounterArray);
+  return NumPromoted != 0;
+}
+
+CPFactory *llvm::LoadPruningProfile(Module &M) {
+  if (PruneProfile.empty())
+    return 0;
+
+  CPFactory *Fact = new CPFactory(M);
+  Fact->buildProfiles(PruneProfile);
+  if (!Fact->hasEdgeCP() && !Fact->hasCallCP() && !Fact->hasPathCP()) {
+    errs() << "WARNING: no profile to prune by in '" << PruneProfile
+           << "', instrumenting everything\n";
+    delete Fact;
+    return 0;
+  }
+  return Fact;
+}
+
+// Converged means: seen in every one of at least -profile-prune-min-runs
+// runs, always within -profile-prune-eps of V (or never seen, for 0).
+bool llvm::HasConvergedTo(const CPHistogram *H, double Runs, double V) {
+  if (Runs < PruneMinRuns)
+    return false;
+  if (V == 0)
+    return !H || !H->nonZero() || H->max() <= PruneEps;
+  if (!H || H->nonZeroWeight() < Runs - 0.5)   // runs weigh 1
+    return false;
+  return H->min() >= V - PruneEps && H->max() <= V + PruneEps;
+}
+
+/// isInstrumentation - A store into CounterArray, or a call into the
+/// profiling runtime (the llvm_* functions of libprofile).
+static bool isInstrumentation(Instruction *I, GlobalValue *CounterArray) {
+  if (StoreInst *SI = dyn_cast<StoreInst>(I))
+    return CounterArray && refersToArray(SI->getPointerOperand(),
+                                         CounterArray);
+  if ((!isa<CallInst>(I) && !isa<InvokeInst>(I)) || isa<IntrinsicInst>(I) ||
+      !I->getType()->isVoidTy())
+    return false;
+  CallSite CS(I);
+  Function *Callee = CS.getCalledFunction();
+  return Callee && Callee->isDeclaration() &&
+         Callee->getName().startswith("llvm_");
+}
+
+/// getSampleCounter - The module-wide sampling counter Name.
+static GlobalVariable *getSampleCounter(Module &M, const char *Name,
+                                        unsigned Init) {
+  if (GlobalVariable *GV = M.getNamedGlobal(Name))
+    return GV;
+  const Type *Int32 = Type::getInt32Ty(M.getContext());
+  return new GlobalVariable(M, Int32, false, GlobalValue::InternalLinkage,
+                            ConstantInt::get(Int32, Init), Name);
+}
+
+/// getSampleBurst - The checks instrumented per sample: at least one, and
+/// no more than there are in an interval.
+static unsigned getSampleBurst() {
+  unsigned Burst = std::max(1U, (unsigned)SampleBurst);
+  return std::min((unsigned)SampleInterval, Burst);
+}
+
+/// emitDecrement - Decrement Counter at the end of Block.  Returns the
+/// new value.
+static Value *emitDecrement(BasicBlock *Block, GlobalVariable *Counter) {
+  const Type *Int32 = Type::getInt32Ty(Block->getContext());
+  Value *Old = new LoadInst(Counter, "sample.cnt", Block);
+  Value *New = BinaryOperator::Create(Instruction::Sub, Old,
+                                      ConstantInt::get(Int32, 1),
+                                      "sample.cnt", Block);
+  new StoreInst(New, Counter, Block);
+  return New;
+}
+
+/// insertCountdown - End Block with "if (--Countdown <= 0) goto Taken;
+/// else goto NotTaken", replacing its terminator.  A check in the
+/// checking copy.
+static void insertCountdown(BasicBlock *Block, GlobalVariable *Countdown,
+                            BasicBlock *Taken, BasicBlock *NotTaken) {
+  if (TerminatorInst *TI = Block->getTerminator())
+    TI->eraseFromParent();
+  const Type *Int32 = Type::getInt32Ty(Block->getContext());
+  Value *New = emitDecrement(Block, Countdown);
+  Value *Done = new ICmpInst(*Block, CmpInst::ICMP_SLE, New,
+                             ConstantInt::get(Int32, 0), "sample.done");
+  BranchInst::Create(Taken, NotTaken, Done, Block);
+  ++NumSampleChecks;
+}
+
+/// insertBurstCheck - End Block with "--Countdown; if (--Burst >= 0) goto
+/// Instrumented;", then, the burst over, "if (Countdown <= 0) goto Fire;
+/// else goto Checking" in a new block, which is returned.  A check in the
+/// instrumented copy: it counts towards the interval as well.
+static BasicBlock *insertBurstCheck(BasicBlock *Block,
+                                   GlobalVariable *Countdown,
+                                   GlobalVariable *Burst, BasicBlock *Fire,
+                                   BasicBlock *Checking,
+                                   BasicBlock *Instrumented) {
+  if (TerminatorInst *TI = Block->getTerminator())
+    TI->eraseFromParent();
+  LLVMContext &Context = Block->getContext();
+  const Type *Int32 = Type::getInt32Ty(Context);
+  emitDecrement(Block, Countdown);
+  Value *New = emitDecrement(Block, Burst);
+  Value *Over = new ICmpInst(*Block, CmpInst::ICMP_SLT, New,
+                             ConstantInt::get(Int32, 0), "sample.over");
+
+  BasicBlock *End = BasicBlock::Create(Context, "sample.end",
+                                       Block->getParent(), Fire);
+  Value *Left = new LoadInst(Countdown, "sample.cnt", End);
+  Value *Done = new ICmpInst(*End, CmpInst::ICMP_SLE, Left,
+                             ConstantInt::get(Int32, 0), "sample.done");
+  BranchInst::Create(Fire, Checking, Done, End);
+
+  BranchInst::Create(End, Instrumented, Over, Block);
+  ++NumSampleChecks;
+  return End;
+}
+
+/// insertEntryCheck - End Dispatch, the check at the entry of F, with
+/// "--Countdown; if (Burst > 0) { --Burst; goto Instrumented; }", then
+/// the countdown to Fire or Checking.  A call made during a burst thus
+/// takes its share of the burst.
+static void insertEntryCheck(BasicBlock *Dispatch, GlobalVariable *Countdown,
+                             GlobalVariable *Burst, BasicBlock *Fire,
+                             BasicBlock *Checking, BasicBlock *Instrumented) {
+  LLVMContext &Context = Dispatch->getContext();
+  Function *F = Dispatch->getParent();
+  const Type *Int32 = Type::getInt32Ty(Context);
+  Value *New = emitDecrement(Dispatch, Countdown);
+  Value *Left = new LoadInst(Burst, "sample.burst", Dispatch);
+  Value *InBurst = new ICmpInst(*Dispatch, CmpInst::ICMP_SGT, Left,
+                                ConstantInt::get(Int32, 0), "sample.inburst");
+
+  BasicBlock *Cont = BasicBlock::Create(Context, "sample.burst", F,
+                                        Instrumented);
+  Value *Rest = BinaryOperator::Create(Instruction::Sub, Left,
+                                       ConstantInt::get(Int32, 1),
+                                       "sample.burst", Cont);
+  new StoreInst(Rest, Burst, Cont);
+  BranchInst::Create(Instrumented, Cont);
+
+  BasicBlock *Check = BasicBlock::Create(Context, "sample.check", F,
+                                         Instrumented);
+  Value *Done = new ICmpInst(*Check, CmpInst::ICMP_SLE, New,
+                             ConstantInt::get(Int32, 0), "sample.done");
+  BranchInst::Create(Fire, Checking, Done, Check);
+
+  BranchInst::Create(Cont, Check, InBurst, Dispatch);
+  ++NumSampleChecks;
+}
+
+/// createSampleFire - A block that starts a burst and goes to Target.
+/// Target is the burst's first check; the rest follow from Burst.
+static BasicBlock *createSampleFire(BasicBlock *Target, BasicBlock *Before,
+                                   GlobalVariable *Countdown,
+                                   GlobalVariable *Burst) {
+  LLVMContext &Context = Target->getContext();
+  const Type *Int32 = Type::getInt32Ty(Context);
+  BasicBlock *Fire = BasicBlock::Create(Context, "sample.fire",
+                                        Target->getParent(), Before);
+  new StoreInst(ConstantInt::get(Int32, SampleInterval), Countdown, Fire);
+  new StoreInst(ConstantInt::get(Int32, getSampleBurst() - 1), Burst, Fire);
+  BranchInst::Create(Target, Fire);
+  return Fire;
+}
+
+/// collectNonLocalUses - The uses of V outside its block, and by PHIs.
+static void collectNonLocalUses(Instruction *V, std::vector<Use*> &Uses) {
+  for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
+       UI != UE; ++UI) {
+    Instruction *User = dyn_cast<Instruction>(*UI);
+    if (User && (User->getParent() != V->getParent() || isa<PHINode>(User)))
+      Uses.push_back(&UI.getUse());
+  }
+}
+
+/// insertPreheader - Route the edges from Preds into Header through a new
+/// block, which gets the PHIs of their incoming values.
+static void insertPreheader(BasicBlock *Header,
+                            const std::set<BasicBlock*> &Preds) {
+  BasicBlock *NewBB = BasicBlock::Create(Header->getContext(),
+                                         Header->getName() + ".sample",
+                                         Header->getParent(), Header);
+  BranchInst::Create(Header, NewBB);
+  for (std::set<BasicBlock*>::const_iterator PI = Preds.begin(),
+       PE = Preds.end(); PI != PE; ++PI)
+    (*PI)->getTerminator()->replaceUsesOfWith(Header, NewBB);
+
+  for (BasicBlock::iterator I = Header->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    PHINode *NewPN = PHINode::Create(PN->getType(), PN->getName() + ".ph",
+                                     NewBB->getTerminator());
+    for (int i = PN->getNumIncomingValues() - 1; i >= 0; --i)
+      if (Preds.count(PN->getIncomingBlock(i))) {
+        NewPN->addIncoming(PN->getIncomingValue(i), PN->getIncomingBlock(i));
+        PN->removeIncomingValue(i, false);
+      }
+    PN->addIncoming(NewPN, NewBB);
+  }
+}
+
+// Arnold-Ryder sampling.  F becomes two copies of itself: the
+// instrumented code, and a checking copy without the instrumentation.
+// Execution starts in the checking copy; a countdown at the entry and on
+// every loop back-edge moves it into the instrumented copy once every
+// -profile-sample-interval checks.  A sample lasts -profile-sample-burst
+// checks, entries and back-edges alike, and every check counts towards
+// the interval in either copy: each check runs the instrumented code at
+// the same rate, burst / interval, so one scale fits all the counters.
+bool llvm::InsertSampleChecks(Function &F, GlobalValue *CounterArray) {
+  if (!SampleInterval || F.isDeclaration() ||
+      F.getEntryBlock().getName() == "sample.dispatch")
+    return false;
+  // A block address would jump into the wrong copy.
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    if (BB->hasAddressTaken())
+      return false;
+
+  // Give each back-edge a block of its own to hold the checks.
+  std::vector<std::pair<TerminatorInst*, unsigned> > Edges;
+  {
+    DominatorTreeBase<BasicBlock> DT(false);
+    DT.recalculate(F);
+    LoopInfoBase<BasicBlock, Loop> LI;
+    LI.Calculate(DT);
+
+    std::vector<Loop*> Loops(LI.begin(), LI.end());
+    while (!Loops.empty()) {
+      Loop *L = Loops.back();
+      Loops.pop_back();
+      Loops.insert(Loops.end(), L->begin(), L->end());
+      BasicBlock *Header = L->getHeader();
+      std::set<BasicBlock*> Latches;
+      for (pred_iterator PI = pred_begin(Header), PE = pred_end(Header);
+           PI != PE; ++PI)
+        if (L->contains(*PI))
+          Latches.insert(*PI);
+      for (std::set<BasicBlock*>::iterator BI = Latches.begin(),
+           BE = Latches.end(); BI != BE; ++BI) {
+        TerminatorInst *TI = (*BI)->getTerminator();
+        if (isa<IndirectBrInst>(TI))
+          continue;
+        for (unsigned s = 0, e = TI->getNumSuccessors(); s != e; ++s)
+          if (TI->getSuccessor(s) == Header)
+            Edges.push_back(std::make_pair(TI, s));
+      }
+    }
+  }
+  std::vector<std::pair<BasicBlock*, BasicBlock*> > BackEdges;
+  for (unsigned i = 0, e = Edges.size(); i != e; ++i) {
+    TerminatorInst *TI = Edges[i].first;
+    BasicBlock *Header = TI->getSuccessor(Edges[i].second);
+    BasicBlock *Block = TI->getParent();
+    if (TI->getNumSuccessors() != 1)
+      Block = SplitCriticalEdge(TI, Edges[i].second);
+    else if (!isa<BranchInst>(TI))
+      Block = 0;
+    if (Block)
+      BackEdges.push_back(std::make_pair(Block, Header));
+  }
+
+  // The static allocas move to a new entry block shared by both copies.
+  LLVMContext &Context = F.getContext();
+  BasicBlock *Entry = &F.getEntryBlock();
+  BasicBlock *Dispatch = BasicBlock::Create(Context, "sample.dispatch", &F,
+                                            Entry);
+  BasicBlock::iterator FirstNonAlloca = Entry->begin();
+  while (isa<AllocaInst>(FirstNonAlloca))
+    ++FirstNonAlloca;
+  Dispatch->getInstList().splice(Dispatch->end(), Entry->getInstList(),
+                                 Entry->begin(), FirstNonAlloca);
+
+  // Clone the instrumented code.
+  ValueToValueMapTy VMap;
+  for (Function::arg_iterator AI = F.arg_begin(), AE = F.arg_end();
+       AI != AE; ++AI)
+    VMap[AI] = AI;
+  for (BasicBlock::iterator I = Dispatch->begin(), E = Dispatch->end();
+       I != E; ++I)
+    VMap[I] = I;
+  std::vector<BasicBlock*> Blocks;
+  std::vector<Instruction*> Values;
+  for (Function::iterator BB = Entry, E = F.end(); BB != E; ++BB) {
+    Blocks.push_back(BB);
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (!I->getType()->isVoidTy())
+        Values.push_back(I);
+  }
+  std::set<BasicBlock*> Checking;
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i) {
+    BasicBlock *Clone = CloneBasicBlock(Blocks[i], VMap, ".chk", &F);
+    VMap[Blocks[i]] = Clone;
+    Checking.insert(Clone);
+  }
+  std::vector<Instruction*> Stripped;
+  for (std::set<BasicBlock*>::iterator BI = Checking.begin(),
+       BE = Checking.end(); BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      RemapInstruction(I, VMap, false);
+      if (isInstrumentation(I, CounterArray))
+        Stripped.push_back(I);
+    }
+  for (unsigned i = 0, e = Stripped.size(); i != e; ++i)
+    Stripped[i]->eraseFromParent();
+
+  // The checks.
+  Module &M = *F.getParent();
+  GlobalVariable *Countdown = getSampleCounter(M, "SampleProfCountdown",
+                                               SampleInterval);
+  GlobalVariable *Burst = getSampleCounter(M, "SampleProfBurst", 0);
+  insertEntryCheck(Dispatch, Countdown, Burst,
+                   createSampleFire(Entry, Entry, Countdown, Burst),
+                   cast<BasicBlock>(VMap[Entry]), Entry);
+
+  std::map<BasicBlock*, std::set<BasicBlock*> > LatchesOf;
+  for (unsigned i = 0, e = BackEdges.size(); i != e; ++i) {
+    BasicBlock *Block = BackEdges[i].first;
+    BasicBlock *Header = BackEdges[i].second;
+    BasicBlock *ChkBlock = cast<BasicBlock>(VMap[Block]);
+    BasicBlock *ChkHeader = cast<BasicBlock>(VMap[Header]);
+
+    // A burst that ends when the interval does starts the next one.
+    BasicBlock *Fire = createSampleFire(Header, Header, Countdown, Burst);
+    BasicBlock *Refire = createSampleFire(Header, Header, Countdown, Burst);
+    insertCountdown(ChkBlock, Countdown, Fire, ChkHeader);
+    BasicBlock *End = insertBurstCheck(Block, Countdown, Burst, Refire,
+                                       ChkHeader, Header);
+    LatchesOf[Header].insert(Block);
+    LatchesOf[Header].insert(Refire);
+    for (BasicBlock::iterator I = Header->begin(); isa<PHINode>(I); ++I) {
+      PHINode *PN = cast<PHINode>(I);
+      Value *V = PN->getIncomingValueForBlock(Block);
+      Value *ChkV = VMap.lookup(V);
+      PN->addIncoming(ChkV ? ChkV : V, Fire);
+      PN->addIncoming(V, Refire);
+      cast<PHINode>(VMap[PN])->addIncoming(V, End);
+    }
+  }
+
+  // Across a switch between the copies, a value has two definitions.
+  if (!BackEdges.empty())
+    for (unsigned i = 0, e = Values.size(); i != e; ++i) {
+      Instruction *I = Values[i];
+      Instruction *ChkI = cast<Instruction>(VMap[I]);
+      std::vector<Use*> Uses;
+      collectNonLocalUses(I, Uses);
+      collectNonLocalUses(ChkI, Uses);
+      if (Uses.empty())
+        continue;
+      SSAUpdater SSA;
+      SSA.Initialize(I->getType(), I->getName());
+      SSA.AddAvailableValue(I->getParent(), I);
+      SSA.AddAvailableValue(ChkI->getParent(), ChkI);
+      for (unsigned u = 0, ue = Uses.size(); u != ue; ++u)
+        SSA.RewriteUse(*Uses[u]);
+    }
+
+  // What only fed the instrumentation is dead in the checking copy.
+  std::set<Instruction*> Live;
+  std::vector<Instruction*> Worklist;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (!Checking.count(BB) || I->mayHaveSideEffects() ||
+          isa<TerminatorInst>(I))
+        if (Live.insert(I).second)
+          Worklist.push_back(I);
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.back();
+    Worklist.pop_back();
+    for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+         OI != OE; ++OI)
+      if (Instruction *Op = dyn_cast<Instruction>(*OI))
+        if (Live.insert(Op).second)
+          Worklist.push_back(Op);
+  }
+  std::vector<Instruction*> Dead;
+  for (std::set<BasicBlock*>::iterator BI = Checking.begin(),
+       BE = Checking.end(); BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I)
+      if (!Live.count(I))
+        Dead.push_back(I);
+  for (unsigned i = 0, e = Dead.size(); i != e; ++i)
+    Dead[i]->dropAllReferences();
+  for (unsigned i = 0, e = Dead.size(); i != e; ++i)
+    Dead[i]->eraseFromParent();
+
+  // Give the instrumented loops a preheader again, for the promotion of
+  // their counters.
+  for (std::map<BasicBlock*, std::set<BasicBlock*> >::iterator
+       HI = LatchesOf.begin(), HE = LatchesOf.end(); HI != HE; ++HI) {
+    std::set<BasicBlock*> Outside;
+    for (pred_iterator PI = pred_begin(HI->first), PE = pred_end(HI->first);
+         PI != PE; ++PI)
+      if (!HI->second.count(*PI))
+        Outside.insert(*PI);
+    if (Outside.size() > 1)
+      insertPreheader(HI->first, Outside);
+  }
+
+  ++NumFunctionsSampled;
+  return true;
+}
+
+// The sampling rate goes in the profile ahead of the counters, so the
+// readers can scale them back up.
+void llvm::InsertSampleInfoInitCall(Function *MainFn) {
+  Module &M = *MainFn->getParent();
+  if (!SampleInterval || M.getNamedGlobal("SampleProfInfo"))
+    return;
+
+  const Type *Int32 = Type::getInt32Ty(M.getContext());
+  std::vector<Constant*> Rate(2);
+  Rate[0] = ConstantInt::get(Int32, SampleInterval);
+  Rate[1] = ConstantInt::get(Int32, getSampleBurst());
+  const ArrayType *ATy = ArrayType::get(Int32, Rate.size());
+  GlobalVariable *Info =
+    new GlobalVariable(M, ATy, true, GlobalValue::InternalLinkage,
+                       ConstantArray::get(ATy, Rate), "SampleProfInfo");
+  InsertProfilingInitCall(MainFn, "llvm_start_sample_profiling", Info);
+}
+
+/// readFunctionList - The names of -profile-list, to instrument (Only) or
+/// not (Skip, the names given as !name).  '#' starts a comment.
+static bool readFunctionList(std::set<std::string> &Only,
+                             std::set<std::string> &Skip) {
+  std::ifstream In(ProfileList.c_str());
+  if (!In) {
+    errs() << "WARNING: cannot open function list '" << ProfileList
+           << "', ignoring it\n";
+    return false;
+  }
+  const char *Blanks = " \t\r";
+  std::string Line;
+  while (std::getline(In, Line)) {
+    Line = Line.substr(0, Line.find('#'));
+    std::string::size_type B = Line.find_first_not_of(Blanks);
+    if (B == std::string::npos)
+      continue;
+    std::string Name = Line.substr(B, Line.find_last_not_of(Blanks) - B + 1);
+    if (Name[0] == '!')
+      Skip.insert(Name.substr(1));
+    else
+      Only.insert(Name);
+  }
+  return true;
+}
+
+static bool heavierFirst(const std::pair<double, const Function*> &A,
+                         const std::pair<double, const Function*> &B) {
+  return A.first > B.first;
+}
+
+/// findColdFunctions - The functions of M outside the hot set of the raw
+/// edge profile -profile-hot: the fewest functions whose edges cover
+/// -profile-hot-coverage of its edge executions.  Functions the profile
+/// knows nothing about (all of their counters Uncounted) are not cold.
+static void findColdFunctions(Module &M, std::set<const Function*> &Cold) {
+  if (FILE *F = fopen(ProfileHot.c_str(), "rb"))
+    fclose(F);
+  else {
+    errs() << "WARNING: cannot open hot profile '" << ProfileHot
+           << "', instrumenting every function\n";
+    return;
+  }
+
+  ProfileInfoLoader PIL("profile-hot", ProfileHot, M);
+  const std::vector<unsigned> &Counts = PIL.getRawEdgeCounts();
+
+  // The counters of each function, in the edge profiler's layout: the
+  // entry edge, then the successors of each block.
+  std::vector<std::pair<double, const Function*> > Weights;
+  double Total = 0;
+  unsigned i = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    unsigned End = i + 1;
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      End += BB->getTerminator()->getNumSuccessors();
+    if (End > Counts.size()) {
+      errs() << "WARNING: hot profile '" << ProfileHot
+             << "' does not match the module, instrumenting every "
+             << "function\n";
+      return;
+    }
+
+    double Weight = 0;
+    bool Known = false;
+    for (; i != End; ++i) {
+      if (Counts[i] == ProfileInfoLoader::Uncounted)
+        continue;
+      Weight += Counts[i];
+      Known = true;
+    }
+    if (Known) {
+      Weights.push_back(std::make_pair(Weight, (const Function*)&*F));
+      Total += Weight;
+    }
+  }
+
+  std::stable_sort(Weights.begin(), Weights.end(), heavierFirst);
+  double Covered = 0;
+  for (unsigned w = 0, e = Weights.size(); w != e; ++w) {
+    if (Total > 0 && Covered >= ProfileHotCoverage * Total)
+      Cold.insert(Weights[w].second);
+    Covered += Weights[w].first;
+  }
+}
+
+// A function is instrumented if it matches -profile-only, is listed in
+// -profile-list and is hot in -profile-hot (each when given), and does
+// not match -profile-skip or is listed as !name.
+bool llvm::SelectInstrumentedFunctions(Module &M,
+                                       std::set<const Function*> &Skipped) {
+  Skipped.clear();
+  if (ProfileOnly.empty() && ProfileSkip.empty() && ProfileList.empty() &&
+      ProfileHot.empty())
+    return false;
+
+  std::string Error;
+  Regex Only(ProfileOnly.empty() ? ".*" : ProfileOnly.c_str());
+  if (!Only.isValid(Error)) {
+    errs() << "WARNING: bad -profile-only regex: " << Error << "\n";
+    return false;
+  }
+  Regex Skip(ProfileSkip.empty() ? "^$" : ProfileSkip.c_str());
+  if (!Skip.isValid(Error)) {
+    errs() << "WARNING: bad -profile-skip regex: " << Error << "\n";
+    return false;
+  }
+
+  std::set<std::string> ListOnly, ListSkip;
+  if (!ProfileList.empty())
+    readFunctionList(ListOnly, ListSkip);
+  std::set<const Function*> Cold;
+  if (!ProfileHot.empty())
+    findColdFunctions(M, Cold);
+
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    std::string Name = F->getName();
+    if (!Only.match(Name) || Skip.match(Name) || ListSkip.count(Name) ||
+        (!ListOnly.empty() && !ListOnly.count(Name)) || Cold.count(F))
+      Skipped.insert(F);
+  }
+
+  NumFunctionsSkipped += Skipped.size();
+  if (!Skipped.empty())
+    errs() << "Leaving " << Skipped.size()
+           << " functions uninstrumented (-profile-only/-skip/-list/-hot)\n";
+  return !Skipped.empty();
+}
+
+void llvm::InsertCounterMapInitCall(Function *MainFn, ProfilingType PT,
+                                    const std::vector<unsigned> &First,
+                                    const std::set<const Function*> &Skipped) {
+  if (Skipped.empty())
+    return;
+  Module &M = *MainFn->getParent();
+
+  const Type *Int32 = Type::getInt32Ty(M.getContext());
+  std::vector<Constant*> Map;
+  Map.push_back(ConstantInt::get(Int32, PT));
+  unsigned f = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    assert(f < First.size() && "A defined function without counters!");
+    Map.push_back(ConstantInt::get(Int32, First[f++]));
+    Map.push_back(ConstantInt::get(Int32, !Skipped.count(F)));
+  }
+
+  const ArrayType *ATy = ArrayType::get(Int32, Map.size());
+  GlobalVariable *MapVar =
+    new GlobalVariable(M, ATy, true, GlobalValue::InternalLinkage,
+                       ConstantArray::get(ATy, Map), "CounterMap");
+  InsertProfilingInitCall(MainFn, "llvm_start_counter_map", MapVar);
+}
+
+void llvm::InsertCFGChecksumInitCall(Function *MainFn, ProfilingType PT,
+                                     const CFGLayout &Layout) {
+  Module &M = *MainFn->getParent();
+  std::vector<unsigned> Words;
+  CFGChecksum::encode(PT, Layout, Words);
+
+  const Type *Int32 = Type::getInt32Ty(M.getContext());
+  std::vector<Constant*> Checksums;
+  for (unsigned i = 0, e = Words.size(); i != e; ++i)
+    Checksums.push_back(ConstantInt::get(Int32, Words[i]));
+
+  const ArrayType *ATy = ArrayType::get(Int32, Checksums.size());
+  GlobalVariable *ChecksumVar =
+    new GlobalVariable(M, ATy, true, GlobalValue::InternalLinkage,
+                       ConstantArray::get(ATy, Checksums), "CFGChecksums");
+  InsertProfilingInitCall(MainFn, "llvm_start_cfg_checksum", ChecksumVar);
+}
+
+void llvm::InsertPrunedCountersInitCall(Function *MainFn, ProfilingType PT,
+                                        const std::vector<unsigned> &Pruned) {
+  if (Pruned.empty())
+    return;
+  Module &M = *MainFn->getParent();
+
+  const Type *Int32 = Type::getInt32Ty(M.getContext());
+  std::vector<Constant*> Words;
+  Words.push_back(ConstantInt::get(Int32, PT));
+  for (unsigned i = 0, e = Pruned.size(); i != e; ++i)
+    Words.push_back(ConstantInt::get(Int32, Pruned[i]));
+
+  const ArrayType *ATy = ArrayType::get(Int32, Words.size());
+  GlobalVariable *PrunedVar =
+    new GlobalVariable(M, ATy, true, GlobalValue::InternalLinkage,
+                       ConstantArray::get(ATy, Words), "PrunedCounters");
+  InsertProfilingInitCall(MainFn, "llvm_start_pruned_counters", PrunedVar);
+}
@@ -18,11 +18,18 @@
 #define PROFILINGUTILS_H
 
 #include "llvm/DerivedTypes.h"
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/Analysis/CFGChecksum.h"
+#include <set>
+#include <vector>
 
 namespace llvm {
   class Function;
   class GlobalValue;
   class BasicBlock;
+  class Module;
+  class CPFactory;
+  class CPHistogram;
 
   void InsertProfilingInitCall(Function *MainFn, const char *FnName,
                                GlobalValue *Arr = 0,
@@ -31,6 +38,64 @@ namespace llvm {
   void IncrementCounterInBlock(BasicBlock *BB, unsigned CounterNum,
                                GlobalValue *CounterArray, 
                                bool beginning = true, bool nowrap = false);
+  // Keep the counters of CounterArray that IncrementCounterInBlock
+  // increments inside the loops of F in registers, and add them to the
+  // array on the way out of each loop nest and before every call, so the
+  // array holds the same counts whenever anything else can read it.
+  // Counters incremented together share one register.  Returns true if
+  // anything was promoted (-profile-promote-counters).
+  bool PromoteCounterIncrements(Function &F, GlobalValue *CounterArray);
+
+  // Instrumentation pruning (-profile-prune-cp): the combined profiles of
+  // earlier runs of M, or null if pruning is off or nothing was loaded.
+  // Build it before M is changed.
+  CPFactory *LoadPruningProfile(Module &M);
+  // True if histogram H of a profile of Runs runs has converged to the
+  // point V (0 or 1.0) under -profile-prune-min-runs/-profile-prune-eps.
+  // A missing histogram is 0 in every run.
+  bool HasConvergedTo(const CPHistogram *H, double Runs, double V);
+
+  // Sampled instrumentation (-profile-sample-interval): split F, already
+  // instrumented with the counters of CounterArray and calls into the
+  // profiling runtime, into that code and a checking copy without them.
+  // Countdown checks at the entry and on the loop back-edges switch from
+  // the checking copy to the instrumented one once every interval, for
+  // -profile-sample-burst checks.  Call it before
+  // PromoteCounterIncrements; a function is only split once.  Returns
+  // true if F was split.
+  bool InsertSampleChecks(Function &F, GlobalValue *CounterArray);
+  // Have main write the sampling rate into the profile (SampleInfo), so
+  // the counts can be scaled back up.  Does nothing if not sampling.
+  void InsertSampleInfoInitCall(Function *MainFn);
+
+  // Selective instrumentation (-profile-only, -profile-skip,
+  // -profile-list, -profile-hot): the defined functions of M that are not
+  // to be instrumented.  Their counters keep their place in the arrays,
+  // so the counter indices of a partial profile are those of a full one.
+  // Call it before M is changed.  Returns true if any function is left
+  // out.
+  bool SelectInstrumentedFunctions(Module &M,
+                                   std::set<const Function*> &Skipped);
+  // Have main write the counter map of a partially instrumented module
+  // (CounterMapInfo) for the counters of type PT, so readers take the
+  // counters of the Skipped functions as unknown rather than 0.  First
+  // holds the index of the first counter of each defined function, in
+  // module order.  Does nothing if no function was skipped.
+  void InsertCounterMapInitCall(Function *MainFn, ProfilingType PT,
+                                const std::vector<unsigned> &First,
+                                const std::set<const Function*> &Skipped);
+  // Have main write the CFG checksums and counter ranges (CFGChecksumInfo)
+  // of the counters of type PT, so the run can be matched to a changed
+  // module.  Compute Layout before M is changed.
+  void InsertCFGChecksumInitCall(Function *MainFn, ProfilingType PT,
+                                 const CFGLayout &Layout);
+  // Have main write the counters of type PT that pruning left out
+  // (PrunedCounterInfo), so readers know them without a marker value in
+  // the counters.  Pruned holds counter indices, or (function number,
+  // path low word, path high word) triples for PathInfo.  Does nothing
+  // if nothing was pruned.
+  void InsertPrunedCountersInitCall(Function *MainFn, ProfilingType PT,
+                                    const std::vector<unsigned> &Pruned);
 }
 
 #endif
@@ -0,0 +1,177 @@
+//===- ValueProfiling.cpp - Insert argument value profiling ---------------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass instruments the specified program to record the most
+// frequent values of call arguments.  Every non-constant integer
+// argument of an FDO inlining candidate (a direct call to a defined
+// function) is a value site; a call to llvm_value_profile before the
+// call site records the argument in the site's table of VP_TOPK
+// (value, count) slots.
+//
+// Sites are numbered in module order: functions, blocks, call sites,
+// arguments.  This must match CombinedValueProfile::isValueSite.
+//
+//===----------------------------------------------------------------------===//
+#define DEBUG_TYPE "insert-value-profiling"
+
+#include "ProfilingUtils.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Support/CallSite.h"
+
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Instrumentation.h"
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumValueSites, "The # of argument value profiling sites");
+
+
+namespace llvm{
+
+  class ValueProfiler : public ModulePass {
+    bool runOnModule(Module &M);
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    ValueProfiler() : ModulePass(ID) {}
+
+    virtual const char *getPassName() const {return "Value Profiler";}
+
+    bool isFDOInliningCandidate(Instruction* I);
+    bool isValueSite(CallSite cs, unsigned argNo);
+  };
+}
+
+
+char ValueProfiler::ID = 0;
+INITIALIZE_PASS(ValueProfiler, "insert-value-profiling",
+                "Insert instrumentation for argument value profiling",
+                false, false);
+
+ModulePass *llvm::createValueProfilerPass() { return new ValueProfiler(); }
+
+
+bool ValueProfiler::runOnModule(Module &M) {
+  Function *Main = M.getFunction("main");
+  if (Main == 0) {
+    errs() << "WARNING: cannot insert value profiling into a module"
+           << " with no main function!\n";
+    return false;  // No main, no instrumentation!
+  }
+
+  // collect the sites before instrumenting, so the probes don't shift
+  // the numbering
+  std::vector<std::pair<Instruction*,unsigned> > Sites;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+  {
+    if (F->isDeclaration()) continue;
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      {
+        if(!isFDOInliningCandidate(I))
+          continue;
+
+        CallSite cs(cast<Value>(I));
+        for(unsigned a = 0, AE = cs.arg_size(); a != AE; ++a)
+          if(isValueSite(cs, a))
+            Sites.push_back(std::make_pair(&(*I), a));
+      }
+  }
+
+  unsigned NumSites = Sites.size();
+  NumValueSites += NumSites;
+
+  errs() << "\n\nValue Profiling: Inserting " << NumSites
+         << " argument value probes\n\n\n";
+
+  if (NumSites == 0)
+    return false;
+
+  // one ValueProfileSite per argument, as an array of unsigned
+  LLVMContext &Context = M.getContext();
+  const unsigned SiteWords = sizeof(ValueProfileSite) / sizeof(unsigned);
+  const Type *Int32 = Type::getInt32Ty(Context);
+  const Type *Int64 = Type::getInt64Ty(Context);
+  const Type *ATy = ArrayType::get(Int32, NumSites * SiteWords);
+  GlobalVariable *Table =
+    new GlobalVariable(M, ATy, false, GlobalValue::InternalLinkage,
+                       Constant::getNullValue(ATy), "ValueProfTable");
+
+  Constant *ProfileFn =
+    M.getOrInsertFunction("llvm_value_profile", Type::getVoidTy(Context),
+                          PointerType::getUnqual(Int32), Int64, NULL);
+
+  for (unsigned s = 0; s < NumSites; ++s)
+  {
+    Instruction *Call = Sites[s].first;
+    CallSite cs(Call);
+    Value *Arg = cs.getArgument(Sites[s].second);
+
+    std::vector<Constant*> Indices(2);
+    Indices[0] = Constant::getNullValue(Int32);
+    Indices[1] = ConstantInt::get(Int32, s * SiteWords);
+    Constant *Site = ConstantExpr::getGetElementPtr(Table, &Indices[0], 2);
+
+    // values are recorded zero-extended to 64 bits
+    if (Arg->getType() != Int64)
+      Arg = new ZExtInst(Arg, Int64, "vprof", Call);
+
+    Value *Args[2] = { Site, Arg };
+    CallInst::Create(ProfileFn, Args, Args+2, "", Call);
+  }
+
+  // Add the initialization call to main.
+  InsertProfilingInitCall(Main, "llvm_start_value_profiling", Table);
+  return true;
+}
+
+
+// Basic checking to see if an instruction is an inlining candidate
+// (same as CallProfiler)
+bool ValueProfiler::isFDOInliningCandidate(Instruction* I)
+{
+  if(I == NULL) return(false);
+
+  CallSite cs(cast<Value>(I));
+  // Not a call instruction
+  if(!cs) return(false);
+
+  // Intrinsics can never be inlined
+  if(isa<IntrinsicInst>(I)) return(false);
+
+  Function* callee = cs.getCalledFunction();
+
+  // Indirect calls cannot be inlined
+  if(callee == NULL) return(false);
+
+  // Ignore immediately-recursive calls.
+  if(callee == cs.getCaller()) return(false);
+
+  // Can't inline without the definition (assumes whole-program analysis)
+  if(callee->isDeclaration()) return(false);
+
+  return(true);
+}
+
+
+// Profile integer arguments (up to 64 bits) that are not already
+// constants.  Variable arguments have no formal to specialize.
+bool ValueProfiler::isValueSite(CallSite cs, unsigned argNo)
+{
+  if(argNo >= cs.getCalledFunction()->arg_size()) return(false);
+
+  Value* arg = cs.getArgument(argNo);
+  if(isa<Constant>(arg)) return(false);
+
+  const IntegerType* IT = dyn_cast<IntegerType>(arg->getType());
+  return( (IT != NULL) && (IT->getBitWidth() <= 64) );
+}
@@ -9,11 +9,15 @@
 //
 // This pass implements a simple loop unroller.  It works best when loops have
 // been canonicalized by the -indvars pass, allowing it to determine the trip
-// counts of loops easily.
+// counts of loops easily.  Loops without a static trip count can be unrolled
+// partially from their profiled trip counts (see -FDOTripCounts).
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "loop-unroll"
+#include "llvm/Constants.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/InlineCost.h"
@@ -39,6 +43,11 @@ UnrollAllowPartial("unroll-allow-partial", cl::init(false), cl::Hidden,
   cl::desc("Allows loops to be partially unrolled until "
            "-unroll-threshold loop size is reached."));
 
+static cl::opt<bool>
+UnrollUseProfile("unroll-use-profile", cl::init(true), cl::Hidden,
+  cl::desc("Partially unroll loops without a static trip count using "
+           "their profiled trip counts (!cp.tripcount)"));
+
 namespace {
   class LoopUnroll : public LoopPass {
   public:
@@ -93,6 +102,32 @@ static unsigned ApproximateLoopSize(const Loop *L, unsigned &NumCalls) {
   return Metrics.NumInsts;
 }
 
+/// GetProfiledTripCounts - Read the trip counts that -FDOTripCounts attached
+/// to the loop: the low, median and high quantiles over the profiled runs.
+/// They are on the terminator of the original header and latch, which may
+/// have moved around in the loop since.
+static bool GetProfiledTripCounts(Loop *L, LoopInfo *LI, unsigned &Low,
+                                  unsigned &Median, unsigned &High) {
+  unsigned Kind = L->getHeader()->getContext().getMDKindID("cp.tripcount");
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I) {
+    if (LI->getLoopFor(*I) != L)
+      continue;  // an inner loop's
+    MDNode *Node = (*I)->getTerminator()->getMetadata(Kind);
+    if (!Node || Node->getNumOperands() != 3)
+      continue;
+    ConstantInt *Counts[3];
+    for (unsigned i = 0; i != 3; ++i)
+      if (!(Counts[i] = dyn_cast_or_null<ConstantInt>(Node->getOperand(i))))
+        return false;
+    Low = Counts[0]->getZExtValue();
+    Median = Counts[1]->getZExtValue();
+    High = Counts[2]->getZExtValue();
+    return true;
+  }
+  return false;
+}
+
 bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   
   LoopInfo *LI = &getAnalysis<LoopInfo>();
@@ -116,14 +151,33 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   unsigned Count = UnrollCount;
 
   // Automatically select an unroll count.
+  bool Profiled = false;
+  unsigned ProfMedian = 0;
   if (Count == 0) {
     // Conservative heuristic: if we know the trip count, see if we can
     // completely unroll (subject to the threshold, checked below); otherwise
     // try to find greatest modulo of the trip count which is still under
     // threshold value.
-    if (TripCount == 0)
-      return false;
-    Count = TripCount;
+    //
+    // Without a static trip count, use the profiled ones: most runs execute
+    // at least the low trip count per entry, so unroll by up to that (each
+    // copy keeps its exit test), preferably by a divisor of the median.
+    unsigned ProfLow, ProfHigh;
+    if (TripCount == 0 && UnrollUseProfile &&
+        GetProfiledTripCounts(L, LI, ProfLow, ProfMedian, ProfHigh)) {
+      DEBUG(dbgs() << "  Profiled trip counts = " << ProfLow << " / "
+            << ProfMedian << " / " << ProfHigh << "\n");
+      if (ProfLow < 2) {
+        DEBUG(dbgs() << "  Not unrolling; too few profiled trips.\n");
+        return false;
+      }
+      Profiled = true;
+      Count = ProfLow;
+    } else {
+      if (TripCount == 0)
+        return false;
+      Count = TripCount;
+    }
   }
 
   // Enforce the threshold.
@@ -135,6 +189,8 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
       DEBUG(dbgs() << "  Not unrolling loop with function calls.\n");
       return false;
     }
+    if (Profiled && (uint64_t)LoopSize*Count > CurrentThreshold)
+      Count = CurrentThreshold / (LoopSize ? LoopSize : 1);
     uint64_t Size = (uint64_t)LoopSize*Count;
     if (TripCount != 1 && Size > CurrentThreshold) {
       DEBUG(dbgs() << "  Too large to fully unroll with count: " << Count
@@ -157,6 +213,19 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     }
   }
 
+  if (Profiled) {
+    unsigned Divisor = Count;
+    while (Divisor > 1 && ProfMedian % Divisor != 0)
+      Divisor--;
+    if (Divisor >= 2)
+      Count = Divisor;
+    if (Count < 2) {
+      DEBUG(dbgs() << "  could not unroll with the profiled trip counts\n");
+      return false;
+    }
+    DEBUG(dbgs() << "  unrolling with profiled count: " << Count << "\n");
+  }
+
   // Unroll the loop.
   Function *F = L->getHeader()->getParent();
   if (!UnrollLoop(L, Count, LI, &LPM))
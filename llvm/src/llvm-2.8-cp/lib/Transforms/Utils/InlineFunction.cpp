@@ -19,6 +19,8 @@
 #include "llvm/Instructions.h"
 #include "llvm/IntrinsicInst.h"
 #include "llvm/Intrinsics.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
 #include "llvm/Attributes.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/DebugInfo.h"
@@ -168,6 +170,38 @@ static void HandleInlinedInvoke(InvokeInst *II, BasicBlock *FirstNewBlock,
   InvokeDest->removePredecessor(II->getParent());
 }
 
+/// GetProfiledFrequency - Return the !cp.freq (-FDOBlockFreqs) of TI's block,
+/// in thousandths of an execution per call of its function, or null.
+static const ConstantInt *GetProfiledFrequency(const TerminatorInst *TI,
+                                               unsigned FreqKind) {
+  const MDNode *Freq = TI->getMetadata(FreqKind);
+  if (!Freq || Freq->getNumOperands() != 1)
+    return 0;
+  return dyn_cast_or_null<ConstantInt>(Freq->getOperand(0));
+}
+
+/// ScaleInlinedFrequencies - The profiled frequencies of the inlined blocks
+/// are per call of the callee, whose entry weighs 1000: scale them by the
+/// frequency of the call site's block, CallFreq, to make them per call of the
+/// caller.  Without CallFreq they are dropped.
+static void ScaleInlinedFrequencies(Function::iterator FirstNewBlock,
+                                    Function::iterator E,
+                                    const ConstantInt *CallFreq,
+                                    unsigned FreqKind) {
+  for (Function::iterator BB = FirstNewBlock; BB != E; ++BB) {
+    TerminatorInst *TI = BB->getTerminator();
+    const ConstantInt *Freq = GetProfiledFrequency(TI, FreqKind);
+    if (!Freq || !CallFreq) {
+      TI->setMetadata(FreqKind, 0);
+      continue;
+    }
+    Value *Scaled = ConstantInt::get(Freq->getType(),
+                                     Freq->getZExtValue() *
+                                     CallFreq->getZExtValue() / 1000);
+    TI->setMetadata(FreqKind, MDNode::get(TI->getContext(), &Scaled, 1));
+  }
+}
+
 /// UpdateCallGraphAfterInlining - Once we have cloned code over from a callee
 /// into the caller, update the specified callgraph to reflect the changes we
 /// made.  Note that it's possible that not all code was copied over, so only
@@ -296,6 +330,13 @@ bool llvm::InlineFunction(CallSite CS, InlineFunctionInfo &IFI) {
   ClonedCodeInfo InlinedFunctionInfo;
   Function::iterator FirstNewBlock;
 
+  // The profiled frequency of the call site's block, which both halves of it
+  // keep when it is split below.
+  unsigned FreqKind = Caller->getContext().getMDKindID("cp.freq");
+  MDNode *CallFreqNode = OrigBB->getTerminator()->getMetadata(FreqKind);
+  const ConstantInt *CallFreq =
+    GetProfiledFrequency(OrigBB->getTerminator(), FreqKind);
+
   { // Scope to destroy VMap after cloning.
     ValueMap<const Value*, Value*> VMap;
 
@@ -382,6 +423,8 @@ bool llvm::InlineFunction(CallSite CS, InlineFunctionInfo &IFI) {
     // Remember the first block that is newly cloned over.
     FirstNewBlock = LastBlock; ++FirstNewBlock;
 
+    ScaleInlinedFrequencies(FirstNewBlock, Caller->end(), CallFreq, FreqKind);
+
     // Update the callgraph if requested.
     if (IFI.CG)
       UpdateCallGraphAfterInlining(CS, FirstNewBlock, VMap, IFI);
@@ -555,6 +598,7 @@ bool llvm::InlineFunction(CallSite CS, InlineFunctionInfo &IFI) {
 
     // Add an unconditional branch to make this look like the CallInst case...
     BranchInst *NewBr = BranchInst::Create(II->getNormalDest(), TheCall);
+    NewBr->setMetadata(FreqKind, CallFreqNode);
 
     // Split the basic block.  This guarantees that no PHI nodes will have to be
     // updated due to new incoming edges, and make the invoke case more
@@ -577,6 +621,7 @@ bool llvm::InlineFunction(CallSite CS, InlineFunctionInfo &IFI) {
   assert(Br && Br->getOpcode() == Instruction::Br &&
          "splitBasicBlock broken!");
   Br->setOperand(0, FirstNewBlock);
+  Br->setMetadata(FreqKind, CallFreqNode);
 
 
   // Now that the function is correct, make it a little bit nicer.  In
@@ -21,10 +21,14 @@
 #define DEBUG_TYPE "loop-unroll"
 #include "llvm/Transforms/Utils/UnrollLoop.h"
 #include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Support/CFG.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -184,6 +188,26 @@ bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM)
 
   std::vector<BasicBlock*> LoopBlocks = L->getBlocks();
 
+  // The profiled trip counts (-FDOTripCounts) do not hold for the unrolled
+  // loop; drop them before the blocks are cloned.  Each of the Count copies
+  // runs a share of the iterations: divide the profiled block frequencies
+  // (-FDOBlockFreqs) among them.
+  unsigned TripCountKind = Header->getContext().getMDKindID("cp.tripcount");
+  unsigned FreqKind = Header->getContext().getMDKindID("cp.freq");
+  for (std::vector<BasicBlock*>::iterator BB = LoopBlocks.begin(),
+       E = LoopBlocks.end(); BB != E; ++BB) {
+    TerminatorInst *TI = (*BB)->getTerminator();
+    if (LI->getLoopFor(*BB) == L)
+      TI->setMetadata(TripCountKind, 0);
+    const MDNode *Freq = TI->getMetadata(FreqKind);
+    const ConstantInt *F = Freq && Freq->getNumOperands() == 1 ?
+      dyn_cast_or_null<ConstantInt>(Freq->getOperand(0)) : 0;
+    if (!F)
+      continue;
+    Value *Share = ConstantInt::get(F->getType(), F->getZExtValue() / Count);
+    TI->setMetadata(FreqKind, MDNode::get(TI->getContext(), &Share, 1));
+  }
+
   bool ContinueOnTrue = L->contains(BI->getSuccessor(0));
   BasicBlock *LoopExit = BI->getSuccessor(ContinueOnTrue);
 
@@ -236,20 +260,23 @@ bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM)
 
       L->addBasicBlockToLoop(New, LI->getBase());
 
-      // Add phi entries for newly created values to all exit blocks except
-      // the successor of the latch block.  The successor of the exit block will
-      // be updated specially after unrolling all the way.
-      if (*BB != LatchBlock)
-        for (Value::use_iterator UI = (*BB)->use_begin(), UE = (*BB)->use_end();
-             UI != UE;) {
-          Instruction *UseInst = cast<Instruction>(*UI);
-          ++UI;
-          if (isa<PHINode>(UseInst) && !L->contains(UseInst)) {
-            PHINode *phi = cast<PHINode>(UseInst);
-            Value *Incoming = phi->getIncomingValueForBlock(*BB);
-            phi->addIncoming(Incoming, New);
-          }
+      // Add phi entries for newly created values to all exit blocks, the
+      // latch's included: without a known trip count every copy of the latch
+      // keeps its exit test.  The entries of the latches that end up with an
+      // unconditional branch are removed below.
+      for (succ_iterator SI = succ_begin(*BB), SE = succ_end(*BB);
+           SI != SE; ++SI) {
+        if (L->contains(*SI))
+          continue;
+        for (BasicBlock::iterator BBI = (*SI)->begin();
+             PHINode *phi = dyn_cast<PHINode>(BBI); ++BBI) {
+          Value *Incoming = phi->getIncomingValueForBlock(*BB);
+          ValueToValueMapTy::iterator It = LastValueMap.find(Incoming);
+          if (It != LastValueMap.end())
+            Incoming = It->second;
+          phi->addIncoming(Incoming, New);
         }
+      }
 
       // Keep track of new headers and latches as we create them, so that
       // we can insert the proper branches later.
@@ -277,20 +304,13 @@ bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM)
         RemapInstruction(I, LastValueMap);
   }
   
-  // The latch block exits the loop.  If there are any PHI nodes in the
-  // successor blocks, update them to use the appropriate values computed as the
-  // last iteration of the loop.
+  // The last latch branches back to the header.  Update the header's PHI
+  // nodes to use the values computed in the last iteration of the loop (the
+  // exit blocks got theirs above).
   if (Count != 1) {
-    SmallPtrSet<PHINode*, 8> Users;
-    for (Value::use_iterator UI = LatchBlock->use_begin(),
-         UE = LatchBlock->use_end(); UI != UE; ++UI)
-      if (PHINode *phi = dyn_cast<PHINode>(*UI))
-        Users.insert(phi);
-    
     BasicBlock *LastIterationBB = cast<BasicBlock>(LastValueMap[LatchBlock]);
-    for (SmallPtrSet<PHINode*,8>::iterator SI = Users.begin(), SE = Users.end();
-         SI != SE; ++SI) {
-      PHINode *PN = *SI;
+    for (unsigned i = 0, e = OrigPHINode.size(); i != e; ++i) {
+      PHINode *PN = OrigPHINode[i];
       Value *InVal = PN->removeIncomingValue(LatchBlock, false);
       // If this value was defined in the loop, take the value defined by the
       // last iteration of the loop.
@@ -342,6 +362,11 @@ bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM)
       // iteration.
       Term->setSuccessor(!ContinueOnTrue, Dest);
     } else {
+      // This latch no longer exits; remove its phi entries in the exit.
+      if (Dest != LoopExit)
+        for (BasicBlock::iterator BBI = LoopExit->begin();
+             PHINode *Phi = dyn_cast<PHINode>(BBI); ++BBI)
+          Phi->removeIncomingValue(Latches[i], false);
       Term->setUnconditionalDest(Dest);
       // Merge adjacent basic blocks, if possible.
       if (BasicBlock *Fold = FoldBlockIntoPredecessor(Dest, LI)) {
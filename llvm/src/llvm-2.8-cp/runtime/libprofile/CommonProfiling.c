@@ -130,3 +130,35 @@ void write_profiling_data(enum ProfilingType PT, unsigned *Start,
   res = write(outFile, &NumElements, sizeof(unsigned));
   res = write(outFile, Start, NumElements*sizeof(unsigned));
 }
+
+/* llvm_start_counter_map - Write out the counter map of a partially
+ * instrumented module (CounterMapInfo) ahead of the counters it covers.
+ */
+int llvm_start_counter_map(int argc, const char **argv,
+                           unsigned *map, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  write_profiling_data(CounterMapInfo, map, numElements);
+  return Ret;
+}
+
+/* llvm_start_cfg_checksum - Write out the CFG checksums and counter
+ * ranges of the instrumented module (CFGChecksumInfo) ahead of the
+ * counters they describe, so a changed module can still use the run.
+ */
+int llvm_start_cfg_checksum(int argc, const char **argv,
+                            unsigned *checksums, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  write_profiling_data(CFGChecksumInfo, checksums, numElements);
+  return Ret;
+}
+
+/* llvm_start_pruned_counters - Write out the counters that the
+ * instrumentation left out because they had converged
+ * (PrunedCounterInfo) ahead of the counters they belong to.
+ */
+int llvm_start_pruned_counters(int argc, const char **argv,
+                               unsigned *pruned, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  write_profiling_data(PrunedCounterInfo, pruned, numElements);
+  return Ret;
+}
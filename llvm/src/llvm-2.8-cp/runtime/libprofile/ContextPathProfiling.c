@@ -0,0 +1,226 @@
+/*===-- ContextPathProfiling.c - Support library for context paths --------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the call back routines for interprocedural path
+|* profiling: the -insert-path-profiling LLVM pass with
+|* -path-profile-context.  The instrumented functions push the path
+|* prefix that ends at a call around the call; every completed path is
+|* counted with the prefixes of its innermost callers.  A pop restores
+|* the depth its push returned, and a landing pad the depth at the entry
+|* of its function, so the frames a longjmp or an exception skipped the
+|* pops of are dropped.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "Profiling.h"
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define CONTEXT_HASH_BIN_COUNT 1021
+
+typedef struct {
+	uint32_t fnNumber;
+	uint64_t pathNumber;
+} contextFrame_t;
+
+typedef struct contextEntry_s {
+	uint32_t depth;
+	uint32_t pathCount;
+	contextFrame_t frames[PP_MAX_CONTEXT + 1];
+	struct contextEntry_s* next;
+} contextEntry_t;
+
+/* the frames of the instrumented callers, innermost last */
+static contextFrame_t* contextStack;
+static uint32_t stackSize;
+static uint32_t stackDepth;
+
+/* the callers recorded with each path (-path-profile-context) */
+static uint32_t contextDepth;
+
+static contextEntry_t* contextBins[CONTEXT_HASH_BIN_COUNT];
+static uint32_t contextCount;
+
+/* Push the path prefix that ends at a call; returns the depth before */
+uint32_t llvm_path_context_push(uint32_t fnNumber, uint64_t pathNumber) {
+	uint32_t depth = stackDepth;
+	contextFrame_t* frame;
+	if( stackDepth > stackSize ) {
+		/* below a lost frame */
+		stackDepth++;
+		return depth;
+	}
+	if( stackDepth == stackSize ) {
+		contextFrame_t* grown;
+		uint32_t size = stackSize ? 2 * stackSize : 256;
+		grown = realloc(contextStack, size * sizeof(contextFrame_t));
+		if( !grown ) {
+			/* too deep: the frame is lost, but the depth stays right */
+			stackDepth++;
+			return depth;
+		}
+		contextStack = grown;
+		stackSize = size;
+	}
+
+	frame = &contextStack[stackDepth];
+	frame->fnNumber = fnNumber;
+	frame->pathNumber = pathNumber;
+	stackDepth++;
+	return depth;
+}
+
+/* Pop it when the call returns: back to the depth before the push */
+void llvm_path_context_pop(uint32_t depth) {
+	if( depth < stackDepth )
+		stackDepth = depth;
+}
+
+/* The depth at the entry of a function with landing pads */
+uint32_t llvm_path_context_depth() {
+	return stackDepth;
+}
+
+static uint32_t hashContext(const contextFrame_t* frames, uint32_t depth) {
+	uint64_t key = depth;
+	uint32_t i;
+	for( i = 0; i < depth; i++ )
+		key = key * 31 + frames[i].fnNumber * 17 + frames[i].pathNumber;
+	return (uint32_t)((key ^ (key >> 32)) % CONTEXT_HASH_BIN_COUNT);
+}
+
+static int sameContext(const contextEntry_t* entry,
+                       const contextFrame_t* frames, uint32_t depth) {
+	uint32_t i;
+	if( entry->depth != depth )
+		return 0;
+	for( i = 0; i < depth; i++ )
+		if( entry->frames[i].fnNumber != frames[i].fnNumber ||
+				entry->frames[i].pathNumber != frames[i].pathNumber )
+			return 0;
+	return 1;
+}
+
+/* Count a completed path with the prefixes of its callers.  Paths
+	 outside of any instrumented caller are only in the path profile. */
+void llvm_increment_context_path(uint32_t fnNumber, uint64_t pathNumber) {
+	contextFrame_t frames[PP_MAX_CONTEXT + 1];
+	contextEntry_t* entry;
+	uint32_t callers = stackDepth < contextDepth ? stackDepth : contextDepth;
+	uint32_t depth = callers + 1;
+	uint32_t i, index;
+
+	if( callers == 0 || stackDepth > stackSize )
+		return;
+
+	/* outermost caller first */
+	for( i = 0; i < callers; i++ )
+		frames[i] = contextStack[stackDepth - callers + i];
+	frames[callers].fnNumber = fnNumber;
+	frames[callers].pathNumber = pathNumber;
+
+	index = hashContext(frames, depth);
+	for( entry = contextBins[index]; entry; entry = entry->next )
+		if( sameContext(entry, frames, depth) )
+			break;
+
+	if( !entry ) {
+		entry = calloc(sizeof(contextEntry_t), 1);
+		entry->depth = depth;
+		for( i = 0; i < depth; i++ )
+			entry->frames[i] = frames[i];
+		entry->next = contextBins[index];
+		contextBins[index] = entry;
+		contextCount++;
+	}
+
+	if( entry->pathCount < 0xffffffff )
+		entry->pathCount++;
+}
+
+/*
+ * Writes out the context paths in the following format.  Path numbers
+ * are 64-bit, low word first.
+ *
+ *      | <-- 32 bits --> |
+ *      +-----------------+-----------------+
+ * 0x00 | profileType     | contextCount    |
+ *      +-----------------+-----------------+
+ * 0x08 | depth           | pathCounter     |                    // context 1
+ *      +-----------------+-----------------+-----------------+
+ * 0x10 | functionNum     | pathNumberLo    | pathNumberHi    |  // caller
+ *      +-----------------+-----------------+-----------------+
+ *  ... |       ...       |       ...       |       ...       |
+ *      +-----------------+-----------------+-----------------+
+ *  ... | functionNum     | pathNumberLo    | pathNumberHi    |  // callee
+ *      +-----------------+-----------------+-----------------+
+ *  ... | depth           | pathCounter     |                    // context 2
+ *      +-----------------+-----------------+
+ *
+ */
+static void contextPathProfAtExitHandler() {
+	int outFile = getOutFile();
+	uint32_t header[2] = { ContextPathInfo, contextCount };
+	uint32_t i, f;
+
+	if (write(outFile, header, sizeof(header)) < 0) {
+		fprintf(stderr,
+			"error: unable to write context path header to output file.\n");
+		return;
+	}
+
+	for( i = 0; i < CONTEXT_HASH_BIN_COUNT; i++ ) {
+		contextEntry_t* entry = contextBins[i];
+		while( entry ) {
+			contextEntry_t* temp;
+			PathContextHeader ch;
+			ch.depth = entry->depth;
+			ch.pathCounter = entry->pathCount;
+
+			if (write(outFile, &ch, sizeof(PathContextHeader)) < 0) {
+				fprintf(stderr,
+					"error: unable to write context path to output file.\n");
+				return;
+			}
+
+			for( f = 0; f < entry->depth; f++ ) {
+				PathContextFrame frame;
+				frame.fnNumber = entry->frames[f].fnNumber;
+				frame.pathNumberLo = (uint32_t)entry->frames[f].pathNumber;
+				frame.pathNumberHi = (uint32_t)(entry->frames[f].pathNumber >> 32);
+				if (write(outFile, &frame, sizeof(PathContextFrame)) < 0) {
+					fprintf(stderr,
+						"error: unable to write context frame to output file.\n");
+					return;
+				}
+			}
+
+			temp = entry;
+			entry = entry->next;
+			free(temp);
+		}
+	}
+}
+
+/* llvm_start_context_path_profiling - The entry point of context path
+ * profiling.  The array holds the number of callers to record.
+ */
+int llvm_start_context_path_profiling(int argc, const char** argv,
+                                      uint32_t* arrayStart,
+                                      uint32_t numElements) {
+	int Ret = save_arguments(argc, argv);
+	contextDepth = numElements ? arrayStart[0] : 1;
+	if( contextDepth > PP_MAX_CONTEXT )
+		contextDepth = PP_MAX_CONTEXT;
+	atexit(contextPathProfAtExitHandler);
+	return Ret;
+}
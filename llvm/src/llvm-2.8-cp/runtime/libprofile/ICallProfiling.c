@@ -0,0 +1,133 @@
+/*===-- ICallProfiling.c - Support library for indirect call profiling ----===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the call back routines for the indirect call
+|* target profiling instrumentation pass.  This should be used with the
+|* -insert-icall-profiling LLVM pass.
+|*
+|* Each indirect call has a ValueProfileSite, filled by llvm_value_profile
+|* (ValueProfiling.c) with the addresses of the called targets.  At exit
+|* the addresses are replaced by function numbers, which do not change
+|* from run to run, before the table is written.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "Profiling.h"
+#include <stdlib.h>
+
+static unsigned *ArrayStart;
+static unsigned NumElements;
+
+/* the address of each defined function, in module order (null if its
+   address is never taken) */
+static void **Targets;
+static unsigned NumTargets;
+
+typedef struct {
+  uint64_t address;
+  unsigned number;
+} TargetEntry;
+
+static int compareTargets(const void *A, const void *B) {
+  uint64_t a = ((const TargetEntry *)A)->address;
+  uint64_t b = ((const TargetEntry *)B)->address;
+  return (a < b) ? -1 : (a > b);
+}
+
+/* findTarget - The function number of a target address, 0 if it is not
+ * a function of the module.
+ */
+static unsigned findTarget(TargetEntry *sorted, unsigned count,
+                           uint64_t address) {
+  unsigned lo = 0, hi = count;
+  while (lo < hi) {
+    unsigned mid = lo + (hi - lo) / 2;
+    if (sorted[mid].address < address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < count && sorted[lo].address == address)
+    return sorted[lo].number;
+  return 0;
+}
+
+/* mapSite - Replace the addresses of a site by function numbers.  The
+ * targets defined elsewhere all become 0, so their slots are merged.
+ */
+static void mapSite(ValueProfileSite *site, TargetEntry *sorted,
+                    unsigned count) {
+  unsigned i, j;
+  for (i = 0; i < VP_TOPK; ++i) {
+    ValueProfileSlot *slot = &site->slots[i];
+    uint64_t address;
+    if (slot->count == 0)
+      continue;
+    address = ((uint64_t)slot->valueHi << 32) | slot->valueLo;
+    slot->valueLo = findTarget(sorted, count, address);
+    slot->valueHi = 0;
+
+    for (j = 0; j < i; ++j) {
+      ValueProfileSlot *prev = &site->slots[j];
+      if (prev->count != 0 && prev->valueLo == slot->valueLo) {
+        prev->count = (prev->count > 0xffffffff - slot->count) ?
+          0xffffffff : prev->count + slot->count;
+        slot->count = 0;
+        break;
+      }
+    }
+  }
+}
+
+/* ICallProfAtExitHandler - When the program exits, map the targets to
+ * function numbers and write out the profiling data.
+ */
+static void ICallProfAtExitHandler() {
+  const unsigned SiteWords = sizeof(ValueProfileSite) / sizeof(unsigned);
+  TargetEntry *sorted = malloc((NumTargets + 1) * sizeof(TargetEntry));
+  unsigned count = 0, i;
+
+  for (i = 0; i < NumTargets; ++i)
+    if (Targets[i]) {
+      sorted[count].address = (uint64_t)(uintptr_t)Targets[i];
+      sorted[count].number = i + 1;
+      count++;
+    }
+  qsort(sorted, count, sizeof(TargetEntry), compareTargets);
+
+  for (i = 0; i + SiteWords <= NumElements; i += SiteWords)
+    mapSite((ValueProfileSite *)(ArrayStart + i), sorted, count);
+  free(sorted);
+
+  write_profiling_data(ICallInfo, ArrayStart, NumElements);
+}
+
+
+/* llvm_icall_targets - Record the table of target addresses, one per
+ * defined function of the module.  Called before the profiling starts.
+ */
+void llvm_icall_targets(void **targets, unsigned numTargets) {
+  Targets = targets;
+  NumTargets = numTargets;
+}
+
+
+/* llvm_start_icall_profiling - This is the main entry point of the
+ * indirect call profiling library.  It is responsible for setting up
+ * the atexit handler.  The array holds one ValueProfileSite per
+ * indirect call.
+ */
+int llvm_start_icall_profiling(int argc, const char **argv,
+                               unsigned *arrayStart, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  ArrayStart = arrayStart;
+  NumElements = numElements;
+  atexit(ICallProfAtExitHandler);
+  return Ret;
+}
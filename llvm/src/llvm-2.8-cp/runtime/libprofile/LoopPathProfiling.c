@@ -0,0 +1,241 @@
+/*===-- LoopPathProfiling.c - Support library for loop paths --------------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the call back routines for loop path profiling:
+|* the -insert-path-profiling LLVM pass with -path-profile-iterations.
+|* Every path that ends at a loop's backedge is one iteration; it is
+|* counted with the iterations before it since the loop was entered, up
+|* to the configured number.  A loop of a recursive function shares its
+|* history between the activations.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "Profiling.h"
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define LOOP_HASH_BIN_COUNT 127
+#define LOOP_PATH_HASH_BIN_COUNT 1021
+
+/* the last iterations of a loop since it was entered */
+typedef struct loopState_s {
+	uint32_t fnNumber;
+	uint32_t loopNumber;
+	uint32_t length;      /* valid iterations in history */
+	uint32_t iterating;   /* the next header entry follows a backedge */
+	uint64_t history[PP_MAX_ITERATIONS];  /* oldest first */
+	struct loopState_s* next;
+} loopState_t;
+
+typedef struct loopPathEntry_s {
+	uint32_t fnNumber;
+	uint32_t loopNumber;
+	uint32_t length;
+	uint32_t pathCount;
+	uint64_t paths[PP_MAX_ITERATIONS];
+	struct loopPathEntry_s* next;
+} loopPathEntry_t;
+
+/* the iterations recorded with each path (-path-profile-iterations) */
+static uint32_t iterationCount;
+
+static loopState_t* loopBins[LOOP_HASH_BIN_COUNT];
+static loopPathEntry_t* loopPathBins[LOOP_PATH_HASH_BIN_COUNT];
+static uint32_t loopPathCount;
+
+static loopState_t* getLoopState(uint32_t fnNumber, uint32_t loopNumber) {
+	uint32_t index = (fnNumber * 31 + loopNumber) % LOOP_HASH_BIN_COUNT;
+	loopState_t* state;
+	for( state = loopBins[index]; state; state = state->next )
+		if( state->fnNumber == fnNumber && state->loopNumber == loopNumber )
+			return state;
+
+	state = calloc(sizeof(loopState_t), 1);
+	if( !state )
+		return 0;
+	state->fnNumber = fnNumber;
+	state->loopNumber = loopNumber;
+	state->next = loopBins[index];
+	loopBins[index] = state;
+	return state;
+}
+
+/* Every entry of a loop header: unless a backedge led here, the loop
+	 was entered afresh and its history starts over. */
+void llvm_loop_header(uint32_t fnNumber, uint32_t loopNumber) {
+	loopState_t* state = getLoopState(fnNumber, loopNumber);
+	if( !state )
+		return;
+	if( state->iterating )
+		state->iterating = 0;
+	else
+		state->length = 0;
+}
+
+static uint32_t hashLoopPath(const loopState_t* state) {
+	uint64_t key = state->fnNumber * 17 + state->loopNumber;
+	uint32_t i;
+	for( i = 0; i < state->length; i++ )
+		key = key * 31 + state->history[i];
+	return (uint32_t)((key ^ (key >> 32)) % LOOP_PATH_HASH_BIN_COUNT);
+}
+
+static int sameLoopPath(const loopPathEntry_t* entry,
+                        const loopState_t* state) {
+	uint32_t i;
+	if( entry->fnNumber != state->fnNumber ||
+			entry->loopNumber != state->loopNumber ||
+			entry->length != state->length )
+		return 0;
+	for( i = 0; i < state->length; i++ )
+		if( entry->paths[i] != state->history[i] )
+			return 0;
+	return 1;
+}
+
+/* Count an iteration (the path that ends at a backedge) with the
+	 iterations before it. */
+void llvm_loop_path(uint32_t fnNumber, uint32_t loopNumber,
+                    uint64_t pathNumber) {
+	loopState_t* state = getLoopState(fnNumber, loopNumber);
+	loopPathEntry_t* entry;
+	uint32_t i, index;
+
+	if( !state )
+		return;
+
+	if( state->length == iterationCount ) {
+		for( i = 1; i < state->length; i++ )
+			state->history[i - 1] = state->history[i];
+		state->length--;
+	}
+	state->history[state->length++] = pathNumber;
+	state->iterating = 1;
+
+	/* a single iteration is already in the path profile */
+	if( state->length < 2 )
+		return;
+
+	index = hashLoopPath(state);
+	for( entry = loopPathBins[index]; entry; entry = entry->next )
+		if( sameLoopPath(entry, state) )
+			break;
+
+	if( !entry ) {
+		entry = calloc(sizeof(loopPathEntry_t), 1);
+		if( !entry )
+			return;
+		entry->fnNumber = fnNumber;
+		entry->loopNumber = loopNumber;
+		entry->length = state->length;
+		for( i = 0; i < state->length; i++ )
+			entry->paths[i] = state->history[i];
+		entry->next = loopPathBins[index];
+		loopPathBins[index] = entry;
+		loopPathCount++;
+	}
+
+	if( entry->pathCount < 0xffffffff )
+		entry->pathCount++;
+}
+
+/*
+ * Writes out the loop paths in the following format.  Path numbers
+ * are 64-bit, low word first.
+ *
+ *      | <-- 32 bits --> |
+ *      +-----------------+-----------------+
+ * 0x00 | profileType     | loopPathCount   |
+ *      +-----------------+-----------------+-----------------+
+ * 0x08 | functionNum     | loopNum         | length          |  // path 1
+ *      +-----------------+-----------------+-----------------+
+ * 0x14 | pathCounter     |
+ *      +-----------------+-----------------+
+ * 0x18 | pathNumberLo    | pathNumberHi    |                    // oldest
+ *      +-----------------+-----------------+
+ *  ... |       ...       |       ...       |
+ *      +-----------------+-----------------+
+ *  ... | pathNumberLo    | pathNumberHi    |                    // last
+ *      +-----------------+-----------------+-----------------+
+ *  ... | functionNum     | loopNum         | length          |  // path 2
+ *      +-----------------+-----------------+-----------------+
+ *
+ */
+static void loopPathProfAtExitHandler() {
+	int outFile = getOutFile();
+	uint32_t header[2] = { LoopPathInfo, loopPathCount };
+	uint32_t i, p;
+
+	if (write(outFile, header, sizeof(header)) < 0) {
+		fprintf(stderr,
+			"error: unable to write loop path header to output file.\n");
+		return;
+	}
+
+	for( i = 0; i < LOOP_PATH_HASH_BIN_COUNT; i++ ) {
+		loopPathEntry_t* entry = loopPathBins[i];
+		while( entry ) {
+			loopPathEntry_t* temp;
+			LoopPathHeader lh;
+			lh.fnNumber = entry->fnNumber;
+			lh.loopNumber = entry->loopNumber;
+			lh.length = entry->length;
+			lh.pathCounter = entry->pathCount;
+
+			if (write(outFile, &lh, sizeof(LoopPathHeader)) < 0) {
+				fprintf(stderr,
+					"error: unable to write loop path to output file.\n");
+				return;
+			}
+
+			for( p = 0; p < entry->length; p++ ) {
+				uint32_t number[2];
+				number[0] = (uint32_t)entry->paths[p];
+				number[1] = (uint32_t)(entry->paths[p] >> 32);
+				if (write(outFile, number, sizeof(number)) < 0) {
+					fprintf(stderr,
+						"error: unable to write loop path to output file.\n");
+					return;
+				}
+			}
+
+			temp = entry;
+			entry = entry->next;
+			free(temp);
+		}
+	}
+
+	for( i = 0; i < LOOP_HASH_BIN_COUNT; i++ ) {
+		loopState_t* state = loopBins[i];
+		while( state ) {
+			loopState_t* temp = state;
+			state = state->next;
+			free(temp);
+		}
+	}
+}
+
+/* llvm_start_loop_path_profiling - The entry point of loop path
+ * profiling.  The array holds the number of iterations to record.
+ */
+int llvm_start_loop_path_profiling(int argc, const char** argv,
+                                   uint32_t* arrayStart,
+                                   uint32_t numElements) {
+	int Ret = save_arguments(argc, argv);
+	iterationCount = numElements ? arrayStart[0] : 2;
+	if( iterationCount > PP_MAX_ITERATIONS )
+		iterationCount = PP_MAX_ITERATIONS;
+	if( iterationCount < 1 )
+		iterationCount = 1;
+	atexit(loopPathProfAtExitHandler);
+	return Ret;
+}
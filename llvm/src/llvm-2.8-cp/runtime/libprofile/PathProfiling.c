@@ -26,7 +26,7 @@
 #define ARBITRARY_HASH_BIN_COUNT 100
 
 typedef struct pathHashEntry_s {
-	uint32_t pathNumber;
+	uint64_t pathNumber;
 	uint32_t pathCount;
 	struct pathHashEntry_s* next;
 } pathHashEntry_t;
@@ -63,7 +63,8 @@ void writeArrayTable(uint32_t fNumber, ftEntry_t* ft, uint32_t* funcCount) {
 		/* was this path executed? */
 		if( pc ) {
 			PathTableEntry pte;
-			pte.pathNumber = arrayIterator;
+			pte.pathNumberLo = arrayIterator;
+			pte.pathNumberHi = 0;
 			pte.pathCounter = pc;
 			pathCounts++;
 
@@ -101,9 +102,9 @@ void writeArrayTable(uint32_t fNumber, ftEntry_t* ft, uint32_t* funcCount) {
 	}
 }
 
-inline uint32_t hash (uint32_t key) {
+inline uint32_t hash (uint64_t key) {
 	/* this may benifit from a proper hash function */
-	return key%ARBITRARY_HASH_BIN_COUNT;
+	return (uint32_t)((key ^ (key >> 32))%ARBITRARY_HASH_BIN_COUNT);
 }
 
 /* output a specific function's hash table to the profile file */
@@ -127,7 +128,8 @@ void writeHashTable(uint32_t functionNumber, pathHashTable_t* hashTable) {
 			pathHashEntry_t* temp;
 
 			PathTableEntry pte;
-			pte.pathNumber = hashEntry->pathNumber;
+			pte.pathNumberLo = (uint32_t)hashEntry->pathNumber;
+			pte.pathNumberHi = (uint32_t)(hashEntry->pathNumber >> 32);
 			pte.pathCounter = hashEntry->pathCount;
 
 			if (write(outFile, &pte, sizeof(PathTableEntry)) < 0) {
@@ -144,7 +146,7 @@ void writeHashTable(uint32_t functionNumber, pathHashTable_t* hashTable) {
 }
 
 /* Return a pointer to this path's specific path counter */
-inline uint32_t* getPathCounter(uint32_t functionNumber, uint32_t pathNumber) {
+inline uint32_t* getPathCounter(uint32_t functionNumber, uint64_t pathNumber) {
 	pathHashTable_t* hashTable;
 	pathHashEntry_t* hashEntry;
 	uint32_t index = hash(pathNumber);
@@ -173,42 +175,41 @@ inline uint32_t* getPathCounter(uint32_t functionNumber, uint32_t pathNumber) {
 }
 
 /* Increment a specific path's count */
-void llvm_increment_path_count (uint32_t functionNumber, uint32_t pathNumber) {
+void llvm_increment_path_count (uint32_t functionNumber, uint64_t pathNumber) {
 	uint32_t* pathCounter = getPathCounter(functionNumber, pathNumber);
 	if( *pathCounter < 0xffffffff )
 		(*pathCounter)++;
 }
 
 /* Increment a specific path's count */
-void llvm_decrement_path_count (uint32_t functionNumber, uint32_t pathNumber) {
+void llvm_decrement_path_count (uint32_t functionNumber, uint64_t pathNumber) {
 	uint32_t* pathCounter = getPathCounter(functionNumber, pathNumber);
 	(*pathCounter)--;
 }
 
 /*
  * Writes out a path profile given a function table, in the following format.
+ * Path numbers are 64-bit, low word first.
  *
  *
  *      | <-- 32 bits --> |
  *      +-----------------+-----------------+
  * 0x00 | profileType     | functionCount   |
  *      +-----------------+-----------------+
- * 0x08 | functionNum     | profileEntries  |  // function 1
- *      +-----------------+-----------------+
- * 0x10 | pathNumber      | pathCounter     |  // entry 1.1
- *      +-----------------+-----------------+
- * 0x18 | pathNumber      | pathCounter     |  // entry 1.2
- *      +-----------------+-----------------+
- *  ... |       ...       |       ...       |  // entry 1.n
- *      +-----------------+-----------------+
- *  ... | functionNum     | profileEntries  |  // function 2
- *      +-----------------+-----------------+
- *  ... | pathNumber      | pathCounter     |  // entry 2.1
- *      +-----------------+-----------------+
- *  ... | pathNumber      | pathCounter     |  // entry 2.2
- *      +-----------------+-----------------+
- *  ... |       ...       |       ...       |  // entry 2.n
- *      +-----------------+-----------------+
+ * 0x08 | functionNum     | profileEntries  |                    // function 1
+ *      +-----------------+-----------------+-----------------+
+ * 0x10 | pathNumberLo    | pathNumberHi    | pathCounter     |  // entry 1.1
+ *      +-----------------+-----------------+-----------------+
+ * 0x1c | pathNumberLo    | pathNumberHi    | pathCounter     |  // entry 1.2
+ *      +-----------------+-----------------+-----------------+
+ *  ... |       ...       |       ...       |       ...       |  // entry 1.n
+ *      +-----------------+-----------------+-----------------+
+ *  ... | functionNum     | profileEntries  |                    // function 2
+ *      +-----------------+-----------------+-----------------+
+ *  ... | pathNumberLo    | pathNumberHi    | pathCounter     |  // entry 2.1
+ *      +-----------------+-----------------+-----------------+
+ *  ... |       ...       |       ...       |       ...       |  // entry 2.n
+ *      +-----------------+-----------------+-----------------+
  *
  */
 static void pathProfAtExitHandler() {
@@ -0,0 +1,27 @@
+/*===-- SampleProfiling.c - Support library for sampled profiling ---------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source      
+|* License. See LICENSE.TXT for details.                                      
+|* 
+|*===----------------------------------------------------------------------===*|
+|* 
+|* This file implements the call back routine for sampled instrumentation
+|* (-profile-sample-interval).  The instrumented code only runs in samples,
+|* so the rate is written ahead of the counters of the run, for the
+|* profile readers to scale them back up.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "Profiling.h"
+
+/* llvm_start_sample_profiling - Write out the sampling rate: rate[1] of
+ * every rate[0] checks run the instrumented code.
+ */
+int llvm_start_sample_profiling(int argc, const char **argv,
+                                unsigned *rate, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  write_profiling_data(SampleInfo, rate, numElements);
+  return Ret;
+}
@@ -0,0 +1,84 @@
+/*===-- ValueProfiling.c - Support library for argument value profiling ---===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the call back routines for the argument value
+|* profiling instrumentation pass.  This should be used with the
+|* -insert-value-profiling LLVM pass.
+|*
+|* Each profiled argument has a ValueProfileSite that keeps the VP_TOPK
+|* most frequent values with the Misra-Gries algorithm: a value that
+|* is not in the table takes an empty slot, or, if there is none,
+|* decrements every slot.  Slot counts are never higher than the real
+|* number of calls with the value, so a value that appears stable
+|* really is.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "Profiling.h"
+#include <stdlib.h>
+
+static unsigned *ArrayStart;
+static unsigned NumElements;
+
+/* ValueProfAtExitHandler - When the program exits, just write out the
+ * profiling data.
+ */
+static void ValueProfAtExitHandler() {
+  write_profiling_data(ValueInfo, ArrayStart, NumElements);
+}
+
+
+/* llvm_start_value_profiling - This is the main entry point of the
+ * value profiling library.  It is responsible for setting up the atexit
+ * handler.  The array holds one ValueProfileSite per profiled argument.
+ */
+int llvm_start_value_profiling(int argc, const char **argv,
+                               unsigned *arrayStart, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  ArrayStart = arrayStart;
+  NumElements = numElements;
+  atexit(ValueProfAtExitHandler);
+  return Ret;
+}
+
+
+/* llvm_value_profile - Record one value of a profiled argument.  All
+ * counters saturate instead of wrapping.
+ */
+void llvm_value_profile(ValueProfileSite *site, uint64_t value) {
+  unsigned lo = (unsigned)value;
+  unsigned hi = (unsigned)(value >> 32);
+  ValueProfileSlot *empty = 0;
+  unsigned i;
+
+  if (site->total != 0xffffffff)
+    site->total++;
+
+  for (i = 0; i < VP_TOPK; ++i) {
+    ValueProfileSlot *slot = &site->slots[i];
+    if (slot->count == 0) {
+      if (!empty)
+        empty = slot;
+    } else if (slot->valueLo == lo && slot->valueHi == hi) {
+      if (slot->count != 0xffffffff)
+        slot->count++;
+      return;
+    }
+  }
+
+  if (empty) {
+    empty->valueLo = lo;
+    empty->valueHi = hi;
+    empty->count = 1;
+    return;
+  }
+
+  for (i = 0; i < VP_TOPK; ++i)
+    site->slots[i].count--;
+}
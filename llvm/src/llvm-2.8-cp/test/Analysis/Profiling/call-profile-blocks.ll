@@ -0,0 +1,37 @@
+; A raw call profile holds the entry count of every function, then a count
+; for every block with calls but the entry blocks (HN-freq 1): main's entry
+; block is the last block with calls and has no count of its own, and t is
+; normalized by the entry count of a.
+; Raw profile: CallInfo, 4 counts: leaf=2, a=2, main=1, t=1
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\012\000\000\000\004\000\000\000\002\000\000\000\002\000\000\000\001\000\000\000\001\000\000\000} > %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: llvm-cpmetrics -print %t.bc %t.cp | FileCheck %s
+
+; CHECK: Profile Type: call
+; CHECK: Index 0:
+; CHECK: point[5.000000e-01] 1.000000e+00
+; CHECK: Index 1:
+; CHECK: point[1.000000e+00] 1.000000e+00
+
+define void @leaf() {
+entry:
+  ret void
+}
+
+define void @a(i1 %c) {
+entry:
+  br i1 %c, label %t, label %e
+t:
+  call void @leaf()
+  br label %e
+e:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @a(i1 true)
+  call void @a(i1 false)
+  ret i32 0
+}
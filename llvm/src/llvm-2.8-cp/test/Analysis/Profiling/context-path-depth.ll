@@ -0,0 +1,32 @@
+; The context frames pushed around a call are popped back to the depth the
+; push returned, so the frames of the calls a longjmp left are dropped at
+; the next pop.  A function with landing pads restores its entry depth at
+; each of them, for the frames of the calls an exception unwound.
+; RUN: opt < %s -insert-path-profiling -path-profile-context=2 \
+; RUN:   -process-early-termination -S | FileCheck %s
+
+@buf = global [200 x i64] zeroinitializer
+
+declare i32 @_setjmp(i64*)
+declare void @may_throw()
+
+; CHECK: define i32 @main
+; CHECK: [[E:%contextDepth[0-9]*]] = call i32 @llvm_path_context_depth()
+; CHECK: [[D:%contextDepth[0-9]*]] = call i32 @llvm_path_context_push
+; CHECK-NEXT: call i32 @_setjmp
+; CHECK-NEXT: call void @llvm_path_context_pop(i32 [[D]])
+define i32 @main() {
+entry:
+  %r = call i32 @_setjmp(i64* getelementptr ([200 x i64]* @buf, i32 0, i32 0))
+  %z = icmp eq i32 %r, 0
+  br i1 %z, label %first, label %done
+first:
+  invoke void @may_throw() to label %done unwind label %lpad
+lpad:
+  ret i32 1
+done:
+  ret i32 0
+}
+
+; CHECK: lpad:
+; CHECK-NEXT: call void @llvm_path_context_pop(i32 [[E]])
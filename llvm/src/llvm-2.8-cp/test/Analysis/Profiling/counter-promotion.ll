@@ -0,0 +1,80 @@
+; Test the promotion of loop counters to registers.  The loop keeps the
+; count of its back-edge in a register, and adds it to the counter on the
+; way out, so the profile is the same as without the promotion.
+; RUN: opt < %s -insert-edge-profiling -S | FileCheck %s
+; RUN: opt < %s -insert-edge-profiling -profile-promote-counters=false -S \
+; RUN:   | FileCheck --check-prefix=NOPROMO %s
+
+; A call may read the counters: they are flushed before it.  The call
+; profiler's counters saturate, so the flush does as well.
+; RUN: opt < %s -insert-call-profiling -S | FileCheck --check-prefix=CALL %s
+
+; A path counter indexed by the path register stays in memory.
+; RUN: opt < %s -insert-path-profiling -S | FileCheck --check-prefix=PATH %s
+
+define i32 @sum(i32 %n) nounwind {
+entry:
+  br label %loop
+
+; CHECK: define i32 @sum
+; CHECK: loop:
+; CHECK-NEXT: %cnt.delta7 = phi i32 [ 0, %entry ], [ %cnt.delta, %loop.loop_crit_edge ]
+; CHECK-NOT: @EdgeProfCounters
+; CHECK: loop.loop_crit_edge:
+; CHECK-NEXT: %cnt.delta = add i32 %cnt.delta7, 1
+; CHECK-NEXT: br label %loop
+; CHECK: exit:
+; CHECK-NEXT: %OldCounter = load i32* getelementptr inbounds ([8 x i32]* @EdgeProfCounters, i32 0, i32 3)
+; CHECK-NEXT: %NewCounter = add i32 %OldCounter, %cnt.delta7
+; CHECK-NEXT: store i32 %NewCounter, i32* getelementptr inbounds ([8 x i32]* @EdgeProfCounters, i32 0, i32 3)
+
+; NOPROMO: define i32 @sum
+; NOPROMO-NOT: cnt.delta
+; NOPROMO: loop.loop_crit_edge:
+; NOPROMO-NEXT: load i32* getelementptr inbounds ([8 x i32]* @EdgeProfCounters, i32 0, i32 3)
+
+; PATH: define i32 @sum
+; PATH-NOT: cnt.delta
+; PATH: loop.loop_crit_edge:
+; PATH-NEXT: %pathNumber1 = add i64 %pathNumber, 1
+; PATH-NEXT: %counterInc2 = getelementptr [4 x i32]* @0, i32 0, i64 %pathNumber1
+; PATH-NEXT: %oldPC3 = load i32* %counterInc2
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, %i
+  %i.next = add i32 %i, 1
+  %done = icmp sge i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @main(i32 %argc, i8** %argv) nounwind {
+entry:
+  br label %loop
+
+; CALL: define i32 @main
+; CALL: loop:
+; CALL-NEXT: %cnt.delta5 = phi i64 [ 0, %entry ], [ %cnt.delta, %loop ]
+; CALL: %SumCounter = add i64 %OldCounter.ext, %cnt.delta5
+; CALL-NEXT: %isOver = icmp ugt i64 %SumCounter, 4294967295
+; CALL-NEXT: %SumCounter.trunc = trunc i64 %SumCounter to i32
+; CALL-NEXT: %NewCounter = select i1 %isOver, i32 -1, i32 %SumCounter.trunc
+; CALL-NEXT: store i32 %NewCounter, i32* getelementptr inbounds ([3 x i32]* @CallProfCounters, i32 0, i32 2)
+; CALL-NEXT: %r = call i32 @sum(i32 %j)
+; CALL: exit:
+; CALL: %SumCounter8 = add i64 %OldCounter.ext7, %cnt.delta
+
+loop:
+  %j = phi i32 [ 0, %entry ], [ %j.next, %loop ]
+  %r = call i32 @sum(i32 %j)
+  %j.next = add i32 %j, 1
+  %done = icmp sge i32 %j.next, 100
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %r
+}
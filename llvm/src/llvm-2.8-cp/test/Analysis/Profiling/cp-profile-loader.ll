@@ -0,0 +1,50 @@
+; The combined edge profile feeds ProfileInfo clients through
+; -cp-profile-loader: block placement moves the hot %often block after
+; %loop and the rare one to the end, and the weights pass the verifier.
+; Raw edge profile: 100 iterations, %rare taken 10 times.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\4\0\0\0\10\0\0\0\1\0\0\0\1\0\0\0\12\0\0\0\132\0\0\0} > %t.prof
+; RUN: printf {\12\0\0\0\132\0\0\0\143\0\0\0\1\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -cp-profile-loader -cp-profile-file=%t.cp -block-placement \
+; RUN:   %t.bc -S | FileCheck %s
+; RUN: opt -cp-profile-loader -cp-profile-file=%t.cp -profile-verifier \
+; RUN:   %t.bc -o /dev/null
+
+; CHECK: entry:
+; CHECK: loop:
+; CHECK: often:
+; CHECK: latch:
+; CHECK: exit:
+; CHECK: rare:
+
+@g = global i32 0
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %latch ]
+  %r = urem i32 %i, 10
+  %c = icmp eq i32 %r, 0
+  br i1 %c, label %rare, label %often
+
+rare:
+  store i32 %i, i32* @g
+  br label %latch
+
+often:
+  %v = load i32* @g
+  %w = add i32 %v, 1
+  store i32 %w, i32* @g
+  br label %latch
+
+latch:
+  %n = add i32 %i, 1
+  %d = icmp slt i32 %n, 100
+  br i1 %d, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,13 @@
+; llvm-cpcluster rejects an edge profile of another version of the program
+; before it reads the dominators of its edges.
+; Raw profile: EdgeInfo, 3 edges (the program has 1)
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\4\0\0\0\3\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} > %t.prof
+; RUN: not llvm-cpcluster -prefix=%t.c %t.bc %t.prof |& FileCheck %s
+
+; CHECK: error: the profile has 3 edges, the program 1
+
+define i32 @main() {
+entry:
+  ret i32 0
+}
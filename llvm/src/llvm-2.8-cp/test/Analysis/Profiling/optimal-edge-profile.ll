@@ -0,0 +1,61 @@
+; llvm-cprof expands an optimal edge profile (counters on the edges off
+; the spanning tree only, the others ~0U) to all edges of the function
+; before combining it: the combined profile is the one of the full edge
+; profile of the same run.
+; Raw optimal edge profile: 100 iterations, %rare taken 10 times.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\7\0\0\0\11\0\0\0\377\377\377\377\1\0\0\0} > %t.prof
+; RUN: printf {\377\377\377\377\377\377\377\377\12\0\0\0\132\0\0\0} >> %t.prof
+; RUN: printf {\377\377\377\377\377\377\377\377\377\377\377\377} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: llvm-cpmetrics -print %t.bc %t.cp | FileCheck %s
+
+; Each edge is normalized by the count of its edge dominator.
+; CHECK: Profile Type: edge
+; CHECK: Index 0:
+; CHECK: point[1.000000e+00]
+; CHECK: Index 1:
+; CHECK: point[1.000000e+00]
+; CHECK: Index 2:
+; CHECK: point[1.000000e+01]
+; CHECK: Index 3:
+; CHECK: point[9.000000e+01]
+; CHECK: Index 4:
+; CHECK: point[1.000000e+00]
+; CHECK: Index 5:
+; CHECK: point[1.000000e+00]
+; CHECK: Index 6:
+; CHECK: point[9.900000e+01]
+; CHECK: Index 7:
+; CHECK: point[1.000000e+00]
+
+@g = global i32 0
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %latch ]
+  %r = urem i32 %i, 10
+  %c = icmp eq i32 %r, 0
+  br i1 %c, label %rare, label %often
+
+rare:
+  store i32 %i, i32* @g
+  br label %latch
+
+often:
+  %v = load i32* @g
+  %w = add i32 %v, 1
+  store i32 %w, i32* @g
+  br label %latch
+
+latch:
+  %n = add i32 %i, 1
+  %d = icmp slt i32 %n, 100
+  br i1 %d, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,400 @@
+; @f has 2^33 Ball-Larus paths.  Without splitting the DAG the path
+; number needs 64 bits: the instrumentation keeps it in an i64, and the
+; raw and combined path profiles carry its high word.  llvm-cprof must
+; number the paths with the same -path-split-threshold.
+; Raw path profile of @f: path 2^33-1 (every %fN) 7 times.
+; RUN: llvm-as %s -o %t.bc
+; RUN: opt -insert-path-profiling -path-split-threshold=100000000000 \
+; RUN:   %t.bc -S | FileCheck %s
+; RUN: printf {\5\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} > %t.prof
+; RUN: printf {\377\377\377\377\1\0\0\0\7\0\0\0} >> %t.prof
+; RUN: llvm-cprof -path-split-threshold=100000000000 -cpFile=%t.cp \
+; RUN:   %t.bc %t.prof
+; RUN: llvm-cpmetrics -print %t.bc %t.cp | FileCheck %s -check-prefix=CP
+
+; CHECK: define i32 @f(i32 %x)
+; CHECK: %pathNumber = phi i64 [ 0, %t0 ], [ 4294967296, %f0 ]
+; CHECK: add i64 %pathNumber, 2147483648
+; CHECK: call void @llvm_increment_path_count(i32 1, i64 %pathNumber{{[0-9]+}})
+; CHECK: declare void @llvm_increment_path_count(i32, i64)
+
+; CP: Profile Type: path
+; CP: Index 0:
+; CP: point[1.000000e+00] 1.000000e+00
+
+define i32 @f(i32 %x) {
+entry:
+  br label %b0
+
+b0:
+  %m0 = and i32 %x, 1
+  %c0 = icmp eq i32 %m0, 0
+  br i1 %c0, label %t0, label %f0
+
+t0:
+  br label %b1
+
+f0:
+  br label %b1
+
+b1:
+  %m1 = and i32 %x, 2
+  %c1 = icmp eq i32 %m1, 0
+  br i1 %c1, label %t1, label %f1
+
+t1:
+  br label %b2
+
+f1:
+  br label %b2
+
+b2:
+  %m2 = and i32 %x, 4
+  %c2 = icmp eq i32 %m2, 0
+  br i1 %c2, label %t2, label %f2
+
+t2:
+  br label %b3
+
+f2:
+  br label %b3
+
+b3:
+  %m3 = and i32 %x, 8
+  %c3 = icmp eq i32 %m3, 0
+  br i1 %c3, label %t3, label %f3
+
+t3:
+  br label %b4
+
+f3:
+  br label %b4
+
+b4:
+  %m4 = and i32 %x, 16
+  %c4 = icmp eq i32 %m4, 0
+  br i1 %c4, label %t4, label %f4
+
+t4:
+  br label %b5
+
+f4:
+  br label %b5
+
+b5:
+  %m5 = and i32 %x, 32
+  %c5 = icmp eq i32 %m5, 0
+  br i1 %c5, label %t5, label %f5
+
+t5:
+  br label %b6
+
+f5:
+  br label %b6
+
+b6:
+  %m6 = and i32 %x, 64
+  %c6 = icmp eq i32 %m6, 0
+  br i1 %c6, label %t6, label %f6
+
+t6:
+  br label %b7
+
+f6:
+  br label %b7
+
+b7:
+  %m7 = and i32 %x, 128
+  %c7 = icmp eq i32 %m7, 0
+  br i1 %c7, label %t7, label %f7
+
+t7:
+  br label %b8
+
+f7:
+  br label %b8
+
+b8:
+  %m8 = and i32 %x, 256
+  %c8 = icmp eq i32 %m8, 0
+  br i1 %c8, label %t8, label %f8
+
+t8:
+  br label %b9
+
+f8:
+  br label %b9
+
+b9:
+  %m9 = and i32 %x, 512
+  %c9 = icmp eq i32 %m9, 0
+  br i1 %c9, label %t9, label %f9
+
+t9:
+  br label %b10
+
+f9:
+  br label %b10
+
+b10:
+  %m10 = and i32 %x, 1024
+  %c10 = icmp eq i32 %m10, 0
+  br i1 %c10, label %t10, label %f10
+
+t10:
+  br label %b11
+
+f10:
+  br label %b11
+
+b11:
+  %m11 = and i32 %x, 2048
+  %c11 = icmp eq i32 %m11, 0
+  br i1 %c11, label %t11, label %f11
+
+t11:
+  br label %b12
+
+f11:
+  br label %b12
+
+b12:
+  %m12 = and i32 %x, 4096
+  %c12 = icmp eq i32 %m12, 0
+  br i1 %c12, label %t12, label %f12
+
+t12:
+  br label %b13
+
+f12:
+  br label %b13
+
+b13:
+  %m13 = and i32 %x, 8192
+  %c13 = icmp eq i32 %m13, 0
+  br i1 %c13, label %t13, label %f13
+
+t13:
+  br label %b14
+
+f13:
+  br label %b14
+
+b14:
+  %m14 = and i32 %x, 16384
+  %c14 = icmp eq i32 %m14, 0
+  br i1 %c14, label %t14, label %f14
+
+t14:
+  br label %b15
+
+f14:
+  br label %b15
+
+b15:
+  %m15 = and i32 %x, 32768
+  %c15 = icmp eq i32 %m15, 0
+  br i1 %c15, label %t15, label %f15
+
+t15:
+  br label %b16
+
+f15:
+  br label %b16
+
+b16:
+  %m16 = and i32 %x, 65536
+  %c16 = icmp eq i32 %m16, 0
+  br i1 %c16, label %t16, label %f16
+
+t16:
+  br label %b17
+
+f16:
+  br label %b17
+
+b17:
+  %m17 = and i32 %x, 131072
+  %c17 = icmp eq i32 %m17, 0
+  br i1 %c17, label %t17, label %f17
+
+t17:
+  br label %b18
+
+f17:
+  br label %b18
+
+b18:
+  %m18 = and i32 %x, 262144
+  %c18 = icmp eq i32 %m18, 0
+  br i1 %c18, label %t18, label %f18
+
+t18:
+  br label %b19
+
+f18:
+  br label %b19
+
+b19:
+  %m19 = and i32 %x, 524288
+  %c19 = icmp eq i32 %m19, 0
+  br i1 %c19, label %t19, label %f19
+
+t19:
+  br label %b20
+
+f19:
+  br label %b20
+
+b20:
+  %m20 = and i32 %x, 1048576
+  %c20 = icmp eq i32 %m20, 0
+  br i1 %c20, label %t20, label %f20
+
+t20:
+  br label %b21
+
+f20:
+  br label %b21
+
+b21:
+  %m21 = and i32 %x, 2097152
+  %c21 = icmp eq i32 %m21, 0
+  br i1 %c21, label %t21, label %f21
+
+t21:
+  br label %b22
+
+f21:
+  br label %b22
+
+b22:
+  %m22 = and i32 %x, 4194304
+  %c22 = icmp eq i32 %m22, 0
+  br i1 %c22, label %t22, label %f22
+
+t22:
+  br label %b23
+
+f22:
+  br label %b23
+
+b23:
+  %m23 = and i32 %x, 8388608
+  %c23 = icmp eq i32 %m23, 0
+  br i1 %c23, label %t23, label %f23
+
+t23:
+  br label %b24
+
+f23:
+  br label %b24
+
+b24:
+  %m24 = and i32 %x, 16777216
+  %c24 = icmp eq i32 %m24, 0
+  br i1 %c24, label %t24, label %f24
+
+t24:
+  br label %b25
+
+f24:
+  br label %b25
+
+b25:
+  %m25 = and i32 %x, 33554432
+  %c25 = icmp eq i32 %m25, 0
+  br i1 %c25, label %t25, label %f25
+
+t25:
+  br label %b26
+
+f25:
+  br label %b26
+
+b26:
+  %m26 = and i32 %x, 67108864
+  %c26 = icmp eq i32 %m26, 0
+  br i1 %c26, label %t26, label %f26
+
+t26:
+  br label %b27
+
+f26:
+  br label %b27
+
+b27:
+  %m27 = and i32 %x, 134217728
+  %c27 = icmp eq i32 %m27, 0
+  br i1 %c27, label %t27, label %f27
+
+t27:
+  br label %b28
+
+f27:
+  br label %b28
+
+b28:
+  %m28 = and i32 %x, 268435456
+  %c28 = icmp eq i32 %m28, 0
+  br i1 %c28, label %t28, label %f28
+
+t28:
+  br label %b29
+
+f28:
+  br label %b29
+
+b29:
+  %m29 = and i32 %x, 536870912
+  %c29 = icmp eq i32 %m29, 0
+  br i1 %c29, label %t29, label %f29
+
+t29:
+  br label %b30
+
+f29:
+  br label %b30
+
+b30:
+  %m30 = and i32 %x, 1073741824
+  %c30 = icmp eq i32 %m30, 0
+  br i1 %c30, label %t30, label %f30
+
+t30:
+  br label %b31
+
+f30:
+  br label %b31
+
+b31:
+  %m31 = and i32 %x, 1
+  %c31 = icmp eq i32 %m31, 0
+  br i1 %c31, label %t31, label %f31
+
+t31:
+  br label %b32
+
+f31:
+  br label %b32
+
+b32:
+  %m32 = and i32 %x, 2
+  %c32 = icmp eq i32 %m32, 0
+  br i1 %c32, label %t32, label %f32
+
+t32:
+  br label %b33
+
+f32:
+  br label %b33
+
+b33:
+  ret i32 %x
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @f(i32 0)
+  ret i32 %r
+}
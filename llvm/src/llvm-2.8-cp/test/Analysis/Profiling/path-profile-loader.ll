@@ -0,0 +1,25 @@
+; The path profile loader skips the blocks of a raw profile it has no use
+; for: a counter map (selective instrumentation), the context paths
+; (-path-profile-context), the loop paths (-path-profile-iterations) and
+; the pruned counters, and still loads the paths that follow them.
+; Raw profile: a counter map, a context path of depth 1, a loop path of 2
+; iterations, no pruned counters, then the one path of @f, run 3 times.
+; RUN: printf {\17\0\0\0\2\0\0\0\5\0\0\0\0\0\0\0} > %t.prof
+; RUN: printf {\23\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\1\0\0\0\0\0\0\0\0\0\0\0} >> %t.prof
+; RUN: printf {\25\0\0\0\1\0\0\0\1\0\0\0\0\0\0\0\2\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0} >> %t.prof
+; RUN: printf {\30\0\0\0\0\0\0\0} >> %t.prof
+; RUN: printf {\5\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\0\0\0\0\0\0\0\0\3\0\0\0} >> %t.prof
+; RUN: opt %s -path-profile-loader -path-profile-loader-file=%t.prof \
+; RUN:   -path-profile-verifier -path-profile-verifier-file=%t.edge \
+; RUN:   -o /dev/null |& FileCheck %s
+
+; CHECK-NOT: error
+; CHECK: Generating edge profile
+
+define void @f() {
+entry:
+  ret void
+}
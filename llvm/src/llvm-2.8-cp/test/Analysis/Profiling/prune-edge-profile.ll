@@ -0,0 +1,90 @@
+; With -profile-prune-cp the edge profiler leaves out the edges that
+; converged in the earlier profile: the ones that never ran (%cold,
+; %rare) and the ones that always ran as often as their edge dominator
+; (1, 6 and 9), which it lists in @PrunedCounters.  llvm-cprof gives the
+; listed counters the count of their dominator again.
+; Raw edge profile, twice: 100 iterations, %cold and %rare never taken.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\4\0\0\0\12\0\0\0\1\0\0\0\1\0\0\0\0\0\0\0\144\0\0\0} > %t.1
+; RUN: printf {\0\0\0\0\0\0\0\0\144\0\0\0\0\0\0\0\143\0\0\0\1\0\0\0} >> %t.1
+; RUN: llvm-cprof -bc=10 -cpFile=%t.cp %t.bc %t.1 %t.1
+; RUN: opt -insert-edge-profiling -profile-prune-cp=%t.cp \
+; RUN:   -profile-prune-min-runs=2 %t.bc -S |& FileCheck %s
+; RUN: opt -insert-edge-profiling -profile-prune-cp=%t.cp %t.bc -S \
+; RUN:   |& FileCheck %s -check-prefix=FEW
+; Raw pruned profile: the pruned edge counters, then the other counts.
+; RUN: printf {\30\0\0\0\4\0\0\0\4\0\0\0\1\0\0\0\6\0\0\0\11\0\0\0} > %t.2
+; RUN: printf {\4\0\0\0\12\0\0\0\1\0\0\0\0\0\0\0\0\0\0\0\144\0\0\0} >> %t.2
+; RUN: printf {\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\143\0\0\0\0\0\0\0} >> %t.2
+; RUN: llvm-cprof -cpFile=%t.pcp %t.bc %t.2
+; RUN: llvm-cpmetrics -print %t.bc %t.pcp | FileCheck %s -check-prefix=CP
+
+; CHECK: Instrumented 3 edges (7 converged edges pruned)
+; CHECK: @PrunedCounters = internal constant [4 x i32] [i32 4, i32 1, i32 6, i32 9]
+; CHECK: call i32 @llvm_start_pruned_counters
+; CHECK-NOT: @EdgeProfCounters, i32 0, i32 {{[1245679]}})
+; CHECK: store {{.*}} @EdgeProfCounters, i32 0, i32 3)
+; CHECK-NOT: @EdgeProfCounters, i32 0, i32 {{[1245679]}})
+; CHECK: store {{.*}} @EdgeProfCounters, i32 0, i32 8)
+; CHECK-NOT: @EdgeProfCounters, i32 0, i32 {{[1245679]}})
+; CHECK: ret i32 0
+
+; FEW: Instrumented 10 edges
+; FEW-NOT: PrunedCounters
+; FEW: define i32 @main()
+
+; CP: Index 1:
+; CP: point[1.000000e+00]
+; CP: Index 6:
+; CP: point[1.000000e+00]
+; CP: Index 8:
+; CP: point[9.900000e+01]
+; CP: Index 9:
+; CP: point[1.000000e+00]
+
+@g = global i32 0
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %latch ]
+  %x = load i32* @g
+  %c = icmp eq i32 %x, -1
+  br i1 %c, label %cold, label %next
+
+cold:
+  %a = mul i32 %x, 7
+  %b = add i32 %a, 3
+  %d = xor i32 %b, 5
+  %e = mul i32 %d, %a
+  %f = sub i32 %e, %b
+  %h = shl i32 %f, 2
+  %j = or i32 %h, %d
+  store i32 %j, i32* @g
+  br label %latch
+
+next:
+  %r = icmp eq i32 %x, 42
+  br i1 %r, label %rare, label %latch
+
+rare:
+  %ra = mul i32 %i, 5
+  %rb = add i32 %ra, 9
+  %rc = xor i32 %rb, 3
+  %rd = mul i32 %rc, %ra
+  %re = sub i32 %rd, %rb
+  %rf = shl i32 %re, 1
+  %rg = or i32 %rf, %rc
+  store i32 %rg, i32* @g
+  br label %latch
+
+latch:
+  %n = add i32 %i, 1
+  %d2 = icmp slt i32 %n, 100
+  br i1 %d2, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,94 @@
+; Test the sampled instrumentation: a checking copy of each function
+; without the counters, and countdown checks at the entry and on the
+; back-edge that run the instrumented copy for 4 of every 100 checks.
+; RUN: opt < %s -insert-edge-profiling -profile-sample-interval=100 \
+; RUN:   -profile-sample-burst=4 -S | FileCheck %s
+; RUN: opt < %s -insert-path-profiling -profile-sample-interval=100 \
+; RUN:   -S | FileCheck --check-prefix=PATH %s
+; RUN: opt < %s -insert-call-profiling -profile-sample-interval=100 \
+; RUN:   -S | FileCheck --check-prefix=CALL %s
+
+; CHECK: @SampleProfCountdown = internal global i32 100
+; CHECK: @SampleProfBurst = internal global i32 0
+; CHECK: @SampleProfInfo = internal constant [2 x i32] [i32 100, i32 4]
+
+; PATH: @SampleProfInfo = internal constant [2 x i32] [i32 100, i32 1]
+; CALL: @SampleProfInfo = internal constant [2 x i32] [i32 100, i32 1]
+
+define i32 @sum(i32 %n) nounwind {
+entry:
+  br label %loop
+
+; The entry check: a call during a burst takes its share of it.
+; CHECK: define i32 @sum
+; CHECK: sample.dispatch:
+; CHECK: store i32 %sample.cnt7, i32* @SampleProfCountdown
+; CHECK: %sample.inburst = icmp sgt i32 %sample.burst, 0
+; CHECK-NEXT: br i1 %sample.inburst, label %sample.burst8, label %sample.check
+; CHECK: sample.fire:
+; CHECK-NEXT: store i32 100, i32* @SampleProfCountdown
+; CHECK-NEXT: store i32 3, i32* @SampleProfBurst
+; CHECK-NEXT: br label %entry
+; CHECK: sample.check:
+; CHECK-NEXT: %sample.done = icmp sle i32 %sample.cnt7, 0
+; CHECK-NEXT: br i1 %sample.done, label %sample.fire, label %entry.chk
+
+; A burst that ends with the interval starts the next one.
+; CHECK: sample.end:
+; CHECK-NEXT: %sample.cnt19 = load i32* @SampleProfCountdown
+; CHECK-NEXT: %sample.done20 = icmp sle i32 %sample.cnt19, 0
+; CHECK-NEXT: br i1 %sample.done20, label %sample.fire11
+
+; The instrumented loop has a preheader, and its counter is promoted.
+; CHECK: loop.sample:
+; CHECK-NEXT: %i.ph = phi i32 [ %i.next.chk, %sample.fire10 ], [ 0, %entry ]
+; CHECK: loop:
+; CHECK-NEXT: %cnt.delta21 = phi i32
+
+; The back-edge check of the instrumented copy counts towards the
+; interval as well.
+; CHECK: loop.loop_crit_edge:
+; CHECK: store i32 %sample.cnt16, i32* @SampleProfCountdown
+; CHECK: store i32 %sample.cnt18, i32* @SampleProfBurst
+; CHECK-NEXT: %sample.over = icmp slt i32 %sample.cnt18, 0
+; CHECK-NEXT: br i1 %sample.over, label %sample.end, label %loop
+
+; The checking copy has no counters.
+; CHECK: entry.chk:
+; CHECK-NOT: @EdgeProfCounters
+; CHECK: loop.loop_crit_edge.chk:
+; CHECK-NOT: @EdgeProfCounters
+; CHECK: br i1 %sample.done14, label %sample.fire10, label %loop.chk
+; CHECK-NOT: @EdgeProfCounters
+; CHECK: define i32 @main
+
+; PATH: define i32 @sum
+; PATH: sample.dispatch:
+; PATH: loop.chk:
+; PATH-NOT: pathNumber
+; PATH: exit.chk:
+; PATH-NOT: pathNumber
+; PATH: define i32 @main
+
+; CALL: define i32 @main
+; CALL: entry.chk:
+; CALL-NOT: @CallProfCounters
+; CALL: call i32 @sum
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, %i
+  %i.next = add i32 %i, 1
+  %done = icmp sge i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @main(i32 %argc, i8** %argv) nounwind {
+entry:
+  %r = call i32 @sum(i32 %argc)
+  ret i32 %r
+}
@@ -0,0 +1,161 @@
+; A raw edge profile of another version of the program is mapped onto
+; this one by its CFG checksums: @keep is unchanged and keeps its counts,
+; @grow gained the block %bx and keeps the counters that still match (10
+; of 12), but the edges %bx dominates are unknown, and @redo, whose CFG was
+; redone, is dropped.  With a higher -cp-stale-match @grow is dropped too.
+; Raw profile: the run of the old version (@grow without %bx, @redo an if
+; on %x > 10) by main: keep(0), grow(1), redo(20); its CFG checksums,
+; then its 21 edge counts.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\1\0\0\0\0\0\0\0} > %t.prof
+; RUN: printf {\27\0\0\0\46\0\0\0\4\0\0\0\245\147\74\0} >> %t.prof
+; RUN: printf {\4\1\10\6\0\0\0\0\4\0\0\0\162\164\156\145} >> %t.prof
+; RUN: printf {\364\313\237\332\46\376\133\305\342\256\145\363\277\156\72\0} >> %t.prof
+; RUN: printf {\5\31\71\6\4\0\0\0\13\0\0\0\162\164\156\145} >> %t.prof
+; RUN: printf {\4\371\311\30\3\255\53\50\330\15\16\141\74\325\325\10} >> %t.prof
+; RUN: printf {\365\10\207\12\5\346\116\146\76\305\124\354\103\27\161\250} >> %t.prof
+; RUN: printf {\140\246\173\317\176\16\132\200\52\76\100\0\200\47\205\136} >> %t.prof
+; RUN: printf {\17\0\0\0\5\0\0\0\162\164\156\145\364\313\237\332} >> %t.prof
+; RUN: printf {\351\173\343\244\342\256\145\363\342\256\145\363\345\157\75\0} >> %t.prof
+; RUN: printf {\104\22\200\76\24\0\0\0\1\0\0\0\162\164\156\145} >> %t.prof
+; RUN: printf {\4\0\0\0\25\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\0\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\1\0\0\0\0\0\0\0} >> %t.prof
+; RUN: printf {\1\0\0\0\0\0\0\0\1\0\0\0} >> %t.prof
+;
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof |& FileCheck %s -check-prefix=MAP
+; RUN: llvm-cpmetrics -print %t.bc %t.cp |& FileCheck %s
+; RUN: llvm-cprof -cp-stale-match=0.9 -cpFile=%t.cp %t.bc %t.prof \
+; RUN:   |& FileCheck %s -check-prefix=STRICT
+
+; MAP: stale edge profile: 1 changed functions matched, 1 of 4 functions dropped
+; STRICT: stale edge profile: 0 changed functions matched, 2 of 4 functions dropped
+
+; @keep: zero was taken
+; CHECK: Index 1:
+; CHECK: point[1.000000e+00]
+; CHECK: Index 2:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: zero
+; @grow: b4->b5 kept, b5->bx and bx->b6 new, the edges below them unknown
+; CHECK: Index 9:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: point[1.000000e+00]
+; CHECK: Index 10:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: zero
+; CHECK: Index 15:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: zero
+; @redo: dropped
+; CHECK: Index 16:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: zero
+; CHECK: Index 19:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: zero
+; @main
+; CHECK: Index 20:
+; CHECK-NEXT: Sums
+; CHECK-NEXT: Range
+; CHECK-NEXT: point[1.000000e+00]
+
+@g = global i32 0
+
+define void @keep(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %zero, label %done
+
+zero:
+  store i32 1, i32* @g
+  br label %done
+
+done:
+  ret void
+}
+
+define void @grow(i32 %x) {
+entry:
+  br label %b1
+
+b1:
+  %v1 = add i32 %x, 2
+  br label %b2
+
+b2:
+  %v2 = mul i32 %v1, 3
+  br label %b3
+
+b3:
+  %v3 = sub i32 %v2, 4
+  br label %b4
+
+b4:
+  %v4 = xor i32 %v3, 5
+  br label %b5
+
+b5:
+  %v5 = or i32 %v4, 6
+  br label %bx
+
+bx:
+  %vx = urem i32 %v5, 7
+  br label %b6
+
+b6:
+  %v6 = and i32 %vx, 7
+  br label %b7
+
+b7:
+  %v7 = shl i32 %v6, 8
+  br label %b8
+
+b8:
+  %v8 = lshr i32 %v7, 9
+  br label %b9
+
+b9:
+  %v9 = ashr i32 %v8, 10
+  br label %b10
+
+b10:
+  %v10 = udiv i32 %v9, 11
+  store i32 %v10, i32* @g
+  ret void
+}
+
+define void @redo(i32 %x) {
+entry:
+  switch i32 %x, label %other [
+    i32 0, label %zero
+    i32 1, label %one
+  ]
+
+zero:
+  store i32 4, i32* @g
+  ret void
+
+one:
+  call void @keep(i32 %x)
+  ret void
+
+other:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @keep(i32 0)
+  call void @grow(i32 1)
+  call void @redo(i32 20)
+  ret i32 0
+}
@@ -0,0 +1,33 @@
+; RUN: llc < %s -march=x86-64 | FileCheck %s
+
+; The profiled weights of a switch (-FDOBranchWeights) are found by case
+; value: case 7 takes 80% of the executions and is tested first, though the
+; cases were reordered and case 2 removed after profiling.
+
+; CHECK: classify:
+; CHECK-NOT: cmp
+; CHECK: cmpl $7, %edi
+; CHECK-NEXT: je
+
+define i32 @classify(i32 %x) nounwind {
+entry:
+  switch i32 %x, label %def [
+    i32 3, label %c
+    i32 1, label %a
+    i32 4, label %e
+    i32 7, label %d
+  ], !cp.weights !0
+
+a:
+  ret i32 10
+c:
+  ret i32 30
+d:
+  ret i32 70
+e:
+  ret i32 40
+def:
+  ret i32 0
+}
+
+!0 = metadata !{i32 200000, i32 1, i32 0, i32 2, i32 0, i32 3, i32 0, i32 7, i32 800000}
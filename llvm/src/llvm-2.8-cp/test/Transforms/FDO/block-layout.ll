@@ -0,0 +1,61 @@
+; %left is the more frequent successor of %loop on average (one run
+; takes it 100 times, three runs 40 times of 100), but %right is the
+; more frequent one in most runs: FDOBlockLayout makes %right the
+; fall-through, where block placement on the mean profile keeps %left.
+; Raw edge profiles: 100 iterations, %left taken 40 or 100 times.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\4\0\0\0\10\0\0\0\1\0\0\0\1\0\0\0\50\0\0\0\74\0\0\0} > %t.1
+; RUN: printf {\50\0\0\0\74\0\0\0\143\0\0\0\1\0\0\0} >> %t.1
+; RUN: printf {\4\0\0\0\10\0\0\0\1\0\0\0\1\0\0\0\144\0\0\0\0\0\0\0} > %t.2
+; RUN: printf {\144\0\0\0\0\0\0\0\143\0\0\0\1\0\0\0} >> %t.2
+; RUN: llvm-cprof -bc=10 -cpFile=%t.cp %t.bc %t.1 %t.1 %t.1 %t.2
+; RUN: opt -FDOBlockLayout -FDBL-prof=%t.cp -FDBL-eval=%t.1 %t.bc -S \
+; RUN:   |& FileCheck %s
+; RUN: opt -cp-profile-loader -cp-profile-file=%t.cp -block-placement \
+; RUN:   %t.bc -S | FileCheck %s -check-prefix=MEAN
+
+; CHECK: 301 transfers; original 199 mean 219 cp 179
+; CHECK: entry:
+; CHECK: loop:
+; CHECK: right:
+; CHECK: latch:
+; CHECK: exit:
+; CHECK: left:
+
+; MEAN: entry:
+; MEAN: loop:
+; MEAN: left:
+; MEAN: latch:
+; MEAN: exit:
+; MEAN: right:
+
+@g = global i32 0
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %latch ]
+  %r = urem i32 %i, 10
+  %c = icmp eq i32 %r, 0
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 %i, i32* @g
+  br label %latch
+
+right:
+  %v = load i32* @g
+  %w = add i32 %v, 1
+  store i32 %w, i32* @g
+  br label %latch
+
+latch:
+  %n = add i32 %i, 1
+  %d = icmp slt i32 %n, 100
+  br i1 %d, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,74 @@
+; FDOColdSplit moves %cold, which no run executed, into a noinline
+; function in .text.unlikely.  %rare ran in one of the two runs: it is
+; only split when half the runs may execute cold code.
+; Raw edge profiles: 100 iterations, %rare taken 0 or 5 times.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\4\0\0\0\12\0\0\0\1\0\0\0\1\0\0\0\0\0\0\0\144\0\0\0} > %t.1
+; RUN: printf {\0\0\0\0\0\0\0\0\144\0\0\0\0\0\0\0\143\0\0\0\1\0\0\0} >> %t.1
+; RUN: printf {\4\0\0\0\12\0\0\0\1\0\0\0\1\0\0\0\0\0\0\0\144\0\0\0} > %t.2
+; RUN: printf {\0\0\0\0\5\0\0\0\137\0\0\0\5\0\0\0\143\0\0\0\1\0\0\0} >> %t.2
+; RUN: llvm-cprof -bc=10 -cpFile=%t.cp %t.bc %t.1 %t.2
+; RUN: opt -FDOColdSplit -FDCS-prof=%t.cp %t.bc -S | FileCheck %s
+; RUN: opt -FDOColdSplit -FDCS-prof=%t.cp -FDCS-max-coverage=0.5 \
+; RUN:   -FDCS-max-weight=5 %t.bc -S | FileCheck %s -check-prefix=HALF
+
+; CHECK: define i32 @main()
+; CHECK: br i1 %c, label %codeRepl, label %next
+; CHECK: call void @main.cold(i32 %x)
+; CHECK: rare:
+; CHECK-NEXT: %ra = mul i32 %i, 5
+; CHECK: define internal void @main.cold(i32 %x) optsize noinline section ".text.unlikely"
+; CHECK: %a = mul i32 %x, 7
+
+; HALF: call void @main.cold(i32 %x)
+; HALF: call void @main.cold1(i32 %i)
+; HALF: define internal void @main.cold(i32 %x)
+; HALF: define internal void @main.cold1(i32 %i) optsize noinline section ".text.unlikely"
+; HALF: %ra = mul i32 %i, 5
+
+@g = global i32 0
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %latch ]
+  %x = load i32* @g
+  %c = icmp eq i32 %x, -1
+  br i1 %c, label %cold, label %next
+
+cold:
+  %a = mul i32 %x, 7
+  %b = add i32 %a, 3
+  %d = xor i32 %b, 5
+  %e = mul i32 %d, %a
+  %f = sub i32 %e, %b
+  %h = shl i32 %f, 2
+  %j = or i32 %h, %d
+  store i32 %j, i32* @g
+  br label %latch
+
+next:
+  %r = icmp eq i32 %x, 42
+  br i1 %r, label %rare, label %latch
+
+rare:
+  %ra = mul i32 %i, 5
+  %rb = add i32 %ra, 9
+  %rc = xor i32 %rb, 3
+  %rd = mul i32 %rc, %ra
+  %re = sub i32 %rd, %rb
+  %rf = shl i32 %re, 1
+  %rg = or i32 %rf, %rc
+  store i32 %rg, i32* @g
+  br label %latch
+
+latch:
+  %n = add i32 %i, 1
+  %d2 = icmp slt i32 %n, 100
+  br i1 %d2, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
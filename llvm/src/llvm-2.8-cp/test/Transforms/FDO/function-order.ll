@@ -0,0 +1,45 @@
+; FDOFunctionOrder gives each function its own section only with
+; -FDFO-sections, and leaves linkonce functions in their COMDAT.
+; Raw call profile: one count per function, then one for %more.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\12\0\0\0\5\0\0\0\1\0\0\0\1\0\0\0} > %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\1\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -FDOFunctionOrder -FDFO-prof=%t.cp -FDFO-sections %t.bc -S \
+; RUN:   | FileCheck %s
+; RUN: opt -FDOFunctionOrder -FDFO-prof=%t.cp %t.bc -S \
+; RUN:   | FileCheck %s -check-prefix=NOSECT
+
+; CHECK: define i32 @main() section ".text.main"
+; CHECK: define void @cold() section ".text.cold"
+; CHECK: define linkonce_odr void @lo() {
+; CHECK: define void @hot() section ".text.hot"
+
+; NOSECT-NOT: section
+; NOSECT: define void @hot() {
+
+define void @cold() {
+entry:
+  ret void
+}
+
+define linkonce_odr void @lo() {
+entry:
+  ret void
+}
+
+define void @hot() {
+entry:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @hot()
+  br label %more
+
+more:
+  call void @lo()
+  call void @cold()
+  ret i32 0
+}
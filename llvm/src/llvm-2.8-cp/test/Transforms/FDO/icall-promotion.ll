@@ -0,0 +1,66 @@
+; 90 of the 100 calls through %fp went to @f1: FDOICallPromotion guards
+; a direct call of @f1 and keeps the indirect call as the fallback.  At
+; a stability of 0.1, @f2 (10 calls) is promoted on the fallback path.
+; Raw icall profile: one site, 100 calls, @f1 (1) 90, @f2 (2) 10.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\21\0\0\0\15\0\0\0\144\0\0\0\1\0\0\0\0\0\0\0} > %t.prof
+; RUN: printf {\132\0\0\0\2\0\0\0\0\0\0\0\12\0\0\0\0\0\0\0} >> %t.prof
+; RUN: printf {\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -FDOICallPromotion -FDICP-prof=%t.cp %t.bc -S | FileCheck %s
+; RUN: opt -FDOICallPromotion -FDICP-prof=%t.cp -FDICP-stable=0.1 %t.bc -S \
+; RUN:   | FileCheck %s -check-prefix=TWO
+
+; CHECK: %fp = load i32 (i32)** %p
+; CHECK-NEXT: %icp.guard = icmp eq i32 (i32)* %fp, @f1
+; CHECK-NEXT: br i1 %icp.guard, label %icp.direct, label %icp.indirect
+; CHECK: icp.direct:
+; CHECK-NEXT: [[D:%[0-9]+]] = call i32 @f1(i32 %i)
+; CHECK: icp.indirect:
+; CHECK-NEXT: %v = call i32 %fp(i32 %i)
+; CHECK: icp.join:
+; CHECK-NEXT: %icp.ret = phi i32 [ [[D]], %icp.direct ], [ %v, %icp.indirect ]
+; CHECK-NEXT: %s1 = add i32 %s, %icp.ret
+
+; TWO: %icp.guard = icmp eq i32 (i32)* %fp, @f1
+; TWO: call i32 @f1(i32 %i)
+; TWO: icp.indirect:
+; TWO-NEXT: %icp.guard{{[0-9]+}} = icmp eq i32 (i32)* %fp, @f2
+; TWO: call i32 @f2(i32 %i)
+; TWO: %v = call i32 %fp(i32 %i)
+
+@tab = global [2 x i32 (i32)*] [i32 (i32)* @f1, i32 (i32)* @f2]
+
+define internal i32 @f1(i32 %x) {
+entry:
+  %r = add i32 %x, 1
+  ret i32 %r
+}
+
+define internal i32 @f2(i32 %x) {
+entry:
+  %r = mul i32 %x, 2
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s1, %loop ]
+  %m = urem i32 %i, 10
+  %c = icmp eq i32 %m, 0
+  %k = zext i1 %c to i64
+  %p = getelementptr [2 x i32 (i32)*]* @tab, i64 0, i64 %k
+  %fp = load i32 (i32)** %p
+  %v = call i32 %fp(i32 %i)
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %d = icmp eq i32 %i1, 100
+  br i1 %d, label %out, label %loop
+
+out:
+  ret i32 %s1
+}
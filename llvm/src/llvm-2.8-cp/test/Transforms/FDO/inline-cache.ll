@@ -0,0 +1,83 @@
+; The FDO inliner keeps its call-site evaluations and decisions in the
+; -FDI-cache file: a second build replays all three call sites, and a
+; larger budget replays them too but reports the two changed decisions.
+; Raw call profile: @hot, @cold, @init, @main, then %loop and %exit.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\12\0\0\0\6\0\0\0\144\0\0\0\1\0\0\0} > %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\144\0\0\0\1\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: rm -f %t.cache
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.a -FDI-cache=%t.cache \
+; RUN:   -FDI-budget=2 %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=FIRST < %t.a.count
+; RUN: FileCheck %s -check-prefix=CACHE1 < %t.cache
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.b -FDI-cache=%t.cache \
+; RUN:   -FDI-budget=2 %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=SAME < %t.b.count
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.c -FDI-cache=%t.cache \
+; RUN:   -FDI-budget=3 %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=CHANGED < %t.c.count
+; RUN: FileCheck %s -check-prefix=CACHE2 < %t.cache
+
+; FIRST: Calls inlined: 1
+; FIRST: Cache replayed: 0 of 3
+
+; One entry per call site: @cold (ordinal 2), @hot (1) and @init (0).
+; CACHE1: FDI-cache 1
+; CACHE1-NEXT: {{[0-9a-f]+ [0-9a-f]+}} 2 {{.*}} 90 15 15 0 0 0 0 N
+; CACHE1-NEXT: {{[0-9a-f]+ [0-9a-f]+}} 1 {{.*}} 9000 1500 15 0 0 0 0 I
+; CACHE1-NEXT: {{[0-9a-f]+ [0-9a-f]+}} 0 {{.*}} 120 15 15 0 0 0 0 N
+
+; SAME: Calls inlined: 1
+; SAME: Cache replayed: 3 of 3
+; SAME-NEXT: Cache changed: 0 decisions
+
+; CHANGED: Calls inlined: 3
+; CHANGED: Cache replayed: 3 of 3
+; CHANGED-NEXT: Cache changed: 2 decisions
+
+; CACHE2: FDI-cache 1
+; CACHE2-NEXT: {{[0-9a-f]+ [0-9a-f]+}} 2 {{.*}} I
+; CACHE2-NEXT: {{[0-9a-f]+ [0-9a-f]+}} 1 {{.*}} I
+; CACHE2-NEXT: {{[0-9a-f]+ [0-9a-f]+}} 0 {{.*}} I
+
+@g = global i32 0
+
+define void @hot() {
+entry:
+  %v = load i32* @g
+  %w = add i32 %v, 1
+  store i32 %w, i32* @g
+  ret void
+}
+
+define void @cold() {
+entry:
+  %v = load i32* @g
+  %w = mul i32 %v, 3
+  store i32 %w, i32* @g
+  ret void
+}
+
+define void @init() {
+entry:
+  store i32 0, i32* @g
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @init()
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %loop ]
+  call void @hot()
+  %n = add i32 %i, 1
+  %c = icmp slt i32 %n, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  call void @cold()
+  ret i32 0
+}
@@ -0,0 +1,66 @@
+; With -FDI-pprof the FDO inliner leaves the never-executed %cold block
+; of @callee out of the inlining cost and weights the constant-argument
+; savings by the heat of the blocks they are in, so both call sites rank
+; higher than on the call profile alone.
+; Raw path profile: the one path of @callee (path 1, %hot) run 100 times.
+; Raw call profile: @callee, @main, then %loop.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\5\0\0\0\2\0\0\0\1\0\0\0\1\0\0\0\1\0\0\0\0\0\0\0} > %t.pprof
+; RUN: printf {\144\0\0\0\2\0\0\0\1\0\0\0\0\0\0\0\0\0\0\0\1\0\0\0} >> %t.pprof
+; RUN: printf {\12\0\0\0\3\0\0\0\144\0\0\0\1\0\0\0\143\0\0\0} > %t.cprof
+; RUN: llvm-cprof -cpFile=%t.pcp %t.bc %t.pprof
+; RUN: llvm-cprof -cpFile=%t.ccp %t.bc %t.cprof
+; RUN: opt -FDOInliner -FDI-cprof=%t.ccp -FDI-log=%t.c %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=CALL < %t.c.debug
+; RUN: opt -FDOInliner -FDI-cprof=%t.ccp -FDI-pprof=%t.pcp -FDI-log=%t.p \
+; RUN:   %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=PATH < %t.p.debug
+
+; CALL: [12078.0000 100%] main[loop](7) --> callee(15) 0[] inlined
+; CALL: [122.0000 100%] main[entry](9) --> callee(15) 0[] inlined
+
+; PATH: [30690.0000 100%] main[loop](7) --> callee(15) 0[] inlined
+; PATH: [310.0000 100%] main[entry](9) --> callee(15) 0[] inlined
+
+@g = global i32 0
+
+define void @callee(i32 %x) {
+entry:
+  %z = icmp eq i32 %x, 0
+  br i1 %z, label %cold, label %hot
+
+cold:
+  %a = load i32* @g
+  %b = mul i32 %a, 7
+  %c = add i32 %b, 3
+  %d = xor i32 %c, 5
+  %e = mul i32 %d, %a
+  %f = sub i32 %e, %b
+  store i32 %f, i32* @g
+  br label %done
+
+hot:
+  %h = load i32* @g
+  %i = add i32 %h, %x
+  store i32 %i, i32* @g
+  br label %done
+
+done:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @callee(i32 1)
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %loop ]
+  call void @callee(i32 1)
+  %n = add i32 %i, 1
+  %c = icmp slt i32 %n, 99
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,74 @@
+; In global metric order the FDO inliner takes the hot call of @other
+; first and then inlines @leaf into @main through @mid; with -FDI-scc it
+; finishes @mid's SCC (mid -> leaf) before @main's, with or without
+; parallel function analysis.
+; Raw call profile: @leaf, @other, @mid, @main, then %loop.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\12\0\0\0\5\0\0\0\1\0\0\0\144\0\0\0} > %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\144\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.g %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=GLOBAL < %t.g.debug
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.s -FDI-scc %t.bc -S \
+; RUN:   | FileCheck %s -check-prefix=IR
+; RUN: FileCheck %s -check-prefix=SCC < %t.s.debug
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.t -FDI-scc \
+; RUN:   -FDI-threads=2 %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=SCC < %t.t.debug
+
+; GLOBAL: main[loop](7) --> other(4) 0[] inlined
+; GLOBAL: main[entry](9) --> mid(2) 0[] inlined
+; GLOBAL: main[entry](9) --> leaf(4) 1[mid] inlined
+; GLOBAL: Calls inlined: 3
+
+; SCC: mid[entry](2) --> leaf(4) 0[] inlined
+; SCC: main[loop](7) --> other(4) 0[] inlined
+; SCC: main[entry](9) --> mid(4) 0[] inlined
+; SCC: Calls inlined: 3
+
+; IR: define void @mid()
+; IR-NOT: call
+; IR: ret void
+; IR: define i32 @main()
+; IR-NOT: call
+; IR: ret i32 0
+
+@g = global i32 0
+
+define void @leaf() {
+entry:
+  %v = load i32* @g
+  %w = add i32 %v, 1
+  store i32 %w, i32* @g
+  ret void
+}
+
+define void @other() {
+entry:
+  %v = load i32* @g
+  %w = mul i32 %v, 3
+  store i32 %w, i32* @g
+  ret void
+}
+
+define void @mid() {
+entry:
+  call void @leaf()
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @mid()
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %loop ]
+  call void @other()
+  %n = add i32 %i, 1
+  %c = icmp slt i32 %n, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,72 @@
+; The inlining simulator picks the call sites in the order the FDO
+; inliner does: the hot call in %loop (100 calls) first, then @init and
+; @cold (1 call each).  A budget of 2 stops the real inliner after @hot.
+; Raw call profile: @hot, @cold, @init, @main, then %loop and %exit.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\12\0\0\0\6\0\0\0\144\0\0\0\1\0\0\0} > %t.prof
+; RUN: printf {\1\0\0\0\1\0\0\0\144\0\0\0\1\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -FDOInlineSim -FDI-cprof=%t.cp -FDIS-max-inlines=1 \
+; RUN:   -FDIS-depths=0,1 -FDIS-threads=2 %t.bc -o /dev/null \
+; RUN:   | FileCheck %s -check-prefix=ONE
+; RUN: opt -FDOInlineSim -FDI-cprof=%t.cp -FDIS-threads=2 %t.bc \
+; RUN:   -o /dev/null | FileCheck %s -check-prefix=ALL
+; RUN: opt -FDOInliner -FDI-cprof=%t.cp -FDI-log=%t.log -FDI-budget=2 \
+; RUN:   %t.bc -S | FileCheck %s -check-prefix=IR
+; RUN: FileCheck %s -check-prefix=LOG < %t.log.debug
+
+; ONE: # FDO inlining simulation: 4 functions, 3 call sites, size 18
+; ONE: 0 mean - 180 0 1 0 0 0 -6 -33.33 8 1 100.0000 1500.00
+; ONE: 1 mean - 180 1 1 0 0 0 -6 -33.33 8 1 100.0000 1500.00
+
+; ALL: 0 mean - 180 0 3 0 0 0 -20 -111.11 -12 3 102.0000 1530.00
+
+; IR: define i32 @main()
+; IR: call void @init()
+; IR-NOT: call
+; IR: call void @cold()
+
+; LOG: main[loop](8) --> hot(4) 0[] inlined
+; LOG-NOT: inlined
+; LOG: Calls inlined: 1
+
+@g = global i32 0
+
+define void @hot() {
+entry:
+  %v = load i32* @g
+  %w = add i32 %v, 1
+  store i32 %w, i32* @g
+  ret void
+}
+
+define void @cold() {
+entry:
+  %v = load i32* @g
+  %w = mul i32 %v, 3
+  store i32 %w, i32* @g
+  ret void
+}
+
+define void @init() {
+entry:
+  store i32 0, i32* @g
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @init()
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %loop ]
+  call void @hot()
+  %n = add i32 %i, 1
+  %c = icmp slt i32 %n, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  call void @cold()
+  ret i32 0
+}
@@ -0,0 +1,80 @@
+; @callee is too big for a budget of 4, but its %cold block never ran:
+; with -FDI-eprof the FDO inliner outlines it into @callee.cold and
+; inlines the rest of @callee into the hot loop.
+; Raw edge profile: @callee called 100 times, %cold never taken.
+; Raw call profile: @callee, @main, then %loop.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\4\0\0\0\11\0\0\0\144\0\0\0\0\0\0\0\144\0\0\0\0\0\0\0} > %t.eprof
+; RUN: printf {\144\0\0\0\1\0\0\0\1\0\0\0\142\0\0\0\1\0\0\0} >> %t.eprof
+; RUN: printf {\12\0\0\0\3\0\0\0\144\0\0\0\1\0\0\0\143\0\0\0} > %t.cprof
+; RUN: llvm-cprof -cpFile=%t.ecp %t.bc %t.eprof
+; RUN: llvm-cprof -cpFile=%t.ccp %t.bc %t.cprof
+; RUN: opt -FDOInliner -FDI-cprof=%t.ccp -FDI-log=%t.c -FDI-budget=4 \
+; RUN:   %t.bc -o /dev/null
+; RUN: FileCheck %s -check-prefix=WHOLE < %t.c.count
+; RUN: opt -FDOInliner -FDI-cprof=%t.ccp -FDI-eprof=%t.ecp -FDI-log=%t.e \
+; RUN:   -FDI-budget=4 %t.bc -S | FileCheck %s
+; RUN: FileCheck %s -check-prefix=COUNT < %t.e.count
+
+; WHOLE: Calls inlined: 0
+; WHOLE: Rejected (big): 1
+
+; CHECK: define void @callee(i32 %x)
+; CHECK: call void @callee.cold()
+; CHECK: define i32 @main()
+; CHECK: call void @callee(i32 %v0)
+; CHECK: loop:
+; CHECK-NOT: call void @callee(
+; CHECK: call void @callee.cold()
+; CHECK: exit:
+; CHECK: define internal void @callee.cold() optsize noinline section ".text.unlikely"
+; CHECK: %b = mul i32 %a, 7
+
+; COUNT: Calls inlined: 1
+; COUNT: Cold outlined: 1 callees
+
+@g = global i32 0
+
+define void @callee(i32 %x) {
+entry:
+  %z = icmp eq i32 %x, 0
+  br i1 %z, label %cold, label %hot
+
+cold:
+  %a = load i32* @g
+  %b = mul i32 %a, 7
+  %c = add i32 %b, 3
+  %d = xor i32 %c, 5
+  %e = mul i32 %d, %a
+  %f = sub i32 %e, %b
+  %f2 = shl i32 %f, 1
+  store i32 %f2, i32* @g
+  br label %done
+
+hot:
+  %h = load i32* @g
+  %i = add i32 %h, %x
+  store i32 %i, i32* @g
+  br label %done
+
+done:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %v0 = load i32* @g
+  call void @callee(i32 %v0)
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %loop ]
+  %v = load i32* @g
+  call void @callee(i32 %v)
+  %n = add i32 %i, 1
+  %c = icmp slt i32 %n, 99
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,65 @@
+; The path through %hot runs 89 of @f's 100 times: FDOSuperblocks makes
+; entry, %hot, %join and %tail a superblock by copying %join and %tail
+; for the side entrance from %side, with phis for the values of the
+; copied blocks.
+; Raw path profile of @f: path 0 (%hot) 89 times, path 1 (%side) 11.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\5\0\0\0\1\0\0\0\1\0\0\0\2\0\0\0\0\0\0\0\0\0\0\0} > %t.prof
+; RUN: printf {\131\0\0\0\1\0\0\0\0\0\0\0\13\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -FDOSuperblocks -FDSB-prof=%t.cp %t.bc -S | FileCheck %s
+
+; CHECK: side:
+; CHECK-NEXT: %s = sub i32 %x, 1
+; CHECK-NEXT: br label %join.sb
+; CHECK: join: ; preds = %hot
+; CHECK-NEXT: %p = phi i32 [ %h, %hot ]
+; CHECK: tail: ; preds = %join
+; CHECK-NEXT: [[R:%[a-z0-9]+]] = phi i32 [ %r, %join ]
+; CHECK-NEXT: %t = add i32 [[R]], %x
+; CHECK: join.sb: ; preds = %side
+; CHECK-NEXT: [[P:%[a-z0-9]+]] = phi i32 [ %s, %side ]
+; CHECK-NEXT: [[RSB:%[a-z0-9]+]] = mul i32 [[P]], 2
+; CHECK-NEXT: br label %tail.sb
+; CHECK: tail.sb: ; preds = %join.sb
+; CHECK-NEXT: [[R2:%[a-z0-9]+]] = phi i32 [ [[RSB]], %join.sb ]
+; CHECK-NEXT: add i32 [[R2]], %x
+
+define i32 @f(i32 %x) {
+entry:
+  %c = icmp sgt i32 %x, 0
+  br i1 %c, label %hot, label %side
+
+hot:
+  %h = add i32 %x, 1
+  br label %join
+
+side:
+  %s = sub i32 %x, 1
+  br label %join
+
+join:
+  %p = phi i32 [ %h, %hot ], [ %s, %side ]
+  %r = mul i32 %p, 2
+  br label %tail
+
+tail:
+  %t = add i32 %r, %x
+  ret i32 %t
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %n, %loop ]
+  %a = sub i32 %i, 10
+  %v = call i32 @f(i32 %a)
+  %n = add i32 %i, 1
+  %d = icmp slt i32 %n, 100
+  br i1 %d, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
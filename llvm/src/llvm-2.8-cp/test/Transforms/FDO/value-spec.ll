@@ -0,0 +1,41 @@
+; FDOValueSpec guards the call of @work on the argument value that 9 of
+; its 10 calls had, and calls a clone specialized for it; at a stability
+; threshold above 0.9 the call is left alone.
+; Raw value profile: one site, 10 calls, value 100 in 9 of them.
+; RUN: llvm-as %s -o %t.bc
+; RUN: printf {\14\0\0\0\15\0\0\0\12\0\0\0\144\0\0\0\0\0\0\0} > %t.prof
+; RUN: printf {\11\0\0\0\1\0\0\0\0\0\0\0\1\0\0\0\0\0\0\0} >> %t.prof
+; RUN: printf {\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0} >> %t.prof
+; RUN: llvm-cprof -cpFile=%t.cp %t.bc %t.prof
+; RUN: opt -FDOValueSpec -FDVS-vprof=%t.cp %t.bc -S | FileCheck %s
+; RUN: opt -FDOValueSpec -FDVS-vprof=%t.cp -FDVS-stable=0.95 %t.bc -S \
+; RUN:   | not grep vspec
+
+; CHECK: define i32 @main
+; CHECK: %vspec.guard = icmp eq i32 %argc, 100
+; CHECK-NEXT: br i1 %vspec.guard, label %vspec, label %vspec.generic
+; CHECK: call i32 @work.vspec(i32 100)
+; CHECK: vspec.generic:
+; CHECK-NEXT: %r = call i32 @work(i32 %argc)
+; CHECK: phi i32
+; CHECK: define internal i32 @work.vspec(i32 %n)
+; CHECK: icmp sgt i32 100, 50
+
+define i32 @work(i32 %n) {
+entry:
+  %c = icmp sgt i32 %n, 50
+  br i1 %c, label %big, label %small
+
+big:
+  %b = mul i32 %n, 3
+  ret i32 %b
+
+small:
+  ret i32 %n
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %r = call i32 @work(i32 %argc)
+  ret i32 %r
+}
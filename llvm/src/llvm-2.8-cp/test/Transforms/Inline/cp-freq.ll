@@ -0,0 +1,44 @@
+; RUN: opt < %s -inline -S | FileCheck %s
+
+; The profiled block frequencies (!cp.freq, from -FDOBlockFreqs) of the callee
+; are per call of the callee, whose entry weighs 1000: the inlined blocks scale
+; them by the frequency of the call site's block (500), and both halves of that
+; block keep its own.
+
+define internal i32 @callee(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %zero, label %done, !cp.freq !0
+
+zero:
+  br label %done, !cp.freq !1
+
+done:
+  %r = phi i32 [ 1, %zero ], [ %x, %entry ]
+  ret i32 %r, !cp.freq !0
+}
+
+define i32 @caller(i32 %x) {
+entry:
+  %r = call i32 @callee(i32 %x)
+  br label %exit, !cp.freq !2
+
+exit:
+  ret i32 %r, !cp.freq !0
+}
+
+; CHECK: define i32 @caller
+; CHECK: entry:
+; CHECK: label %callee.exit, !cp.freq [[CALL:![0-9]+]]
+; CHECK: zero.i:
+; CHECK: br label %callee.exit, !cp.freq [[ZERO:![0-9]+]]
+; CHECK: callee.exit:
+; CHECK: br label %exit, !cp.freq [[CALL]]
+; CHECK: ret i32 %r.i, !cp.freq [[ENTRY:![0-9]+]]
+; CHECK: [[CALL]] = metadata !{i64 500}
+; CHECK: [[ZERO]] = metadata !{i64 5}
+; CHECK: [[ENTRY]] = metadata !{i64 1000}
+
+!0 = metadata !{i64 1000}
+!1 = metadata !{i64 10}
+!2 = metadata !{i64 500}
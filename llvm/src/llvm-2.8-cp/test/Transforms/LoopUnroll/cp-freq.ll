@@ -0,0 +1,33 @@
+; RUN: opt < %s -loop-unroll -unroll-count=4 -S | FileCheck %s
+
+; Each of the 4 copies of the unrolled loop runs a quarter of its iterations:
+; the profiled block frequencies (!cp.freq, from -FDOBlockFreqs) of the loop
+; are divided among them (the copies are merged into one block here), those
+; outside the loop kept.
+
+; CHECK: entry:
+; CHECK: br label %loop, !cp.freq [[ENTRY:![0-9]+]]
+; CHECK: loop:
+; CHECK: %i.next.3 = add
+; CHECK: br i1 %done.3, label %exit, label %loop, !cp.freq [[SHARE:![0-9]+]]
+; CHECK: exit:
+; CHECK: ret i32 %i.next.lcssa, !cp.freq [[ENTRY]]
+; CHECK: [[ENTRY]] = metadata !{i64 1000}
+; CHECK: [[SHARE]] = metadata !{i64 2000}
+
+define i32 @count() nounwind {
+entry:
+  br label %loop, !cp.freq !0
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, 8
+  br i1 %done, label %exit, label %loop, !cp.freq !1
+
+exit:
+  ret i32 %i.next, !cp.freq !0
+}
+
+!0 = metadata !{i64 1000}
+!1 = metadata !{i64 8000}
@@ -0,0 +1,36 @@
+; RUN: opt < %s -loop-unroll -unroll-count=3 -S | FileCheck %s
+
+; Without a known trip count every copy of the latch keeps its exit test (as
+; when unrolling by the profiled trip counts, -FDOTripCounts), so the exit
+; phi needs an entry from each of them.
+
+; CHECK: exit:
+; CHECK-NEXT: %s.next.lcssa = phi i32 [ %s.next, %latch ], [ %s.next.1, %latch.1 ], [ %s.next.2, %latch.2 ]
+; CHECK: loop.1:
+; CHECK: latch.2:
+; CHECK: br i1 %done.2, label %exit, label %loop
+
+define i32 @sum(i32 %n) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %odd = and i32 %i, 1
+  %c = icmp eq i32 %odd, 0
+  br i1 %c, label %even, label %latch
+
+even:
+  %s2 = add i32 %s, %i
+  br label %latch
+
+latch:
+  %s.next = phi i32 [ %s2, %even ], [ %s, %loop ]
+  %i.next = add i32 %i, 1
+  %done = icmp sge i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %s.next
+}
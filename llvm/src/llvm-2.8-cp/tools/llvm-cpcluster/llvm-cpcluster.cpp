@@ -0,0 +1,442 @@
+//===- llvm-cpcluster.cpp - Combined profiles per cluster of runs ---------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool splits a set of profiled runs into clusters of runs with
+// similar behavior, and builds one combined profile per cluster, for
+// the passes that specialize code for each input class
+// (-FDOMultiversion).
+//
+// Each run (one argument block and the raw profiles after it) is
+// described by its hierarchically-normalized edge frequencies, as they
+// go into a combined edge profile, on a log scale (log(1 + f)) so that
+// loop trip counts do not drown the branch biases.  The runs are
+// clustered by k-means, from the runs farthest apart.  Cluster c is
+// written to <prefix><c>.cp with all the profile types of its runs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Analysis/EdgeDominatorTree.h"
+#include "llvm/Analysis/ProfileInfoTypes.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/System/Signals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+#define VERBOSE(s) if( Verbose ) { s; }
+
+using namespace llvm;
+
+namespace {
+	// Uninstrumented bitcode file
+	cl::opt<std::string> BitcodeFile(cl::Positional,
+		cl::desc("<program bitcode file>"), cl::Required);
+
+	// Raw profiles of the runs
+	cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
+		cl::desc("<raw profile files>"));
+
+	cl::opt<unsigned> Clusters("k", cl::init(2),
+		cl::desc("Number of clusters"));
+
+	cl::opt<unsigned> MaxIterations("max-iter", cl::init(100), cl::Hidden,
+		cl::desc("Most k-means iterations"));
+
+	cl::opt<std::string> Prefix("prefix", cl::init("cluster"),
+		cl::value_desc("prefix"),
+		cl::desc("Cluster c is written to <prefix><c>.cp"));
+
+	cl::opt<bool> Verbose("v",
+		cl::desc("Print the runs of each cluster"));
+
+  // one profiled run
+  struct Run {
+    std::string file;
+    std::string args;
+    std::vector<double> x;  // log(1 + normalized edge frequency)
+  };
+
+  // ---------------------------------------------------------------------------
+
+  // load a module's bitcode into memory
+	Module* loadModule()
+  {
+		LLVMContext &Context = getGlobalContext();
+    Module* M = NULL;
+
+		// Read in the bitcode file ...
+		std::string ErrorMessage;
+		if (MemoryBuffer *Buffer = MemoryBuffer::getFileOrSTDIN(BitcodeFile,
+                                                            &ErrorMessage))
+    {
+			M = ParseBitcodeFile(Buffer, Context, &ErrorMessage);
+			delete Buffer;
+		}
+
+		// Ensure the module has been loaded
+		if (M == NULL)
+			errs() << BitcodeFile << ": " << ErrorMessage << "\n";
+
+		return(M);
+	}
+
+
+  bool readArguments(FILE* file, std::string& args)
+  {
+    unsigned length;
+    if( fread(&length, sizeof(unsigned), 1, file) != 1 )
+      return(false);
+
+    std::vector<char> buffer(length + 1, '\0');
+    if( fread(&buffer[0], 1, length, file) != length )
+      return(false);
+    args = &buffer[0];
+
+    // byte alignment
+    return(fseek(file, (4-(length&3))%4, SEEK_CUR) == 0);
+  }
+
+
+  // the hierarchically-normalized frequencies of a raw edge profile (see
+  // CombinedEdgeProfile::addProfile), or of an optimal one's edge counts
+  bool readEdges(FILE* file, bool optimal, Module& M, EdgeDominatorTree& edt,
+                 std::vector<double>& x)
+  {
+    unsigned edgeCount;
+    if( fread(&edgeCount, sizeof(unsigned), 1, file) != 1 )
+      return(false);
+
+    std::vector<unsigned> counts(edgeCount);
+    if( (edgeCount > 0)
+        && (fread(&counts[0], sizeof(unsigned), edgeCount, file) != edgeCount) )
+      return(false);
+    if(optimal)
+    {
+      std::vector<unsigned> raw;
+      raw.swap(counts);
+      if( !CombinedEdgeProfile::expandOptimalCounts(M, raw, counts) )
+        return(false);
+      edgeCount = counts.size();
+    }
+
+    // a profile of another version of the program (checked before the
+    // dominators, which are indexed by the program's edges)
+    if(edgeCount != edt.getEdgeCount())
+    {
+      errs() << "error: the profile has " << edgeCount
+             << " edges, the program " << edt.getEdgeCount() << "\n";
+      return(false);
+    }
+
+    x.assign(edgeCount, 0);
+    for(unsigned i = 0; i < edgeCount; i++)
+    {
+      unsigned dom = edt.getDominatorIndex(i);
+      double f = 1;  // roots
+      if(dom != i)
+        f = counts[dom] ? double(counts[i]) / double(counts[dom]) : 0;
+      x[i] = std::log(1 + f);
+    }
+    return(true);
+  }
+
+
+  // Reads the runs of the raw profile files, numbered as by
+  // CPFactory::selectRuns.  Only the first edge profile of a run is
+  // kept.
+  bool readRuns(Module& M, EdgeDominatorTree& edt, std::vector<Run>& runs)
+  {
+    for(unsigned fnum = 0, E = InputFilenames.size(); fnum < E; ++fnum)
+    {
+      FILE* file = fopen(InputFilenames[fnum].c_str(), "rb");
+      if( !file )
+      {
+        errs() << "error: cannot open '" << InputFilenames[fnum] << "'\n";
+        return(false);
+      }
+
+      bool fresh = true;
+      bool error = false;
+      runs.push_back(Run());
+      runs.back().file = InputFilenames[fnum];
+
+      ProfilingType profType;
+      while( !error && (fread(&profType, sizeof(ProfilingType), 1, file) > 0) )
+      {
+        if( (profType == ArgumentInfo) && !fresh )
+        {
+          runs.push_back(Run());
+          runs.back().file = InputFilenames[fnum];
+        }
+        fresh = false;
+
+        Run& run = runs.back();
+        if(profType == ArgumentInfo)
+          error = !readArguments(file, run.args);
+        else if( ((profType == EdgeInfo) || (profType == OptEdgeInfo))
+                 && run.x.empty() )
+          error = !readEdges(file, profType == OptEdgeInfo, M, edt, run.x);
+        else
+          error = !CPFactory::skipRawProfile(profType, file);
+      }
+      fclose(file);
+
+      if(error)
+      {
+        errs() << "error: bad or combined profile in '"
+               << InputFilenames[fnum] << "' ("
+               << CPFactory::profilingTypeToString(profType) << ")\n";
+        return(false);
+      }
+    }
+    return(true);
+  }
+
+
+  double sqDistance(const std::vector<double>& a,
+                    const std::vector<double>& b)
+  {
+    double d = 0;
+    for(unsigned i = 0, E = a.size(); i != E; ++i)
+      d += (a[i] - b[i]) * (a[i] - b[i]);
+    return(d);
+  }
+
+
+  unsigned nearest(const std::vector<double>& x,
+                   const std::vector<std::vector<double> >& centers)
+  {
+    unsigned best = 0;
+    for(unsigned c = 1, E = centers.size(); c != E; ++c)
+      if( sqDistance(x, centers[c]) < sqDistance(x, centers[best]) )
+        best = c;
+    return(best);
+  }
+
+
+  // k-means over the runs with an edge profile; clusterOf[r] is -1 for
+  // the others.  Returns the number of clusters.
+  unsigned cluster(std::vector<Run>& runs, std::vector<int>& clusterOf)
+  {
+    std::vector<unsigned> points;
+    for(unsigned r = 0, E = runs.size(); r != E; ++r)
+      if( !runs[r].x.empty() )
+        points.push_back(r);
+    clusterOf.assign(runs.size(), -1);
+    if(points.empty())
+      return(0);
+
+    // the first run, then each time the run farthest from its center
+    std::vector<std::vector<double> > centers;
+    centers.push_back(runs[points[0]].x);
+    unsigned k = std::min((unsigned)Clusters, (unsigned)points.size());
+    while(centers.size() < k)
+    {
+      unsigned far = points[0];
+      double farthest = -1;
+      for(unsigned p = 0, E = points.size(); p != E; ++p)
+      {
+        std::vector<double>& x = runs[points[p]].x;
+        double d = sqDistance(x, centers[nearest(x, centers)]);
+        if(d > farthest)
+        {
+          farthest = d;
+          far = points[p];
+        }
+      }
+      if(farthest <= 0)
+        break;  // fewer distinct runs than clusters
+      centers.push_back(runs[far].x);
+    }
+
+    for(unsigned it = 0; it < MaxIterations; ++it)
+    {
+      bool changed = false;
+      for(unsigned p = 0, E = points.size(); p != E; ++p)
+      {
+        int c = nearest(runs[points[p]].x, centers);
+        if(clusterOf[points[p]] != c)
+        {
+          clusterOf[points[p]] = c;
+          changed = true;
+        }
+      }
+      if( !changed )
+        break;
+
+      // move each center to the mean of its runs (empty: stays)
+      for(unsigned c = 0, E = centers.size(); c != E; ++c)
+      {
+        std::vector<double> sum(centers[c].size(), 0);
+        unsigned n = 0;
+        for(unsigned p = 0, PE = points.size(); p != PE; ++p)
+        {
+          if(clusterOf[points[p]] != (int)c) continue;
+          std::vector<double>& x = runs[points[p]].x;
+          for(unsigned i = 0, IE = x.size(); i != IE; ++i)
+            sum[i] += x[i];
+          n++;
+        }
+        if(n == 0) continue;
+        for(unsigned i = 0, IE = sum.size(); i != IE; ++i)
+          sum[i] /= n;
+        centers[c] = sum;
+      }
+    }
+    return(centers.size());
+  }
+
+
+  // build the combined profiles of some runs and write them to a file
+  // (as llvm-cprof does)
+  bool writeCluster(Module& M, const std::set<unsigned>& members,
+                    const std::string& filename)
+  {
+    CPFactory fact = CPFactory(M);
+    fact.selectRuns(members);
+    if( !fact.buildProfiles(InputFilenames) )
+      return(false);
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if( !file )
+    {
+      errs() << "error: cannot open '" << filename << "' for writing.\n";
+      return(false);
+    }
+
+    if(fact.hasEdgeCP())
+    {
+      CombinedEdgeProfile* cep = fact.takeEdgeCP();
+      cep->serialize(file);
+      delete cep;
+    }
+    if(fact.hasPathCP())
+    {
+      CombinedPathProfile* cpp = fact.takePathCP();
+      cpp->serialize(file);
+      delete cpp;
+    }
+    if(fact.hasCallCP())
+    {
+      CombinedCallProfile* ccp = fact.takeCallCP();
+      ccp->serialize(file);
+      delete ccp;
+    }
+    if(fact.hasValueCP())
+    {
+      CombinedValueProfile* cvp = fact.takeValueCP();
+      cvp->serialize(file);
+      delete cvp;
+    }
+    if(fact.hasICallCP())
+    {
+      CombinedICallProfile* cip = fact.takeICallCP();
+      cip->serialize(file);
+      delete cip;
+    }
+    if(fact.hasContextPathCP())
+    {
+      CombinedContextPathProfile* cxp = fact.takeContextPathCP();
+      cxp->serialize(file);
+      delete cxp;
+    }
+    if(fact.hasLoopPathCP())
+    {
+      CombinedLoopPathProfile* clp = fact.takeLoopPathCP();
+      clp->serialize(file);
+      delete clp;
+    }
+    fclose(file);
+    return(true);
+  }
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+  // Print a stack trace if we signal out.
+	sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+
+	// Call llvm_shutdown() on exit.
+  llvm_shutdown_obj Y;
+
+	// Setup command line arguments
+  cl::ParseCommandLineOptions(argc, argv,
+		"llvm combined profile run clustering\n");
+
+  Module* M = loadModule();
+  if( M == NULL ) return 1;
+
+  std::vector<Run> runs;
+  EdgeDominatorTree* edt = new EdgeDominatorTree(*M);
+  bool read = readRuns(*M, *edt, runs);
+  delete edt;
+  if( !read )
+  {
+    delete M;
+    return(1);
+  }
+
+  std::vector<int> clusterOf;
+  unsigned k = cluster(runs, clusterOf);
+  if(k == 0)
+  {
+    errs() << "error: no edge profiles\n";
+    delete M;
+    return(1);
+  }
+
+  int status = 0;
+  for(unsigned c = 0; c < k; ++c)
+  {
+    std::set<unsigned> members;
+    for(unsigned r = 0, E = runs.size(); r != E; ++r)
+      if(clusterOf[r] == (int)c)
+        members.insert(r);
+
+    std::string filename = Prefix + utostr(c) + ".cp";
+    outs() << "cluster " << c << ": " << members.size() << " runs -> "
+           << filename << "\n";
+    VERBOSE(
+      for(std::set<unsigned>::iterator r = members.begin(),
+            E = members.end(); r != E; ++r)
+        outs() << format("  %4u  ", *r) << runs[*r].file << "  '"
+               << runs[*r].args << "'\n";
+    );
+
+    if( !writeCluster(*M, members, filename) )
+      status = 1;
+  }
+
+  for(unsigned r = 0, E = runs.size(); r != E; ++r)
+    if(clusterOf[r] < 0)
+      errs() << "warning: run " << r << " (" << runs[r].file
+             << ") has no edge profile\n";
+
+  delete M;
+  CPFactory::freeStaticData();
+
+  return(status);
+}
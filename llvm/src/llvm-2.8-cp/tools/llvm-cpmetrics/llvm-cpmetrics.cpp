@@ -99,7 +99,9 @@ CombinedProfile* getCP(const std::string& filename, Module& M)
     return(rc);
   }
   
-  int numProfs = fact.hasEdgeCP() + fact.hasPathCP() + fact.hasCallCP();
+  int numProfs = fact.hasEdgeCP() + fact.hasPathCP() + fact.hasCallCP()
+    + fact.hasValueCP() + fact.hasICallCP() + fact.hasContextPathCP()
+    + fact.hasLoopPathCP();
   if(numProfs != 1)
   {
     errs() << "Error: CP file has more than one type of profile\n";
@@ -109,6 +111,10 @@ CombinedProfile* getCP(const std::string& filename, Module& M)
   if(fact.hasEdgeCP()) rc = fact.takeEdgeCP();
   if(fact.hasPathCP()) rc = fact.takePathCP();
   if(fact.hasCallCP()) rc = fact.takeCallCP();
+  if(fact.hasValueCP()) rc = fact.takeValueCP();
+  if(fact.hasICallCP()) rc = fact.takeICallCP();
+  if(fact.hasContextPathCP()) rc = fact.takeContextPathCP();
+  if(fact.hasLoopPathCP()) rc = fact.takeLoopPathCP();
   
   return(rc);
 }
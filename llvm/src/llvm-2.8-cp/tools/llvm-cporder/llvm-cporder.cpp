@@ -0,0 +1,135 @@
+//===- llvm-cporder.cpp - Function link order from a call profile ---------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool computes a link order of the functions of a program from a
+// combined call profile (see CPFunctionOrder.h), and writes it as an
+// order file: one section name per line (.text.<function>, for gold's
+// --section-ordering-file on code built with -FDOFunctionOrder or
+// function sections), or one symbol name per line with -symbols.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/CPFactory.h"
+#include "llvm/Analysis/CPFunctionOrder.h"
+#include "llvm/Analysis/CombinedProfile.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/System/Signals.h"
+
+#define VERBOSE(s) if( Verbose ) { s; }
+
+using namespace llvm;
+
+namespace {
+	// Uninstrumented bitcode file
+	cl::opt<std::string> BitcodeFile(cl::Positional,
+		cl::desc("<program bitcode file>"), cl::Required);
+
+	// Combined call profile
+	cl::opt<std::string> ProfileFile(cl::Positional,
+		cl::desc("<combined call profile>"), cl::Required);
+
+	cl::opt<std::string> OutputFilename("o", cl::init("-"),
+		cl::desc("Order file (default: stdout)"), cl::value_desc("filename"));
+
+	cl::opt<double> Quantile("q", cl::init(0.5),
+		cl::desc("Quantile of the call frequency distributions"));
+
+	cl::opt<unsigned> MaxCluster("max-cluster", cl::init(1024),
+		cl::desc("Largest cluster of functions (instructions)"));
+
+	cl::opt<bool> Symbols("symbols",
+		cl::desc("Write symbol names instead of section names"));
+
+	cl::opt<bool> Verbose("v",
+		cl::desc("Print the estimated calls of each function"));
+
+  // ---------------------------------------------------------------------------
+
+  // load a module's bitcode into memory
+	Module* loadModule()
+  {
+		LLVMContext &Context = getGlobalContext();
+    Module* M = NULL;
+
+		// Read in the bitcode file ...
+		std::string ErrorMessage;
+		if (MemoryBuffer *Buffer = MemoryBuffer::getFileOrSTDIN(BitcodeFile,
+                                                            &ErrorMessage))
+    {
+			M = ParseBitcodeFile(Buffer, Context, &ErrorMessage);
+			delete Buffer;
+		}
+
+		// Ensure the module has been loaded
+		if (M == NULL)
+			errs() << BitcodeFile << ": " << ErrorMessage << "\n";
+
+		return(M);
+	}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+  // Print a stack trace if we signal out.
+	sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+
+	// Call llvm_shutdown() on exit.
+  llvm_shutdown_obj Y;
+
+	// Setup command line arguments
+  cl::ParseCommandLineOptions(argc, argv,
+		"llvm combined call profile function orderer\n");
+
+  Module* M = loadModule();
+  if( M == NULL ) return 1;
+
+  CPFactory fact = CPFactory(*M);
+  if( !fact.buildProfiles(ProfileFile) || !fact.hasCallCP() )
+  {
+    errs() << "error: no call profile in '" << ProfileFile << "'\n";
+    delete M;
+    return(1);
+  }
+  CombinedCallProfile* ccp = fact.takeCallCP();
+
+  CPFunctionOrder order(*M, *ccp, Quantile, MaxCluster);
+
+  VERBOSE(
+    const CPFunctionOrder::Order& functions = order.getOrder();
+    for(unsigned f = 0, E = functions.size(); f != E; ++f)
+      errs() << format("%12.2f  ", order.getCalls(functions[f]))
+             << functions[f]->getName() << "\n";
+  );
+
+  std::string error;
+  raw_fd_ostream out(OutputFilename.c_str(), error);
+  if( !error.empty() )
+  {
+    errs() << error << "\n";
+    return(1);
+  }
+  order.writeOrderFile(out, !Symbols);
+
+  delete ccp;
+  delete M;
+  fact.freeStaticData();
+
+  return(0);
+}
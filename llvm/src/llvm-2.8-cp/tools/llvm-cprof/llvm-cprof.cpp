@@ -155,6 +155,56 @@ int main(int argc, char *argv[])
     VERBOSE(errs() << "CCP: wrote " << written << " histograms.\n");
     delete ccpOut;
   }
+
+  // write the combined value profile
+  if(fact.hasValueCP())
+  {
+    CombinedValueProfile* cvpOut = fact.takeValueCP();
+    VERBOSE(errs() << "CVP: " << cvpOut->getSiteCount() << " value sites, "
+            << cvpOut->size() << " values\n");
+    VERBOSE(errs() << "Writing combined value profile to '" 
+            << CPOutFile.c_str() << "'\n");
+    unsigned written = cvpOut->serialize(file);
+    VERBOSE(errs() << "CVP: wrote " << written << " histograms.\n");
+    delete cvpOut;
+  }
+
+  // write the combined indirect call profile
+  if(fact.hasICallCP())
+  {
+    CombinedICallProfile* cipOut = fact.takeICallCP();
+    VERBOSE(errs() << "CIP: " << cipOut->getSiteCount() << " icall sites, "
+            << cipOut->size() << " targets\n");
+    VERBOSE(errs() << "Writing combined icall profile to '" 
+            << CPOutFile.c_str() << "'\n");
+    unsigned written = cipOut->serialize(file);
+    VERBOSE(errs() << "CIP: wrote " << written << " histograms.\n");
+    delete cipOut;
+  }
+
+  // write the combined context path profile
+  if(fact.hasContextPathCP())
+  {
+    CombinedContextPathProfile* cxpOut = fact.takeContextPathCP();
+    VERBOSE(errs() << "CXP: " << cxpOut->size() << " context paths\n");
+    VERBOSE(errs() << "Writing combined context path profile to '" 
+            << CPOutFile.c_str() << "'\n");
+    unsigned written = cxpOut->serialize(file);
+    VERBOSE(errs() << "CXP: wrote " << written << " histograms.\n");
+    delete cxpOut;
+  }
+
+  // write the combined loop path profile
+  if(fact.hasLoopPathCP())
+  {
+    CombinedLoopPathProfile* clpOut = fact.takeLoopPathCP();
+    VERBOSE(errs() << "CLP: " << clpOut->size() << " loop paths\n");
+    VERBOSE(errs() << "Writing combined loop path profile to '" 
+            << CPOutFile.c_str() << "'\n");
+    unsigned written = clpOut->serialize(file);
+    VERBOSE(errs() << "CLP: wrote " << written << " histograms.\n");
+    delete clpOut;
+  }
   
   fclose(file);
   